@@ -22,6 +22,7 @@
 #include "fx.h"
 #include <qptrlist.h>
 #include <qcstring.h>
+#include <qmemarray.h>
 
 struct DevInfo
 {
@@ -65,6 +66,387 @@ public:
 	}
 };
 
+class EchoThread : public QThread
+{
+public:
+	QIODevice *dev;
+	FXuint rounds, msgsize;
+	EchoThread(QIODevice *_dev, FXuint _rounds, FXuint _msgsize) : dev(_dev), rounds(_rounds), msgsize(_msgsize), QThread() { }
+	virtual void run()
+	{
+		char buffer[256];
+		dev->open(IO_ReadWrite);
+		for(FXuint n=0; n<rounds; n++)
+		{
+			for(FXuval read=0; read<msgsize; read+=dev->readBlock(buffer+read, msgsize-read));
+			dev->writeBlock(buffer, msgsize);
+		}
+	}
+	virtual void *cleanup()
+	{
+		return 0;
+	}
+};
+
+class ReadAllThread : public QThread
+{
+public:
+	QIODevice *dev;
+	QByteArray data;
+	ReadAllThread(QIODevice *_dev, FXuint len) : dev(_dev), data(len), QThread() { }
+	virtual void run()
+	{
+		for(FXuval read=0; read<data.size(); read+=dev->readBlock((char *) data.data()+read, data.size()-read));
+	}
+	virtual void *cleanup()
+	{
+		return 0;
+	}
+};
+
+class RandomReadThread : public QThread
+{
+public:
+	QIODevice *dev;
+	FXuint reads, blocksize, seed;
+	RandomReadThread(QIODevice *_dev, FXuint _reads, FXuint _blocksize, FXuint _seed) : dev(_dev), reads(_reads), blocksize(_blocksize), seed(_seed), QThread() { }
+	virtual void run()
+	{
+		char buffer[65536];
+		FXfval blocks=dev->size()/blocksize;
+		for(FXuint n=0; n<reads; n++)
+		{
+			seed=seed*1103515245+12345;
+			if(blocksize!=dev->readBlockFrom(buffer, blocksize, (seed % blocks)*blocksize))
+				fxerror("Error: Random read came up short!\n");
+		}
+	}
+	virtual void *cleanup()
+	{
+		return 0;
+	}
+};
+
+// Writes v compactly, checking it takes the expected number of bytes and reads back the same
+template<typename type> static bool compactRoundTrip(type v, FXuval bytes)
+{
+	QBuffer buffer;
+	buffer.open(IO_ReadWrite);
+	FXStream s(&buffer);
+	type r=0;
+	s.setCompact(true);
+	s << v;
+	s.flush();
+	if(buffer.size()!=bytes) return false;
+	s.position(0);
+	s >> r;
+	return r==v && s.atEnd();
+}
+
+// Returns true if reading a compact type from the bytes throws
+template<typename type> static bool compactReadThrows(const char *data, FXuint len)
+{
+	QByteArray in(len);
+	if(len) memcpy(in.data(), data, len);
+	QBuffer buffer(in);
+	buffer.open(IO_ReadOnly);
+	FXStream s(&buffer);
+	bool threw=false;
+	s.setCompact(true);
+	FXERRH_TRY
+	{
+		type v;
+		s >> v;
+	}
+	FXERRH_CATCH(FXException &)
+	{
+		threw=true;
+	}
+	FXERRH_ENDTRY
+	return threw;
+}
+
+/* Written by the reference lz4 tool (v1.9.4) from lz4ReferenceText(): a frame
+made with -B4 whose last block is stored uncompressed, a skippable frame, then
+a frame made with -B4 -BX --content-size -9 which has block checksums */
+static const FXuchar lz4reference[]={
+	0x04, 0x22, 0x4d, 0x18, 0x64, 0x40, 0xa7, 0x26, 0x03, 0x00, 0x00, 0xf1, 0x0e, 0x4c, 0x69, 0x6e,
+	0x65, 0x20, 0x30, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72,
+	0x65, 0x6e, 0x63, 0x65, 0x20, 0x74, 0x65, 0x78, 0x74, 0x0a, 0x1d, 0x00, 0x1f, 0x31, 0x1d, 0x00,
+	0x09, 0x1f, 0x32, 0x1d, 0x00, 0x09, 0x1f, 0x33, 0x1d, 0x00, 0x09, 0x1f, 0x34, 0x1d, 0x00, 0x09,
+	0x1f, 0x35, 0x1d, 0x00, 0x09, 0x1f, 0x36, 0x1d, 0x00, 0x09, 0x1f, 0x37, 0x1d, 0x00, 0x09, 0x1f,
+	0x38, 0x1d, 0x00, 0x09, 0x1f, 0x39, 0x1d, 0x00, 0x09, 0x1f, 0x31, 0x23, 0x01, 0x0b, 0x0f, 0x24,
+	0x01, 0x0a, 0x1f, 0x31, 0x25, 0x01, 0x0a, 0x1f, 0x31, 0x26, 0x01, 0x0a, 0x1f, 0x31, 0x27, 0x01,
+	0x0a, 0x1f, 0x31, 0x28, 0x01, 0x0a, 0x1f, 0x31, 0x29, 0x01, 0x0a, 0x1f, 0x31, 0x2a, 0x01, 0x0a,
+	0x1f, 0x31, 0x2b, 0x01, 0x0a, 0x1f, 0x31, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f,
+	0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32,
+	0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c,
+	0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01,
+	0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a,
+	0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f,
+	0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x34,
+	0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c,
+	0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01,
+	0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a,
+	0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f,
+	0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35,
+	0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c,
+	0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01,
+	0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a,
+	0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f,
+	0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37,
+	0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c,
+	0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01,
+	0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a,
+	0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f,
+	0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38,
+	0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c,
+	0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01,
+	0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x0f, 0xd1, 0x00, 0x0a, 0x0f,
+	0xd0, 0x00, 0x0a, 0x0f, 0xcf, 0x00, 0x0a, 0x0f, 0xce, 0x00, 0x0a, 0x0f, 0xcd, 0x00, 0x0a, 0x0f,
+	0xcc, 0x00, 0x0a, 0x0f, 0xcb, 0x00, 0x0a, 0x0f, 0xf6, 0x01, 0x0b, 0x0f, 0x37, 0x0b, 0x09, 0x0f,
+	0xf4, 0x01, 0x0a, 0x0f, 0x54, 0x0b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x61, 0x50, 0x69, 0x6e, 0x65, 0x20,
+	0x35, 0x2c, 0x01, 0x00, 0x80, 0xc6, 0x7e, 0x81, 0x6b, 0x4b, 0xfb, 0xe2, 0xfb, 0x54, 0xf6, 0xbd,
+	0xdf, 0x7c, 0x1c, 0xe1, 0x87, 0x01, 0xbf, 0x31, 0xde, 0x56, 0x72, 0x0f, 0x47, 0x67, 0x66, 0x87,
+	0x59, 0xaa, 0x88, 0x3c, 0x59, 0xea, 0x56, 0x13, 0x7b, 0xd2, 0x85, 0xa1, 0xd8, 0x3c, 0x54, 0x55,
+	0x2f, 0x37, 0xae, 0x65, 0x5b, 0xda, 0x02, 0x79, 0x98, 0xcc, 0xe3, 0x1a, 0x76, 0x8e, 0x5f, 0xd9,
+	0x99, 0x8f, 0x1f, 0x3f, 0x36, 0xee, 0x43, 0x78, 0x4d, 0x0d, 0xfa, 0xbe, 0xa6, 0xda, 0xe4, 0x86,
+	0x8e, 0xdc, 0x29, 0x6d, 0x4e, 0xff, 0x56, 0xe1, 0x70, 0x20, 0xfb, 0x8f, 0xb1, 0x58, 0x05, 0x90,
+	0xc5, 0x09, 0xdc, 0x53, 0xcd, 0xaa, 0x3b, 0x48, 0x99, 0x52, 0xd3, 0x52, 0x9d, 0x06, 0x9f, 0xea,
+	0xb5, 0xc2, 0x06, 0x13, 0x98, 0x49, 0xb2, 0x01, 0x1e, 0xac, 0x32, 0x88, 0x31, 0x9c, 0x52, 0x46,
+	0x95, 0x71, 0x36, 0x8f, 0x57, 0xf6, 0x39, 0x1d, 0x16, 0xfa, 0x88, 0x74, 0xf5, 0x98, 0x7c, 0x17,
+	0x5c, 0x41, 0xbb, 0x6d, 0x71, 0x8e, 0x0f, 0x70, 0x59, 0xc7, 0x01, 0x1b, 0x2f, 0x33, 0x3d, 0x91,
+	0xc0, 0x1d, 0xa5, 0x0d, 0x0d, 0xab, 0x33, 0x8d, 0x7e, 0x5e, 0x8f, 0x3e, 0xe6, 0x68, 0x74, 0xa6,
+	0x3a, 0xb1, 0xc3, 0x93, 0x11, 0xa8, 0x64, 0xc7, 0xdb, 0xca, 0xe0, 0x60, 0xe1, 0xf3, 0xbf, 0x09,
+	0x00, 0x67, 0xa2, 0xe3, 0x25, 0xa0, 0x21, 0x31, 0x87, 0xd5, 0x62, 0xc5, 0xa8, 0x4f, 0x7e, 0x2e,
+	0x09, 0x6b, 0x94, 0x9f, 0xb0, 0x6d, 0xa9, 0x9e, 0x5a, 0x0b, 0x46, 0x70, 0x80, 0xb6, 0xcf, 0x47,
+	0x0c, 0xa6, 0xa5, 0x2a, 0xd8, 0xac, 0xfb, 0xa0, 0xeb, 0xb7, 0x79, 0x24, 0x72, 0x23, 0x92, 0x48,
+	0x80, 0xc5, 0xa6, 0xa7, 0x85, 0xb7, 0xd7, 0x8c, 0x90, 0xe4, 0xab, 0x63, 0x44, 0x52, 0x66, 0xe3,
+	0x9c, 0x33, 0x25, 0xf9, 0x5e, 0xaa, 0xba, 0x73, 0x60, 0x5d, 0x4b, 0x71, 0x7e, 0xbe, 0xa9, 0x8c,
+	0x57, 0x19, 0x71, 0xc3, 0xca, 0x5e, 0xe5, 0x2a, 0x33, 0xac, 0x88, 0x51, 0x66, 0xa1, 0x7b, 0x75,
+	0x67, 0x64, 0x9a, 0x69, 0xef, 0x6f, 0x56, 0x42, 0xa0, 0x1d, 0x51, 0xc5, 0x02, 0xf7, 0xbb, 0x92,
+	0x45, 0x00, 0x00, 0x00, 0x00, 0x99, 0x38, 0x28, 0x75, 0x5a, 0x2a, 0x4d, 0x18, 0x06, 0x00, 0x00,
+	0x00, 0x54, 0x6e, 0x46, 0x4f, 0x58, 0x21, 0x04, 0x22, 0x4d, 0x18, 0x7c, 0x40, 0x2c, 0x01, 0x01,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x27, 0xf7, 0x02, 0x00, 0x00, 0xf1, 0x0e, 0x4c, 0x69, 0x6e, 0x65,
+	0x20, 0x30, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65,
+	0x6e, 0x63, 0x65, 0x20, 0x74, 0x65, 0x78, 0x74, 0x0a, 0x1d, 0x00, 0x1f, 0x31, 0x1d, 0x00, 0x09,
+	0x1f, 0x32, 0x1d, 0x00, 0x09, 0x1f, 0x33, 0x1d, 0x00, 0x09, 0x1f, 0x34, 0x1d, 0x00, 0x09, 0x1f,
+	0x35, 0x1d, 0x00, 0x09, 0x1f, 0x36, 0x1d, 0x00, 0x09, 0x1f, 0x37, 0x1d, 0x00, 0x09, 0x1f, 0x38,
+	0x1d, 0x00, 0x09, 0x1f, 0x39, 0x05, 0x01, 0x0a, 0x0f, 0x23, 0x01, 0x0b, 0x0f, 0x24, 0x01, 0x0a,
+	0x1f, 0x31, 0x25, 0x01, 0x0a, 0x1f, 0x31, 0x26, 0x01, 0x0a, 0x1f, 0x31, 0x27, 0x01, 0x0a, 0x1f,
+	0x31, 0x28, 0x01, 0x0a, 0x1f, 0x31, 0x29, 0x01, 0x0a, 0x1f, 0x31, 0x2a, 0x01, 0x0a, 0x1f, 0x31,
+	0x2b, 0x01, 0x0a, 0x1f, 0x31, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x50,
+	0x02, 0x0b, 0x0f, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a,
+	0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f,
+	0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x32, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33,
+	0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x7d, 0x03, 0x0b, 0x0f, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01,
+	0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a,
+	0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x33, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f,
+	0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0xaa, 0x04, 0x0b, 0x0f, 0x2c,
+	0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01,
+	0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x34, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a,
+	0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f,
+	0x35, 0xd7, 0x05, 0x0b, 0x0f, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c,
+	0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x35, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01,
+	0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a,
+	0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x04, 0x07, 0x0b, 0x0f, 0x2c, 0x01, 0x0a, 0x1f, 0x36,
+	0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x36, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c,
+	0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01,
+	0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x31, 0x08, 0x0b,
+	0x0f, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x37, 0x2c, 0x01, 0x0a, 0x1f, 0x38,
+	0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c,
+	0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01,
+	0x0a, 0x1f, 0x38, 0x5e, 0x09, 0x0b, 0x0f, 0x2c, 0x01, 0x0a, 0x1f, 0x38, 0x2c, 0x01, 0x0a, 0x1f,
+	0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39,
+	0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c, 0x01, 0x0a, 0x1f, 0x39, 0x2c,
+	0x01, 0x05, 0x0f, 0x54, 0x0b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x89, 0x50, 0x69, 0x6e, 0x65, 0x20,
+	0x35, 0x48, 0xb2, 0x56, 0x0e, 0x2c, 0x01, 0x00, 0x80, 0xc6, 0x7e, 0x81, 0x6b, 0x4b, 0xfb, 0xe2,
+	0xfb, 0x54, 0xf6, 0xbd, 0xdf, 0x7c, 0x1c, 0xe1, 0x87, 0x01, 0xbf, 0x31, 0xde, 0x56, 0x72, 0x0f,
+	0x47, 0x67, 0x66, 0x87, 0x59, 0xaa, 0x88, 0x3c, 0x59, 0xea, 0x56, 0x13, 0x7b, 0xd2, 0x85, 0xa1,
+	0xd8, 0x3c, 0x54, 0x55, 0x2f, 0x37, 0xae, 0x65, 0x5b, 0xda, 0x02, 0x79, 0x98, 0xcc, 0xe3, 0x1a,
+	0x76, 0x8e, 0x5f, 0xd9, 0x99, 0x8f, 0x1f, 0x3f, 0x36, 0xee, 0x43, 0x78, 0x4d, 0x0d, 0xfa, 0xbe,
+	0xa6, 0xda, 0xe4, 0x86, 0x8e, 0xdc, 0x29, 0x6d, 0x4e, 0xff, 0x56, 0xe1, 0x70, 0x20, 0xfb, 0x8f,
+	0xb1, 0x58, 0x05, 0x90, 0xc5, 0x09, 0xdc, 0x53, 0xcd, 0xaa, 0x3b, 0x48, 0x99, 0x52, 0xd3, 0x52,
+	0x9d, 0x06, 0x9f, 0xea, 0xb5, 0xc2, 0x06, 0x13, 0x98, 0x49, 0xb2, 0x01, 0x1e, 0xac, 0x32, 0x88,
+	0x31, 0x9c, 0x52, 0x46, 0x95, 0x71, 0x36, 0x8f, 0x57, 0xf6, 0x39, 0x1d, 0x16, 0xfa, 0x88, 0x74,
+	0xf5, 0x98, 0x7c, 0x17, 0x5c, 0x41, 0xbb, 0x6d, 0x71, 0x8e, 0x0f, 0x70, 0x59, 0xc7, 0x01, 0x1b,
+	0x2f, 0x33, 0x3d, 0x91, 0xc0, 0x1d, 0xa5, 0x0d, 0x0d, 0xab, 0x33, 0x8d, 0x7e, 0x5e, 0x8f, 0x3e,
+	0xe6, 0x68, 0x74, 0xa6, 0x3a, 0xb1, 0xc3, 0x93, 0x11, 0xa8, 0x64, 0xc7, 0xdb, 0xca, 0xe0, 0x60,
+	0xe1, 0xf3, 0xbf, 0x09, 0x00, 0x67, 0xa2, 0xe3, 0x25, 0xa0, 0x21, 0x31, 0x87, 0xd5, 0x62, 0xc5,
+	0xa8, 0x4f, 0x7e, 0x2e, 0x09, 0x6b, 0x94, 0x9f, 0xb0, 0x6d, 0xa9, 0x9e, 0x5a, 0x0b, 0x46, 0x70,
+	0x80, 0xb6, 0xcf, 0x47, 0x0c, 0xa6, 0xa5, 0x2a, 0xd8, 0xac, 0xfb, 0xa0, 0xeb, 0xb7, 0x79, 0x24,
+	0x72, 0x23, 0x92, 0x48, 0x80, 0xc5, 0xa6, 0xa7, 0x85, 0xb7, 0xd7, 0x8c, 0x90, 0xe4, 0xab, 0x63,
+	0x44, 0x52, 0x66, 0xe3, 0x9c, 0x33, 0x25, 0xf9, 0x5e, 0xaa, 0xba, 0x73, 0x60, 0x5d, 0x4b, 0x71,
+	0x7e, 0xbe, 0xa9, 0x8c, 0x57, 0x19, 0x71, 0xc3, 0xca, 0x5e, 0xe5, 0x2a, 0x33, 0xac, 0x88, 0x51,
+	0x66, 0xa1, 0x7b, 0x75, 0x67, 0x64, 0x9a, 0x69, 0xef, 0x6f, 0x56, 0x42, 0xa0, 0x1d, 0x51, 0xc5,
+	0x02, 0xf7, 0xbb, 0x92, 0x45, 0xe4, 0x98, 0x97, 0x54, 0x00, 0x00, 0x00, 0x00, 0x99, 0x38, 0x28,
+	0x75
+};
+static const FXuval lz4referencechecksummed=1143;		// Where the second frame starts
+
+static QByteArray lz4ReferenceText()
+{
+	const FXuint textlen=65536, randomlen=300;
+	QByteArray ret(textlen+randomlen);
+	char line[64];
+	for(FXuint n=0, idx=0; idx<textlen; n++)
+	{
+		FXuint len=(FXuint) sprintf(line, "Line %u of the reference text\n", n % 97);
+		if(len>textlen-idx) len=textlen-idx;
+		memcpy(ret.data()+idx, line, len);
+		idx+=len;
+	}
+	FXuint seed=1;
+	for(FXuint n=0; n<randomlen; n++)
+	{
+		seed=seed*1103515245+12345;
+		ret[textlen+n]=(FXuchar)(seed>>16);
+	}
+	return ret;
+}
+
+// Decompresses len bytes of .lz4 data into out, returning false if the device threw
+static bool lz4Decompress(QByteArray &out, const FXuchar *data, FXuval len)
+{
+	QByteArray in((FXuint) len);
+	if(len) memcpy(in.data(), data, len);
+	QBuffer src(in);
+	QLZ4Device dev(&src);
+	bool ok=true;
+	out.resize(0);
+	FXERRH_TRY
+	{
+		char buffer[16384];
+		FXuval read;
+		dev.open(IO_ReadOnly);
+		while((read=dev.readBlock(buffer, sizeof(buffer))))
+		{
+			FXuint outlen=out.size();
+			out.resize(outlen+(FXuint) read);
+			memcpy(out.data()+outlen, buffer, read);
+		}
+	}
+	FXERRH_CATCH(FXException &)
+	{
+		ok=false;
+	}
+	FXERRH_ENDTRY
+	return ok;
+}
+
+// Returns true if out is the start of the two copies of text in lz4reference
+static bool lz4IsReferencePrefix(const QByteArray &out, const QByteArray &text)
+{
+	FXuint outlen=out.size(), textlen=text.size();
+	if(outlen>2*textlen) return false;
+	if(!outlen) return true;
+	if(memcmp(out.data(), text.data(), FXMIN(outlen, textlen))) return false;
+	return outlen<=textlen || !memcmp(out.data()+textlen, text.data(), outlen-textlen);
+}
+
+// Stalls inside truncate() or atEnd(), which call at() and getch() with the file's lock held
+class StallingFile : public QFile
+{
+	void stallHere()
+	{
+		if(stall)
+		{
+			stall=false;
+			stalled.wakeAll();
+			release.wait();
+		}
+	}
+public:
+	QWaitCondition stalled, release;
+	bool stall;
+	StallingFile(const FXString &name) : QFile(name), stall(false) { }
+	using QFile::at;
+	virtual bool at(FXfval newpos)
+	{
+		stallHere();
+		return QFile::at(newpos);
+	}
+	virtual int getch()
+	{
+		stallHere();
+		return QFile::getch();
+	}
+};
+
+class StallThread : public QThread
+{
+public:
+	QFile *file;
+	FXfval size;
+	// Truncates to size, or if zero checks for the end
+	StallThread(QFile *_file, FXfval _size) : file(_file), size(_size), QThread() { }
+	virtual void run()
+	{
+		if(size)
+			file->truncate(size);
+		else
+			file->atEnd();
+	}
+	virtual void *cleanup()
+	{
+		return 0;
+	}
+};
+
+class PositionalIOThread : public QThread
+{
+public:
+	QIODevice *dev;
+	FXuint blocks;
+	bool write;
+	PositionalIOThread(QIODevice *_dev, FXuint _blocks, bool _write) : dev(_dev), blocks(_blocks), write(_write), QThread() { }
+	virtual void run()
+	{
+		char buffer[4096];
+		for(FXuint n=0; n<blocks; n++)
+		{
+			if(sizeof(buffer)!=dev->readBlockFrom(buffer, sizeof(buffer), n*sizeof(buffer)))
+				fxerror("Error: Positional read came up short!\n");
+			if(write && sizeof(buffer)!=dev->writeBlockTo(n*sizeof(buffer), buffer, sizeof(buffer)))
+				fxerror("Error: Positional write came up short!\n");
+		}
+	}
+	virtual void *cleanup()
+	{
+		return 0;
+	}
+};
+
 int main(int argc, char *argv[])
 {
 	int ret=0;
@@ -130,6 +512,72 @@ int main(int argc, char *argv[])
 			if(buffer2h.size()!=bufferh.size()*2)
 				fxerror("Endian conversion and mixed read-writes test failed\n");
 
+			fxmessage("\nCompact integer encoding test:\n"
+					  "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+			if(!compactRoundTrip<FXuint>(0, 1) || !compactRoundTrip<FXuint>(127, 1) || !compactRoundTrip<FXuint>(128, 2)
+				|| !compactRoundTrip<FXuint>(16383, 2) || !compactRoundTrip<FXuint>(16384, 3)
+				|| !compactRoundTrip<FXushort>(0xffff, 3) || !compactRoundTrip<FXuint>(0xffffffff, 5)
+				|| !compactRoundTrip<FXulong>((FXulong)-1, 10))
+				fxerror("FAILED, unsigned variable length integers did not read back!\n");
+			if(!compactRoundTrip<FXint>(-1, 1) || !compactRoundTrip<FXint>(-64, 1) || !compactRoundTrip<FXint>(-65, 2)
+				|| !compactRoundTrip<FXshort>(-32768, 3) || !compactRoundTrip<FXshort>(32767, 3)
+				|| !compactRoundTrip<FXint>(-2147483647-1, 5) || !compactRoundTrip<FXint>(2147483647, 5)
+				|| !compactRoundTrip<FXlong>((FXlong)((FXulong) 1<<63), 10) || !compactRoundTrip<FXlong>((FXlong)(((FXulong) 1<<63)-1), 10))
+				fxerror("FAILED, zigzagged variable length integers did not read back!\n");
+			// Truncated must throw rather than read past the end
+			if(!compactReadThrows<FXuint>("", 0) || !compactReadThrows<FXuint>("\x80", 1) || !compactReadThrows<FXushort>("\xff\xff", 2)
+				|| !compactReadThrows<FXulong>("\xff\xff\xff\xff\xff\xff\xff\xff\xff", 9))
+				fxerror("FAILED, truncated variable length integers did not throw!\n");
+			// As must anything too big for its type
+			if(!compactReadThrows<FXushort>("\x80\x80\x04", 3) || !compactReadThrows<FXshort>("\x80\x80\x04", 3)
+				|| !compactReadThrows<FXuint>("\x80\x80\x80\x80\x10", 5)
+				|| !compactReadThrows<FXulong>("\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02", 10)
+				|| !compactReadThrows<FXulong>("\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", 11))
+				fxerror("FAILED, over-long variable length integers did not throw!\n");
+			fxmessage("Test passed!\n");
+
+			fxmessage("\nBuffered stream test:\n"
+					  "-=-=-=-=-=-=-=-=-=-=-\n");
+			QBuffer buffer3h;
+			buffer3h.open(IO_ReadWrite);
+			FXStream sbuffer3h(&buffer3h);
+			sbuffer3h.setBufferSize(61);	// Deliberately odd so items straddle the buffer
+			for(buffer2h.at(0); !sbuffer2h.atEnd(); )
+			{
+				FXulong c;
+				FXuint i;
+				FXushort s1;
+				FXuchar b;
+				sbuffer2h >> c;
+				b=(FXuchar) c;
+				sbuffer3h << b << c << (FXuint) c << (FXushort) c;
+				sbuffer3h.rewind(6);
+				sbuffer3h >> i >> s1;
+				if(i!=(FXuint) c || s1!=(FXushort) c)
+					fxerror("Buffered stream mixed read-writes failed\n");
+				sbuffer3h.rewind(6);
+				sbuffer3h << s1 << i;
+			}
+			if(sbuffer3h.position()!=(FXlong) buffer2h.size()*15/8)
+				fxerror("Buffered stream position is wrong\n");
+			sbuffer3h.flush();
+			if(buffer3h.size()!=buffer2h.size()*15/8)
+				fxerror("Buffered stream flush failed\n");
+			for(buffer2h.at(0), sbuffer3h.position(0); !sbuffer2h.atEnd(); )
+			{
+				FXulong c, c2;
+				FXuint i;
+				FXushort s1;
+				FXuchar b;
+				sbuffer2h >> c;
+				sbuffer3h >> b >> c2 >> s1 >> i;
+				if(b!=(FXuchar) c || c2!=c || s1!=(FXushort) c || i!=(FXuint) c)
+					fxerror("Buffered stream readback failed\n");
+			}
+			if(!sbuffer3h.atEnd())
+				fxerror("Buffered stream readback failed\n");
+			fxmessage("Test passed!\n");
+
 			QBuffer temp;
 			temp.open(IO_ReadWrite);
 			FXStream stemp(&temp);
@@ -174,6 +622,136 @@ int main(int argc, char *argv[])
 				} while(read);
 			}
 
+			fxmessage("\nStreaming GZip device test:\n"
+					    "-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+			{
+				QFile streamed("../IOTestOutputStream.gz");
+				QGZipDevice gzipstream(&streamed, true, 65536);
+				gzipstream.open(IO_WriteOnly);
+				gzipstream.writeBlock(temp.buffer().data(), temp.size());
+				gzipstream.close();
+				streamed.close();
+				fxmessage("Data gzipped incrementally is %u bytes long\n", (FXuint) streamed.size());
+				gzipstream.open(IO_ReadOnly);
+				if(gzipstream.size()!=temp.size())
+					fxerror("FAILED, streamed size from trailer is not same as original size!\n");
+				char buffer[16384];
+				FXuval idx=0, read;
+				do
+				{
+					if(memcmp(buffer, temp.buffer().data()+idx, read=gzipstream.readBlock(buffer, sizeof(buffer))))
+						fxerror("FAILED, original data is not same as streamed decompressed data at %u!\n", (FXuint) idx);
+					idx+=read;
+				} while(read);
+				if(idx!=temp.size() || gzipstream.size()!=temp.size())
+					fxerror("FAILED, original size is not same as streamed decompressed size!\n");
+				FXuint time=FXProcess::getMsCount();
+				for(int n=0; n<1000; n++)
+				{
+					FXuval pos=rand() % (temp.size()-sizeof(buffer));
+					if(sizeof(buffer)!=gzipstream.readBlockFrom(buffer, sizeof(buffer), pos) || memcmp(buffer, temp.buffer().data()+pos, sizeof(buffer)))
+						fxerror("FAILED, random read of streamed data at %u is different!\n", (FXuint) pos);
+				}
+				fxmessage("1000 random reads took %u ms\n", FXProcess::getMsCount()-time);
+			}
+			{	// Uncompressed data read through a streaming device passes through with its real size
+				QFile plain("../IOTestOutputPlain.txt");
+				plain.open(IO_WriteOnly);
+				plain.writeBlock(temp.buffer().data(), temp.size());
+				plain.close();
+				QGZipDevice gzipplain(&plain, true);
+				gzipplain.open(IO_ReadOnly);
+				if(gzipplain.size()!=temp.size())
+					fxerror("FAILED, uncompressed data through streaming device has wrong size!\n");
+				char buffer[16384];
+				FXuval pos=temp.size()/2;
+				if(sizeof(buffer)!=gzipplain.readBlockFrom(buffer, sizeof(buffer), pos) || memcmp(buffer, temp.buffer().data()+pos, sizeof(buffer)))
+					fxerror("FAILED, uncompressed data through streaming device is different!\n");
+			}
+
+			fxmessage("\nParallel GZip device test:\n"
+					    "-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+			{
+				QFile parallel("../IOTestOutputParallel.gz");
+				QGZipDevice gzipparallel(&parallel, true);
+				gzipparallel.setParallelCompression(256*1024);
+				gzipparallel.open(IO_WriteOnly);
+				FXuint time=FXProcess::getMsCount();
+				gzipparallel.writeBlock(temp.buffer().data(), temp.size());
+				gzipparallel.close();
+				fxmessage("Data gzipped in parallel is %u bytes long and took %u ms\n", (FXuint) parallel.size(), FXProcess::getMsCount()-time);
+				parallel.close();
+				gzipparallel.open(IO_ReadOnly);
+				char buffer[16384];
+				FXuval idx=0, read;
+				do
+				{
+					if(memcmp(buffer, temp.buffer().data()+idx, read=gzipparallel.readBlock(buffer, sizeof(buffer))))
+						fxerror("FAILED, original data is not same as parallel decompressed data at %u!\n", (FXuint) idx);
+					idx+=read;
+				} while(read);
+				if(idx!=temp.size())
+					fxerror("FAILED, original size is not same as parallel decompressed size!\n");
+			}
+
+			fxmessage("\nLZ4 device test:\n"
+					    "-=-=-=-=-=-=-=-=\n");
+			{
+				QFile lz4ed("../IOTestOutput.lz4");
+				QLZ4Device lz4dev(&lz4ed);
+				lz4dev.open(IO_WriteOnly);
+				FXuint time=FXProcess::getMsCount();
+				lz4dev.writeBlock(temp.buffer().data(), temp.size());
+				lz4dev.close();
+				fxmessage("Data lz4ed is %u bytes long and took %u ms\n", (FXuint) lz4ed.size(), FXProcess::getMsCount()-time);
+				lz4ed.close();
+				fxmessage("Test file saved out as '%s' - try testing it with the lz4 utility\n", lz4ed.name().text());
+				lz4dev.open(IO_ReadOnly);
+				char buffer[16384];
+				FXuval idx=0, read;
+				time=FXProcess::getMsCount();
+				do
+				{
+					if(memcmp(buffer, temp.buffer().data()+idx, read=lz4dev.readBlock(buffer, sizeof(buffer))))
+						fxerror("FAILED, original data is not same as lz4 decompressed data at %u!\n", (FXuint) idx);
+					idx+=read;
+				} while(read);
+				fxmessage("Decompressing took %u ms\n", FXProcess::getMsCount()-time);
+				if(idx!=temp.size() || lz4dev.size()!=temp.size())
+					fxerror("FAILED, original size is not same as lz4 decompressed size!\n");
+				time=FXProcess::getMsCount();
+				for(int n=0; n<1000; n++)
+				{
+					FXuval pos=rand() % (temp.size()-sizeof(buffer));
+					if(sizeof(buffer)!=lz4dev.readBlockFrom(buffer, sizeof(buffer), pos) || memcmp(buffer, temp.buffer().data()+pos, sizeof(buffer)))
+						fxerror("FAILED, random read of lz4 data at %u is different!\n", (FXuint) pos);
+				}
+				fxmessage("1000 random reads took %u ms\n", FXProcess::getMsCount()-time);
+			}
+			{	// Frames written by the lz4 tool, whole and damaged
+				QByteArray text=lz4ReferenceText(), out, damaged(sizeof(lz4reference));
+				if(!lz4Decompress(out, lz4reference, sizeof(lz4reference)) || out.size()!=2*text.size() || !lz4IsReferencePrefix(out, text))
+					fxerror("FAILED, data written by the lz4 tool decompressed wrongly!\n");
+				if(lz4Decompress(out, lz4reference, 400))
+					fxerror("FAILED, truncated block was not detected!\n");
+				// Cut short anywhere it must throw or lose only what was cut off
+				for(FXuval len=0; len<sizeof(lz4reference); len++)
+				{
+					if(lz4Decompress(out, lz4reference, len) && !lz4IsReferencePrefix(out, text))
+						fxerror("FAILED, lz4 data truncated to %u bytes decompressed wrongly!\n", (FXuint) len);
+				}
+				// Damaged anywhere it must not fault, and where blocks have checksums it must throw
+				// or lose only what follows the damage
+				for(FXuval pos=0; pos<sizeof(lz4reference); pos++)
+				{
+					memcpy(damaged.data(), lz4reference, sizeof(lz4reference));
+					damaged[(FXuint) pos]^=0xFF;
+					if(lz4Decompress(out, damaged.data(), sizeof(lz4reference)) && pos>=lz4referencechecksummed && !lz4IsReferencePrefix(out, text))
+						fxerror("FAILED, lz4 data damaged at %u decompressed wrongly!\n", (FXuint) pos);
+				}
+				fxmessage("Data written by the lz4 tool decompressed correctly, and truncated or damaged was handled\n");
+			}
+
 			fxmessage("\nBZip2 device test:\n"
 					    "-=-=-=-=-=-=-=-=-\n");
 			QFile bzipped("../IOTestOutput.bz2");
@@ -229,12 +807,24 @@ int main(int argc, char *argv[])
 				buff->truncate(testsize);
 				devs.append(new DevInfo("QBuffer", buff));
 			}
+			if(1) {	// Not presized, as growing a segmented buffer doesn't copy
+				QBuffer *buff=new QBuffer;
+				buff->setSegmented(true);
+				buff->open(IO_WriteOnly);
+				devs.append(new DevInfo("QBuffer (segmented)", buff));
+			}
 			if(1) {
 				QLocalPipe *p=new QLocalPipe;
 				p->setGranularity(1024*1024);
 				devs.append(new DevInfo("QLocalPipe", new QLocalPipe(p->clientEnd()), p));
 				p->open(IO_WriteOnly);
 			}
+			if(1) {
+				QLocalPipe *p=new QLocalPipe;
+				p->setRingSize(1024*1024);
+				devs.append(new DevInfo("QLocalPipe (ring)", new QLocalPipe(p->clientEnd()), p));
+				p->open(IO_WriteOnly);
+			}
 			if(1) {
 				QPipe *r=new QPipe("TestPipe", true), *w=new QPipe("TestPipe", true);
 				w->create(IO_WriteOnly);
@@ -323,6 +913,127 @@ int main(int argc, char *argv[])
 			}
 		}
 
+		if(1)
+		{
+			const FXuint rounds=100000, msgsize=16;
+			fxmessage("\nLatency test:\n"
+					    "-=-=-=-=-=-=-\n");
+			for(int n=0; n<3; n++)
+			{
+				QIODeviceS *me, *them;
+				if(n<2)
+				{
+					QLocalPipe *p=new QLocalPipe;
+					if(n) p->setRingSize();
+					me=p; them=new QLocalPipe(p->clientEnd());
+				}
+				else
+				{
+					QPipe *p=new QPipe("TestLatencyPipe");
+					me=p; them=new QPipe("TestLatencyPipe");
+				}
+				me->create(IO_ReadWrite);
+				EchoThread *t=new EchoThread(them, rounds, msgsize);
+				t->start(true);
+				// Make definitely sure the other end is open
+				QThread::msleep(100);
+				char buffer[256];
+				memset(buffer, 0, sizeof(buffer));
+				FXuint time=FXProcess::getMsCount();
+				for(FXuint i=0; i<rounds; i++)
+				{
+					me->writeBlock(buffer, msgsize);
+					for(FXuval read=0; read<msgsize; read+=me->readBlock(buffer+read, msgsize-read));
+				}
+				double taken=(FXProcess::getMsCount()-time)/1000.0;
+				t->wait();
+				fxmessage("%s: %u round trips of %u bytes took %f seconds, average round trip=%fus\n",
+					(n<2) ? ((n) ? "QLocalPipe (ring)" : "QLocalPipe") : "QPipe", rounds, msgsize, taken, taken*1000000/rounds);
+				delete t;
+				FXDELETE(them);
+				FXDELETE(me);
+			}
+		}
+
+		if(1)
+		{
+			const FXuint idle=10000, active=100, rounds=10000;
+			fxmessage("\nWait set test:\n"
+					    "-=-=-=-=-=-=-=-\n");
+			QMemArray<QIODeviceS *> list;
+			QBlkSocket *s=0;
+			FXERRH_TRY
+			{
+				for(; list.size()<idle+active; s=0)
+				{
+					s=new QBlkSocket(QBlkSocket::Datagram);
+					s->create(IO_ReadOnly);
+					list.push_back(s);
+				}
+			}
+			FXERRH_CATCH(FXException &)
+			{	// Almost certainly out of handles
+				delete s;
+			}
+			FXERRH_ENDTRY
+			FXuint no=(FXuint) list.size(), noactive=FXMIN(active, no/10);
+			fxmessage("Created %u datagram sockets of which the last %u are active (raise the handle limit to test more)\n", no, noactive);
+			QBlkSocket sender(QHOSTADDRESS_LOCALHOST, ((QBlkSocket *) list.at(0))->port(), QBlkSocket::Datagram);
+			sender.open(IO_WriteOnly);
+			QIODeviceSWaitSet set;
+			FXuint time=FXProcess::getMsCount();
+			for(FXuint n=0; n<no; n++)
+				set.add(list.at(n));
+			fxmessage("Adding them to a QIODeviceSWaitSet took %u ms\n", FXProcess::getMsCount()-time);
+			QMemArray<QIODeviceS *> signalled(no);
+			char buffer[64];
+			for(int method=0; method<2; method++)
+			{
+				FXuint myrounds=(method) ? rounds/100 : rounds;
+				time=FXProcess::getMsCount();
+				for(FXuint i=0; i<myrounds; i++)
+				{
+					QBlkSocket *to=(QBlkSocket *) list.at(no-1-(FXuint)(noactive*(FXulong) rand()/((FXulong) RAND_MAX+1)));
+					sender.setRequestedAddressAndPort(QHOSTADDRESS_LOCALHOST, to->port());
+					sender.writeBlock(buffer, sizeof(buffer));
+					FXuint ready=0;
+					if(method)
+					{
+						if(QIODeviceS::waitForData(signalled.data(), no, list.data()))
+							for(; ready<no && signalled.at(ready); ready++);
+					}
+					else
+						ready=set.wait(signalled.data(), no);
+					if(1!=ready || signalled.at(0)!=to)
+						fxerror("FAILED: Wrong socket signalled!\n");
+					to->readBlock(buffer, sizeof(buffer));
+				}
+				double taken=(FXProcess::getMsCount()-time)/1000.0;
+				fxmessage("%s: %u waits took %f seconds, average wait=%fus\n",
+					(method) ? "QIODeviceS::waitForData()" : "QIODeviceSWaitSet", myrounds, taken, taken*1000000/myrounds);
+			}
+			{	// Devices sharing one OS handle are all signalled, by both methods
+				QBlkSocket *to=(QBlkSocket *) list.at(no-1);
+				QSSLDevice ssl(to);
+				QIODeviceS *pair[3]={ to, &ssl, to };
+				set.add(&ssl);
+				sender.setRequestedAddressAndPort(QHOSTADDRESS_LOCALHOST, to->port());
+				sender.writeBlock(buffer, sizeof(buffer));
+				if(2!=set.wait(signalled.data(), no) || signalled.at(0)==signalled.at(1)
+					|| (signalled.at(0)!=to && signalled.at(0)!=&ssl) || (signalled.at(1)!=to && signalled.at(1)!=&ssl))
+					fxerror("FAILED: Devices sharing a handle weren't both signalled!\n");
+				if(!QIODeviceS::waitForData(signalled.data(), 3, pair, 0) || !signalled.at(0))
+					fxerror("FAILED: Devices sharing a handle weren't signalled!\n");
+				set.remove(&ssl);
+				if(1!=set.wait(signalled.data(), no) || signalled.at(0)!=to)
+					fxerror("FAILED: Wrong socket signalled!\n");
+				to->readBlock(buffer, sizeof(buffer));
+			}
+			set.clear();
+			for(FXuint n=0; n<no; n++)
+				delete list.at(n);
+		}
+
 		if(1)
 		{
 			fxmessage("\nStippled i/o test:\n"
@@ -363,6 +1074,336 @@ int main(int argc, char *argv[])
 				fxmessage("Test passed!\n");
 		}
 
+		if(1)
+		{
+			fxmessage("\nQMemMap vs QFile scan test:\n"
+						"-=-=-=-=-=-=-=-=-=-=-=-=-=-=\n");
+			const FXuint testsize=64*1024*1024, reads=16384, blocksize=4096;
+			FXuint origCRC=0;
+			{
+				QFile fh("../BigFile.txt");
+				FXuint tbuffer[16384/4];
+				fh.open(IO_WriteOnly);
+				for(FXuint n=0; n<testsize; n+=sizeof(tbuffer))
+				{
+					for(int i=0; i<16384/4; i++)
+						tbuffer[i]=rand();
+					fh.writeBlock((char *) tbuffer, sizeof(tbuffer));
+					origCRC=fxadler32(origCRC, (FXuchar *) tbuffer, sizeof(tbuffer));
+				}
+			}
+			static const char *names[5]={ "QFile", "QMemMap (all mapped)", "QMemMap (all mapped, access hints)", "QMemMap (4Mb sliding window, prefaulted)", "QFile (mapped)" };
+			QByteArray buffer(65536);
+			for(int d=0; d<5; d++)
+			{
+				QFile fh("../BigFile.txt");
+				QMemMap mm("../BigFile.txt");
+				QIODevice *dev=(d && d<4) ? (QIODevice *) &mm : (QIODevice *) &fh;
+				if(4==d)
+					fh.setMapThreshold(1024*1024);
+				if(3==d)
+				{
+					mm.setWindowSize(4*1024*1024);
+					mm.setPrefault(true);
+				}
+				dev->open(IO_ReadOnly);
+				if(1==d || 2==d) mm.mapIn();
+				if(2==d) mm.advise(QMemMap::SequentialAccess);
+				FXuint crc=0, time=FXProcess::getMsCount();
+				FXuval read;
+				while((read=dev->readBlock((char *) buffer.data(), buffer.size())))
+					crc=fxadler32(crc, buffer.data(), read);
+				double taken=(FXProcess::getMsCount()-time)/1000.0;
+				if(taken<0.001) taken=0.001;
+				if(crc!=origCRC) fxerror("FAILED: Data read by %s was corrupted!\n", names[d]);
+				if(4==d && (!fh.isMapped() || fxadler32(0, (const FXuchar *) fh.view(0, testsize), testsize)!=origCRC))
+					fxerror("FAILED: Zero copy view of file was wrong!\n");
+				fxmessage("Sequential scan using %s took %f seconds (%dKb/sec)\n", names[d], taken, (FXuint)((testsize/1024)/taken));
+				if(2==d) mm.advise(QMemMap::RandomAccess);
+				time=FXProcess::getMsCount();
+				for(FXuint n=0; n<reads; n++)
+					dev->readBlockFrom((char *) buffer.data(), blocksize, (FXfval)((FXulong) rand()*(testsize-blocksize)/RAND_MAX));
+				taken=(FXProcess::getMsCount()-time)/1000.0;
+				if(taken<0.001) taken=0.001;
+				fxmessage("%u random %u byte reads using %s took %f seconds (%dKb/sec)\n", reads, blocksize, names[d],
+					taken, (FXuint)(((FXlong) reads*blocksize/1024)/taken));
+			}
+			fxmessage("Test passed!\n");
+		}
+
+		if(1)
+		{
+			fxmessage("\nQFile buffered serialisation test:\n"
+						"-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+			static const FXuint items=2*1024*1024;
+			static const FXuval bufsizes[2]={ 0, 64*1024 };
+			for(int b=0; b<2; b++)
+			{
+				QFile fh("../BigFile.txt");
+				fh.setBufferSize(bufsizes[b]);
+				fh.open(IO_ReadWrite|IO_Truncate);
+				FXStream s(&fh);
+				FXuint n, time=FXProcess::getMsCount();
+				for(n=0; n<items; n++)
+					s << n << (FXushort) n << (FXuchar) n;
+				fh.flush();
+				double wtaken=(FXProcess::getMsCount()-time)/1000.0;
+				if(fh.size()!=(FXfval) items*7)
+					fxerror("Error: Serialised file is the wrong size!\n");
+				fh.at(0);
+				time=FXProcess::getMsCount();
+				for(n=0; n<items; n++)
+				{
+					FXuint i; FXushort sh; FXuchar c;
+					s >> i >> sh >> c;
+					if(i!=n || sh!=(FXushort) n || c!=(FXuchar) n)
+						fxerror("Error: Serialised data read back wrongly!\n");
+				}
+				// Now check scatter/gather i/o agrees with the above
+				char plain[14], recs[2][7];
+				QIODevice::IOVec segs[2]={ QIODevice::IOVec(recs[0], 7), QIODevice::IOVec(recs[1], 7) };
+				fh.readBlockFrom(plain, 14, 7*1000);
+				fh.at(7*1000);
+				if(fh.readBlockV(segs, 2)!=14 || memcmp(plain, recs[0], 7) || memcmp(plain+7, recs[1], 7))
+					fxerror("Error: Vectored read failed!\n");
+				fh.at(0);
+				if(fh.writeBlockV(segs, 2)!=14)
+					fxerror("Error: Vectored write failed!\n");
+				fh.at(0);
+				s >> n;
+				if(n!=1000)
+					fxerror("Error: Vectored write failed!\n");
+				double rtaken=(FXProcess::getMsCount()-time)/1000.0;
+				if(wtaken<0.001) wtaken=0.001;
+				if(rtaken<0.001) rtaken=0.001;
+				fxmessage("With a %u byte buffer writing took %f seconds (%dKb/sec), reading took %f seconds (%dKb/sec)\n",
+					(FXuint) fh.bufferSize(), wtaken, (FXuint)(((FXlong) items*7/1024)/wtaken), rtaken, (FXuint)(((FXlong) items*7/1024)/rtaken));
+			}
+			fxmessage("Test passed!\n");
+
+			fxmessage("\nDevice to device transfer test:\n"
+						"-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+			QFile src("../BigFile.txt"), dest("../BigFile2.txt");
+			QBuffer pumped, copied;
+			src.open(IO_ReadOnly);
+			dest.open(IO_ReadWrite|IO_Truncate);
+			pumped.open(IO_ReadWrite);
+			copied.open(IO_ReadWrite);
+			FXuint time=FXProcess::getMsCount();
+			FXfval moved=src.transferTo(dest);
+			double taken=(FXProcess::getMsCount()-time)/1000.0;
+			if(taken<0.001) taken=0.001;
+			if(moved!=src.size() || dest.size()!=src.size() || dest.at()!=src.size())
+				fxerror("Error: File to file transfer moved the wrong amount!\n");
+			fxmessage("File to file took %f seconds (%dKb/sec)\n", taken, (FXuint)(((FXlong) moved/1024)/taken));
+			src.at(0); dest.at(0);
+			time=FXProcess::getMsCount();
+			src.transferTo(pumped);
+			taken=(FXProcess::getMsCount()-time)/1000.0;
+			if(taken<0.001) taken=0.001;
+			fxmessage("File to memory (pumped) took %f seconds (%dKb/sec)\n", taken, (FXuint)(((FXlong) moved/1024)/taken));
+			dest.transferTo(copied);
+			if(pumped.size()!=moved || copied.size()!=moved || memcmp(pumped.buffer().data(), copied.buffer().data(), (size_t) moved))
+				fxerror("Error: Transferred files are different!\n");
+			{	// The kernel won't splice into an appending file, so this must fall back cleanly
+				QFile appended("../BigFile3.txt");
+				QBuffer readback;
+				appended.open(IO_WriteOnly|IO_Truncate);
+				appended.writeBlock("head", 4);
+				appended.close();
+				appended.open(IO_WriteOnly|IO_Append);
+				src.at(0);
+				if(src.transferTo(appended)!=moved)
+					fxerror("Error: File to appending file transfer moved the wrong amount!\n");
+				appended.close();
+				appended.open(IO_ReadOnly);
+				readback.open(IO_ReadWrite);
+				appended.transferTo(readback);
+				appended.remove();
+				if(readback.size()!=moved+4 || memcmp(readback.buffer().data(), "head", 4)
+					|| memcmp(readback.buffer().data()+4, copied.buffer().data(), (size_t) moved))
+					fxerror("Error: File to appending file transfer copied the wrong data!\n");
+			}
+#ifndef WIN32
+			{
+				QChildProcess cat("/bin/cat", "../BigFile.txt", QChildProcess::StdOut);
+				QFile catted("../BigFile3.txt");
+				catted.open(IO_ReadWrite|IO_Truncate);
+				cat.open(IO_ReadOnly);
+				time=FXProcess::getMsCount();
+				FXfval catmoved=cat.transferTo(catted);
+				taken=(FXProcess::getMsCount()-time)/1000.0;
+				if(taken<0.001) taken=0.001;
+				cat.close();
+				if(catmoved!=moved || catted.size()!=moved)
+					fxerror("Error: Child process to file transfer moved the wrong amount!\n");
+				fxmessage("Child process to file took %f seconds (%dKb/sec)\n", taken, (FXuint)(((FXlong) moved/1024)/taken));
+				QBuffer readback;
+				readback.open(IO_ReadWrite);
+				catted.at(0);
+				catted.transferTo(readback);
+				if(memcmp(readback.buffer().data(), copied.buffer().data(), (size_t) moved))
+					fxerror("Error: Child process to file transfer copied the wrong data!\n");
+				catted.remove();
+			}
+			{	// A child filling its stderr pipe mustn't stall a transfer of its stdout
+				QFile script("../TestStdErr.sh");
+				script.open(IO_WriteOnly|IO_Truncate);
+				const char *text="cat ../BigFile.txt >&2\ncat ../BigFile.txt\n";
+				script.writeBlock(text, strlen(text));
+				script.close();
+				QChildProcess both("/bin/sh", "../TestStdErr.sh", QChildProcess::StdOut);
+				QBuffer out, err;
+				out.open(IO_ReadWrite);
+				err.open(IO_ReadWrite);
+				both.open(IO_ReadOnly);
+				if(both.transferTo(out)!=moved)
+					fxerror("Error: Child process transfer with a busy stderr moved the wrong amount!\n");
+				both.setReadChannel(QChildProcess::StdErr);
+				char buffer[65536];
+				FXuval read;
+				while((read=both.readBlock(buffer, sizeof(buffer))))
+					err.writeBlock(buffer, read);
+				both.close();
+				if(out.size()!=moved || err.size()!=moved
+					|| memcmp(out.buffer().data(), copied.buffer().data(), (size_t) moved)
+					|| memcmp(err.buffer().data(), copied.buffer().data(), (size_t) moved))
+					fxerror("Error: Child process transfer with a busy stderr copied the wrong data!\n");
+				script.remove();
+			}
+			{
+				QPipe r("TestTeePipe", true), w("TestTeePipe", true);
+				QBuffer teed;
+				char buffer[4096];
+				r.create(IO_ReadOnly);
+				w.open(IO_WriteOnly);
+				teed.open(IO_ReadWrite);
+				w.writeBlock(copied.buffer().data(), sizeof(buffer));
+				if(r.teeTo(teed)!=sizeof(buffer) || r.readBlock(buffer, sizeof(buffer))!=sizeof(buffer)
+					|| memcmp(buffer, copied.buffer().data(), sizeof(buffer)) || memcmp(buffer, teed.buffer().data(), sizeof(buffer)))
+					fxerror("Error: Pipe tee copied the wrong data!\n");
+			}
+			{	// Gift mode writes of many pipe-fulls from both aligned and unaligned buffers
+				const FXuint giftsize=1024*1024, pagesize=FXProcess::pageSize();
+				QByteArray giftbuffer(giftsize+pagesize+1);
+				char *aligned=(char *)(((FXuval) giftbuffer.data()+pagesize-1) & ~((FXuval) pagesize-1));
+				for(int n=0; n<2; n++)
+				{
+					char *data=aligned+n;
+					for(FXuint i=0; i<giftsize; i++)
+						data[i]=(char)(i*13+n);
+					QPipe r("TestGiftPipe", true), w("TestGiftPipe", true);
+					r.create(IO_ReadOnly);
+					w.open(IO_WriteOnly);
+					w.setGiftMode(true);
+					ReadAllThread *t=new ReadAllThread(&r, giftsize);
+					t->start();
+					FXuval written=w.writeBlock(data, giftsize);
+					w.flush();
+					t->wait();
+					if(written!=giftsize || memcmp(t->data.data(), data, giftsize))
+						fxerror("Error: Pipe gift mode write lost data!\n");
+					delete t;
+				}
+			}
+#endif
+			fxmessage("Test passed!\n");
+
+			fxmessage("\nAsynchronous i/o test:\n"
+						"-=-=-=-=-=-=-=-=-=-=-=\n");
+			{
+				FXAsyncIO aio;
+				const int reqsno=1024, blocksize=4096;
+				FXfval blocks=src.size()/blocksize;
+				QByteArray readbuff(reqsno*blocksize), checkbuff(blocksize);
+				FXAsyncIO::Request reqs[reqsno];
+				for(int n=0; n<reqsno; n++)
+					reqs[n]=FXAsyncIO::Request(FXAsyncIO::Request::Read, &src, (rand() % blocks)*blocksize, (char *) readbuff.data()+n*blocksize, blocksize);
+				time=FXProcess::getMsCount();
+				FXAsyncIO::Future f=aio.submit(reqs, reqsno);
+				f.wait();
+				taken=(FXProcess::getMsCount()-time)/1000.0;
+				if(taken<0.001) taken=0.001;
+				if(f.failures())
+					fxerror("Error: %u asynchronous reads failed!\n", f.failures());
+				for(int n=0; n<reqsno; n++)
+				{
+					if(reqs[n].transferred!=(FXuval) blocksize || blocksize!=src.readBlockFrom((char *) checkbuff.data(), blocksize, reqs[n].pos)
+						|| memcmp(checkbuff.data(), reqs[n].data, blocksize))
+						fxerror("Error: Asynchronous read returned different data!\n");
+				}
+				fxmessage("%d random %d byte reads (%s) took %f seconds (%dKb/sec)\n", reqsno, blocksize,
+					aio.isKernelQueued() ? "kernel queued" : "thread pool", taken, (FXuint)((reqsno*blocksize/1024)/taken));
+			}
+			fxmessage("Test passed!\n");
+
+			fxmessage("\nMulti-threaded random read test:\n"
+						"-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=\n");
+			for(FXuint threadsno=1; threadsno<=8; threadsno<<=1)
+			{
+				const FXuint reads=16384, blocksize=4096;
+				QPtrVector<RandomReadThread> threads(true);
+				for(FXuint n=0; n<threadsno; n++)
+					threads.append(new RandomReadThread(&src, reads/threadsno, blocksize, n));
+				time=FXProcess::getMsCount();
+				for(FXuint n=0; n<threadsno; n++)
+					threads[n]->start();
+				for(FXuint n=0; n<threadsno; n++)
+					threads[n]->wait();
+				taken=(FXProcess::getMsCount()-time)/1000.0;
+				if(taken<0.001) taken=0.001;
+				fxmessage("%u threads performing %u random %u byte reads took %f seconds (%dKb/sec)\n", threadsno, reads, blocksize,
+					taken, (FXuint)(((FXlong) reads*blocksize/1024)/taken));
+			}
+			fxmessage("Test passed!\n");
+
+#ifndef WIN32
+			fxmessage("\nPositional i/o bypassing the file lock test:\n"
+						"-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=\n");
+			{
+				const FXuint blocks=256;
+				StallingFile fh("../BigFile2.txt");
+				fh.open(IO_ReadWrite|IO_Truncate);
+				QByteArray data(blocks*4096), check(4096);
+				for(FXuint n=0; n<data.size(); n++)
+					data[n]=(FXuchar)(n*7);
+				// Buffered writes must be seen by positional reads
+				for(FXuint n=0; n<data.size(); n+=1024)
+					fh.writeBlock((char *) data.data()+n, 1024);
+				if(4096!=fh.readBlockFrom((char *) check.data(), 4096, 4096) || memcmp(check.data(), data.data()+4096, 4096))
+					fxerror("Error: Positional read missed buffered writes!\n");
+				// Positional writes must replace read-ahead covering them
+				fh.at(0);
+				if(16!=fh.readBlock((char *) check.data(), 16))
+					fxerror("Error: Read came up short!\n");
+				fh.writeBlockTo(16, "Hello world", 11);
+				if(11!=fh.readBlock((char *) check.data(), 11) || memcmp(check.data(), "Hello world", 11))
+					fxerror("Error: Positional write left stale read-ahead!\n");
+				// Now stall one thread with the file's lock held, first with the buffer empty and
+				// then holding read-ahead, and positional i/o must carry on regardless
+				for(int n=0; n<2; n++)
+				{
+					fh.at(n ? 0 : fh.size());
+					if(n && 16!=fh.readBlock((char *) check.data(), 16))
+						fxerror("Error: Read came up short!\n");
+					fh.stall=true;
+					StallThread staller(&fh, n ? 0 : fh.size()-1);
+					staller.start();
+					fh.stalled.wait();
+					fh.stalled.reset();
+					PositionalIOThread io(&fh, blocks-1, !n);
+					io.start();
+					if(!io.wait(10000))
+						fxerror("FAILED: Positional i/o waited for the file's lock!\n");
+					fh.release.wakeAll();
+					staller.wait();
+					fh.release.reset();
+				}
+				fxmessage("Test passed!\n");
+			}
+#endif
+		}
+
 		if(0)
 		{	// Test of 64 bit file handling
 			fxmessage("\n64 bit file handling test:\n"
@@ -35,6 +35,32 @@ static void printDir(const QFileInfoList *list)
 		print(*it);
 	}
 }
+static bool testNumericSort()
+{
+	static const char *names[]={ "NumSort10.txt", "NumSort2.txt", "NumSort1.txt", "NumSort3.txt", "NumSort2a.txt", "NumSort100.txt" };
+	static const char *numeric[]={ "NumSort1.txt", "NumSort2.txt", "NumSort2a.txt", "NumSort3.txt", "NumSort10.txt", "NumSort100.txt" };
+	static const char *lexical[]={ "NumSort1.txt", "NumSort10.txt", "NumSort100.txt", "NumSort2.txt", "NumSort2a.txt", "NumSort3.txt" };
+	const int count=sizeof(names)/sizeof(const char *);
+	for(int n=0; n<count; n++)
+	{
+		QFile file(names[n]);
+		file.open(IO_WriteOnly);
+	}
+	QDir dir(".", "NumSort*", QDir::Name|QDir::IgnoreCase|QDir::Numeric, QDir::Files);
+	QStringList bynumber=dir.entryList();
+	dir.setSorting(QDir::Name|QDir::IgnoreCase);
+	QStringList byname=dir.entryList();
+	for(int n=0; n<count; n++)
+		dir.remove(names[n]);
+	fxmessage("Numerically sorted: %s\n", bynumber.join(" ").text());
+	if(count!=(int) bynumber.count() || count!=(int) byname.count()) return false;
+	QStringList::iterator nit=bynumber.begin(), lit=byname.begin();
+	for(int n=0; n<count; n++, ++nit, ++lit)
+	{
+		if(*nit!=numeric[n] || *lit!=lexical[n]) return false;
+	}
+	return true;
+}
 static int called;
 static void handler(FXFSMonitor::Change change, const QFileInfo &oldfi, const QFileInfo &newfi)
 {
@@ -83,6 +109,11 @@ int main(int argc, char *argv[])
 	FXuint after2=FXProcess::getMsCount();
 	fxmessage("  (took %dms for list, %dms for file info fetch)\n", after1-before, after2-after1);
 	printDir(list);
+	if(!testNumericSort())
+	{
+		fxwarning("FAILED: Numeric sort of directory is in the wrong order!\n");
+		ret=1;
+	}
 	fxmessage("\nMonitoring for changes ...\n");
 	FXFSMonitor::add(".", FXFSMonitor::ChangeHandler(handler));
 	QThread::sleep(1);
@@ -20,6 +20,8 @@
 ********************************************************************************/
 
 #include "fx.h"
+#include "qptrdenselist.h"
+#include <list>
 
 #define UNIQUENAME3(var, no) var##no
 #define UNIQUENAME2(var, no) UNIQUENAME3(var, no)
@@ -103,6 +105,79 @@ struct TestStruct
 	}
 };
 
+static void DenseListBenchmark()
+{
+	static const FXuint ITEMS=10000, ITERATIONS=500;
+	fxmessage("\nQPtrDenseList vs. std::list:\n"
+		        "-=-=-=-=-=-=-=-=-=-=-=-=-=-=\n");
+	FXuint *items=new FXuint[ITEMS], n, i;
+	for(n=0; n<ITEMS; n++) items[n]=n;
+	std::list<FXuint *> stdlist;
+	QPtrDenseList<FXuint> denselist;
+	for(n=0; n<ITEMS; n++)
+	{	// Interleave with other allocations so the list nodes scatter like in real use
+		stdlist.push_back(&items[n]);
+		delete new char[(n*7)%256+1];
+		denselist.append(&items[n]);
+	}
+	FXulong stdsum=0, densesum=0;
+	FXuint start=FXProcess::getMsCount();
+	for(i=0; i<ITERATIONS; i++)
+		for(std::list<FXuint *>::iterator it=stdlist.begin(); it!=stdlist.end(); ++it)
+			stdsum+=**it;
+	FXuint stdtime=FXProcess::getMsCount()-start;
+	start=FXProcess::getMsCount();
+	FXuint *item;
+	for(i=0; i<ITERATIONS; i++)
+		for(QPtrDenseListIterator<FXuint> it(denselist); (item=it.current()); ++it)
+			densesum+=*item;
+	FXuint densetime=FXProcess::getMsCount()-start;
+	if(stdsum!=densesum) fxerror("Iteration results differ!\n");
+	fxmessage("Iterating %u items %u times: std::list %ums, QPtrDenseList %ums\n", ITEMS, ITERATIONS, stdtime, densetime);
+
+	// Remove every third item while iterating, then iterate what's left
+	start=FXProcess::getMsCount();
+	for(std::list<FXuint *>::iterator it=stdlist.begin(); it!=stdlist.end();)
+	{
+		if(!(**it%3)) it=stdlist.erase(it); else ++it;
+	}
+	for(i=0; i<ITERATIONS; i++)
+		for(std::list<FXuint *>::iterator it=stdlist.begin(); it!=stdlist.end(); ++it)
+			stdsum+=**it;
+	stdtime=FXProcess::getMsCount()-start;
+	start=FXProcess::getMsCount();
+	for(QPtrDenseListIterator<FXuint> it(denselist); (item=it.current());)
+	{
+		if(!(*item%3)) denselist.takeByIter(it); else ++it;
+	}
+	for(i=0; i<ITERATIONS; i++)
+		for(QPtrDenseListIterator<FXuint> it(denselist); (item=it.current()); ++it)
+			densesum+=*item;
+	densetime=FXProcess::getMsCount()-start;
+	if(stdsum!=densesum || stdlist.size()!=denselist.count()) fxerror("Removal results differ!\n");
+	fxmessage("Removing a third then iterating %u times: std::list %ums, QPtrDenseList %ums\n", ITERATIONS, stdtime, densetime);
+
+	// Use as a FIFO queue
+	start=FXProcess::getMsCount();
+	for(i=0; i<ITERATIONS*100; i++)
+	{
+		stdlist.push_back(stdlist.front());
+		stdlist.pop_front();
+	}
+	stdtime=FXProcess::getMsCount()-start;
+	start=FXProcess::getMsCount();
+	for(i=0; i<ITERATIONS*100; i++)
+	{
+		denselist.append(denselist.getFirst());
+		denselist.takeFirst();
+	}
+	densetime=FXProcess::getMsCount()-start;
+	if(stdlist.front()!=denselist.getFirst() || stdlist.back()!=denselist.getLast()) fxerror("Queue results differ!\n");
+	fxmessage("Queueing %u items: std::list %ums, QPtrDenseList %ums\n", ITERATIONS*100, stdtime, densetime);
+	denselist.clear();
+	delete[] items;
+}
+
 int main(int argc, char *argv[])
 {
 	FXProcess myprocess(argc, argv);
@@ -194,6 +269,8 @@ int main(int argc, char *argv[])
 	Generic::BoundFunctor<Generic::TL::create<int, int>::value> testfnb2=Generic::BindObj(teststruct, &TestStruct::foo, 5);
 	fxmessage("Bound object functor call result=%d\n", testfnb2());
 
+	DenseListBenchmark();
+
 	fxmessage("All Done!\n");
 #ifdef _MSC_VER
 	if(!myprocess.isAutomatedTest())
@@ -20,6 +20,10 @@
 
 #include "fx.h"
 #include "../Tn/TFileBySyncDev.cxx"
+#ifndef WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 class TestChannel : public FXIPCChannel
 {
@@ -33,9 +37,273 @@ protected:
 	}
 };
 
+typedef FXIPCMsgChunkCodeAlloc<0x100, true> LZ4TestChunkBegin;
+struct LZ4Test_Echo : public FXIPCMsg
+{
+	typedef FXIPCMsgChunkCodeAlloc<LZ4TestChunkBegin::code, true> id;
+	typedef FXIPCMsgRegister<id, LZ4Test_Echo> regtype;
+	QByteArray data;
+	LZ4Test_Echo() : FXIPCMsg(id::code) { }
+	void   endianise(FXStream &ds) const { ds << data; }
+	void deendianise(FXStream &ds)       { ds >> data; }
+};
+struct LZ4Test_EchoAck : public FXIPCMsg
+{
+	typedef FXIPCMsgChunkCodeAlloc<LZ4TestChunkBegin::code, false> id;
+	typedef FXIPCMsgRegister<id, LZ4Test_EchoAck> regtype;
+	QByteArray data;
+	LZ4Test_EchoAck(FXuint _id=0) : FXIPCMsg(id::code, _id) { }
+	void   endianise(FXStream &ds) const { ds << data; }
+	void deendianise(FXStream &ds)       { ds >> data; }
+};
+typedef FXIPCMsgChunk<Generic::TL::create<
+		LZ4Test_Echo::regtype,
+		LZ4Test_EchoAck::regtype
+	>::value> LZ4TestChunk;
+static class LZ4TestRegistry : public FXIPCMsgRegistry
+{
+	LZ4TestChunk mychunk;
+public:
+	LZ4TestRegistry() : mychunk(this) { }
+} lz4testregistry;
+class LZ4TestChannel : public FXIPCChannel
+{
+public:
+	LZ4TestChannel(QIODeviceS *dev, const char *name) : FXIPCChannel(lz4testregistry, dev, false, 0, name)
+	{
+		setCompression(LZ4Compression);
+		setMaxMsgSize(0);
+	}
+	~LZ4TestChannel()
+	{
+		if(running())
+		{
+			requestClose();
+			wait();
+		}
+	}
+protected:
+	HandledCode msgReceived(FXIPCMsg *rawmsg)
+	{
+		if(LZ4Test_Echo::id::code==rawmsg->msgType())
+		{
+			LZ4Test_Echo *i=(LZ4Test_Echo *) rawmsg;
+			LZ4Test_EchoAck ia(i->msgId());
+			ia.data=i->data;
+			sendMsg(ia);
+			return Handled;
+		}
+		return NotHandled;
+	}
+};
+
+// Sends compressible, incompressible and tiny payloads through a LZ4 compressed channel and back
+static void testLZ4Channel()
+{
+	fxmessage("Testing LZ4 compressed IPC channel ...\n");
+	QLocalPipe pipe, pipeClient(pipe.clientEnd());
+	pipe.open(IO_ReadWrite);
+	pipeClient.open(IO_ReadWrite);
+	LZ4TestChannel server(&pipe, "LZ4 test server"), client(&pipeClient, "LZ4 test client");
+	server.start(true);
+	client.start(true);
+	static const FXuint sizes[]={ 0, 1, 15, 4096, 65536, 256*1024+7 };
+	FXuint seed=12345;
+	for(int kind=0; kind<2; kind++)
+	{
+		for(FXuint s=0; s<sizeof(sizes)/sizeof(FXuint); s++)
+		{
+			LZ4Test_Echo msg;
+			LZ4Test_EchoAck ack;
+			msg.data.resize(sizes[s]);
+			for(FXuint n=0; n<sizes[s]; n++)
+				msg.data[n]=(FXuchar)(kind ? fxrandom(seed) : "There are bottles on the wall! "[n % 31]);
+			client.sendMsg(ack, msg);
+			if(ack.data.size()!=msg.data.size() || memcmp(ack.data.data(), msg.data.data(), msg.data.size()))
+				fxerror("Error: LZ4 compressed IPC message %u bytes long did not survive the round trip!\n", sizes[s]);
+		}
+	}
+	client.requestClose();
+	client.wait();
+	server.requestClose();
+	server.wait();
+	fxmessage("LZ4 compressed IPC channel passed\n");
+}
+
+#ifndef WIN32
+// Returns the two lowest free descriptors, which descriptors received are given first
+static void lowestFreeHandles(int &first, int &second)
+{
+	first=::dup(0);
+	second=::dup(0);
+	::close(first);
+	::close(second);
+}
+
+// Hands a shared memory object from one end of a local socket pair to the other
+static void testLocalSocketHandles()
+{
+	fxmessage("Testing local socket descriptor passing ...\n");
+	QLocalSocket *a=0, *b=0;
+	QLocalSocket::createPair(a, b);
+	FXPtrHold<QLocalSocket> aa(a), bb(b);
+	const FXuval len=1024*1024;
+	int shm=QLocalSocket::createSharedMemory(len);
+	char *data=(char *) ::mmap(0, len, PROT_READ|PROT_WRITE, MAP_SHARED, shm, 0);
+	if(MAP_FAILED==data) fxerror("Error: Couldn't map shared memory!\n");
+	for(FXuval n=0; n<len; n++)
+		data[n]="There are bottles on the wall! "[n % 31];
+	a->writeBlock("M", 1, &shm, 1);
+	char msg=0;
+	int handles[4];
+	FXuint nohandles=4;
+	b->readBlock(&msg, 1, handles, nohandles);
+	if('M'!=msg || 1!=nohandles)
+		fxerror("Error: Sent one descriptor but received %u!\n", nohandles);
+	char *view=(char *) ::mmap(0, len, PROT_READ|PROT_WRITE, MAP_SHARED, handles[0], 0);
+	if(MAP_FAILED==view) fxerror("Error: Couldn't map received shared memory!\n");
+	if(memcmp(view, data, len))
+		fxerror("Error: Received shared memory has different contents!\n");
+	view[len-1]='!';
+	if('!'!=data[len-1])
+		fxerror("Error: Write through received shared memory not seen by sender!\n");
+	::munmap(view, len);
+	::close(handles[0]);
+
+	// Send more handles than the receiver has room for, the excess must be closed
+	int sent[3]={ shm, shm, shm };
+	a->writeBlock("X", 1, sent, 3);
+	int first, second, afterfirst, aftersecond;
+	lowestFreeHandles(first, second);
+	nohandles=1;
+	b->readBlock(&msg, 1, handles, nohandles);
+	if('X'!=msg || 1!=nohandles)
+		fxerror("Error: Receiving into room for one descriptor returned %u!\n", nohandles);
+	::close(handles[0]);
+	lowestFreeHandles(afterfirst, aftersecond);
+	if(afterfirst!=first || aftersecond!=second)
+		fxerror("Error: Descriptors received beyond room for them were not closed!\n");
+	::munmap(data, len);
+	::close(shm);
+	fxmessage("Local socket descriptor passing passed\n");
+}
+#endif
+
+static void readFully(QIODeviceS *dev, char *buffer, FXuval len)
+{
+	for(FXuval read=0; read<len;)
+		read+=dev->readBlock(buffer+read, len-read);
+}
+
+// Measures round trip latency and throughput of the local transports
+static void benchmark(bool amServer)
+{
+	static const char *names[]={ "Pipe", "Loopback socket", "Shared memory pipe" };
+	const int pings=20000;
+	const FXuval bulk=64*1024*1024;
+	char buffer[65536];
+	memset(buffer, 'N', sizeof(buffer));
+	for(int t=0; t<3; t++)
+	{
+		FXPtrHold<QIODeviceS> transport;
+		if(amServer)
+		{
+			if(0==t)
+			{
+				FXERRHM(transport=new QPipe("TestIPCBench", true));
+				transport->create(IO_ReadWrite);
+			}
+			else if(1==t)
+			{
+				QBlkSocket server(QBlkSocket::Stream, (FXushort) 12346);
+				server.create(IO_ReadWrite);
+				transport=server.waitForConnection();
+			}
+			else
+			{
+				FXERRHM(transport=new QShrdMemPipe("TestIPCBench"));
+				transport->create(IO_ReadWrite);
+			}
+		}
+		else
+		{
+			if(0==t)
+				FXERRHM(transport=new QPipe("TestIPCBench", true));
+			else if(1==t)
+				FXERRHM(transport=new QBlkSocket(QHOSTADDRESS_LOCALHOST, 12346));
+			else
+				FXERRHM(transport=new QShrdMemPipe("TestIPCBench"));
+			for(int n=0;; n++)
+			{	// Give the server time to get there first
+				FXERRH_TRY
+				{
+					transport->open(IO_ReadWrite);
+					break;
+				}
+				FXERRH_CATCH(FXException &)
+				{
+					if(n>=50) throw;
+					QThread::msleep(100);
+				}
+				FXERRH_ENDTRY;
+			}
+		}
+		if(amServer)
+		{
+			FXuint before=FXProcess::getMsCount();
+			for(int n=0; n<pings; n++)
+			{
+				transport->writeBlock(buffer, 64);
+				readFully(transport, buffer, 64);
+			}
+			FXuint after=FXProcess::getMsCount();
+			fxmessage("%s: %f microseconds per round trip\n", names[t], 1000.0*(after-before)/pings);
+			before=FXProcess::getMsCount();
+			for(FXuval n=0; n<bulk; n+=sizeof(buffer))
+				transport->writeBlock(buffer, sizeof(buffer));
+			readFully(transport, buffer, 1);
+			after=FXProcess::getMsCount();
+			fxmessage("%s: %fMb/sec\n", names[t], (1000.0*bulk/FXMAX(after-before, 1U))/(1024*1024));
+		}
+		else
+		{
+			for(int n=0; n<pings; n++)
+			{
+				readFully(transport, buffer, 64);
+				transport->writeBlock(buffer, 64);
+			}
+			for(FXuval n=0; n<bulk;)
+				n+=transport->readBlock(buffer, FXMIN(bulk-n, (FXuval) sizeof(buffer)));
+			transport->writeBlock(buffer, 1);
+			// Wait for the server to finish with this transport before closing it
+			FXERRH_TRY
+			{
+				transport->readBlock(buffer, 1);
+			}
+			FXERRH_CATCH(FXConnectionLostException &)
+			{
+			}
+			FXERRH_ENDTRY;
+		}
+	}
+}
+
 int main(int argc, char *argv[])
 {
 	FXProcess myprocess(argc, argv);
+	FXERRH_TRY
+	{
+		testLZ4Channel();
+#ifndef WIN32
+		testLocalSocketHandles();
+#endif
+	}
+	FXERRH_CATCH(FXException &e)
+	{
+		fxmessage("\n\nException %s\n", e.report().text());
+		return 1;
+	}
+	FXERRH_ENDTRY;
 	QChildProcess child(myprocess.execpath(), "-automatedtest -client");
 	char devtype[8], server[8];
 	bool amServer;
@@ -61,7 +329,8 @@ int main(int argc, char *argv[])
 	do
 	{
 		fxmessage("What should I use for the transport? (S: Socket, P: Pipe\n"
-			"    E: Encrypted Socket):\n");
+			"    E: Encrypted Socket, L: Local Socket, M: Shared Memory Pipe,\n"
+			"    B: Benchmark the local transports):\n");
 		if(myprocess.isAutomatedTest())
 			devtype[0]='E';
 		else
@@ -69,7 +338,26 @@ int main(int argc, char *argv[])
 		if('s'==devtype[0] || 'S'==devtype[0]) choice=1;
 		else if('p'==devtype[0] || 'P'==devtype[0]) choice=2;
 		else if('e'==devtype[0] || 'E'==devtype[0]) choice=3;
+		else if('l'==devtype[0] || 'L'==devtype[0]) choice=4;
+		else if('m'==devtype[0] || 'M'==devtype[0]) choice=5;
+		else if('b'==devtype[0] || 'B'==devtype[0]) choice=6;
 	} while(!choice);
+	if(6==choice)
+	{
+		fxmessage("Benchmark\n");
+		FXERRH_TRY
+		{
+			benchmark(amServer);
+		}
+		FXERRH_CATCH(FXException &e)
+		{
+			fxmessage("\n\nException %s\n", e.report().text());
+			return 1;
+		}
+		FXERRH_ENDTRY;
+		printf("\n\nTests complete!\n");
+		return 0;
+	}
 	FXPtrHold<QIODeviceS> realtransport;
 	FXPtrHold<QIODeviceS> transport;
 	if(1==choice || 3==choice)
@@ -96,6 +384,30 @@ int main(int argc, char *argv[])
 		else
 			transport->open(IO_ReadWrite);
 	}
+	if(4==choice)
+	{
+		fxmessage("Local socket\n");
+		if(amServer)
+		{
+			QLocalSocket server("TestIPC");
+			server.create(IO_ReadWrite);
+			transport=server.waitForConnection();
+		}
+		else
+		{
+			FXERRHM(transport=new QLocalSocket("TestIPC"));
+			transport->open(IO_ReadWrite);
+		}
+	}
+	if(5==choice)
+	{
+		fxmessage("Shared memory pipe\n");
+		FXERRHM(transport=new QShrdMemPipe("TestIPC"));
+		if(amServer)
+			transport->create(IO_ReadWrite);
+		else
+			transport->open(IO_ReadWrite);
+	}
 	if(3==choice)
 	{
 		fxmessage("Encrypted socket\n");
@@ -111,6 +423,7 @@ int main(int argc, char *argv[])
 	TestChannel ch(transport);
 	ch.setUnreliable(false);
 	ch.setCompression(false);
+	ch.setCompactEncoding(true);
 	ch.setPrintStatistics(false);
 	FXERRH_TRY
 	{
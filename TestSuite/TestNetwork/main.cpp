@@ -20,8 +20,31 @@
 ********************************************************************************/
 
 #include "fx.h"
+#include "FXNetworkService.h"
+#include <qmemarray.h>
 #include <stdio.h>
 
+static FXAtomicInt reactorEchoes, reactorCloses;
+static FXNetworkService::Action vetClient(FXNetworkService *service, QBlkSocket *skt)
+{
+	return FXNetworkService::ACCEPTED;
+}
+static void echoClient(FXSocketReactor *reactor, QBlkSocket *skt, FXuint events)
+{
+	if(events & FXSocketReactor::Closed)
+	{
+		++reactorCloses;
+		return;
+	}
+	char buffer[256];
+	FXuval read;
+	while((read=skt->readBlock(buffer, sizeof(buffer))))
+	{
+		skt->writeBlock(buffer, read);
+		++reactorEchoes;
+	}
+}
+
 int main(int argc, char *argv[])
 {
 	FXProcess myprocess(argc, argv);
@@ -46,5 +69,131 @@ int main(int argc, char *argv[])
 		if(myprocess.isAutomatedTest())
 			break;
 	}
+
+	{
+		const FXuint target=50000, rounds=10000;
+		fxmessage("\nReactor test:\n"
+				    "-=-=-=-=-=-=-\n");
+		QBlkSocket server(QHOSTADDRESS_LOCALHOST, 0);
+		server.setMaxPending(1024);
+		server.create(IO_ReadWrite);
+		FXNetworkService service(&server, std::move(FXNetworkService::NewClientSpec(vetClient)));
+		FXSocketReactor reactor;	// Must die before the service as it calls into it
+		service.setMaxClientsPerIP(FXINFINITE);
+		service.setReactor(&reactor, std::move(FXSocketReactor::HandlerSpec(echoClient)));
+		service.start(true);
+		QMemArray<QBlkSocket *> clients;
+		QBlkSocket *s=0;
+		FXuint time=FXProcess::getMsCount();
+		FXERRH_TRY
+		{	// Each connection costs two handles in this process
+			for(; clients.size()<target; s=0)
+			{
+				s=new QBlkSocket(QHOSTADDRESS_LOCALHOST, server.port());
+				s->open(IO_ReadWrite);
+				clients.push_back(s);
+			}
+		}
+		FXERRH_CATCH(FXException &)
+		{	// Almost certainly out of handles
+			delete s;
+		}
+		FXERRH_ENDTRY
+		FXuint no=(FXuint) clients.size();
+		while(reactor.count()<no && FXProcess::getMsCount()-time<60000)
+			QThread::msleep(10);
+		fxmessage("Opened %u connections in %u ms, %u are in the reactor (raise the handle limit to test more)\n",
+			no, FXProcess::getMsCount()-time, reactor.count());
+		char buffer[64];
+		memset(buffer, 'x', sizeof(buffer));
+		time=FXProcess::getMsCount();
+		for(FXuint n=0; n<rounds; n++)
+		{
+			QBlkSocket *c=clients.at((FXuint)(no*(FXulong) rand()/((FXulong) RAND_MAX+1)));
+			c->writeBlock(buffer, sizeof(buffer));
+			for(FXuval read=0; read<sizeof(buffer); read+=c->readBlock(buffer+read, sizeof(buffer)-read));
+		}
+		double taken=(FXProcess::getMsCount()-time)/1000.0;
+		fxmessage("%u echoes among %u mostly idle connections took %f seconds, average round trip=%fus\n",
+			rounds, no, taken, taken*1000000/rounds);
+		if((int) reactorEchoes<(int) rounds)
+			fxerror("FAILED: Reactor did not echo everything!\n");
+		for(FXuint n=0; n<no/2; n++)
+			delete clients.at(n);
+		time=FXProcess::getMsCount();
+		while((FXuint)(int) reactorCloses<no/2 && FXProcess::getMsCount()-time<60000)
+			QThread::msleep(10);
+		fxmessage("Closed %u connections, reactor saw %d close and holds %u\n", no/2, (int) reactorCloses, reactor.count());
+		if(reactor.count()!=no-no/2)
+			fxerror("FAILED: Reactor did not remove closed connections!\n");
+		time=FXProcess::getMsCount();
+		while(service.IPClientRecord(QHOSTADDRESS_LOCALHOST).connections!=no-no/2 && FXProcess::getMsCount()-time<10000)
+			QThread::msleep(10);
+		if(service.IPClientRecord(QHOSTADDRESS_LOCALHOST).connections!=no-no/2 || (FXuint)(int) reactorCloses!=no/2)
+			fxerror("FAILED: Closed connections were not counted out exactly once!\n");
+		service.requestTermination();
+		service.wait();
+		for(FXuint n=no/2; n<no; n++)
+			delete clients.at(n);
+	}
+
+	{
+		const FXuint packets=500000, batch=32, size=64;
+		fxmessage("\nDatagram batching test:\n"
+				    "-=-=-=-=-=-=-=-=-=-=-=-\n");
+		QBlkSocket rx(QBlkSocket::Datagram);
+		rx.create(IO_ReadOnly);
+		rx.setReceiveBufferSize(4*1024*1024);
+		QBlkSocket tx(QHOSTADDRESS_LOCALHOST, rx.port(), QBlkSocket::Datagram);
+		tx.open(IO_WriteOnly);
+		static char sendbuffer[batch*size], recvbuffer[batch][2048];
+		QBlkSocket::Packet sendpkts[batch], recvpkts[batch];
+		for(FXuint n=0; n<batch; n++)
+		{
+			memset(sendbuffer+n*size, n, size);
+			sendpkts[n]=QBlkSocket::Packet(sendbuffer+n*size, size);
+		}
+		for(int method=0; method<3; method++)
+		{
+			FXuint received=0, time=FXProcess::getMsCount();
+			while(received<packets)
+			{	// Receive each batch before sending the next so none are dropped
+				if(0==method)
+				{
+					for(FXuint n=0; n<batch; n++)
+						tx.writeBlock(sendbuffer+n*size, size);
+					for(FXuint n=0; n<batch; n++)
+						rx.readBlock(recvbuffer[n], sizeof(recvbuffer[n]));
+					received+=batch;
+				}
+				else
+				{
+					if(1==method)
+						tx.writeDatagrams(sendpkts, batch);
+					else
+					{	// Hand the whole batch over as one segmented packet
+						QBlkSocket::Packet pkt(sendbuffer, batch*size, size);
+						tx.writeDatagrams(&pkt, 1);
+					}
+					for(FXuint got=0; got<batch; )
+					{
+						for(FXuint n=0; n<batch; n++)
+							recvpkts[n]=QBlkSocket::Packet(recvbuffer[n], sizeof(recvbuffer[n]));
+						FXuint no=rx.readDatagrams(recvpkts, batch-got);
+						for(FXuint n=0; n<no; n++)
+							if(size!=recvpkts[n].len || (char)(got+n)!=recvbuffer[n][0])
+								fxerror("FAILED: Datagram %u of batch is wrong!\n", got+n);
+						got+=no;
+					}
+					received+=batch;
+				}
+			}
+			double taken=(FXProcess::getMsCount()-time)/1000.0;
+			static const char *names[]={ "writeBlock()/readBlock()", "writeDatagrams()/readDatagrams()", "Segmented writeDatagrams()" };
+			fxmessage("%s: %u datagrams of %u bytes took %f seconds, %f packets/sec\n",
+				names[method], received, size, taken, received/taken);
+		}
+		fxmessage("Segmentation offload is %s\n", tx.hasSegmentationOffload() ? "done by the kernel" : "emulated");
+	}
 	return 0;
 }
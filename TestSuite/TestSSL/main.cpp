@@ -78,6 +78,24 @@ public:
 	}
 };
 
+class EchoThread : public QThread
+{
+public:
+	QBlkSocket *server;
+	EchoThread(QBlkSocket *s) : server(s), QThread() { }
+	virtual void run()
+	{	// Echoes one byte back over a new SSL connection
+		FXPtrHold<QBlkSocket> skt(server->waitForConnection());
+		QSSLDevice ssl(skt);
+		char c;
+		ssl.create(IO_ReadWrite);
+		if(ssl.readBlock(&c, 1)) ssl.writeBlock(&c, 1);
+		ssl.flush();
+		ssl.close();
+	}
+	virtual void *cleanup() { return 0; }
+};
+
 static void dumpSSLStats(QSSLDevice &d)
 {
 	FXString msg("SSL used %1 at %2 bits (%3)\n");
@@ -291,6 +309,101 @@ int main(int argc, char *argv[])
 				}
 			}
 		}
+		if(1)
+		{
+			fxmessage("\nSession resumption test:\n"
+					    "-=-=-=-=-=-=-=-=-=-=-=-=\n");
+			QSSLDevice::setSessionCaching(QSSLDevice::AllSessionCaching);
+			QSSLDevice::resetSessionCacheStats();
+			QBlkSocket server;
+			server.create(IO_ReadWrite);
+			for(int n=0; n<8; n++)
+			{
+				EchoThread t(&server);
+				t.start();
+				QBlkSocket client(QHOSTADDRESS_LOCALHOST, server.port());
+				QSSLDevice ssl(&client);
+				char c='A'+n;
+				FXuint time=FXProcess::getMsCount();
+				ssl.open(IO_ReadWrite);
+				ssl.writeBlock(&c, 1);
+				ssl.flush();
+				if(!ssl.readBlock(&c, 1) || c!='A'+n)
+				{
+					fxwarning("WARNING: Echoed data was corrupted!\n");
+					ret=1;
+				}
+				fxmessage("Connection %d took %ums and %s\n", n, FXProcess::getMsCount()-time,
+					ssl.sessionReused() ? "resumed its session" : "negotiated a new session");
+				ssl.close();
+				t.wait();
+			}
+			QSSLDevice::SessionCacheStats stats=QSSLDevice::sessionCacheStats();
+			fxmessage("Client resumed %u of %u, server resumed %u of %u, hit rate=%f%%\n",
+				stats.clientHits, stats.clientHits+stats.clientMisses,
+				stats.serverHits, stats.serverHits+stats.serverMisses, stats.hitRate());
+			if(!stats.clientHits)
+			{
+				fxwarning("WARNING: No sessions were resumed!\n");
+				ret=1;
+			}
+		}
+		if(1)
+		{
+			const FXuint testsize=64*1024*1024;
+			fxmessage("\nEncrypted file throughput test:\n"
+					    "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n");
+			static const struct { const char *name; FXSSLKey::KeyType type; FXuint bits; } ciphers[]={
+				{ "AES-128", FXSSLKey::AES, 128 },
+				{ "AES-256", FXSSLKey::AES, 256 },
+				{ "Blowfish-128", FXSSLKey::Blowfish, 128 }
+			};
+			static const FXuint blocksizes[]={ 4096, 1024*1024 };
+			QByteArray blockbuffer(1024*1024);
+			FXuchar *tbuffer=blockbuffer.data();
+			for(int c=0; c<(int)(sizeof(ciphers)/sizeof(ciphers[0])); c++)
+			{
+				FXSSLKey key(ciphers[c].bits, ciphers[c].type, "TestSSL");
+				for(int b=0; b<(int)(sizeof(blocksizes)/sizeof(blocksizes[0])); b++)
+				{
+					const FXuint blocksize=blocksizes[b];
+					QFile file("../BigFile4.bin");
+					QSSLDevice dev(&file);
+					FXuint origCRC=0, readCRC=0, n;
+					double taken;
+					dev.setKey(key);
+					for(n=0; n<blocksize; n++)
+						tbuffer[n]=32+(n % 0x60);
+					FXuint time=FXProcess::getMsCount();
+					dev.open(IO_WriteOnly|IO_Truncate);
+					for(n=0; n<testsize; n+=blocksize)
+					{
+						tbuffer[0]=(FXuchar) n;		// Make each block different
+						dev.writeBlock((char *) tbuffer, blocksize);
+						origCRC=fxadler32(origCRC, tbuffer, blocksize);
+					}
+					dev.close();
+					taken=(FXProcess::getMsCount()-time)/1000.0;
+					fxmessage("%s writing in %uKb blocks took %f seconds, average speed=%dKb/sec\n",
+						ciphers[c].name, blocksize/1024, taken, (FXuint)((testsize/1024)/taken));
+					time=FXProcess::getMsCount();
+					dev.open(IO_ReadOnly);
+					FXuval read;
+					while((read=dev.readBlock((char *) tbuffer, blocksize)))
+						readCRC=fxadler32(readCRC, tbuffer, read);
+					dev.close();
+					taken=(FXProcess::getMsCount()-time)/1000.0;
+					fxmessage("%s reading in %uKb blocks took %f seconds, average speed=%dKb/sec\n",
+						ciphers[c].name, blocksize/1024, taken, (FXuint)((testsize/1024)/taken));
+					if(origCRC!=readCRC)
+					{
+						fxwarning("WARNING: Decrypted data not same as original\n");
+						ret=1;
+					}
+				}
+			}
+			FXFile::remove("../BigFile4.bin");
+		}
 	}
 	FXERRH_CATCH(FXException &e)
 	{
@@ -33,6 +33,42 @@ static void testcode(const char *msg, int a)
 }
 static FXuint seed;
 
+struct SortItem
+{
+	FXuint key, idx;
+	SortItem(FXuint _key=0, FXuint _idx=0) : key(_key), idx(_idx) { }
+	bool operator<(const SortItem &o) const { return key<o.key; }
+};
+static bool testParallelSort()
+{	// Lots of equal keys so that stability matters
+	const FXuint count=300000;
+	QValueList<SortItem> parallel, serial;
+	std::vector<SortItem> reference;
+	for(FXuint n=0; n<count; n++)
+	{
+		SortItem item(fxrandom(seed) % 1000, n);
+		parallel.push_back(item);
+		serial.push_back(item);
+		reference.push_back(item);
+	}
+	FXuint before=FXProcess::getMsCount();
+	QValueListQSort<SortItem>(serial).run();
+	FXuint after1=FXProcess::getMsCount();
+	QValueListQSort<SortItem>(parallel, QVLQSortParallel).run();
+	FXuint after2=FXProcess::getMsCount();
+	std::stable_sort(reference.begin(), reference.end());
+	fxmessage("Sorting %u items took %ums serially and %ums in parallel\n", count, after1-before, after2-after1);
+	if(parallel.size()!=count || serial.size()!=count)
+		return false;
+	QValueList<SortItem>::iterator pit=parallel.begin(), sit=serial.begin();
+	for(FXuint n=0; n<count; n++, ++pit, ++sit)
+	{	// The serial sort isn't stable, so only its keys must match
+		if(pit->key!=sit->key || pit->key!=reference[n].key || pit->idx!=reference[n].idx)
+			return false;
+	}
+	return true;
+}
+
 int main(int argc, char *argv[])
 {
 	FXProcess myprocess(argc, argv);
@@ -68,6 +104,13 @@ int main(int argc, char *argv[])
 		tp.wait(handles[n]);
 	}
 
+	fxmessage("\nNow testing parallel sort ...\n");
+	if(!testParallelSort())
+	{
+		fxwarning("FAILED: Parallel sort differs from serial sort!\n");
+		return 1;
+	}
+
 	fxmessage("All Done!\n");
 #ifdef _MSC_VER
 	if(!myprocess.isAutomatedTest())
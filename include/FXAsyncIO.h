@@ -0,0 +1,151 @@
+/********************************************************************************
+*                                                                               *
+*                         Asynchronous file i/o engine                          *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#ifndef FXASYNCIO_H
+#define FXASYNCIO_H
+
+#include "FXGenericTools.h"
+
+namespace FX {
+
+/*! \file FXAsyncIO.h
+\brief Defines classes used to perform file i/o asynchronously
+*/
+
+class QIODevice;
+class QThreadPool;
+
+/*! \class FXAsyncIO
+\brief Performs batches of positional reads & writes asynchronously
+
+All i/o through FX::QIODevice is synchronous. FX::QFile lets
+FX::QIODevice::readBlockFrom() and FX::QIODevice::writeBlockTo() run in
+parallel on one file, but each still blocks its calling thread until the
+transfer completes. This is fine for most uses, but a modern solid state
+drive wants dozens of requests outstanding at once to reach its rated
+throughput - which would otherwise mean dozens of threads.
+
+FXAsyncIO instead takes batches of positional read & write requests
+(FX::FXAsyncIO::Request) and returns immediately with a
+FX::FXAsyncIO::Future which you can poll or wait upon. Optionally when
+the whole batch completes a functor can be dispatched to a thread pool.
+Up to queueDepth() requests are kept in flight at once, with submit()
+blocking until there is room for more. Several threads may call submit() at
+once and between them they still never exceed queueDepth().
+
+On Linux 5.1 or later, where the kernel provides \c io_uring, requests
+against FX::QFile are passed directly to the kernel's submission queue and
+reaped by a single internal thread so a handful of threads can keep the
+device's queues full. Elsewhere, or if the kernel
+refuses to create a ring (some containers forbid it), each request runs
+as a \c pread() or \c pwrite() on a thread pool - by default the process
+one (FX::FXProcess::threadPool()). Devices which don't expose a kernel
+handle such as FX::QMemMap are serviced by readBlockFrom() and
+writeBlockTo() on the thread pool.
+
+Each request's buffer must remain valid until its batch completes, as must
+the request array itself which is updated with the results. A failed
+request doesn't stop the others - check FX::FXAsyncIO::Future::failures()
+and each request's \c errcode afterwards.
+
+\note Requests against a FX::QFile bypass its buffer and file pointer, so
+don't mix synchronous i/o on the same region with outstanding requests and
+call FX::QFile::reloadSize() if asynchronous writes have extended the file.
+
+<h3>Usage:</h3>
+\code
+FXAsyncIO aio;
+FXAsyncIO::Request reqs[64];
+for(int n=0; n<64; n++)
+	reqs[n]=FXAsyncIO::Request(FXAsyncIO::Request::Read, &file, n*65536, buffers[n], 65536);
+FXAsyncIO::Future f=aio.submit(reqs, 64);
+... do something else ...
+f.wait();
+\endcode
+*/
+struct FXAsyncIOPrivate;
+class FXAPIR FXAsyncIO
+{
+	FXAsyncIOPrivate *p;
+	FXAsyncIO(const FXAsyncIO &);
+	FXAsyncIO &operator=(const FXAsyncIO &);
+public:
+	//! A single positional read or write
+	struct Request
+	{
+		enum Type
+		{
+			Read=0,		//!< Read into \em data
+			Write		//!< Write from \em data
+		} type;					//!< What to do
+		QIODevice *dev;			//!< The device (usually a FX::QFile)
+		FXfval pos;				//!< The offset into the device
+		char *data;				//!< The buffer
+		FXuval len;				//!< How many bytes to transfer
+		FXuval transferred;		//!< Upon completion, how many bytes were transferred
+		int errcode;			//!< Upon completion, the \c errno of any failure or zero
+		Request() : type(Read), dev(0), pos(0), data(0), len(0), transferred(0), errcode(0) { }
+		Request(Type _type, QIODevice *_dev, FXfval _pos, char *_data, FXuval _len)
+			: type(_type), dev(_dev), pos(_pos), data(_data), len(_len), transferred(0), errcode(0) { }
+	};
+	struct Batch;
+	/*! \class Future
+	\brief A reference counted handle to a submitted batch of requests
+	*/
+	class FXAPI Future
+	{
+		Batch *b;
+		friend class FXAsyncIO;
+		explicit Future(Batch *_b);
+	public:
+		Future() : b(0) { }
+		Future(const Future &o);
+		Future &operator=(const Future &o);
+		~Future();
+		//! Returns true if this future refers to a batch
+		bool isValid() const throw() { return b!=0; }
+		//! Returns true if every request in the batch has completed
+		bool isFinished() const throw();
+		//! Waits up to \em period milliseconds for the batch to complete, returning false on timeout
+		bool wait(FXuint period=FXINFINITE) const;
+		//! Returns how many requests in the batch failed so far
+		FXuint failures() const throw();
+	};
+	/*! Constructs an instance keeping up to \em queuedepth requests in flight,
+	using \em pool for non-kernel requests (the process thread pool if zero) */
+	FXAsyncIO(FXuint queuedepth=128, QThreadPool *pool=0);
+	//! Waits for all outstanding requests before destructing
+	~FXAsyncIO();
+	//! Returns the maximum number of requests in flight
+	FXuint queueDepth() const throw();
+	//! Returns true if requests against kernel handles go via \c io_uring
+	bool isKernelQueued() const throw();
+	/*! Submits \em count requests starting at \em reqs, returning a future
+	for the batch. If \em completion is set, it is dispatched to the thread pool
+	(which takes ownership of it) once the whole batch has completed. */
+	Future submit(Request *reqs, FXuint count, Generic::BoundFunctorV *completion=0);
+	//! Waits for every outstanding request to complete
+	void waitAll();
+};
+
+} // namespace
+
+#endif
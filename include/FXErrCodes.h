@@ -85,6 +85,8 @@ AUTOMATICALLY GENERATED BY CPPMUNGE - CHANGES WILL BE LOST!
 #define QGZIPDEVICE_NOZLIB 0x87F8C600L
 #define QGZIPDEVICE_CANTTRUNCATE 0x87F8C601L
 #define QGZIPDEVICE_MISSINGSOURCE 0x87F8C602L
+#define QGZIPDEVICE_NOTSEEKABLE 0x87F8C603L
+#define QGZIPDEVICE_BADSTREAMINGMODE 0x87F8C604L
 // End codes for QGZipDevice.cxx
 // Codes for QDir.cxx
 #define QDIR_ISABSOLUTEPATH 0x7cec2600
@@ -103,6 +105,13 @@ AUTOMATICALLY GENERATED BY CPPMUNGE - CHANGES WILL BE LOST!
 #define QBZIP2DEVICE_MISSINGSOURCE 0x7478c602
 #define QBZIP2DEVICE_NOTSEEKABLE 0x7478c603
 // End codes for QBZip2Device.cxx
+// Codes for QLZ4Device.cxx
+#define QLZ4DEVICE_NOTSEEKABLE 0x71C8C600L
+#define QLZ4DEVICE_UNSUPPORTED 0x71C8C601L
+#define QLZ4DEVICE_MISSINGSOURCE 0x71C8C602L
+#define QLZ4DEVICE_BADMODE 0x71C8C603L
+#define QLZ4DEVICE_CANTTRUNCATE 0x71C8C604L
+// End codes for QLZ4Device.cxx
 // END
 
 #endif
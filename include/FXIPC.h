@@ -40,12 +40,13 @@ TnFOX provides a lightweight but powerful IPC framework based around message
 passing. It has been designed primarily with efficiency in mind - not only
 in terms of execution, but especially in terms of maintainence and extensibility.
 The IPC framework can use any FX::QIODeviceS eg; FX::QPipe, FX::QBlkSocket,
-FX::QLocalPipe or FX::QSSLDevice and via threads can provide full portable
+FX::QLocalSocket, FX::QShrdMemPipe, FX::QLocalPipe or FX::QSSLDevice and via threads can provide full portable
 asynchronous i/o (ie; you can send a message, go do something else and get
 notified when its acknowledgement returns).
 
 Messages can be of any size though generally they are unsuited for very large
-blocks of data (consider using a FX::QMemMap if machine-local). If you are
+blocks of data (consider using a FX::QMemMap if machine-local, or passing a
+shared memory descriptor over a FX::QLocalSocket). If you are
 streaming over an external connection (socket) then you'd usually want to
 chop them up into lots of smaller messages. For maximum flexibility there are
 broadcast type messages (one way) and synchronous messages (send and wait
@@ -190,7 +191,10 @@ struct FXIPCMsg
 		FlagsWantAck=1,		//!< If unset and this message has an ack, don't bother serialising the ack
 		FlagsGZipped=2,		//!< If set, data has been run through a FX::QGZipDevice
 		FlagsHasRouting=4,	//!< If set, msg contains routing number
-		FlagsIsBigEndian=8	//!< If set, the sender was big endian
+		FlagsIsBigEndian=8,	//!< If set, the sender was big endian
+		FlagsCompact=16,	//!< If set, data was serialised using FX::FXStream's compact encoding
+		FlagsCompactCapable=32,	//!< If set, the sender is willing to receive compact encoded data
+		FlagsLZ4=64			//!< If set, data has been run through a FX::QLZ4Device
 	};
 private:
 	// The following are sent in this order (total: 18 bytes)
@@ -248,6 +252,8 @@ public:
 	void setRouting(FXuint no) throw() { myrouting=no; myflags|=FlagsHasRouting; }
 	//! Returns true if the message was serialised by a big endian architecture
 	bool inBigEndian() const throw() { return (myflags & FlagsIsBigEndian)!=0; }
+	//! Returns true if the message data was serialised using FX::FXStream's compact encoding
+	bool inCompact() const throw() { return (myflags & FlagsCompact)!=0; }
 	/*! Returns a pointer to the serialised data from which this message was
 	constructed (if it wasn't generated this way, then zero). FX::FXIPCChannel
 	only sets this when a received message is known, not an ack and only for
@@ -255,9 +261,21 @@ public:
 	a message to prevent you using the wrong data (as the buffer gets overwritten). */
 	FXuchar *originalData() const throw() { return myoriginaldata; }
 	//! Dumps the message header to stream \em s. Does not send subclass data - you need to use this as part of a larger call
-	void write(FXStream &s) const { s << len << crc << type << myid << mymsgrev << myflags; if(myflags & FlagsHasRouting) s << myrouting; }
+	void write(FXStream &s) const
+	{	// Header is always fixed width
+		bool compact=s.isCompact();
+		s.setCompact(false);
+		s << len << crc << type << myid << mymsgrev << myflags; if(myflags & FlagsHasRouting) s << myrouting;
+		s.setCompact(compact);
+	}
 	//! Unpacks the message header from stream \em s.
-	void read(FXStream &s) { s >> len >> crc >> type >> myid >> mymsgrev >> myflags; if(myflags & FlagsHasRouting) s >> myrouting; }
+	void read(FXStream &s)
+	{
+		bool compact=s.isCompact();
+		s.setCompact(false);
+		s >> len >> crc >> type >> myid >> mymsgrev >> myflags; if(myflags & FlagsHasRouting) s >> myrouting;
+		s.setCompact(compact);
+	}
 private:
 	// Default constructor so GCC is happy
 	FXDLLLOCAL FXIPCMsg();
@@ -450,10 +468,12 @@ The two most interesting functions for average users will be sendMsg() and
 getMsgAck(). sendMsg() endianises all the requisite data and sets all header
 items of FXIPCMsg for you before writing to the transport device. If
 unreliable() is set, a slight amount of overhead is incurred to calculate
-the adler32 checksum of the message contents. If compression() is set, a
-\b great amount of overhead is incurred by compressing the message data
-using an internal FX::QGZipDevice - it makes no sense to use this except
-when the transport is very, very slow indeed (eg; a modem dialup). Note
+the adler32 checksum of the message contents. If compression() is set to
+\c GZipCompression, a \b great amount of overhead is incurred by compressing
+the message data using an internal FX::QGZipDevice - it makes no sense to use
+this except when the transport is very, very slow indeed (eg; a modem dialup).
+\c LZ4Compression instead uses an internal FX::QLZ4Device which costs far
+less and is worth it for bulky messages over ordinary networks. Note
 that one end can be compressed and the other not as indeed one end can
 be unreliable and the other not.
 
@@ -468,6 +488,17 @@ a different endian to the source and destination. You can still force
 one kind of endian or another which is especially useful for dumping
 message exchanges into a format you can read later.
 
+If you call setCompactEncoding(), message data is serialised using
+FX::FXStream's compact variable length integer encoding which typically
+halves the size of messages mostly consisting of small integers. This is
+negotiated: every message sent by a channel with compact encoding enabled
+is marked as such, and only once a message so marked has been received from
+the other end does the channel begin sending compact encoded message data.
+Thus it is safe to enable even when the other end may be running older code.
+Message headers always remain fixed width. Note that restampMsgAndSend()
+forwards message data as-is, so if tunnelling compact encoded messages the
+destination must be capable of receiving them.
+
 Because of exception safety requirements, thread termination is disabled
 during most of doReception() - all except the first read from the device
 which is the one which normally does most of the waiting. After the initial
@@ -628,10 +659,27 @@ public:
 	bool unreliable() const;
 	//! Sets if CRC checking is enabled for this channel
 	void setUnreliable(bool v);
+	//! The kinds of compression which can be applied to sent messages
+	enum CompressionKinds
+	{
+		NoCompression=0,		//!< Messages are sent uncompressed (default)
+		GZipCompression,		//!< Messages are compressed with FX::QGZipDevice
+		LZ4Compression			//!< Messages are compressed with FX::QLZ4Device
+	};
 	//! Returns if compression is enabled for this channel
 	bool compression() const;
-	//! Sets if compression is enabled for this channel
+	//! Returns what kind of compression is applied to messages sent by this channel
+	CompressionKinds compressionKind() const;
+	//! Sets if compression is enabled for this channel, using \c GZipCompression if so
 	void setCompression(bool v);
+	//! Sets what kind of compression to apply to messages sent by this channel
+	void setCompression(CompressionKinds kind);
+	//! Returns if compact encoding is enabled for this channel
+	bool compactEncoding() const;
+	//! Sets if compact encoding is enabled for this channel, subject to the other end agreeing
+	void setCompactEncoding(bool v);
+	//! Returns true if compact encoding has been negotiated with the other end
+	bool compactEncodingActive() const;
 	//! Returns if channel is active
 	bool active() const;
 	//! Resets the channel to its initial state
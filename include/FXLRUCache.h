@@ -149,7 +149,7 @@ public:
 	//! Returns if this cache adjusts itself dynamically to memory full
 	bool dynamic() const throw() { return amDynamic; }
 	//! Sets if this cache adjusts itself dynamically to memory full
-	void setDynamic(bool v) const throw() { amDynamic=v; }
+	void setDynamic(bool v) { amDynamic=v; dynMax(); }
 	//! Returns the maximum cost permitted by the cache
 	FXuint maxCost() const throw() { return maximum; }
 	//! Sets the maximum cost permitted. Disposes of items immediately if the new cost warrants it.
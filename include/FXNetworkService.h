@@ -26,6 +26,7 @@
 #include "QThread.h"
 #include "FXStream.h"
 #include "QBlkSocket.h"
+#include "FXSocketReactor.h"
 #include <qvaluelist.h>
 
 namespace FX {
@@ -45,8 +46,9 @@ struct FXNetworkServiceClient
 	FXTime bannedUntil;			//!< Until when this client will be banned
 	FXuint refusedCount;		//!< Number of times this client has been refused
 	QValueList<QThreadPool::handle> threadhs;	//!< Threadpool threads currently working with this IP
+	FXuint connections;			//!< Connections from this IP currently in the reactor (see FX::FXNetworkService::setReactor())
 	void *data;					//!< Third party data pointer
-	FXNetworkServiceClient() : data(0) { }
+	FXNetworkServiceClient() : refusedCount(0), connections(0), data(0) { }
 };
 /*! \class FXNetworkService
 \ingroup IPC
@@ -61,6 +63,11 @@ to server CPU exhaustion (you can of course always subsequently negotiate a SSL
 connection after you have verified identity - this is what Tn does). Of course, you
 can hack in a FX::QSSLDevice with a little bit of work if you want to.
 
+If clients reconnect often, setSSLSessionCaching() lets any FX::QSSLDevice negotiated
+over the accepted sockets resume a previous session rather than repeat the full key
+exchange. As FX::QSSLDevice's session cache is process-wide, this affects every
+server in the process.
+
 Ban masks are supported whereby entire IP classes can be banned, as well as client
 throttling, per-IP record keeping (based on a LRU cache which will self-adjust
 according to free memory) and per-IP attempt throttling. FXNetworkService basically
@@ -72,6 +79,14 @@ on all non-localhost addresses. Ban masks work through the AND and XOR technique
 whereby an incoming IP address is ANDed with the mask and then XORed with the XOR,
 and if the remaining value is zero then the IP is accepted. FX::Maths::Vector<> is
 used so SIMD will be used on machines supporting it to perform the bit operations.
+
+For servers with very many mostly idle clients, setReactor() makes the service
+hand accepted clients to a FX::FXSocketReactor rather than needing a thread each.
+\em newclientv is then called in the monitor thread purely to vet the client
+(so it must not block) and if it returns \c ACCEPTED, the socket is made
+non-blocking and added to the reactor with the handler given to setReactor(),
+the reactor deleting it once it closes. In this mode maxClients() of zero means
+no limit and maxClientsPerIP() counts the connections in the reactor.
 */
 struct FXNetworkServicePrivate;
 class FXAPIR FXNetworkService : protected QMutex, public QThread
@@ -79,6 +94,8 @@ class FXAPIR FXNetworkService : protected QMutex, public QThread
 	FXNetworkServicePrivate *p;
 	FXNetworkService(const FXNetworkService &);
 	FXNetworkService &operator=(const FXNetworkService &);
+	FXDLLLOCAL void int_reactorEvent(FXSocketReactor *reactor, QBlkSocket *skt, FXuint events);
+	FXDLLLOCAL void int_reactorRetired(FXSocketReactor *reactor, QBlkSocket *skt);
 public:
 	//! Actions to be taken
 	enum Action
@@ -124,6 +141,16 @@ public:
 	QMemArray<IPMask> bannedIPMasks() const;
 	//! Sets a list of banned IP \b masks
 	void setBannedIPMasks(const QMemArray<IPMask> &list);
+	//! Returns true if SSL session resumption is enabled for servers (see FX::QSSLDevice::setSessionCaching())
+	bool SSLSessionCaching() const;
+	/*! Sets if SSL session resumption is enabled for servers, holding up to
+	\em entries sessions (zero leaves the cache size as it is) */
+	void setSSLSessionCaching(bool enable, FXuint entries=0);
+	//! Returns the reactor serving accepted clients, zero if none
+	FXSocketReactor *reactor() const throw();
+	/*! Sets a reactor to which accepted clients are added with \em handler. A zero
+	\em reactor restores the normal dispatch of new clients to threads. */
+	void setReactor(FXSocketReactor *reactor, FXSocketReactor::HandlerSpec handler);
 	//! Returns a list of IP client records
 	QHostAddressDict<FXNetworkServiceClient> IPClientRecords() const;
 	//! Returns the client record for the specified IP
@@ -0,0 +1,129 @@
+/********************************************************************************
+*                                                                               *
+*                        Event driven network socket reactor                    *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#ifndef FXSOCKETREACTOR_H
+#define FXSOCKETREACTOR_H
+
+#include "FXGenericTools.h"
+
+namespace FX {
+
+/*! \file FXSocketReactor.h
+\brief Defines classes used to serve many sockets from a few threads
+*/
+
+class QBlkSocket;
+class QThreadPool;
+
+/*! \class FXSocketReactor
+\ingroup IPC
+\brief Multiplexes many non-blocking sockets onto a thread pool
+
+The usual way of serving FX::QBlkSocket connections is to hand each one to
+a thread which blocks in readBlock(), which bounds the number of clients
+by how many threads (and their stacks) the process can afford. A server
+with tens of thousands of mostly idle connections instead wants to only
+spend a thread on a connection while it has something to do.
+
+FXSocketReactor watches any number of sockets using a single internal
+thread and, whenever one becomes readable or writable, dispatches its
+handler to a thread pool (by default the process one, FX::FXProcess::threadPool()).
+The handler is called with the reactor, the socket and which of
+FX::FXSocketReactor::Events occurred, and should do whatever can be done
+without waiting before returning. Sockets added are made non-blocking (see
+FX::QBlkSocket::setBlocking()) so a handler reads until readBlock() returns
+zero. A handler is never called for the same socket in two threads at once.
+
+By default the reactor is level triggered so a handler which returns
+leaving data unread is called again straight away. If constructed edge
+triggered, a handler is only called again once more data arrives which
+saves a system call per event, but the handler \b must then read until
+readBlock() returns zero or it may never be called again for that data.
+
+When the other end closes or the connection fails, the handler is called
+with \c Closed set (it may also be set with \c Readable if there is data
+left to read) after which the socket is removed from the reactor. The same
+happens if a handler throws an exception, in which case the handler is
+then called once more with just \c Closed so it can clean up - an
+FX::FXConnectionLostException (as thrown by reading a closed non-blocking
+socket) is treated as a normal close whereas anything else is rethrown for
+the thread pool to report. If the socket was added with \em autodelete it
+is then deleted.
+
+On Linux \c epoll is used so the cost of waiting doesn't depend on how many
+sockets there are and fifty thousand idle connections cost little more than
+their memory. Other POSIX systems use \c poll() which scans every socket on
+each wait and emulates edge triggering with level triggering. Windows is not
+supported as FX::QBlkSocket can't be non-blocking there.
+
+\sa FX::FXNetworkService::setReactor()
+*/
+struct FXSocketReactorPrivate;
+class FXAPIR FXSocketReactor
+{
+	friend struct FXSocketReactorPrivate;
+	FXSocketReactorPrivate *p;
+	FXSocketReactor(const FXSocketReactor &);
+	FXSocketReactor &operator=(const FXSocketReactor &);
+public:
+	//! The events a handler can be called for
+	enum Events
+	{
+		Readable=1,		//!< There is data to be read
+		Writable=2,		//!< There is room to write more
+		Closed=4		//!< The connection has closed or failed
+	};
+	//! The API of a socket handler
+	typedef Generic::Functor<Generic::TL::create<void, FXSocketReactor *, QBlkSocket *, FXuint>::value> HandlerSpec;
+	//! The API of an upcall made when a socket leaves the reactor
+	typedef Generic::Functor<Generic::TL::create<void, FXSocketReactor *, QBlkSocket *>::value> RetiredSpec;
+	/*! Constructs a reactor dispatching handlers to \em dispatch (the process
+	thread pool if zero), edge triggered if \em edgetriggered */
+	FXSocketReactor(QThreadPool *dispatch=0, bool edgetriggered=false);
+	//! Waits for any handlers running, then deletes any sockets added with autodelete
+	~FXSocketReactor();
+	//! Returns the thread pool handlers are dispatched to
+	QThreadPool *dispatchPool() const throw();
+	//! Returns true if the reactor is edge triggered
+	bool edgeTriggered() const throw();
+	/*! Starts watching \em skt for \em events (\c Closed is always watched), calling
+	\em handler when they occur. The socket must be open and is made non-blocking. If
+	\em autodelete, the reactor deletes the socket once it closes or the reactor
+	is destroyed. If \em retired is set, it is moved from and called once the socket leaves the
+	reactor for whatever reason - it closed, remove() was called or the reactor is
+	being destroyed - without the reactor's lock held and before any autodelete. */
+	void add(QBlkSocket *skt, HandlerSpec handler, FXuint events=Readable, bool autodelete=false, RetiredSpec *retired=0);
+	/*! Changes which events \em skt is watched for, typically to watch for \c Writable
+	only while there is data waiting to be sent. May be called from its handler. */
+	void setEvents(QBlkSocket *skt, FXuint events);
+	//! Returns which events \em skt is watched for, or zero if it isn't in the reactor
+	FXuint events(QBlkSocket *skt) const;
+	/*! Stops watching \em skt, returning false if it wasn't being. The socket is
+	never deleted and may be used as normal (it stays non-blocking) once any
+	handler running for it has returned. May be called from its handler. */
+	bool remove(QBlkSocket *skt);
+	//! Returns how many sockets are being watched
+	FXuint count() const;
+};
+
+} // namespace
+
+#endif
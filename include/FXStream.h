@@ -110,11 +110,33 @@ a flag within your data structure to avoid unnecessary endian conversions
 end of the communications channel).
 
 Since FOX v1.1.31, FXStream incorporates buffering and more general purpose
-facilities. The buffering in particular is left out because that's for the
+facilities. The buffering by default is left out because that's for the
 i/o device classes to implement if they want to. More importantly, IPC just
 would not work if a write to a pipe was coalesced into a larger packet sent
 sometime later.
 
+However every primitive serialised costs a virtual call into the i/o device
+(which typically also takes its mutex), so when serialising large numbers
+of small items you may wish to call setBufferSize() which makes FXStream
+keep an internal buffer through which primitives are transferred inline.
+Writes are coalesced until the buffer fills or flush() is called, and reads
+are satisfied from a read-ahead window. position(), rewind() and atEnd()
+account for the buffer contents, but if you access device() directly you
+must call flush() first. Read-ahead is only performed on non-synchronous
+devices without CR/LF translation - for all others reads pass straight
+through.
+
+<h3>Compact encoding:</h3>
+By default all integral types are written out in their full fixed width. If
+you call setCompact(), all 16, 32 and 64 bit integers are instead written as
+LEB128 variable length integers, with signed integers zigzag encoded first so
+small negative numbers also stay small. As most integers serialised in practice
+(lengths, counts, flags, ids) are small, this usually halves the size of the
+output or better. Bytes, bools, floating point and the array save() and load()
+functions are unaffected and remain fixed width. Obviously the reading end
+must be set to the same mode as the writing end - FX::FXIPCChannel negotiates
+this for you (see FX::FXIPCChannel::setCompactEncoding()).
+
 <h3>Difference from FOX's FXStream & Qt's QDataStream</h3>
 Endian translation is performed for you on big endian machines by default
 (simply because numerically more computers in the world are little endian,
@@ -161,9 +183,15 @@ protected:
   FXuint             seq;       // Sequence number
   bool               owns;      // Stream owns buffer
   bool               swap;      // Swap bytes on readin
+  bool               compact;   // Variable length integers
 
 protected: // TnFOX stuff
   QIODevice         *dev;       // i/o device
+  FXuchar           *iobuf;     // Internal i/o buffer (if enabled)
+  FXuval             iobufsize; // Size of internal i/o buffer
+  FXuchar           *ioptr;     // Next byte to read or write within iobuf
+  FXuchar           *ioend;     // End of data read or end of iobuf if writing
+  FXStreamDirection  iodir;     // What iobuf currently holds
 public:
 
   //! Constructs an instance using device \em dev. \em cont is for FOX FXStream emulation only.
@@ -176,7 +204,12 @@ public:
   //! \deprecated For Qt compatibility only
   FXDEPRECATEDEXT void unsetDevice() { setDevice(0); }
   //! Returns true if there is no more data to be read
-  bool atEnd() const { return dev->atEnd(); }
+  bool atEnd() const { return (FXStreamLoad==iodir && ioptr<ioend) ? false : dev->atEnd(); }
+  //! Returns the size of the internal i/o buffer, zero if disabled
+  FXuval bufferSize() const { return iobufsize; }
+  /*! Sets the size of the internal i/o buffer, flushing any existing contents.
+  Zero (the default) disables buffering */
+  void setBufferSize(FXuval size);
 
   enum ByteOrder
   {
@@ -193,7 +226,7 @@ public:
   //! Reads preformatted byte data into the specified buffer
   FXStream &readRawBytes(char *buffer, FXuval len)
   {
-	if(len!=dev->readBlock(buffer, len)) int_throwPrematureEOF();
+	if(len!=int_read(buffer, len)) int_throwPrematureEOF();
 	return *this;
   }
 
@@ -204,7 +237,7 @@ public:
   //! Writes preformatted byte data from the specified buffer
   FXStream &writeRawBytes(const char *buffer, FXuval len)
   {
-	dev->writeBlock(buffer, len);
+	int_write(buffer, len);
 	return *this;
   }
   //! \overload
@@ -247,11 +280,10 @@ public:
   */
   FXDEPRECATEDEXT bool open(FXStreamDirection save_or_load,FXuval size=8192,FXuchar* data=NULL);
 
-  /** \deprecated For FOX compatibility only
-  
-  Flush buffer
-  */
-  virtual FXDEPRECATEDEXT bool flush();
+  /*! Writes out the internal i/o buffer if writing, or discards any read-ahead
+  if reading, such that the device's file pointer equals position(). Does
+  nothing if setBufferSize() has not been called. */
+  virtual bool flush();
 
   /** \deprecated For FOX compatibility only
 
@@ -323,72 +355,134 @@ public:
   * Return true if big endian mode.
   */
   bool isBigEndian() const { return (swap^FOX_BIGENDIAN); }
+
+  //! Returns true if integers are written using compact variable length encoding
+  bool isCompact() const { return compact; }
+  //! Sets if integers are written using compact variable length encoding
+  void setCompact(bool v) { compact=v; }
 private:
   void int_throwPrematureEOF();
+  void int_sync();
+  void int_writeBuffered(const char *data, FXuval len);
+  FXuval int_readBuffered(char *data, FXuval len);
+  void int_write(const void *data, FXuval len)
+  {
+    if(FXStreamSave==iodir && (FXuval)(ioend-ioptr)>=len)
+    {
+      memcpy(ioptr, data, len);
+      ioptr+=len;
+    }
+    else int_writeBuffered((const char *) data, len);
+  }
+  FXuval int_read(void *data, FXuval len)
+  {
+    if(FXStreamLoad==iodir && (FXuval)(ioend-ioptr)>=len)
+    {
+      memcpy(data, ioptr, len);
+      ioptr+=len;
+      return len;
+    }
+    return int_readBuffered((char *) data, len);
+  }
+  FXStream &int_writeVarint(FXulong v)
+  {
+    FXuchar buf[10], *p=buf;
+    while(v>=0x80)
+    {
+      *p++=(FXuchar)(v|0x80);
+      v>>=7;
+    }
+    *p++=(FXuchar) v;
+    int_write(buf, p-buf);
+    return *this;
+  }
+  FXulong int_readVarint(FXulong max);
+  static FXulong int_zigzag(FXlong v) { return ((FXulong) v<<1)^(FXulong)(v>>63); }
+  static FXlong int_unzigzag(FXulong v) { return (FXlong)(v>>1)^-(FXlong)(v&1); }
+  template<typename type> void int_saveArray(const type *p, FXuval n);
+  template<typename type> bool int_loadArray(type *p, FXuval n);
 public:
   /// Save single items to stream
   friend inline FXStream& operator<<(FXStream& s, const FXuchar& v)
   {
-    s.dev->putch(v);
+    if(FXStreamSave==s.iodir && s.ioptr<s.ioend) *s.ioptr++=v;
+    else s.int_writeBuffered((const char *) &v,1);
     return s;
   }
   friend inline FXStream& operator<<(FXStream& s, const FXchar& v){ return s << reinterpret_cast<const FXuchar&>(v); }
   friend inline FXStream& operator<<(FXStream& s, const FXushort& _v)
   {
+    if(s.compact) return s.int_writeVarint(_v);
     FXushort v=_v;
     if(s.swap){fxendianswap(v);}
-    s.dev->writeBlock((char *) &v,2);
+    s.int_write(&v,2);
     return s;
   }
-  friend inline FXStream& operator<<(FXStream& s, const FXshort& v){ return s << reinterpret_cast<const FXushort&>(v); }
+  friend inline FXStream& operator<<(FXStream& s, const FXshort& v)
+  {
+    if(s.compact) return s.int_writeVarint(int_zigzag(v));
+    return s << reinterpret_cast<const FXushort&>(v);
+  }
   friend inline FXStream& operator<<(FXStream& s, const FXuint& _v)
   {
+    if(s.compact) return s.int_writeVarint(_v);
     FXuint v=_v;
     if(s.swap){fxendianswap(v);}
-    s.dev->writeBlock((char *) &v,4);
+    s.int_write(&v,4);
     return s;
   }
-  friend inline FXStream& operator<<(FXStream& s, const FXint& v){ return s << reinterpret_cast<const FXuint&>(v); }
+  friend inline FXStream& operator<<(FXStream& s, const FXint& v)
+  {
+    if(s.compact) return s.int_writeVarint(int_zigzag(v));
+    return s << reinterpret_cast<const FXuint&>(v);
+  }
   friend inline FXStream& operator<<(FXStream& s, const FXfloat& _v)
   {
     FXuint v=*(FXuint *)&_v;
     if(s.swap){fxendianswap(v);}
-    s.dev->writeBlock((char *) &v,4);
+    s.int_write(&v,4);
     return s;
   }
   friend inline FXStream& operator<<(FXStream& s, const FXdouble& _v)
   {
     FXulong v=*(FXulong *)&_v;
     if(s.swap){fxendianswap(v);}
-    s.dev->writeBlock((char *) &v,8);
+    s.int_write(&v,8);
     return s;
   }
-  friend inline FXStream& operator<<(FXStream& s, const FXlong& v){ return s << reinterpret_cast<const FXulong&>(v); }
+  friend inline FXStream& operator<<(FXStream& s, const FXlong& v)
+  {
+    if(s.compact) return s.int_writeVarint(int_zigzag(v));
+    return s << reinterpret_cast<const FXulong&>(v);
+  }
   friend inline FXStream& operator<<(FXStream& s, const FXulong& _v)
   {
+    if(s.compact) return s.int_writeVarint(_v);
     FXulong v=_v;
     if(s.swap){fxendianswap(v);}
-    s.dev->writeBlock((char *) &v,8);
+    s.int_write(&v,8);
     return s;
   }
   friend inline FXStream& operator<<(FXStream& s, const char *v)
   {
-    s.dev->writeBlock(v, strlen(v));
+    s.int_write(v, strlen(v));
     return s;
   }
   friend inline FXStream& operator<<(FXStream& s, const bool& _v)
   {
-    s.dev->putch(_v);
-    return s;
+    FXuchar v=_v;
+    return s << v;
   }
 
   /// Save arrays of items to stream
   inline FXStream& save(const FXuchar* p,unsigned long n){	// inlined as FXString uses it
     FXASSERT(n==0 || (n>0 && p!=NULL));
-    dev->writeBlock((char *) p,n);
+    int_write(p,n);
     return *this;
   }
   FXStream& save(const FXchar* p,unsigned long n){ return save(reinterpret_cast<const FXuchar*>(p),n); }
+  /*! Save arrays of 16, 32 and 64 bit items to stream. If byte swapping, this is performed
+  in cache sized chunks using SSSE3 or AVX2 if the compiler is targeting them */
   FXStream& save(const FXushort* p,unsigned long n);
   FXStream& save(const FXshort* p,unsigned long n){ return save(reinterpret_cast<const FXushort*>(p),n); }
   FXStream& save(const FXuint* p,unsigned long n);
@@ -401,50 +495,64 @@ public:
   /// Load single items from stream
   friend inline FXStream& operator>>(FXStream& s, FXuchar& v)
   {
-    int _v=s.dev->getch();
-    v=(FXuchar) _v;
-    if(-1==_v) s.int_throwPrematureEOF();
+    if(FXStreamLoad==s.iodir && s.ioptr<s.ioend) v=*s.ioptr++;
+    else if(1!=s.int_readBuffered((char *) &v,1)) s.int_throwPrematureEOF();
     return s;
   }
   friend inline FXStream& operator>>(FXStream& s, FXchar& v){ return s >> reinterpret_cast<FXuchar&>(v); }
   friend inline FXStream& operator>>(FXStream& s, FXushort& v)
   {
-    if(2!=s.dev->readBlock((char *) &v,2)) s.int_throwPrematureEOF();
+    if(s.compact){ v=(FXushort) s.int_readVarint(0xffff); return s; }
+    if(2!=s.int_read(&v,2)) s.int_throwPrematureEOF();
     if(s.swap){fxendianswap(v);}
     return s;
   }
-  friend inline FXStream& operator>>(FXStream& s, FXshort& v){ return s >> reinterpret_cast<FXushort&>(v); }
+  friend inline FXStream& operator>>(FXStream& s, FXshort& v)
+  {
+    if(s.compact){ v=(FXshort) int_unzigzag(s.int_readVarint(0xffff)); return s; }
+    return s >> reinterpret_cast<FXushort&>(v);
+  }
   friend inline FXStream& operator>>(FXStream& s, FXuint& v)
   {
-    if(4!=s.dev->readBlock((char *) &v,4)) s.int_throwPrematureEOF();
+    if(s.compact){ v=(FXuint) s.int_readVarint(0xffffffff); return s; }
+    if(4!=s.int_read(&v,4)) s.int_throwPrematureEOF();
     if(s.swap){fxendianswap(v);}
     return s;
   }
-  friend inline FXStream& operator>>(FXStream& s, FXint& v){ return s >> reinterpret_cast<FXuint&>(v); }
+  friend inline FXStream& operator>>(FXStream& s, FXint& v)
+  {
+    if(s.compact){ v=(FXint) int_unzigzag(s.int_readVarint(0xffffffff)); return s; }
+    return s >> reinterpret_cast<FXuint&>(v);
+  }
   friend inline FXStream& operator>>(FXStream& s, FXfloat& v)
   {
-    if(4!=s.dev->readBlock((char *) &v,4)) s.int_throwPrematureEOF();
+    if(4!=s.int_read(&v,4)) s.int_throwPrematureEOF();
     if(s.swap){fxendianswap(*(FXuint *)&v);}
     return s;
   }
   friend inline FXStream& operator>>(FXStream& s, FXdouble& v)
   {
-    if(8!=s.dev->readBlock((char *) &v,8)) s.int_throwPrematureEOF();
+    if(8!=s.int_read(&v,8)) s.int_throwPrematureEOF();
     if(s.swap){fxendianswap(*(FXulong *)&v);}
     return s;
   }
-  friend inline FXStream& operator>>(FXStream& s, FXlong& v){ return s >> reinterpret_cast<FXulong&>(v); }
+  friend inline FXStream& operator>>(FXStream& s, FXlong& v)
+  {
+    if(s.compact){ v=int_unzigzag(s.int_readVarint((FXulong)-1)); return s; }
+    return s >> reinterpret_cast<FXulong&>(v);
+  }
   friend inline FXStream& operator>>(FXStream& s, FXulong& v)
   {
-    if(8!=s.dev->readBlock((char *) &v,8)) s.int_throwPrematureEOF();
+    if(s.compact){ v=s.int_readVarint((FXulong)-1); return s; }
+    if(8!=s.int_read(&v,8)) s.int_throwPrematureEOF();
     if(s.swap){fxendianswap(v);}
     return s;
   }
   friend inline FXStream& operator>>(FXStream& s, bool& v)
   {
-    int _v=s.dev->getch();
+    FXuchar _v;
+    s >> _v;
     v=(_v!=0);
-    if(-1==_v) s.int_throwPrematureEOF();
     return s;
   }
 
@@ -452,10 +560,12 @@ public:
   /// Load arrays of items from stream
   FXStream& load(FXuchar* p,unsigned long n){	// inlined as FXString uses it
     FXASSERT(n==0 || (n>0 && p!=NULL));
-    if(n!=dev->readBlock((char *) p,n)) int_throwPrematureEOF();
+    if(n!=int_read(p,n)) int_throwPrematureEOF();
     return *this;
   }
   FXStream& load(FXchar* p,unsigned long n){ return load(reinterpret_cast<FXuchar*>(p),n); }
+  /*! Load arrays of 16, 32 and 64 bit items from stream. If byte swapping, this is performed
+  in cache sized chunks as they are read */
   FXStream& load(FXushort* p,unsigned long n);
   FXStream& load(FXshort* p,unsigned long n){ return load(reinterpret_cast<FXushort*>(p),n); }
   FXStream& load(FXuint* p,unsigned long n);
@@ -39,6 +39,14 @@ the .bz2 file and provides the decompressed version to anything using it. You ca
 it for reading or writing, though unless seeking is enabled during construction,
 you may only perform linear reading or writing.
 
+If you set parallel compression with setParallelCompression(), the data is
+split into blocks (by default 900Kb, the largest bzip2 block) which are
+compressed independently on the process thread pool
+(FX::FXProcess::threadPool()) and written as concatenated .bz2 streams.
+bunzip2 and this class decompress these as one stream. With the default
+block size the output is barely bigger, as bzip2 never compresses across
+blocks anyway.
+
 <h3>Implementation notes:</h3>
 If seeking is enabled, the class internally decompresses to a QBuffer on open()
 and all work is done to and from this buffer. Only on close() or flush() is the
@@ -81,6 +89,11 @@ public:
 	QIODevice *BZ2Data() const;
 	//! Sets the device being usied as .bz2 source
 	void setBZ2Data(QIODevice *gzdata);
+	//! Returns the block size used for parallel compression, or zero if disabled
+	FXuval parallelCompression() const;
+	/*! Sets parallel compression of \em blocksize blocks, or disables it if zero.
+	Takes effect at the next open() */
+	void setParallelCompression(FXuval blocksize=900000);
 
 	virtual bool open(FXuint mode);
 	virtual void close();
@@ -44,8 +44,9 @@ events - instead a much simpler and elegant structure is required of having
 a unique thread wait on input and it can handle and/or dispatch incoming data.
 
 It is also almost API compatible with Qt's QSocketDevice which is Qt's
-core socket class. Unlike QSocketDevice, QBlkSocket can only behave in
-a blocking fashion.
+core socket class. Like QSocketDevice, QBlkSocket can be made non-blocking
+with setBlocking() on POSIX, which is how FX::FXSocketReactor serves many
+thousands of connections from a few threads.
 
 Furthermore, QBlkSocket provides a full IPv6 interface as well as IPv4
 facilities. All you need to do is set an IPv6 address in FX:QHostAddress
@@ -119,7 +120,7 @@ implementation.
 <h4>Differences from Qt:</h4>
 First off, as usual, errors are returned as exceptions rather than by error().
 Secondly, a lot of the complexity in QSocketDevice can be avoided as this
-socket always blocks - thus some API's return default values. I've also
+socket blocks by default - thus some API's return default values. I've also
 removed the methods allowing direct manipulation of the socket handle
 as code should need to know nothing about it (and this is the biggest
 break from QSocketDevice's API). Lastly, I've extended the API where
@@ -148,8 +149,10 @@ class FXAPIR QBlkSocket : public QIODeviceS
 	FXDLLLOCAL void fillInAddrs(bool incPeer);
 	FXDLLLOCAL void zeroAddrs();
 	FXDLLLOCAL void setupSocket();
+	FXDLLLOCAL void applyBlocking();
 	QBlkSocket(const QBlkSocket &o, int h);
 	virtual FXDLLLOCAL void *int_getOSHandle() const;
+	virtual FXDLLLOCAL int int_transferHandle(bool write);
 public:
 	//! The types of connection you can have
 	enum Type
@@ -157,6 +160,19 @@ public:
 		Stream=0,	//!< A connection based reliable socket (TCP)
 		Datagram	//!< A packet based unreliable socket (UDP)
 	};
+	/*! \struct Packet
+	\brief A datagram for readDatagrams() and writeDatagrams()
+	*/
+	struct Packet
+	{
+		char *data;				//!< The datagram's data
+		FXuval len;				//!< Its length. When reading, the space at \em data on entry and the length received on return
+		QHostAddress addr;		//!< Where it came from or goes to (if null when writing, requestedAddress())
+		FXushort port;			//!< The port it came from or goes to
+		FXuval segmentSize;		//!< If nonzero, \em data holds consecutive datagrams of this size (the last may be shorter)
+		bool truncated;			//!< Set when reading if the datagram was too big for \em len
+		Packet(char *_data=0, FXuval _len=0, FXuval _segmentSize=0) : data(_data), len(_len), port(0), segmentSize(_segmentSize), truncated(false) { }
+	};
 	//! Constructs a socket on the local machine on port \em port (you still need to call create())
 	QBlkSocket(Type type=Stream, FXushort port=0);
 	//! Constructs a socket to connect to \em addr (you still need to call open()) or a server on localhost
@@ -218,6 +234,15 @@ public:
 	void setMaxPending(FXint newp);
 	//! \overload
 	bool listen(int newp) { setMaxPending(newp); return true; }
+	//! Returns true if this socket blocks (the default). See setBlocking().
+	bool blocking() const;
+	/*! Sets if this socket blocks. A non-blocking socket returns zero from
+	readBlock() when there is nothing to read and throws FX::FXConnectionLostException
+	when the other end has closed, writeBlock() may write less than asked or nothing
+	at all, and waitForConnection() returns zero when there is no connection pending.
+	This is intended for use with FX::FXSocketReactor. Not supported on Windows.
+	*/
+	void setBlocking(bool newb);
 	//! Returns true if this socket's address is reusable (never if isUnique() is true). Use only after opening.
 	bool addressReusable() const;
 	//! Sets if this socket's address is reusable (never if isUnique() is true). Use only after opening.
@@ -282,6 +307,49 @@ public:
 	Useful for UDP packet sends
 	*/
 	FXuval writeBlock(const char *data, FXuval maxlen, const QHostAddress &addr, FXushort port);
+	/*! Reads into several buffers at once. On POSIX this is a single readv(), or a
+	recvmsg() for datagram sockets which scatters one datagram across the segments
+	*/
+	FXuval readBlockV(const IOVec *segs, FXuint count);
+	/*! Writes several buffers at once. On POSIX this is a single writev(), or a
+	sendmsg() for datagram sockets which gathers the segments into one datagram
+	(in which case no more than 64 segments may be given)
+	*/
+	FXuval writeBlockV(const IOVec *segs, FXuint count);
+	/*! \return The number of datagrams received
+	\param pkts Array of packets to receive into
+	\param count Number of packets in the array
+
+	Receives up to \em count datagrams, waiting only for the first (unless
+	non-blocking) and filling in each packet's length and source address. On
+	Linux this is a single \c recvmmsg() per 64 datagrams, saving the system
+	call per datagram which otherwise dominates at high packet rates. If
+	setReceiveCoalescing() is on, each packet may hold several datagrams from
+	the same source in which case its \c segmentSize is set.
+	*/
+	FXuint readDatagrams(Packet *pkts, FXuint count);
+	/*! \return The number of datagrams sent
+	\param pkts Array of packets to send
+	\param count Number of packets in the array
+
+	Sends \em count datagrams, each to its own address. On Linux this is a single
+	\c sendmmsg() per 64 datagrams. A packet with a \c segmentSize is sent as
+	consecutive datagrams of that size - if hasSegmentationOffload(), the kernel
+	(or even the network card) does the splitting and each \c sendmmsg() can carry
+	up to 64Kb of such a packet, otherwise it's split here. If the socket
+	is non-blocking, fewer packets than asked may be sent.
+	*/
+	FXuint writeDatagrams(const Packet *pkts, FXuint count);
+	//! Returns true if the kernel splits packets written with a segment size (UDP GSO, Linux 4.18 onwards)
+	bool hasSegmentationOffload() const;
+	//! Returns true if the kernel coalesces received datagrams (see setReceiveCoalescing())
+	bool receiveCoalescing() const;
+	/*! Sets if the kernel may coalesce datagrams received from the same source into
+	one packet for readDatagrams() (UDP GRO, Linux 5.0 onwards). Returns if it is now
+	on, which it can't be where unsupported. Use only after opening and note that
+	readBlock() would return coalesced datagrams as one.
+	*/
+	bool setReceiveCoalescing(bool newb);
 	//! Tries to unread a character. Unsupported for sockets.
 	int ungetch(int);
 	/*! \return A new'ed instance of QBlkSocket for the new connection or 0 if timed out
@@ -293,10 +361,6 @@ public:
 	QBlkSocket *waitForConnection(FXuint waitfor=FXINFINITE);
 
 public:
-	//! \deprecated For Qt compatibility only
-	FXDEPRECATEDEXT bool blocking() const { return true; }
-	//! \deprecated For Qt compatibility only
-	FXDEPRECATEDEXT void setBlocking(bool) { }
 	//! \deprecated For Qt compatibility only
 	FXDEPRECATEDEXT FXuval waitForMore(int msecs, bool *timeout=0);
 };
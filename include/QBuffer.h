@@ -48,6 +48,25 @@ with files in TnFOX does though, so the conversion can be done then.
 deleted on destruction or setBuffer(). If you set your own buffer, it is never
 deleted by QBuffer.
 
+<h3>Segmented mode</h3>
+Writing past the end of a QByteArray means reallocating it and copying
+everything written so far, which gets expensive when building large buffers
+of unknown size. setSegmented() switches to holding the contents instead in a
+chain of SegmentSize byte segments drawn from a process-wide pool, so
+extending the buffer never copies what's already there and freed segments
+get reused. Everything works as before except that the contents are no longer
+contiguous:
+\li segments() returns where the contents are as a list of FX::QIODevice::IOVec
+suitable for passing straight to FX::QIODevice::writeBlockV()
+\li linearize() returns the contents as one block, copying them only if they
+span more than one segment
+\li buffer() turns segmented mode back off, copying the contents into the
+byte array, so existing code keeps working (if slowly)
+
+If you had set your own byte array, turning segmented mode on copies its contents
+out and leaves it untouched until segmented mode is turned back off, when the
+contents are copied back into it.
+
 <h3>Differences from QBuffer</h3>
 Since there is no reference counted sharing in TnFOX, buffer() and setBuffer()
 return and take references.
@@ -73,6 +92,19 @@ public:
 	QByteArray &buffer() const;
 	//! Sets the byte array being addressed by this device. Closes the old buffer first.
 	void setBuffer(QByteArray &buffer);
+	//! The size of each segment in segmented mode
+	static const FXuval SegmentSize=64*1024;
+	//! Returns true if the contents are held in a chain of segments
+	bool isSegmented() const;
+	//! Sets if the contents are held in a chain of segments, converting the current contents
+	void setSegmented(bool v);
+	/*! Returns the contents as one contiguous block. In segmented mode this is only
+	valid until the next write to or truncation of the buffer */
+	const char *linearize();
+	/*! Fills in up to \em count of \em segs with where the contents from \em offset
+	onwards are, returning how many were filled. If \em segs is zero, returns how many
+	are needed. Only valid until the next write to or truncation of the buffer */
+	FXuint segments(IOVec *segs, FXuint count, FXfval offset=0) const;
 
 	virtual bool open(FXuint mode);
 	virtual void close();
@@ -70,6 +70,12 @@ instead of blocking for more data to arrive.
 
 Unix programs output two streams: \c stdout and \c stderr. You can switch between
 which is active, or whether to merge them, as the read channel using setReadChannel().
+To send a child's output somewhere else, use transferTo() which on Linux splice()'s
+it from the child's pipe straight into a FX::QFile, socket or pipe without it passing
+through user space. This only happens when the read channel is \c stdout or \c stderr
+alone, as the merging of the two is done by QChildProcess. Equally, calling
+FX::QIODevice::transferTo() on a FX::QFile with a QChildProcess as the destination
+feeds the file into the child's \c stdin without copying it.
 */
 
 struct QChildProcessPrivate;
@@ -81,6 +87,7 @@ class FXAPIR QChildProcess : public QIODeviceS
 	virtual FXDLLLOCAL void *int_getOSHandle() const;
 	FXDLLLOCAL void int_killChildI(bool);
 	FXDLLLOCAL bool int_suckPipesDry(bool block=false);
+	virtual FXDLLLOCAL int int_transferHandle(bool write);
 public:
 	//! The types of read channel
 	enum ReadChannel
@@ -151,6 +158,12 @@ public:
 	isn't reading in from its input quickly enough, this may block.
 	*/
 	FXuval writeBlock(const char *data, FXuval maxlen);
+	/*! Copies up to \em len bytes of the command's output to \em dst, by default
+	until the command exits. Whatever has already been read from the command is
+	written first, and then the rest is moved within the kernel where possible.
+	See the class description above.
+	*/
+	FXfval transferTo(QIODevice &dst, FXfval len=(FXfval)-1);
 
 	//! Tries to unread a character. Unsupported.
 	int ungetch(int);
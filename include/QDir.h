@@ -69,6 +69,10 @@ generate the list of FX::QFileInfo's - which may mean an incomplete listing. If
 the directory enumerated has vanished altogether, then a null pointer is returned.
 The static method extractChanges() is additional functionality over Qt.
 
+Sorting calculates each item's sort key (case folded name, size or modification
+time) once up front and then merge sorts using FX::FXProcess::threadPool(), so
+even directories with hundreds of thousands of entries sort quickly.
+
 Note that as with all TnFOX functionality, if something fails it throws an exception.
 Thus many of the boolean returns are always true.
 */
@@ -114,6 +118,7 @@ public:
 		DirsFirst =0x04,	//!< Directories first
 		Reversed  =0x08,	//!< Reversed
 		IgnoreCase=0x10,	//!< Ignore case
+		Numeric   =0x20,	//!< Compare runs of digits by value (eg; file2 before file10)
 
 		DefaultSort=0xffffffff
 	};
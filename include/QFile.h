@@ -40,12 +40,37 @@ namespace FX {
 
 Not much to say about this - it works as you'd expect. It's also thread-safe
 so multiple threads can read and write from it (though the current file pointer
-is the same for both, so it probably doesn't help you much).
+is the same for both, so it probably doesn't help you much). Where you
+want many threads working on one file, use readBlockFrom() and writeBlockTo()
+instead. These never move the file pointer, and on POSIX unless the file is
+translated they go straight to \c pread() and \c pwrite(). The file's lock
+is only taken to write out pending write-behind data (or, for a write, to
+discard read-ahead it overlaps) and never during the i/o itself, so
+concurrent readers scale with the number of threads and don't wait for a
+thread doing sequential i/o.
 
 Most likely you'll prefer to use FX::QMemMap all the time as it offers
-superior performance and facilities in most cases. Indeed, QFile does no
-internal buffering as it is expected it will only be used rarely, mostly
-for small files with little i/o performed to them.
+superior performance and facilities in most cases. However QFile does keep
+an internal buffer (64Kb by default, see setBufferSize()) so that small
+reads and writes such as those made by FX::FXStream don't each cost a
+syscall. Reads are satisfied from a read-ahead window which grows while
+access remains sequential and writes are coalesced until the buffer fills,
+the file pointer is moved outside of the buffer, flush() is called or the
+file is closed (when the buffer is always written out). Seeks within the
+read-ahead window and ungetch() of the byte just read cost nothing. Because
+written data may sit in the buffer, other handles onto the same file won't
+see it until you call flush(). Opening with \c IO_Raw, \c IO_Translate or
+setting a buffer size of zero disables the buffer.
+
+Reading big files with readBlock() still costs a copy by the kernel for every
+byte. If you set a map threshold with setMapThreshold(), opening a regular
+file read-only whose size is at least that maps the whole file into memory
+from its open handle and readBlock(), readBlockFrom() and getch() become a
+\c memcpy() from the mapping. view() goes one better and hands out
+a pointer directly into the mapping so you needn't copy at all. Smaller files,
+pipes, devices and files opened for writing or with \c IO_Translate are read
+as before, as are files which couldn't be mapped (eg; when out of address space
+on 32 bit architectures).
 
 Like all file type i/o classes, QFile can perform automatic CR/LF translation
 as well as UTF-8 to UTF-16 and UTF-32 conversion. If you enable \c IO_Translate,
@@ -88,6 +113,11 @@ class FXAPIR QFile : public QIODevice
 	friend class QMemMap;
 	friend class FXProcess;
 	FXDLLLOCAL int int_fileDescriptor() const;
+	FXDLLLOCAL bool int_buffered() const;
+	FXDLLLOCAL void int_syncBuffer();
+	FXDLLLOCAL bool int_readyPositional(bool write, FXfval pos, FXuval len);
+	virtual FXDLLLOCAL int int_transferHandle(bool write);
+	virtual FXDLLLOCAL void int_transferDone(bool write, FXfval moved);
 public:
 	QFile();
 	//! Constructs a new instance, setting the file name to be used to \em name
@@ -103,6 +133,23 @@ public:
 	bool remove();
 	//! Reloads the size of the file. See description above
 	FXfval reloadSize();
+	//! Returns the size of the internal buffer, zero if disabled
+	FXuval bufferSize() const;
+	/*! Sets the size of the internal buffer, writing out or discarding any
+	existing contents. Zero disables buffering. */
+	void setBufferSize(FXuval size);
+	//! Returns the size of file at and above which reads are served by a mapping, zero if disabled
+	FXfval mapThreshold() const;
+	/*! Sets the size of file at and above which opening read-only maps the file into memory
+	to serve reads. Zero (the default) disables mapping. Takes effect on the next open(). */
+	void setMapThreshold(FXfval size);
+	//! Returns true if reads are being served by a mapping of the file
+	bool isMapped() const;
+	/*! Returns a pointer to the \em len bytes of the file at \em offset if reads are being
+	served by a mapping and all of them lie within the file, otherwise zero. The data is
+	valid until the file is closed or reloadSize() is called and must not be written to.
+	The file pointer is not moved. */
+	const char *view(FXfval offset, FXuval len) const;
 	/*! Returns an QIODevice referring to stdin/stdout. This is somewhat of a special device
 	in that it can't be closed, doesn't have a size and reads from it can block.
 	\sa QPipe
@@ -128,6 +175,10 @@ public:
 	virtual FXuval writeBlock(const char *data, FXuval maxlen);
 	virtual FXuval readBlockFrom(char *data, FXuval maxlen, FXfval pos);
 	virtual FXuval writeBlockTo(FXfval pos, const char *data, FXuval maxlen);
+	virtual FXuval readBlockV(const IOVec *segs, FXuint count);
+	virtual FXuval writeBlockV(const IOVec *segs, FXuint count);
+	virtual int getch();
+	virtual int putch(int c);
 	virtual int ungetch(int c);
 };
 
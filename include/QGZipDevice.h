@@ -44,12 +44,46 @@ reduce their size and loading time. Simply attach the i/o device accessing
 the translation file to an instance of this class using setGZData(). Then
 read from this instance instead.
 
+Compressing is slow, so if you set parallel compression with
+setParallelCompression() the data is split into blocks (1Mb by default)
+which are compressed independently on the process thread pool
+(FX::FXProcess::threadPool()). Each block becomes a separate gzip member,
+which gunzip and this class decompress as one concatenated stream. The
+file comes out around 0.1% larger because each block starts without
+history. This works both when streaming and when not.
+
 <h3>Implementation notes:</h3>
 Since the process of inflation and deflation is slow, the class internally
 decompresses to a QBuffer on open() and all work is done to and from this
 buffer. Only on close() or flush() is the data in the buffer gzipped back
 to the gzdata source.
 
+This obviously needs memory for the whole of the decompressed data and
+a long wait before the first byte can be read, so for large files you can
+construct the device in <i>streaming</i> mode instead. This inflates
+and deflates incrementally as you read or write, using a small fixed
+amount of memory. A streaming device can be opened either for reading or
+for writing, but not both, and it can't do CR/LF or UTF translation.
+When writing, only sequential writes are possible and flush() performs a
+zlib sync flush so that everything written so far can be decompressed. If
+opened with \c IO_Append, a new gzip member is appended to the source rather
+than replacing its contents.
+
+When reading in streaming mode, seeking forwards inflates and discards the
+intervening data. So that seeking backwards doesn't restart from the
+beginning, every \em indexspacing bytes of decompressed data an access
+point is recorded holding the 32Kb of preceding data inflation needs to
+restart there (the technique from zlib's zran.c example). Random reads
+therefore cost at most \em indexspacing bytes of inflation, with the
+index costing 32Kb per access point. Seeking backwards is not possible
+if the source is a synchronous device. Until the end of the data has been
+reached, size() is estimated from the gzip trailer which only holds the
+size modulo 4Gb, so it is exact only for single member files which are
+smaller than 4Gb larger than what has been read so far. If the source
+is synchronous there is no trailer to read, so size() returns how much
+has been decompressed so far. Data which isn't compressed at all has
+its size taken from the source.
+
 The source if not already open is opened on open() - if being reopened
 it does not reset the file pointer so ensure it's at the right place.
 After open() it leaves the file pointer pointing after the .gz data.
@@ -73,12 +107,22 @@ class FXAPIR QGZipDevice : public QIODevice
 	QGZipDevice(const QGZipDevice &);
 	QGZipDevice &operator=(const QGZipDevice &);
 public:
-	QGZipDevice(QIODevice *gzdata=0);
+	/*! Constructs an instance using \em gzdata as the .gz source. If \em streaming is true,
+	the data is inflated or deflated as it is read or written with seeks assisted by an
+	index entry every \em indexspacing decompressed bytes */
+	QGZipDevice(QIODevice *gzdata=0, bool streaming=false, FXuval indexspacing=4*1024*1024);
 	~QGZipDevice();
 	//! Returns the device being used as .gz source
 	QIODevice *GZData() const;
 	//! Sets the device being usied as .gz source
 	void setGZData(QIODevice *gzdata);
+	//! Returns true if the device is in streaming mode
+	bool isStreaming() const;
+	//! Returns the block size used for parallel compression, or zero if disabled
+	FXuval parallelCompression() const;
+	/*! Sets parallel compression of \em blocksize blocks, or disables it if zero.
+	Takes effect at the next open() */
+	void setParallelCompression(FXuval blocksize=1024*1024);
 
 	virtual bool open(FXuint mode);
 	virtual void close();
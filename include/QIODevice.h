@@ -158,6 +158,19 @@ public:
 	QIODevice() : mymode(0), myCRLFType(Default), myUnicodeType(NoTranslation), ioIndex(0) { }
 	virtual ~QIODevice() { }
 
+	/*! \struct IOVec
+	\brief One segment of a scatter/gather i/o operation
+	\sa readBlockV(), writeBlockV()
+	*/
+	struct IOVec
+	{
+		char *data;			//!< Start of the segment
+		FXuval len;			//!< Length of the segment
+		IOVec() : data(0), len(0) { }
+		IOVec(char *_data, FXuval _len) : data(_data), len(_len) { }
+		IOVec(const char *_data, FXuval _len) : data((char *) _data), len(_len) { }
+	};
+
 	//! Returns the flags of this device
 	FXuint flags() const { return mymode; }
 	/*! Returns the mode of this device \sa QIODeviceOpenFlags */
@@ -255,6 +268,36 @@ public:
 	virtual FXuval writeBlockTo(FXfval pos, const char *data, FXuval maxlen)=0;
 	//! \overload
 	FXuval writeBlockTo(FXfval pos, const FXuchar *data, FXuval maxlen) { return writeBlockTo(pos, (char *) data, maxlen); }
+	/*! Reads into each of the \em count segments in \em segs in turn, returning how much
+	was read in total. Stops early if a segment could not be filled, so the result is
+	the same as calling readBlock() on each segment until one comes up short - which is
+	what the default implementation does. FX::QFile, FX::QPipe and FX::QBlkSocket
+	override this to perform the whole transfer with one call to the kernel where
+	the platform supports it (readv() on POSIX).
+	*/
+	virtual FXuval readBlockV(const IOVec *segs, FXuint count);
+	/*! Writes out each of the \em count segments in \em segs in turn, returning how
+	much was written in total. This lets you send a header and its payload from
+	separate buffers without first copying them together. As with readBlockV(), the
+	default implementation calls writeBlock() per segment and the kernel based devices
+	use writev() or sendmsg() on POSIX.
+	*/
+	virtual FXuval writeBlockV(const IOVec *segs, FXuint count);
+	/*! Copies up to \em len bytes from the file pointer of this device to the file
+	pointer of \em dst, returning how much was copied. Stops early at the end of this
+	device's data, so for sockets and pipes the default of \em len copies until the
+	other end closes.
+
+	On Linux, when both devices are backed by kernel handles (eg; FX::QFile,
+	FX::QPipe or a stream FX::QBlkSocket) the data never enters user space.
+	copy_file_range() is tried first between two files, which copy-on-write filing
+	systems such as btrfs and XFS turn into a reflink. Then sendfile() is tried from
+	a file, and splice() is used otherwise. Anything else is pumped through a 256Kb
+	buffer with readBlock() and writeBlock(). See also FX::QPipe::teeTo() and
+	FX::QChildProcess::transferTo().
+	\note Neither device should be used by another thread while this is running
+	*/
+	virtual FXfval transferTo(QIODevice &dst, FXfval len=(FXfval)-1);
 
 	//! Reads a single byte. Returns -1 for no data found.
 	virtual int getch();
@@ -295,6 +338,17 @@ protected:
 	void setMode(int m) { mymode=(mymode & ~IO_ModeMask)|m; }
 	//! Sets the state
 	void setState(int s) { mymode=(mymode & ~IO_StateMask)|s; }
+	/* Performs readv() or writev() on a POSIX file descriptor, splitting the segments
+	into batches the kernel will accept. Returns (FXuval)-1 with errno set if nothing
+	could be transferred */
+	static FXDLLLOCAL FXuval int_vectoredIO(int fd, const IOVec *segs, FXuint count, bool write);
+	/* Returns a POSIX file descriptor positioned at at() for transferTo() to use, having
+	flushed any user space buffering, or -1 if the device can't take part */
+	virtual FXDLLLOCAL int int_transferHandle(bool write);
+	// Tells the device that transferTo() moved that many bytes through its handle
+	virtual FXDLLLOCAL void int_transferDone(bool write, FXfval moved);
+	friend class FXAsyncIO;
+	friend class QPipe;
 	friend FXAPI FXStream &operator<<(FXStream &s, QIODevice &i);
 	friend FXAPI FXStream &operator>>(FXStream &s, QIODevice &i);
 };
@@ -46,7 +46,8 @@ You'll also want to see FX::QIODevice. All subclasses of this base class
 are i/o devices which provide a synchronous functionality.
 
 You can wait for data to become available on any one of a number of QIODeviceS's
-using the static method waitForData().
+using the static method waitForData(). If you wait on the same large set of
+devices repeatedly, use FX::QIODeviceSWaitSet instead.
 
 */
 class FXAPI QIODeviceS : public QIODevice
@@ -84,13 +85,76 @@ public:
 	\note This is a thread cancellation point
 	*/
 	static bool waitForData(QIODeviceS **signalled, FXuint no, QIODeviceS **list, FXuint waitfor=FXINFINITE);
-	//! Returns the maximum number of QIODeviceS's which can be waited for at once
+	/*! Returns the maximum number of QIODeviceS's which can be waited for at once.
+	On Linux this is unlimited as anything beyond what \c select() can do is waited
+	for using a temporary FX::QIODeviceSWaitSet */
 	static FXuint waitForDataMax() throw();
 private:
 	friend class QSSLDevice;
+	friend class QIODeviceSWaitSet;
+	friend class FXSocketReactor;
 	virtual FXDLLLOCAL void *int_getOSHandle() const=0;
 };
 
+/*! \class QIODeviceSWaitSet
+\ingroup siodevices
+\brief A persistent set of QIODeviceS's which can be waited upon for data
+
+FX::QIODeviceS::waitForData() must hand the whole list of devices to the
+kernel on every call, which costs time proportional to the number of devices
+even when almost all are idle, and on POSIX it can't wait on more than
+\c FD_SETSIZE devices at all. For a server waiting upon thousands of
+mostly idle sockets and pipes, add them once to a QIODeviceSWaitSet and
+call wait() as often as you like - on Linux this uses \c epoll so a wait
+costs time proportional to how many devices have data, not how many are
+in the set.
+
+Devices must be open and must stay open while in the set - remove() them
+before closing them. Only devices with an OS handle can be added, so for example
+FX::QLocalPipe can't be. Devices sharing one OS handle (eg; a FX::QSSLDevice
+and its FX::QBlkSocket) may both be added and are returned together. Adding
+and removing are threadsafe and may be done while another thread is in
+wait(), which won't return a device once its remove() has returned. More
+than one thread may wait at once though then each device with data is
+usually returned to all of them.
+
+On other platforms the set falls back to calling FX::QIODeviceS::waitForData()
+with its members and so has the same limits. There a removed device must
+also not be deleted until any wait() in progress has returned.
+*/
+struct QIODeviceSWaitSetPrivate;
+class FXAPI QIODeviceSWaitSet
+{
+	QIODeviceSWaitSetPrivate *p;
+	QIODeviceSWaitSet(const QIODeviceSWaitSet &);
+	QIODeviceSWaitSet &operator=(const QIODeviceSWaitSet &);
+public:
+	QIODeviceSWaitSet();
+	~QIODeviceSWaitSet();
+	//! Adds \em dev to the set. Adding a device already in the set does nothing.
+	void add(QIODeviceS *dev);
+	//! Removes \em dev from the set, returning false if it wasn't in it
+	bool remove(QIODeviceS *dev);
+	//! Returns true if \em dev is in the set
+	bool contains(QIODeviceS *dev) const;
+	//! Returns how many devices are in the set
+	FXuint count() const;
+	//! Removes all devices from the set
+	void clear();
+	/*! \return The number of devices with data waiting, or zero if the wait timed out
+	\param signalled Array to receive the devices with data waiting, zero terminated if
+	there is room
+	\param max Size of the array at \em signalled
+	\param waitfor Milliseconds to wait, or \c FXINFINITE to wait forever
+
+	Waits for data to become available for reading on any of the devices in the
+	set. At most \em max devices are returned per call - any others remain
+	signalled for the next call.
+	\note This is a thread cancellation point
+	*/
+	FXuint wait(QIODeviceS **signalled, FXuint max, FXuint waitfor=FXINFINITE);
+};
+
 } // namespace
 
 #endif
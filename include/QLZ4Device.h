@@ -0,0 +1,109 @@
+/********************************************************************************
+*                                                                               *
+*                          Filter device applying .lz4                          *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#ifndef QLZ4DEVICE_H
+#define QLZ4DEVICE_H
+
+#include "QIODevice.h"
+
+namespace FX {
+
+/*! \file QLZ4Device.h
+\brief Defines classes used in translating .lz4 files
+*/
+
+/*! \class QLZ4Device
+\ingroup fiodevices
+\brief Provides a filter i/o device which transparently translates .lz4 files
+
+This is the fast counterpart of FX::QGZipDevice. LZ4 compresses a few
+times less well than zlib but at hundreds of megabytes per second with
+decompression several times faster still, which makes it suitable for hot
+paths such as compressing FX::FXIPCChannel traffic (see
+FX::FXIPCChannel::setCompression()) or spilling caches to disk.
+
+The data is read and written in the standard LZ4 frame format, so the
+\c lz4 command line tool can decompress what this device writes and vice
+versa. No external library is needed as a small implementation of the
+LZ4 block format is bundled with TnFOX in \c src/lz4.
+
+The device can be opened either for reading or for writing, but not both,
+and it can't do CR/LF or UTF translation. When writing, the data is
+compressed in independent blocks of \em blocksize bytes (64Kb, 256Kb, 1Mb or
+4Mb) as it is written so only sequential writes are possible. flush()
+writes out any partial block so everything written so far can be
+decompressed. If opened with \c IO_Append, a new frame is appended to the
+source rather than replacing its contents.
+
+When reading, an index of where each block is in the source is built as
+blocks are first read, so seeking to anywhere already read costs at most
+decompressing one block. Seeking forwards indexes the intervening blocks
+without decompressing them (but does read them). Concatenated frames and
+skippable frames are handled, but frames whose blocks depend on the
+previous block can't be read. Block checksums are verified if present.
+Seeking backwards is not possible if the source is a synchronous device.
+Anything after the last frame which isn't an LZ4 frame is ignored, so the
+source can be a buffer longer than its compressed contents.
+
+The source if not already open is opened on open() - if being reopened
+it does not reset the file pointer when reading, so ensure it's at the right
+place. When writing, the source is written from its start (or end if
+appending) and truncated after the data on close(). QLZ4Device never closes
+the source when you close() it.
+*/
+struct QLZ4DevicePrivate;
+class FXAPIR QLZ4Device : public QIODevice
+{
+	QLZ4DevicePrivate *p;
+	QLZ4Device(const QLZ4Device &);
+	QLZ4Device &operator=(const QLZ4Device &);
+public:
+	/*! Constructs an instance using \em lz4data as the .lz4 source, writing blocks of
+	\em blocksize bytes rounded up to the nearest size the format allows */
+	QLZ4Device(QIODevice *lz4data=0, FXuval blocksize=64*1024);
+	~QLZ4Device();
+	//! Returns the device being used as .lz4 source
+	QIODevice *LZ4Data() const;
+	//! Sets the device being used as .lz4 source
+	void setLZ4Data(QIODevice *lz4data);
+	//! Returns the size of block written
+	FXuval blockSize() const;
+
+	virtual bool open(FXuint mode);
+	virtual void close();
+	virtual void flush();
+	virtual FXfval size() const;
+	virtual void truncate(FXfval size);
+	virtual FXfval at() const;
+	virtual bool at(FXfval newpos);
+	virtual bool atEnd() const;
+	virtual FXuval readBlock(char *data, FXuval maxlen);
+	virtual FXuval writeBlock(const char *data, FXuval maxlen);
+	virtual FXuval readBlockFrom(char *data, FXuval maxlen, FXfval pos);
+	virtual FXuval writeBlockTo(FXfval pos, const char *data, FXuval maxlen);
+	virtual int getch();
+	virtual int putch(int c);
+	virtual int ungetch(int c);
+};
+
+} // namespace
+
+#endif
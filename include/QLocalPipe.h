@@ -52,6 +52,22 @@ the MSVC6 STL \c <vector> implementation is crossing over some boundary
 where it reallocates every time. One thing my tests \b do confirm is that
 QLocalPipe has a \em much lower latency than FX::QPipe which means
 anything working without a sliding window will benefit a lot.
+
+<h3>Ring mode:</h3>
+By far the most common use is one thread writing and one other thread reading
+each direction, and for this setRingSize() switches the pipe to a fixed capacity
+ring per direction which takes no lock at all. The positions written by the
+reader and writer live on separate cache lines so the two threads don't fight
+over them, and a side only ever sleeps (on a futex on Linux, elsewhere on a
+FX::QWaitCondition) when the ring is empty for the reader or full for the writer.
+While data keeps flowing neither end enters the kernel, so small messages
+see a much lower round trip latency than in the freestore mode (TestDeviceIO
+compares both modes against FX::QPipe).
+
+The price is that writeBlock() blocks while the ring is full rather than
+returning immediately, and that it is \b not safe for more than one thread to
+read or write the same end at once - use the default freestore mode for that.
+Data waiting in the rings is lost once both ends have closed.
 */
 
 struct QLocalPipePrivate;
@@ -73,6 +89,13 @@ public:
 	FXuval granularity() const;
 	//! Sets the granularity of memory allocation. Set only when the device is closed.
 	void setGranularity(FXuval newval);
+	//! Returns the capacity of the lock-free ring used in each direction, or zero if the freestore is used
+	FXuval ringSize() const;
+	/*! Sets the capacity of the lock-free ring used in each direction, rounded up
+	to a power of two of at least 4Kb, or zero to use the freestore (the default). Set
+	only when both ends are closed. See the class documentation above.
+	*/
+	void setRingSize(FXuval size=256*1024);
 	//!	Returns an instance of this local pipe reflecting the client end of the local pipe
 	QLocalPipe clientEnd() const { return *this; }
 	//! Opens the local pipe for usage
@@ -108,7 +131,8 @@ public:
 	\param data Pointer to buffer of data to send
 	\param maxlen Number of bytes to send
 
-	Writes a block of data from the given buffer to the pipe. This is instantaneous.
+	Writes a block of data from the given buffer to the pipe. This is instantaneous
+	except in ring mode, where it waits while the ring is full.
 	*/
 	FXuval writeBlock(const char *data, FXuval maxlen);
 
@@ -0,0 +1,211 @@
+/********************************************************************************
+*                                                                               *
+*                          Local domain socket i/o device                       *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+
+#ifndef QLOCALSOCKET_H
+#define QLOCALSOCKET_H
+#include "QIODeviceS.h"
+
+namespace FX {
+
+/*! \file QLocalSocket.h
+\brief Defines classes used to provide a local domain socket
+*/
+
+class FXString;
+
+/*! \class QLocalSocket
+\ingroup siodevices
+\brief A local (UNIX domain) socket i/o device
+
+Communication between processes on the same machine has traditionally gone over
+FX::QPipe or a loopback FX::QBlkSocket, the former being limited by the size of
+the pipe buffer and needing two FIFOs per connection, the latter paying for a TCP
+stack which does nothing useful when both ends are local. QLocalSocket is a
+POSIX local domain socket which is a single full duplex connection with deep
+kernel buffers, and can also carry open file descriptors from one process to
+another.
+
+Usage is much like FX::QPipe: construct one, set its name and have your
+server process call create(), which makes a listening socket. Then call
+waitForConnection() which returns a new QLocalSocket for each client that
+calls open() on a QLocalSocket of the same name. Like FX::QPipe, you can
+use setUnique() to have a randomised name chosen for you. If you simply want
+two connected ends, for example to hand one to a child process, see createPair().
+Reads block until data is available and are compatible with thread cancellation.
+If the other end closes the connection, an FX::FXConnectionLostException is thrown.
+
+A \c Stream socket is a byte stream like a pipe and is what you should use
+with FX::FXIPCChannel. A \c SeqPacket socket preserves the boundaries of each
+write so one read returns exactly one write, discarding whatever of it
+didn't fit in the buffer given - FX::FXIPCChannel does not cope with this.
+
+<h4>Passing descriptors:</h4>
+The overloads of readBlock() and writeBlock() taking an array of handles send
+open file descriptors along with some data. The receiving process gets new
+descriptors referring to the same open files, which it then owns and must
+close. This is how to hand a large payload to another process without copying
+it through the socket: create a shared memory object using createSharedMemory(),
+\c mmap() it, fill it in and send its descriptor. The receiver \c mmap()'s its
+descriptor and sees the same pages.
+
+At least one byte of data must accompany the handles, and they are received by
+whichever read returns the first byte of that data. For a \c Stream socket that read
+may also return data written before it, so the simplest arrangement is to send a
+small fixed size message with the handles and to read it using the handle receiving
+readBlock(). If more handles arrive than there is room for, the excess are closed.
+
+Default security is for the creating user to have full access. On most POSIX
+systems (but not all BSDs) a client must have write access to the socket in
+order to connect.
+
+The socket name is deleted by its creator on close() unless you specify
+\c IO_DontUnlink in the flags to create(). A name left behind by a crashed
+process is reclaimed by the next create() of it.
+
+\note Local domain sockets don't exist on Windows, so on Windows this device
+throws FX::FXNotSupportedException.
+*/
+
+struct QLocalSocketPrivate;
+class FXAPIR QLocalSocket : public QIODeviceS
+{
+	QLocalSocketPrivate *p;
+	bool creator, anonymous;
+	QLocalSocket(const QLocalSocket &);
+	QLocalSocket &operator=(const QLocalSocket &);
+	FXDLLLOCAL QLocalSocket(const QLocalSocket &o, int h);
+	virtual FXDLLLOCAL void *int_getOSHandle() const;
+	virtual FXDLLLOCAL int int_transferHandle(bool write);
+public:
+	//! The kind of local socket
+	enum Type
+	{
+		Stream=0,		//!< A byte stream
+		SeqPacket		//!< A connected stream of packets whose boundaries are preserved
+	};
+	//! Constructs a unique stream socket
+	QLocalSocket();
+	/*! \param name Name you wish this socket to refer to. If null, the socket is set as unique
+	\param type The kind of socket
+
+	Constructs a local socket referring to \em name on the local machine
+	*/
+	QLocalSocket(const FXString &name, Type type=Stream);
+	~QLocalSocket();
+
+	//! The name of the socket
+	const FXString &name() const;
+	//! Sets the name of the socket. Closes the socket if open before changing the name. Also unsets unique.
+	void setName(const FXString &name);
+	//! Returns true if this socket is unique
+	bool isUnique() const { return anonymous; }
+	//! Set if you want a unique socket
+	void setUnique(bool a) { anonymous=a; }
+	//! Returns the kind of socket
+	Type type() const;
+	//! Sets the kind of socket. Closes the socket if open.
+	void setType(Type type);
+
+	//! Creates the named socket so that others can connect to it, then listens for connections
+	bool create(FXuint mode=IO_ReadWrite);
+	//! Connects to an existing named socket
+	bool open(FXuint mode=IO_ReadWrite);
+	//! Closes the connection, deleting the name if this created it
+	void close();
+	//! Does nothing as sockets have no buffers which can be flushed
+	void flush();
+	//! Returns the amount of data waiting to be read
+	FXfval size() const;
+	virtual const FXACL &permissions() const;
+	virtual void setPermissions(const FXACL &perms);
+	//! Returns the permissions for the socket called \em name
+	static FXACL permissions(const FXString &name);
+	//! Sets the permissions for the socket called \em name
+	static void setPermissions(const FXString &name, const FXACL &perms);
+
+	/*! \return The number of bytes read (which may be less than requested)
+	\param data Pointer to buffer to receive data
+	\param maxlen Maximum number of bytes to read
+
+	Reads a block of data from the socket, waiting until some is available. Any
+	handles sent with the data are closed.
+	*/
+	FXuval readBlock(char *data, FXuval maxlen);
+	/*! \return The number of bytes read (which may be less than requested)
+	\param data Pointer to buffer to receive data
+	\param maxlen Maximum number of bytes to read
+	\param handles Array to receive any descriptors sent with the data
+	\param nohandles On entry the size of \em handles, on exit how many were received
+
+	Reads a block of data from the socket as readBlock() and any descriptors sent with
+	it. The descriptors received are owned by the caller and are set close-on-exec.
+	*/
+	FXuval readBlock(char *data, FXuval maxlen, int *handles, FXuint &nohandles);
+	/*! \return The number of bytes written.
+	\param data Pointer to buffer of data to send
+	\param maxlen Number of bytes to send
+
+	Writes a block of data to the socket, waiting until there is room for it if necessary.
+	*/
+	FXuval writeBlock(const char *data, FXuval maxlen);
+	/*! \return The number of bytes written.
+	\param data Pointer to buffer of data to send (at least one byte)
+	\param maxlen Number of bytes to send
+	\param handles Descriptors to send with the data
+	\param nohandles How many descriptors to send, at most maxHandles()
+
+	Writes a block of data to the socket as writeBlock() along with copies of
+	\em handles. Your copies remain open and still owned by you. The handles are
+	sent with the first write of the data, so if fewer than \em maxlen bytes are
+	written the remainder is sent without them.
+	*/
+	FXuval writeBlock(const char *data, FXuval maxlen, const int *handles, FXuint nohandles);
+	//! Reads into several buffers at once using a single system call
+	FXuval readBlockV(const IOVec *segs, FXuint count);
+	//! Writes several buffers at once using a single system call, so a \c SeqPacket socket sends one packet
+	FXuval writeBlockV(const IOVec *segs, FXuint count);
+
+	//! Tries to unread a character. Unsupported for sockets.
+	int ungetch(int);
+public:
+	/*! Waits for a client to connect to a socket which has been create()'d, returning
+	a new socket connected to that client or zero if \em waitfor milliseconds passed first.
+	You must delete the returned socket when you are done with it.
+	*/
+	QLocalSocket *waitForConnection(FXuint waitfor=FXINFINITE);
+	/*! Creates two unnamed sockets of \em type connected to one another, both open
+	for reading and writing. You must delete both when you are done with them.
+	*/
+	static void createPair(QLocalSocket *&a, QLocalSocket *&b, Type type=Stream);
+	//! Returns the maximum number of handles which can be sent in one write
+	static FXuint maxHandles() throw();
+	/*! Returns a new descriptor for an anonymous shared memory object of \em size
+	bytes, suitable for \c mmap() and for sending to another process. It is a \c memfd
+	on Linux and an immediately unlinked POSIX shared memory object elsewhere.
+	You own the descriptor and must close it.
+	*/
+	static int createSharedMemory(FXuval size);
+};
+
+} // namespace
+
+#endif
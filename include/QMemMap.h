@@ -133,6 +133,27 @@ be done automatically because the mapping address which you may be relying
 upon could change). There is a difference between writing off the end of the file
 and truncate()-ing it - only the latter extends the ability to map the new data.
 
+<h4>Access hints, prefaulting and sliding windows:</h4>
+How the operating system pages in mapped data makes a big difference to
+performance. advise() tells it how the data will be accessed - sequentially
+so it can read ahead aggressively and drop pages behind, randomly so it
+doesn't bother reading ahead, that some data will be needed soon so it can
+start reading it in now or that some data won't be needed for a while so its
+memory can be reclaimed. With setPrefault(), sections are read in entirely when
+mapped rather than page by page on first access which avoids a page fault per
+page when you know you'll touch all of it. setHugePages() asks for large pages
+to back mapped sections where the host OS supports that for files, which
+reduces TLB pressure when randomly accessing big maps.
+
+Mapping in all of a big file can exhaust address space and costs a lot of page
+table setup, whereas mapping in pieces yourself is tedious. setWindowSize()
+enables a sliding window mode whereby whenever readBlock() or writeBlock() would
+otherwise fall back onto file i/o within the mappable extent, a window of the
+given size containing the file pointer is mapped in instead, replacing the
+previous window. Sections you map in yourself are left alone. This gives near
+mapped i/o performance for sequential and local access patterns over files of
+any size with bounded address space usage.
+
 The mapOffset() method lets you see if any arbitrary file ptr offset
 maps into the currently mapped sections. It returns the address of the
 corresponding location in memory or zero if that section is not mapped.
@@ -169,6 +190,7 @@ class FXAPIR QMemMap : public QIODevice
 	QMemMap &operator=(const QMemMap &);
 	void winopen(int mode);
 	inline void setIoIndex(FXfval offset);
+	bool slideWindow();
 public:
 	//! The types of mapped memory there are
 	enum Type
@@ -176,6 +198,15 @@ public:
 		File=0,			//!< The name refers to a file based on disc
 		Memory			//!< The name refers to a name of shared memory
 	};
+	//! How mapped data will be accessed. See advise()
+	enum AccessHint
+	{
+		NormalAccess=0,		//!< No particular pattern (the default)
+		SequentialAccess,	//!< Data will be accessed in order, so read ahead aggressively
+		RandomAccess,		//!< Data will be accessed in no particular order, so don't read ahead
+		WillNeedAccess,		//!< Data will be needed soon, so start reading it in now
+		DontNeedAccess		//!< Data won't be needed for a while, so its memory can be reclaimed
+	};
 	//! A mapped region within the map
 	struct MappedRegion
 	{
@@ -213,7 +244,9 @@ public:
 	bool exists() const;
 	//! Deletes the file name, closing the file first if open. Returns false if file doesn't exist
 	bool remove();
-	//! Reloads the size of the file. See description above
+	/*! Reloads the size of the file. See description above. For shared memory returns
+	the real size of the object, which differs from the size passed to the constructor
+	when an existing object was opened */
 	FXfval reloadSize();
 	//! Returns the current mappable extent of the file (which may be shorter than the file length)
 	FXfval mappableSize() const;
@@ -252,6 +285,34 @@ public:
 	place is not mapped into memory.
 	*/
 	void *mapOffset(FXfval offset=(FXfval) -1) const;
+	/*! Advises the operating system how the data between \em offset and \em offset+amount
+	will be accessed, which by default is all of it. Applies to the mapped sections within
+	the range and, for file maps, to reads of the file itself. \c NormalAccess, \c SequentialAccess
+	and \c RandomAccess also become the pattern applied to sections mapped in afterwards.
+	Returns false if the host OS couldn't take the advice (which is harmless).
+	\note \c DontNeedAccess isn't applied to copy-on-write sections as it would lose their changes
+	*/
+	bool advise(AccessHint hint, FXfval offset=0, FXfval amount=(FXfval) -1);
+	//! Returns the access pattern applied to newly mapped sections
+	AccessHint accessHint() const;
+	//! Returns true if newly mapped sections are prefaulted
+	bool prefault() const;
+	/*! Sets if newly mapped sections are read in entirely when mapped rather than
+	on first access (\c MAP_POPULATE on Linux, touching each page elsewhere) */
+	void setPrefault(bool v);
+	//! Returns true if newly mapped sections ask for huge pages
+	bool hugePages() const;
+	/*! Sets if newly mapped sections ask for huge pages (\c MADV_HUGEPAGE on Linux,
+	which needs a kernel and filing system supporting transparent huge pages for files).
+	Has no effect elsewhere */
+	void setHugePages(bool v);
+	//! Returns the size of the sliding window, or zero if sliding window mode is off
+	FXuval windowSize() const;
+	/*! Sets the size of the sliding window used by readBlock() and writeBlock()
+	when outside a mapped section, rounded up to a multiple of FXProcess::pageSize().
+	Zero disables sliding window mode and maps out any current window. See the class
+	description above */
+	void setWindowSize(FXuval size);
 
 	virtual bool open(FXuint mode);
 	virtual void close();
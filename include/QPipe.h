@@ -89,6 +89,18 @@ until it finds one available during create(). Thereafter you can send its unique
 name (retrieved by name()) to the other process to open(). Note that reset()
 may rerandomise the name if it something else has claimed that name.
 
+<h4>Moving data without copying it:</h4>
+On Linux the data in a pipe need never enter user space. FX::QIODevice::transferTo()
+splice()'s what arrives in a pipe straight into a FX::QFile, a stream FX::QBlkSocket
+or another pipe, and teeTo() duplicates what is waiting in a pipe into another device
+without consuming it, so it can be both logged to a file and then forwarded elsewhere.
+In the other direction, setGiftMode() has large writes hand the pages of your buffer
+to the pipe with vmsplice() rather than copying them. As the reader then gets the
+contents of those pages when it reads rather than when you wrote, you must not
+change or free a buffer written in gift mode until flush() has returned. The pages
+are donated outright (\c SPLICE_F_GIFT) when the buffer is page aligned and a
+multiple of FX::FXProcess::pageSize() long. Elsewhere gift mode does nothing.
+
 \warning On both POSIX and Win32, the read side of a pipe is operated in non-blocking mode
 (to prevent blocks on open or breaking waitForData() on POSIX and to emulate thread
 cancellation on Win32). You shouldn't ever notice this.
@@ -120,6 +132,7 @@ class FXAPIR QPipe : public QIODeviceS
 	void FXDLLLOCAL int_hack_makeHandlesInheritable() throw();
 	void FXDLLLOCAL int_getOSHandles(void **buf) const throw();
 	void FXDLLLOCAL int_setOSHandles(void **buf) throw();
+	virtual FXDLLLOCAL int int_transferHandle(bool write);
 public:
 	QPipe();
 	/*! \param name Name you wish this pipe to refer to. If null, the pipe is set as anonymous
@@ -138,6 +151,11 @@ public:
 	bool isUnique() const { return anonymous; }
 	//! Set if you want a unique pipe
 	void setUnique(bool a) { anonymous=a; }
+	//! Returns true if large writes hand their pages to the pipe rather than copying them
+	bool giftMode() const;
+	/*! Sets whether writes of 64Kb or more hand their pages to the pipe rather than
+	copying them. See the class description above */
+	void setGiftMode(bool v);
 
 	//!	Creates the named pipe so that others can connect to it
 	bool create(FXuint mode=IO_ReadWrite);
@@ -145,7 +163,7 @@ public:
 	bool open(FXuint mode=IO_ReadWrite);
 	//! Closes the connection
 	void close();
-	//! Flushes any data currently waiting to be transferred
+	//! Flushes any data currently waiting to be transferred. In gift mode, also waits until the other end has read everything written.
 	void flush();
 	//! Resets the pipe back to original just opened state
 	bool reset();
@@ -186,6 +204,21 @@ public:
 	returning.
 	*/
 	FXuval writeBlock(const char *data, FXuval maxlen);
+	/*! Reads into several buffers at once, waiting as readBlock() does. On POSIX this
+	is a single readv() */
+	FXuval readBlockV(const IOVec *segs, FXuint count);
+	/*! Writes several buffers at once. On POSIX this is a single writev() and so is
+	atomic if the total is less than maxAtomicLength() */
+	FXuval writeBlockV(const IOVec *segs, FXuint count);
+	/*! Copies up to \em len bytes of the data waiting to be read to the file pointer
+	of \em dst without consuming it, waiting as readBlock() does until there is some.
+	Returns how much was copied, which is at most what was waiting and zero once the
+	other end has closed. The same data is then returned by the next read or
+	FX::QIODevice::transferTo() from this pipe. Uses tee() and never enters
+	user space unless \em dst isn't backed by a kernel handle.
+	\note Only supported on Linux, elsewhere throws FX::FXNotSupportedException
+	*/
+	FXfval teeTo(QIODevice &dst, FXfval len=(FXfval)-1);
 
 	//! Tries to unread a character. Unsupported for pipes.
 	int ungetch(int);
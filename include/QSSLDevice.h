@@ -443,6 +443,28 @@ most other similar strength block-ciphers. It is considerably faster
 than plain DES and vastly faster than 3DES. AES is also faster than any other
 for small packet transfers (smaller than 1024 bytes) so bear this in mind.
 
+<h4>Session caching:</h4>
+The key exchange dominates the cost of setting up a connection, so if the same
+two processes reconnect often you should let them resume a previous session
+instead. This is configured process-wide using setSessionCaching():
+\li \c ServerSessionCache keeps the sessions negotiated by servers in
+OpenSSL's internal cache under their session id. This is on by default.
+\li \c SessionTickets lets servers hand the session state to clients to keep
+instead (RFC 5077), so servers keep no state. Also on by default if your
+OpenSSL supports it.
+\li \c ClientSessionCache makes clients remember the session last negotiated
+with each peer and offer it when next connecting. This is off by default.
+Peers are identified by sessionPeer() which defaults to the IP address and port
+of the encrypted device if it is a FX::QBlkSocket - otherwise set it yourself.
+
+Servers only resume sessions they issued, so resumption works between processes
+but not after the server process restarts. Cached sessions expire after
+sessionCacheTimeout() seconds (five minutes by default) and at most
+sessionCacheSize() are kept, least recently used going first.
+sessionCacheStats() returns how many handshakes resumed a session so you can
+check that caching is working; sessionReused() tells you for a single connection.
+FX::FXNetworkService::setSSLSessionCaching() enables the server side for you.
+
 [1]: OpenSSL itself is only partially threadsafe - in particular, it is not
 threadsafe when multiple threads use a SSL connection at the same time (which
 unfortunately TnFOX requires as this is what the synchronous i/o model requires).
@@ -497,16 +519,15 @@ CTR mode has the advantage of instant seeks whereas OFB must be iterated
 from beginning to the seek point on each seek - so I have opted for CTR
 mode despite that it is probably slightly weaker.
 
-Performance-wise, throughput is heavily dependent on the speed at which
-your processor can XOR portions of memory. There is an SSE2 instruction for
-XORing 16 bytes at a time, but it requires 16 byte aligned memory which
-is highly unlikely in general purpose usage. This implementation does
-make use of memory alignment up to eight (for which the src, dest AND
-offset inside encrypted stream buffer must all be multiples of eight) but
-profiling shows that even that is rarely used compared against the four
-byte aligned XOR on 32 bit systems. If however you are using a cipher with
-a large (>16) block size, you could see substantial speed increases if you always
-pass a buffer to readBlock() and writeBlock() which is eight byte aligned.
+Performance-wise, the encryption stream is generated in batches of 4Kb
+per call into OpenSSL (many counter blocks at once) and XORed into your data
+sixteen bytes at a time using SSE2, or thirty-two using AVX2, where the
+compiler targets them (see the \c x86_SSE build option). Neither buffer
+alignment nor cipher block size matter. Reads and writes of 512Kb or more
+are additionally split across the process thread pool (see
+FX::FXProcess::threadPool()), each thread generating the stream for its
+own portion with its own cipher context, so big transfers scale with the
+number of processors.
 
 
 <h4>Usage:</h4>
@@ -725,6 +746,13 @@ public:
 	during renegotiation but only if they are performed in another thread.
 	*/
 	void renegotiate();
+	/*! Returns the name under which this device caches its client session, which
+	if empty means the peer address and port if the encrypted device is a FX::QBlkSocket */
+	FXString sessionPeer() const;
+	//! Sets the name under which this device caches its client session
+	void setSessionPeer(const FXString &peer);
+	//! True if the current connection resumed a previous session rather than negotiating a new one
+	bool sessionReused() const;
 
 	//! Returns the size of the TNFXSECD header for this instance
 	FXuint fileHeaderLen() const throw();
@@ -763,6 +791,51 @@ public:
 	static const FXString &strongestAnonCipher();
 	//! Returns a cipher string representing the fastest non-authenticated encryption (currently ADH-AES128-SHA)
 	static const FXString &fastestAnonCipher();
+
+	//! Kinds of session caching
+	enum SessionCaching
+	{
+		NoSessionCaching=0,		//!< Every connection negotiates a new session
+		ClientSessionCache=1,	//!< Clients offer the session last negotiated with the same peer
+		ServerSessionCache=2,	//!< Servers keep sessions they negotiated for resumption
+		SessionTickets=4,		//!< Servers give clients their session state to keep
+		AllSessionCaching=7
+	};
+	//! Returns the process-wide session caching in use (default is \c ServerSessionCache|SessionTickets)
+	static FXuint sessionCaching();
+	//! Sets the process-wide session caching, taking effect for new connections
+	static void setSessionCaching(FXuint modes);
+	//! Returns the maximum number of sessions kept by each of the client and server caches (default is 1024)
+	static FXuint sessionCacheSize();
+	//! Sets the maximum number of sessions kept by each of the client and server caches
+	static void setSessionCacheSize(FXuint entries);
+	//! Returns after how many seconds a cached session expires (default is 300)
+	static FXuint sessionCacheTimeout();
+	//! Sets after how many seconds a cached session expires
+	static void setSessionCacheTimeout(FXuint secs);
+	//! Statistics about session resumption
+	struct SessionCacheStats
+	{
+		FXuint clientHits;		//!< Client handshakes which resumed a cached session
+		FXuint clientMisses;	//!< Client handshakes which negotiated a new session
+		FXuint serverHits;		//!< Server handshakes which resumed a session
+		FXuint serverMisses;	//!< Server handshakes which negotiated a new session
+		FXuint clientEntries;	//!< Sessions currently in the client cache
+		FXuint serverEntries;	//!< Sessions currently in the server cache
+		SessionCacheStats() : clientHits(0), clientMisses(0), serverHits(0), serverMisses(0), clientEntries(0), serverEntries(0) { }
+		//! Returns the percentage of all handshakes which resumed a session
+		float hitRate() const throw()
+		{
+			FXuint hits=clientHits+serverHits, total=hits+clientMisses+serverMisses;
+			return total ? 100.0f*hits/total : 0.0f;
+		}
+	};
+	//! Returns session resumption statistics since process start or the last resetSessionCacheStats()
+	static SessionCacheStats sessionCacheStats();
+	//! Zeros the session resumption statistics
+	static void resetSessionCacheStats();
+	//! Throws away all cached sessions
+	static void flushSessionCache();
 };
 
 } // namespace
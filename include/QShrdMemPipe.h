@@ -0,0 +1,136 @@
+/********************************************************************************
+*                                                                               *
+*                         Shared memory pipe i/o device                         *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+
+#ifndef QSHRDMEMPIPE_H
+#define QSHRDMEMPIPE_H
+#include "QIODeviceS.h"
+
+namespace FX {
+
+/*! \file QShrdMemPipe.h
+\brief Defines classes used to provide a pipe between processes through shared memory
+*/
+
+class FXString;
+
+/*! \class QShrdMemPipe
+\ingroup siodevices
+\brief A pipe between two processes through shared memory
+
+Every byte sent through FX::QPipe, FX::QLocalSocket or a loopback FX::QBlkSocket
+is copied into the kernel by the writer and out again by the reader, and each
+transfer is a system call. QShrdMemPipe instead places a lock-free ring for
+each direction in named FX::QMemMap shared memory which both processes map,
+so the writer copies straight into memory the reader copies straight out of.
+It is the inter-process equivalent of the ring mode of FX::QLocalPipe and works
+the same way: the positions written by the reader and writer live on separate
+cache lines, and a side only sleeps when the ring is empty for the reader or
+full for the writer, on a process shared futex on Linux. While data keeps flowing
+neither process enters the kernel at all (TestIPC compares the round trip
+latency and throughput with FX::QPipe and loopback FX::QBlkSocket).
+
+Usage is much like FX::QPipe: construct one, set its name (or set it unique
+and send its name() to the other process) and have your server process call
+create(). Then have your client process call open() on a QShrdMemPipe of the same name.
+Exactly one client can connect to each pipe. The creator may write before the
+client has connected, up to ringSize() bytes. If the other end closes (or its
+process dies), reads throw a FX::FXConnectionLostException once what it wrote
+has been read and writes throw one straight away.
+
+As with the ring mode of FX::QLocalPipe, writeBlock() waits while the ring
+is full and it is \b not safe for more than one thread to read or write the
+same end at once. As there is no operating system handle to wait upon,
+FX::QIODeviceS::waitForData() can't be used - this is no problem for
+FX::FXIPCChannel which only uses it when FX::FXIPCChannel::doReception() is
+given a timeout. Default security is that of FX::QMemMap shared memory.
+
+\note On systems without futexes a sleeping side polls the ring every millisecond
+*/
+
+struct QShrdMemPipePrivate;
+class FXAPIR QShrdMemPipe : public QIODeviceS
+{
+	QShrdMemPipePrivate *p;
+	bool creator, anonymous;
+	QShrdMemPipe(const QShrdMemPipe &);
+	QShrdMemPipe &operator=(const QShrdMemPipe &);
+	virtual FXDLLLOCAL void *int_getOSHandle() const;
+public:
+	//! Constructs a unique shared memory pipe
+	QShrdMemPipe();
+	/*! \param name Name you wish this pipe to refer to. If null, the pipe is set as unique
+	\param ringsize The capacity of the ring used in each direction
+
+	Constructs a shared memory pipe referring to \em name on the local machine
+	*/
+	QShrdMemPipe(const FXString &name, FXuval ringsize=256*1024);
+	~QShrdMemPipe();
+
+	//! The name of the pipe
+	const FXString &name() const;
+	//! Sets the name of the pipe. Closes the pipe if open before changing the name. Also unsets unique.
+	void setName(const FXString &name);
+	//! Returns true if this pipe is unique
+	bool isUnique() const { return anonymous; }
+	//! Set if you want a unique pipe
+	void setUnique(bool a) { anonymous=a; }
+	//! Returns the capacity of the ring used in each direction
+	FXuval ringSize() const;
+	/*! Sets the capacity of the ring used in each direction, rounded up to a power of
+	two of at least 4Kb. Only create() uses this as open() takes the creator's. */
+	void setRingSize(FXuval size);
+
+	//! Creates the shared memory so that another process can connect to it
+	bool create(FXuint mode=IO_ReadWrite);
+	//! Connects to a pipe another process has created
+	bool open(FXuint mode=IO_ReadWrite);
+	//! Closes the connection. Any data still waiting to be read by the other end remains readable by it.
+	void close();
+	//! Waits until the other end has read everything written
+	void flush();
+	//! Returns the amount of data waiting to be read
+	FXfval size() const;
+	virtual const FXACL &permissions() const;
+	virtual void setPermissions(const FXACL &perms);
+
+	/*! \return The number of bytes read (which may be less than requested)
+	\param data Pointer to buffer to receive data
+	\param maxlen Maximum number of bytes to read
+
+	Reads a block of data from the pipe, waiting until some is available.
+	*/
+	FXuval readBlock(char *data, FXuval maxlen);
+	/*! \return The number of bytes written.
+	\param data Pointer to buffer of data to send
+	\param maxlen Number of bytes to send
+
+	Writes a block of data to the pipe, waiting while the ring is full.
+	*/
+	FXuval writeBlock(const char *data, FXuval maxlen);
+
+	//! Tries to unread a character. Unsupported for pipes.
+	int ungetch(int);
+};
+
+} // namespace
+
+#endif
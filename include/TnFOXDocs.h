@@ -179,7 +179,9 @@ combinations respectively (note that their use in new code is deprecated).
 
 <li><b>Enhanced i/o facilities</b><br>
 FX::QPipe provides a feature-rich portable named pipe across all platforms and 
-FX::QLocalPipe provides an intra-process pipe. FX::QBlkSocket and
+FX::QLocalPipe provides an intra-process pipe. FX::QLocalSocket provides a local domain
+socket which can also pass open files between processes and FX::QShrdMemPipe provides a pipe
+between processes through shared memory which avoids the kernel. FX::QBlkSocket and
 FX::QHostAddress provide Qt-compatible network access including full IPv4 and IPv6 support.
 FX::QGZipDevice provides a transparent gzip format compressor and decompressor which uses LZW
 compression to substantially decrease data size. FX::QBZip2Device provides a transparent bzip2
@@ -246,6 +246,7 @@
 
 // TnFOX classes
 #include "FXACL.h"
+#include "FXAsyncIO.h"
 #include "FXErrCodes.h"
 #include "FXExceptionDialog.h"
 #include "FXFSMonitor.h"
@@ -265,6 +266,7 @@
 #include "FXRefedObject.h"
 #include "FXRollback.h"
 #include "FXSecure.h"
+#include "FXSocketReactor.h"
 #include "FXTime.h"
 #include "FXWinLinks.h"
 #include "QBlkSocket.h"
@@ -279,8 +281,11 @@
 #include "QIODevice.h"
 #include "QIODeviceS.h"
 #include "QLocalPipe.h"
+#include "QLocalSocket.h"
+#include "QLZ4Device.h"
 #include "QMemMap.h"
 #include "QPipe.h"
+#include "QShrdMemPipe.h"
 #include "QSSLDevice.h"
 #include "QThread.h"
 #include "QTrans.h"
@@ -297,6 +302,7 @@
 
 #include "qdict.h"
 #include "qmemarray.h"
+#include "qptrdenselist.h"
 #include "qptrdict.h"
 #include "qptrlist.h"
 #include "qptrvector.h"
@@ -0,0 +1,172 @@
+/********************************************************************************
+*                                                                               *
+*                     Parallel block compression for devices                    *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#ifndef INT_PARALLELCOMPRESSOR_H
+#define INT_PARALLELCOMPRESSOR_H
+
+#include "QIODevice.h"
+#include "QThread.h"
+#include "FXProcess.h"
+#include "FXException.h"
+#include "FXRollback.h"
+#include "QTrans.h"
+#include <qcstring.h>
+#include <qptrlist.h>
+
+namespace FX {
+
+/* Splits a stream into blocks which are each compressed independently on the
+process thread pool, writing the results in order to a device. Used by the
+compression devices to write multi-member .gz and concatenated .bz2 files, both
+of which stock tools decompress as one */
+class QIODevice_ParallelCompressor
+{
+public:
+	/* Must compress len bytes at in into out as one complete member or stream,
+	returning false on failure. Usually called in a pool thread */
+	typedef bool (*CompressFunc)(QByteArray &out, const FXuchar *in, FXuval len, int level);
+private:
+	struct Block
+	{	// Reference counted as the pool may get round to it after we've claimed and compressed it ourselves
+		FXAtomicInt refs, claimed;
+		QByteArray in, out;
+		FXuval inlen;
+		QWaitCondition done;
+		bool failed;
+		Block(FXuval blocksize) : refs(1), in(blocksize), inlen(0), failed(false) { }
+		void release()
+		{
+			if(!--refs) delete this;
+		}
+		// Returns true if the caller is the one to compress it
+		bool claim()
+		{
+			return !claimed.swap(1);
+		}
+	};
+	QIODevice *dest;
+	CompressFunc compress;
+	int level;
+	FXuval blocksize;
+	FXuint maxinflight;
+	QPtrList<Block> inflight;
+	Block *current;
+	FXfval written;
+	QIODevice_ParallelCompressor(const QIODevice_ParallelCompressor &);
+	QIODevice_ParallelCompressor &operator=(const QIODevice_ParallelCompressor &);
+	static void compressBlock(CompressFunc compress, Block *b, int level)
+	{
+		FXERRH_TRY
+		{
+			b->failed=!compress(b->out, b->in.data(), b->inlen, level);
+		}
+		FXERRH_CATCH(FXException &)
+		{
+			b->failed=true;
+		}
+		FXERRH_ENDTRY
+		b->done.wakeAll();
+	}
+	static void run(CompressFunc compress, Block *b, int level)
+	{
+		if(b->claim()) compressBlock(compress, b, level);
+		b->release();
+	}
+	void writeOldest()
+	{	// Waiting on a block the pool hasn't started would deadlock if we're a pool thread, so do it ourselves
+		Block *b=inflight.getFirst();
+		FXRBOp unb=FXRBObj(*b, &Block::release);
+		inflight.removeFirst();
+		if(b->claim())
+			compressBlock(compress, b, level);
+		else
+			b->done.wait();
+		bool failed=b->failed;
+		if(!failed) dest->writeBlock(b->out.data(), b->out.size());
+		unb.dismiss();
+		b->release();
+		if(failed) FXERRGIO(QTrans::tr("QIODevice", "Failed to compress block"));
+	}
+	void submit()
+	{
+		if(!current || !current->inlen) return;
+		while(inflight.count()>=maxinflight) writeOldest();
+		inflight.append(current);
+		Block *b=current;
+		current=0;
+		++b->refs;
+		FXRBOp unref=FXRBObj(*b, &Block::release);
+		FXProcess::threadPool().dispatch(Generic::BindFuncN(&run, compress, b, level));
+		unref.dismiss();
+	}
+public:
+	QIODevice_ParallelCompressor(QIODevice *_dest, CompressFunc _compress, int _level, FXuval _blocksize)
+		: dest(_dest), compress(_compress), level(_level), blocksize(_blocksize), current(0), written(0)
+	{	// Bound memory use to a couple of blocks per thread
+		maxinflight=2*FXMAX(1, FXProcess::threadPool().maximum());
+	}
+	~QIODevice_ParallelCompressor()
+	{	// Blocks the pool has started must finish before their output is abandoned
+		for(Block *b; (b=inflight.getFirst()); inflight.removeFirst())
+		{
+			if(!b->claim()) b->done.wait();
+			b->release();
+		}
+		FXDELETE(current);
+	}
+	//! Returns how many bytes have been accepted
+	FXfval size() const throw() { return written; }
+	FXuval write(const FXuchar *data, FXuval len)
+	{
+		for(FXuval idx=0; idx<len;)
+		{
+			if(!current) FXERRHM(current=new Block(blocksize));
+			FXuval tocopy=FXMIN(len-idx, blocksize-current->inlen);
+			memcpy(current->in.data()+current->inlen, data+idx, tocopy);
+			current->inlen+=tocopy;
+			idx+=tocopy;
+			if(blocksize==current->inlen) submit();
+		}
+		written+=len;
+		return len;
+	}
+	//! Compresses any partial block and writes out everything in order
+	void flush()
+	{
+		submit();
+		while(!inflight.isEmpty()) writeOldest();
+	}
+	//! As flush(), but writes an empty member if nothing was ever written
+	void finish()
+	{
+		if(!written)
+		{
+			QByteArray out;
+			if(!compress(out, 0, 0, level)) FXERRGIO(QTrans::tr("QIODevice", "Failed to compress block"));
+			dest->writeBlock(out.data(), out.size());
+		}
+		flush();
+	}
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,627 @@
+/********************************************************************************
+*                                                                               *
+*                  D e n s e   P o i n t e r   L i s t                          *
+*                                                                               *
+*********************************************************************************
+* Copyright (C) 2009 by Niall Douglas.   All Rights Reserved.                   *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#ifndef QPTRDENSELIST_H
+#define QPTRDENSELIST_H
+
+#if _MSC_VER==1200
+#pragma warning(disable: 4786)
+#endif
+
+#include <vector>
+#include <algorithm>
+#include "fxdefs.h"
+#include "FXStream.h"
+#include "FXException.h"
+
+namespace FX {
+
+typedef FXuint uint;
+
+/*! \file qptrdenselist.h
+\brief Defines a contiguous drop-in replacement for FX::QPtrList
+*/
+
+/*! \class QPtrDenseList
+\ingroup QTL
+\brief A FX::QPtrList work-alike which keeps its pointers in one contiguous array
+
+FX::QPtrList is a thunk of \c std::list and so walking it means chasing a
+pointer to a separately allocated node for every single item. For the small
+lists which are scanned far more often than they are modified - which is most
+of them inside TnFOX - this is a poor trade, as every step of the iteration is
+a likely cache miss. QPtrDenseList offers the same API as QPtrList and
+QPtrDenseListIterator the same API as QPtrListIterator, so you can swap one for
+the other with a search & replace, but the pointers live in a single array and
+iteration is a linear walk through memory.
+
+Removals don't shuffle the array - instead the slot is overwritten with a
+null tombstone which iteration skips. Once the tombstones outnumber the live
+items the array is compacted in one pass. Removing from the front advances a
+head index, so the list also works well as a FIFO queue. Iterators register
+themselves with their list so that insertions and compactions can fix them up,
+and the upshot is that like QPtrList, insertions and removals do not invalidate
+iterators. Unlike QPtrList, an iterator whose item is removed remains valid and
+moves onto the item which followed it, so you can remove via an iterator inside
+a loop and carry on.
+
+Some caveats:
+\li You cannot store null pointers in this list as they are its tombstones.
+\li Because iterators register themselves with their list, even read-only
+iteration alters the list. Unlike with QPtrList, concurrent iteration by
+multiple threads must therefore be serialised.
+\li Index based operations (at(), insert(), remove(uint) etc.) compact the list
+first if it contains tombstones, after which they are constant time. Inserting
+anywhere other than the ends costs a move of the following pointers.
+\li Sorting keeps iterators at their position rather than with their item.
+
+\warning Like QPtrList, this list throws an exception on memory exhaustion.
+*/
+template<class type> class QPtrDenseListIterator;
+template<class type> class QPtrDenseList
+{
+	friend class QPtrDenseListIterator<type>;
+public:
+	typedef std::vector<type *> Base;
+private:
+	Base slots;
+	uint live, tombs, head;
+	bool autodel;
+	mutable QPtrDenseListIterator<type> *iters;
+	uint int_next(uint i) const
+	{
+		uint end=(uint) slots.size();
+		while(i<end && !slots[i]) ++i;
+		return i;
+	}
+	uint int_prev(uint i) const
+	{	// Returns (uint)-1 if there is no previous item
+		while(i-- && !slots[i]);
+		return i;
+	}
+	uint int_phys(uint i)
+	{
+		if(tombs) compact();
+		return i;
+	}
+	void int_insert(uint i, const type *d)
+	{
+		assert(d);
+		FXEXCEPTION_STL1 { slots.insert(slots.begin()+i, const_cast<type *>(d)); } FXEXCEPTION_STL2;
+		++live;
+		if(i<head) head=i;
+		for(QPtrDenseListIterator<type> *it=iters; it; it=it->next)
+			if(it->idx>=i) ++it->idx;
+	}
+	void int_kill(uint i)
+	{
+		slots[i]=0;
+		--live; ++tombs;
+		if(i==head) head=int_next(i);
+		if(i+1==slots.size())
+		{	// Never leave tombstones at the end
+			while(!slots.empty() && !slots.back())
+			{
+				slots.pop_back();
+				--tombs;
+			}
+			uint end=(uint) slots.size();
+			if(head>end) head=end;
+			for(QPtrDenseListIterator<type> *it=iters; it; it=it->next)
+				if(it->idx>=end) it->dead=true;
+		}
+		if(tombs>=16 && tombs>live) compact();
+	}
+	void int_copy(const QPtrDenseList &o)
+	{
+		FXEXCEPTION_STL1 { slots.reserve(o.live); } FXEXCEPTION_STL2;
+		for(uint n=o.head; n<o.slots.size(); n++)
+			if(o.slots[n]) slots.push_back(o.slots[n]);
+		live=o.live;
+	}
+	struct compareMe
+	{
+		const QPtrDenseList *me;
+		compareMe(const QPtrDenseList *_me) : me(_me) { }
+		bool operator()(type *a, type *b) const { return me->compareItems(a, b)<0; }
+	};
+public:
+	explicit QPtrDenseList(bool wantAutoDel=false) : live(0), tombs(0), head(0), autodel(wantAutoDel), iters(0) { }
+	//! Copies the items of another list, but not its auto-deletion
+	QPtrDenseList(const QPtrDenseList &o) : live(0), tombs(0), head(0), autodel(false), iters(0) { int_copy(o); }
+	QPtrDenseList &operator=(const QPtrDenseList &o)
+	{
+		if(this!=&o)
+		{
+			clear();
+			int_copy(o);
+		}
+		return *this;
+	}
+	~QPtrDenseList()
+	{
+		clear();
+		for(QPtrDenseListIterator<type> *it=iters; it; it=it->next)
+		{
+			it->mylist=0; it->dead=true;
+		}
+	}
+	//! Returns if auto-deletion is enabled
+	bool autoDelete() const { return autodel; }
+	//! Sets if auto-deletion is enabled
+	void setAutoDelete(bool a) { autodel=a; }
+
+	//! Returns the number of items in the list
+	uint count() const { return live; }
+	//! Returns true if the list is empty
+	bool isEmpty() const { return !live; }
+	//! Inserts item \em d into the list at index \em i
+	bool insert(uint i, const type *d)
+	{
+		if(i>live) return false;
+		int_insert(int_phys(i), d);
+		return true;
+	}
+	//! Inserts item \em d into the list at where iterator \em it points
+	bool insertAtIter(QPtrDenseListIterator<type> &it, const type *d);
+	//! Inserts item \em d into the list in its correct sorted order
+	void inSort(const type *d)
+	{
+		for(uint n=int_next(head); n<slots.size(); n=int_next(n+1))
+		{
+			if(compareItems(slots[n], const_cast<type *>(d))>=0)
+			{
+				int_insert(n, d);
+				return;
+			}
+		}
+		append(d);
+	}
+	//! Prepends item \em d onto the list
+	void prepend(const type *d)
+	{
+		if(head)
+		{	// Reuse the tombstone before the first item
+			assert(d);
+			for(QPtrDenseListIterator<type> *it=iters; it; it=it->next)
+				if(it->idx==head-1) it->idx=head;
+			slots[--head]=const_cast<type *>(d);
+			++live; --tombs;
+		}
+		else int_insert(0, d);
+	}
+	//! Appends the item \em d onto the list
+	void append(const type *d)
+	{
+		assert(d);
+		FXEXCEPTION_STL1 { slots.push_back(const_cast<type *>(d)); } FXEXCEPTION_STL2;
+		++live;
+	}
+	//! Removes the item at index \em i
+	bool remove(uint i)
+	{
+		if(i>=live) return false;
+		i=int_phys(i);
+		type *d=slots[i];
+		int_kill(i);
+		deleteItem(d);
+		return true;
+	}
+	//! Removes the specified item \em d via compareItems()
+	bool remove(const type *d)
+	{
+		for(uint n=int_next(head); n<slots.size(); n=int_next(n+1))
+		{
+			if(0==compareItems(slots[n], const_cast<type *>(d)))
+			{
+				type *i=slots[n];
+				int_kill(n);
+				deleteItem(i);
+				return true;
+			}
+		}
+		return false;
+	}
+	//! Removes the specified item \em d via pointer compare (quicker)
+	bool removeRef(const type *d)
+	{
+		for(uint n=head; n<slots.size(); n++)
+		{
+			if(slots[n]==d)
+			{
+				int_kill(n);
+				deleteItem(const_cast<type *>(d));
+				return true;
+			}
+		}
+		return false;
+	}
+	//! Removes the item pointed to by \em it (quickest). \em it moves onto the next item.
+	bool removeByIter(QPtrDenseListIterator<type> &it);
+	//! Removes the first item
+	bool removeFirst()
+	{
+		if(!live) return false;
+		type *d=slots[head];
+		int_kill(head);
+		deleteItem(d);
+		return true;
+	}
+	//! Removes the last item
+	bool removeLast()
+	{
+		if(!live) return false;
+		type *d=slots.back();
+		int_kill((uint) slots.size()-1);
+		deleteItem(d);
+		return true;
+	}
+	//! Removes the item at index \em i without auto-deletion
+	type *take(uint i)
+	{
+		if(i>=live) return 0;
+		i=int_phys(i);
+		type *ret=slots[i];
+		int_kill(i);
+		return ret;
+	}
+	//! Removes the specified item \em d via compareItems() without auto-deletion
+	bool take(const type *d)
+	{
+		for(uint n=int_next(head); n<slots.size(); n=int_next(n+1))
+		{
+			if(0==compareItems(slots[n], const_cast<type *>(d)))
+			{
+				int_kill(n);
+				return true;
+			}
+		}
+		return false;
+	}
+	//! Removes the item pointed to by \em it without auto-deletion (quickest). \em it moves onto the next item.
+	bool takeByIter(QPtrDenseListIterator<type> &it);
+	//! Removes the specified item \em d via pointer compare (quicker) without auto-deletion
+	bool takeRef(const type *d)
+	{
+		for(uint n=head; n<slots.size(); n++)
+		{
+			if(slots[n]==d)
+			{
+				int_kill(n);
+				return true;
+			}
+		}
+		return false;
+	}
+	//! Removes the first item without auto-deletion
+	bool takeFirst()
+	{
+		if(!live) return false;
+		int_kill(head);
+		return true;
+	}
+	//! Removes the last item without auto-deletion
+	bool takeLast()
+	{
+		if(!live) return false;
+		int_kill((uint) slots.size()-1);
+		return true;
+	}
+	//! Clears the list
+	void clear()
+	{
+		Base old;
+		old.swap(slots);
+		live=tombs=head=0;
+		for(QPtrDenseListIterator<type> *it=iters; it; it=it->next)
+		{
+			it->idx=0; it->dead=true;
+		}
+		for(typename Base::iterator it=old.begin(); it!=old.end(); ++it)
+		{
+			if(*it) deleteItem(*it);
+		}
+	}
+	//! Removes all tombstones from the list. Iterators are adjusted to match.
+	void compact()
+	{
+		if(!tombs) return;
+		for(QPtrDenseListIterator<type> *it=iters; it; it=it->next)
+			it->idx-=(uint) std::count(slots.begin(), slots.begin()+FXMIN((uint) slots.size(), it->idx), (type *) 0);
+		slots.erase(std::remove(slots.begin(), slots.end(), (type *) 0), slots.end());
+		tombs=head=0;
+	}
+	//! Sorts the list using a user supplied callable entity taking two pointers of type \em type
+	template<typename SortFuncSpec> void sort(SortFuncSpec sortfunc)
+	{
+		compact();
+		std::stable_sort(slots.begin(), slots.end(), sortfunc);
+	}
+	//! Sorts the list
+	void sort()
+	{
+		compact();
+		std::stable_sort(slots.begin(), slots.end(), compareMe(this));
+	}
+	//! Returns the index of the position of item \em d via compareItems(), or -1 if not found
+	int find(const type *d)
+	{
+		int idx=0;
+		for(uint n=int_next(head); n<slots.size(); n=int_next(n+1), ++idx)
+		{
+			if(0==compareItems(slots[n], const_cast<type *>(d))) return idx;
+		}
+		return -1;
+	}
+	//! Returns the index of the position of item \em d via pointer compare, or -1 if not found
+	int findRef(const type *d)
+	{
+		int idx=0;
+		for(uint n=int_next(head); n<slots.size(); n=int_next(n+1), ++idx)
+		{
+			if(slots[n]==d) return idx;
+		}
+		return -1;
+	}
+	//! Returns the number of item \em d in the list via compareItems()
+	uint contains(const type *d) const
+	{
+		uint count=0;
+		for(uint n=int_next(head); n<slots.size(); n=int_next(n+1))
+		{
+			if(0==compareItems(slots[n], const_cast<type *>(d))) count++;
+		}
+		return count;
+	}
+	//! Returns the number of item \em d in the list via pointer compare
+	uint containsRef(const type *d) const
+	{
+		if(!d) return 0;
+		return (uint) std::count(slots.begin()+head, slots.end(), d);
+	}
+	//! Replaces item at index \em i with \em d
+	bool replace(uint i, const type *d)
+	{
+		if(i>=live) return false;
+		assert(d);
+		slots[int_phys(i)]=const_cast<type *>(d);
+		return true;
+	}
+	//! Replaces item at iterator with \em d
+	bool replaceAtIter(QPtrDenseListIterator<type> &it, const type *d);
+	//! Returns the item at index \em i
+	type *at(uint i) { return (i>=live) ? 0 : slots[int_phys(i)]; }
+	//! Returns the first item in the list
+	type *getFirst() const { return live ? slots[head] : 0; }
+	//! Returns the last item in the list
+	type *getLast() const { return live ? slots.back() : 0; }
+	//! Returns the first item in the list
+	type *first() { return live ? slots[head] : 0; }
+	//! Returns the last item in the list
+	type *last() { return live ? slots.back() : 0; }
+	//! Compares two items (used by many methods above). Default returns -1 if a < b, +1 if a > b and 0 if a==b
+	virtual int compareItems(type *a, type *b) const { return (a<b) ? -1 : (a==b) ? 0 : 1; }
+
+	//! Returns the number of tombstones currently in the list
+	uint int_tombstones() const { return tombs; }
+protected:
+	virtual void deleteItem(type *d);
+};
+
+// Don't delete void *
+template<> inline void QPtrDenseList<void>::deleteItem(void *)
+{
+}
+
+template<class type> inline void QPtrDenseList<type>::deleteItem(type *d)
+{
+	if(autodel) delete d;
+}
+
+/*! \class QPtrDenseListIterator
+\ingroup QTL
+\brief An iterator for a QPtrDenseList
+*/
+template<class type> class QPtrDenseListIterator
+{
+	friend class QPtrDenseList<type>;
+	QPtrDenseList<type> *mylist;
+	mutable uint idx;
+	mutable bool dead;
+	QPtrDenseListIterator *prev, *next;		// Chain of iterators registered with mylist
+	void int_register()
+	{
+		prev=0; next=0;
+		if(!mylist) return;
+		next=mylist->iters;
+		if(next) next->prev=this;
+		mylist->iters=this;
+	}
+	void int_unregister()
+	{
+		if(!mylist) return;
+		if(prev) prev->next=next; else mylist->iters=next;
+		if(next) next->prev=prev;
+	}
+protected:
+	type *retptr() const
+	{
+		if(dead) return 0;
+		idx=mylist->int_next(idx);		// Skip any tombstones
+		if(idx>=mylist->slots.size()) { dead=true; return 0; }
+		return mylist->slots[idx];
+	}
+public:
+	uint int_getIndex() const { return idx; }
+	QPtrDenseListIterator() : mylist(0), idx(0), dead(true) { int_register(); }
+	//! Construct an iterator to the specified QPtrDenseList
+	QPtrDenseListIterator(const QPtrDenseList<type> &l) : mylist(&const_cast<QPtrDenseList<type> &>(l)), idx(l.head), dead(false) { int_register(); retptr(); }
+	QPtrDenseListIterator(const QPtrDenseListIterator &o) : mylist(o.mylist), idx(o.idx), dead(o.dead) { int_register(); }
+	~QPtrDenseListIterator() { int_unregister(); }
+	QPtrDenseListIterator &operator=(const QPtrDenseListIterator &o)
+	{
+		if(this!=&o)
+		{
+			int_unregister();
+			mylist=o.mylist; idx=o.idx; dead=o.dead;
+			int_register();
+		}
+		return *this;
+	}
+	bool operator==(const QPtrDenseListIterator &o) const
+	{
+		if(mylist!=o.mylist) return false;
+		type *a=retptr(), *b=o.retptr();
+		return a==b && idx==o.idx;
+	}
+	bool operator!=(const QPtrDenseListIterator &o) const { return !(*this==o); }
+	//! Returns the number of items in the list this iterator references
+	uint count() const   { return mylist->count(); }
+	//! Returns true if the list this iterator references is empty
+	bool isEmpty() const { return mylist->isEmpty(); }
+	//! Returns true if this iterator is at the start of its list
+	bool atFirst() const
+	{
+		return retptr() && idx==mylist->int_next(mylist->head);
+	}
+	//! Returns true if this iterator is at the end of its list
+	bool atLast() const
+	{
+		return retptr() && idx+1==mylist->slots.size();
+	}
+	//! Sets the iterator to point to the first item in the list, then returns that item
+	type *toFirst()
+	{
+		idx=mylist->head; dead=false;
+		return retptr();
+	}
+	//! Sets the iterator to point to the last item in the list, then returns that item
+	type *toLast()
+	{
+		dead=mylist->isEmpty();
+		idx=dead ? 0 : (uint) mylist->slots.size()-1;
+		return retptr();
+	}
+	//! Makes the iterator dead (ie; point to nothing)
+	QPtrDenseListIterator &makeDead()
+	{
+		dead=true;
+		return *this;
+	}
+	//! Returns what the iterator points to
+	type *operator*() const { return retptr(); }
+	//! Returns the item this iterator points to
+	type *current() const { return retptr(); }
+	//! Increments the iterator
+	type *operator++()
+	{
+		if(retptr()) ++idx;
+		return retptr();
+	}
+	//! Increments the iterator
+	type *operator+=(uint j)
+	{
+		for(uint n=0; n<j && retptr(); n++)
+			++idx;
+		return retptr();
+	}
+	//! Decrements the iterator
+	type *operator--()
+	{
+		if(!dead)
+		{
+			uint i=mylist->int_prev(idx);
+			if((uint)-1==i) dead=true; else idx=i;
+		}
+		return retptr();
+	}
+	//! Decrements the iterator
+	type *operator-=(uint j)
+	{
+		for(uint n=0; n<j && !dead; n++)
+			operator--();
+		return retptr();
+	}
+};
+
+template<class type> inline bool QPtrDenseList<type>::insertAtIter(QPtrDenseListIterator<type> &it, const type *d)
+{
+	if(!it.retptr())
+		append(d);
+	else
+		int_insert(it.idx, d);
+	return true;
+}
+
+template<class type> inline bool QPtrDenseList<type>::removeByIter(QPtrDenseListIterator<type> &it)
+{
+	type *d=it.retptr();
+	if(!d) return false;
+	int_kill(it.idx);
+	deleteItem(d);
+	return true;
+}
+
+template<class type> inline bool QPtrDenseList<type>::takeByIter(QPtrDenseListIterator<type> &it)
+{
+	if(!it.retptr()) return false;
+	int_kill(it.idx);
+	return true;
+}
+
+template<class type> inline bool QPtrDenseList<type>::replaceAtIter(QPtrDenseListIterator<type> &it, const type *d)
+{
+	if(!it.retptr()) return false;
+	assert(d);
+	slots[it.idx]=const_cast<type *>(d);
+	return true;
+}
+
+//! Writes the contents of the list to stream \em s
+template<class type> FXStream &operator<<(FXStream &s, const QPtrDenseList<type> &i)
+{
+	FXuint mysize=i.count();
+	s << mysize;
+	for(QPtrDenseListIterator<type> it(i); it.current(); ++it)
+	{
+		s << *it.current();
+	}
+	return s;
+}
+//! Reads in a list from stream \em s
+template<class type> FXStream &operator>>(FXStream &s, QPtrDenseList<type> &i)
+{
+	FXuint mysize;
+	s >> mysize;
+	i.clear();
+	for(uint n=0; n<mysize; n++)
+	{
+		type *item;
+		FXERRHM(item=new type);
+		s >> *item;
+		i.append(item);
+	}
+	return s;
+}
+
+} // namespace
+
+#endif
@@ -27,6 +27,7 @@
 #endif
 
 #include <list>
+#include <vector>
 #undef Unsorted
 #include "fxdefs.h"
 #include "FXException.h"
@@ -198,8 +199,20 @@ enum QVLQSortType
 	QVLQSortMerge=2,		//!< Merge sort
 	QVLQSortQuick=4,		//!< Quick sort
 
-	QVLQSortStable=256		//!< Prevents use of algorithms which reorder equal elements
+	QVLQSortStable=256,		//!< Prevents use of algorithms which reorder equal elements
+	QVLQSortParallel=512	//!< Merge sorts across the process thread pool (always stable)
 };
+
+/*! Sorts the array of \em count indices \em idxs using \em less, which is
+called with \em ctx and two of the indices and returns true if the first should
+come before the second. The sort is a stable merge sort whose runs are sorted and
+merged by FX::FXProcess::threadPool() with the calling thread pitching in, so it
+is safe to call from within a pool thread. \em less must be thread-safe and must
+not throw. This is what QValueListQSort uses for \c QVLQSortParallel, and it is
+particularly useful when expensive sort keys can be calculated once up front into
+an array rather than per comparison.
+*/
+extern FXAPI void int_parallelSort(FXuint *idxs, FXuint count, bool (*less)(void *ctx, FXuint a, FXuint b), void *ctx);
 /*! \class QValueListQSort
 \ingroup QTL
 \brief Lets you quickly sort a QValueList with custom swapper
@@ -253,6 +266,14 @@ whereby identical elements will get reordered.
 \note As yet, merge sorting remains unimplemented. Either a quick or insertion
 sort is chosen as appropriate.
 
+If you specify \c QVLQSortParallel, none of the above is used. Instead an
+array of iterators to the list items is sorted using FX::int_parallelSort()
+which merge sorts across the process thread pool, after which the list nodes
+are relinked into the sorted order using the move policy (each item is moved
+in turn to the end of the list). This is much faster for large lists on
+multi-processor machines and the order of equal items is preserved, but your
+compare policy must be thread-safe.
+
 <h3>Usage:</h3>
 If you have three interdependent lists in the same order and want to sort
 them, usually it's best to consider merging those lists somehow. If that's
@@ -299,10 +320,14 @@ public:
 	void run(int _sorttype=QVLQSortDefault)
 	{
 		if(mylist.empty()) return;
-		if(QVLQSortDefault!=sorttype) sorttype=_sorttype;
+		if(QVLQSortDefault!=_sorttype) sorttype=_sorttype;
 		if(!sorttype) sorttype=QVLQSortInsertion|QVLQSortMerge|QVLQSortQuick;
 		int s=(int) mylist.size();
-		if(s>mergeCutOff && (sorttype & QVLQSortQuick) && !(sorttype & QVLQSortStable))
+		if(sorttype & QVLQSortParallel)
+		{
+			psort();
+		}
+		else if(s>mergeCutOff && (sorttype & QVLQSortQuick) && !(sorttype & QVLQSortStable))
 		{
 			intit l=std::make_pair(0, mylist.begin());
 			intit u=std::make_pair(s, mylist.end());
@@ -319,6 +344,36 @@ public:
 		}
 	}
 private:
+	struct psortCtx
+	{
+		QValueListQSort *me;
+		iterator *items;
+	};
+	static bool psortLess(void *_ctx, FXuint a, FXuint b)
+	{
+		psortCtx *ctx=(psortCtx *) _ctx;
+		iterator ia=ctx->items[a], ib=ctx->items[b];
+		return ctx->me->comparePolicy<type>::compare(ctx->me->mylist, ia, ib);
+	}
+	void psort()
+	{
+		std::vector<iterator> items;
+		std::vector<FXuint> idxs;
+		FXEXCEPTION_STL1 {
+			items.reserve(mylist.size());
+			for(iterator it=mylist.begin(); it!=mylist.end(); ++it)
+			{
+				idxs.push_back((FXuint) items.size());
+				items.push_back(it);
+			}
+		} FXEXCEPTION_STL2;
+		psortCtx ctx={ this, &items.front() };
+		int_parallelSort(&idxs.front(), (FXuint) idxs.size(), psortLess, &ctx);
+		for(typename std::vector<FXuint>::iterator it=idxs.begin(); it!=idxs.end(); ++it)
+		{
+			movePolicy<type>::move(mylist, mylist.end(), items[*it]);
+		}
+	}
 	void isort(iterator &lb, iterator &ub)
 	{	// Niall's bastard iterator based insertion sort
 		for(iterator it=lb;;)
@@ -334,7 +389,7 @@ private:
 					if(find!=it && comparePolicy<type>::compare(mylist, it, find))
 					{
 						bool atStart=(find==lb);
-						move(mylist, find, it);
+						movePolicy<type>::move(mylist, find, it);
 						if(atStart) lb=it;
 						found=true;
 						break;
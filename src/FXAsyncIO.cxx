@@ -0,0 +1,486 @@
+/********************************************************************************
+*                                                                               *
+*                         Asynchronous file i/o engine                          *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#include "QThread.h"		// May undefine USE_WINAPI and USE_POSIX
+#ifdef USE_POSIX
+ #include <unistd.h>
+ #include <errno.h>
+ #include <sys/uio.h>
+ #if defined(__linux__) && defined(__has_include)
+  #if __has_include(<linux/io_uring.h>)
+   #include <linux/io_uring.h>
+   #include <sys/mman.h>
+   #include <sys/syscall.h>
+   #if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+    #define USE_IOURING
+   #endif
+  #endif
+ #endif
+#else
+ #include <errno.h>
+#endif
+
+#include "FXAsyncIO.h"
+#include "QIODevice.h"
+#include "FXProcess.h"
+#include "FXException.h"
+#include "FXRollback.h"
+#include "QTrans.h"
+#include <string.h>
+#include <vector>
+#include "FXMemDbg.h"
+#if defined(DEBUG) && defined(FXMEMDBG_H)
+static const char *_fxmemdbg_current_file_ = __FILE__;
+#endif
+
+namespace FX {
+
+struct FXAsyncIO::Batch
+{	// Reference counted as the caller may hold futures long after completion
+	struct Slot
+	{
+		Batch *batch;
+		FXuint idx;
+		int fd;
+#ifdef USE_POSIX
+		struct iovec iov;
+#endif
+		Slot(Batch *_batch, FXuint _idx, int _fd) : batch(_batch), idx(_idx), fd(_fd) { }
+	};
+	FXAtomicInt refs, outstanding, failures;
+	Request *reqs;
+	std::vector<Slot> slots;
+	QWaitCondition done;
+	Generic::BoundFunctorV *completion;
+	QThreadPool *pool;
+	Batch(Request *_reqs, FXuint count, Generic::BoundFunctorV *_completion, QThreadPool *_pool)
+		: refs(1), outstanding(count), reqs(_reqs), completion(_completion), pool(_pool) { }
+	~Batch()
+	{
+		FXDELETE(completion);
+	}
+	void release()
+	{
+		if(!--refs) delete this;
+	}
+	void finish()
+	{	// Drops the in flight reference
+		done.wakeAll();
+		if(completion)
+		{
+			Generic::BoundFunctorV *c=completion;
+			completion=0;
+			pool->dispatch(c);
+		}
+		release();
+	}
+	// Returns true if this was the last request of the batch
+	bool complete(Slot &s, FXuval transferred, int errcode)
+	{
+		Request &r=reqs[s.idx];
+		r.transferred=transferred;
+		r.errcode=errcode;
+		if(errcode) ++failures;
+		return !--outstanding;
+	}
+};
+
+struct FXDLLLOCAL FXAsyncIOPrivate : public QMutex
+{
+	typedef FXAsyncIO::Batch Batch;
+	typedef FXAsyncIO::Batch::Slot Slot;
+	FXuint depth;
+	QThreadPool *pool;
+	FXAtomicInt inflight;
+	QWaitCondition progress;
+#ifdef USE_IOURING
+	struct Reaper : public QThread
+	{
+		FXAsyncIOPrivate *p;
+		Reaper(FXAsyncIOPrivate *_p) : QThread("Async i/o reaper", false, 64*1024, QThread::InProcess), p(_p) { }
+		void run() { p->reap(); }
+		void *cleanup() { return 0; }
+	};
+	int ringfd;
+	void *sqmap, *cqmap;
+	size_t sqmaplen, cqmaplen, sqeslen;
+	unsigned *sqhead, *sqtail, *sqmask, *sqarray, *cqhead, *cqtail, *cqmask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned unsubmitted;
+	Reaper *reaper;
+	bool quit;
+#endif
+	FXAsyncIOPrivate(FXuint _depth, QThreadPool *_pool) : QMutex(), depth(_depth), pool(_pool), progress(false)
+#ifdef USE_IOURING
+		, ringfd(-1), sqmap(MAP_FAILED), cqmap(MAP_FAILED), sqmaplen(0), cqmaplen(0), sqeslen(0), sqes((struct io_uring_sqe *) MAP_FAILED),
+		unsubmitted(0), reaper(0), quit(false)
+#endif
+	{
+	}
+	~FXAsyncIOPrivate()
+	{
+#ifdef USE_IOURING
+		if(reaper)
+		{	// Wake the reaper with a sentinel
+			{
+				QMtxHold h(this);
+				quit=true;
+				struct io_uring_sqe *sqe=nextSQE();
+				sqe->opcode=IORING_OP_NOP;
+				sqe->user_data=0;
+				submitSQEs();
+			}
+			reaper->wait();
+			FXDELETE(reaper);
+		}
+		if(MAP_FAILED!=(void *) sqes) ::munmap(sqes, sqeslen);
+		if(MAP_FAILED!=cqmap && cqmap!=sqmap) ::munmap(cqmap, cqmaplen);
+		if(MAP_FAILED!=sqmap) ::munmap(sqmap, sqmaplen);
+		if(ringfd>=0) ::close(ringfd);
+#endif
+	}
+	void waitFor(FXuint limit)
+	{	// Waits until no more than limit requests are in flight
+		while((FXuint)(int) inflight>limit)
+		{
+			progress.reset();
+			if((FXuint)(int) inflight<=limit) break;
+			progress.wait();
+		}
+	}
+	void reserveSlot()
+	{	// Waits for a free slot and takes it, checking under the lock so concurrent submitters can't exceed depth
+		QMtxHold h(this);
+		while((FXuint)(int) inflight>=depth)
+		{
+			progress.reset();
+			if((FXuint)(int) inflight<depth) break;
+			h.unlock();
+			progress.wait();
+			h.relock();
+		}
+		++inflight;
+	}
+	void completed(Slot &s, FXuval transferred, int errcode)
+	{
+		Batch *b=s.batch;
+		if(b->complete(s, transferred, errcode)) b->finish();
+		--inflight;
+		progress.wakeAll();
+	}
+	void runSlot(Slot *s)
+	{	// Called in the context of a pool thread
+		FXAsyncIO::Request &r=s->batch->reqs[s->idx];
+		FXuval done=0;
+		int errcode=0;
+#ifdef USE_POSIX
+		if(s->fd>=0)
+		{
+			while(done<r.len)
+			{
+				ssize_t ret=(FXAsyncIO::Request::Write==r.type) ? ::pwrite(s->fd, r.data+done, r.len-done, (off_t)(r.pos+done))
+					: ::pread(s->fd, r.data+done, r.len-done, (off_t)(r.pos+done));
+				if(ret<0)
+				{
+					if(EINTR==errno) continue;
+					errcode=errno;
+					break;
+				}
+				if(!ret) break;
+				done+=(FXuval) ret;
+			}
+		}
+		else
+#endif
+		{
+			FXERRH_TRY
+			{
+				while(done<r.len)
+				{
+					FXuval ret=(FXAsyncIO::Request::Write==r.type) ? r.dev->writeBlockTo(r.pos+done, r.data+done, r.len-done)
+						: r.dev->readBlockFrom(r.data+done, r.len-done, r.pos+done);
+					if(!ret) break;
+					done+=ret;
+				}
+			}
+			FXERRH_CATCH(FXException &)
+			{
+				errcode=EIO;
+			}
+			FXERRH_ENDTRY;
+		}
+		completed(*s, done, errcode);
+	}
+#ifdef USE_IOURING
+	bool setupRing()
+	{
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		if((ringfd=(int) ::syscall(__NR_io_uring_setup, depth, &params))<0) return false;
+		sqmaplen=params.sq_off.array+params.sq_entries*sizeof(unsigned);
+		cqmaplen=params.cq_off.cqes+params.cq_entries*sizeof(struct io_uring_cqe);
+		if(params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			if(cqmaplen>sqmaplen) sqmaplen=cqmaplen;
+			cqmaplen=sqmaplen;
+		}
+		if(MAP_FAILED==(sqmap=::mmap(0, sqmaplen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringfd, IORING_OFF_SQ_RING)))
+			return false;
+		if(params.features & IORING_FEAT_SINGLE_MMAP)
+			cqmap=sqmap;
+		else if(MAP_FAILED==(cqmap=::mmap(0, cqmaplen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringfd, IORING_OFF_CQ_RING)))
+			return false;
+		sqeslen=params.sq_entries*sizeof(struct io_uring_sqe);
+		if(MAP_FAILED==(void *)(sqes=(struct io_uring_sqe *) ::mmap(0, sqeslen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringfd, IORING_OFF_SQES)))
+			return false;
+		char *sq=(char *) sqmap, *cq=(char *) cqmap;
+		sqhead=(unsigned *)(sq+params.sq_off.head);
+		sqtail=(unsigned *)(sq+params.sq_off.tail);
+		sqmask=(unsigned *)(sq+params.sq_off.ring_mask);
+		sqarray=(unsigned *)(sq+params.sq_off.array);
+		cqhead=(unsigned *)(cq+params.cq_off.head);
+		cqtail=(unsigned *)(cq+params.cq_off.tail);
+		cqmask=(unsigned *)(cq+params.cq_off.ring_mask);
+		cqes=(struct io_uring_cqe *)(cq+params.cq_off.cqes);
+		// The completion queue is at least as deep as the submission queue
+		depth=params.sq_entries;
+		return true;
+	}
+	// Must be called with the lock held, and there must be space
+	struct io_uring_sqe *nextSQE()
+	{
+		unsigned tail=*sqtail+unsubmitted, idx=tail & *sqmask;
+		struct io_uring_sqe *sqe=&sqes[idx];
+		memset(sqe, 0, sizeof(*sqe));
+		sqarray[idx]=idx;
+		++unsubmitted;
+		return sqe;
+	}
+	void prepSlot(Slot &s, FXuval done)
+	{
+		FXAsyncIO::Request &r=s.batch->reqs[s.idx];
+		struct io_uring_sqe *sqe=nextSQE();
+		s.iov.iov_base=r.data+done;
+		s.iov.iov_len=r.len-done;
+		sqe->opcode=(FXAsyncIO::Request::Write==r.type) ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->fd=s.fd;
+		sqe->off=r.pos+done;
+		sqe->addr=(FXulong)(FXuval) &s.iov;
+		sqe->len=1;
+		sqe->user_data=(FXulong)(FXuval) &s;
+	}
+	// Must be called with the lock held
+	void submitSQEs()
+	{
+		if(!unsubmitted) return;
+		__sync_synchronize();
+		*sqtail+=unsubmitted;
+		__sync_synchronize();
+		FXuint tosubmit=unsubmitted;
+		unsubmitted=0;
+		while(tosubmit)
+		{
+			int ret=(int) ::syscall(__NR_io_uring_enter, ringfd, tosubmit, 0, 0, (void *) 0, 0);
+			if(ret<0)
+			{
+				if(EINTR==errno || EAGAIN==errno || EBUSY==errno) { QThread::yield(); continue; }
+				FXERRHIO(ret);
+			}
+			tosubmit-=ret;
+		}
+	}
+	void reap()
+	{
+		for(;;)
+		{
+			int ret=(int) ::syscall(__NR_io_uring_enter, ringfd, 0, 1, IORING_ENTER_GETEVENTS, (void *) 0, 0);
+			if(ret<0 && EINTR!=errno) FXERRHIO(ret);
+			unsigned head=*cqhead;
+			bool sawquit=false;
+			for(;;)
+			{
+				__sync_synchronize();
+				if(head==*cqtail) break;
+				struct io_uring_cqe *cqe=&cqes[head & *cqmask];
+				Slot *s=(Slot *)(FXuval) cqe->user_data;
+				int res=cqe->res;
+				*cqhead=++head;
+				if(!s) { sawquit=true; continue; }
+				FXAsyncIO::Request &r=s->batch->reqs[s->idx];
+				FXuval done=r.transferred;
+				if(-EINTR==res || -EAGAIN==res || (res>0 && done+res<r.len))
+				{	// Resubmit the remainder (a short read may simply be end of file,
+					// which the next read will confirm by returning zero)
+					if(res>0) r.transferred=(done+=res);
+					QMtxHold h(this);
+					prepSlot(*s, done);
+					submitSQEs();
+					continue;
+				}
+				if(res<0)
+					completed(*s, done, -res);
+				else
+					completed(*s, done+res, 0);
+			}
+			if(sawquit || (quit && !(int) inflight)) break;
+		}
+	}
+#endif
+};
+
+FXAsyncIO::Future::Future(Batch *_b) : b(_b)
+{
+	++b->refs;
+}
+FXAsyncIO::Future::Future(const Future &o) : b(o.b)
+{
+	if(b) ++b->refs;
+}
+FXAsyncIO::Future &FXAsyncIO::Future::operator=(const Future &o)
+{
+	if(o.b) ++o.b->refs;
+	if(b) b->release();
+	b=o.b;
+	return *this;
+}
+FXAsyncIO::Future::~Future()
+{
+	if(b) b->release();
+	b=0;
+}
+bool FXAsyncIO::Future::isFinished() const throw()
+{
+	return !b || !(int) b->outstanding;
+}
+bool FXAsyncIO::Future::wait(FXuint period) const
+{
+	if(!b) return true;
+	return b->done.wait(period);
+}
+FXuint FXAsyncIO::Future::failures() const throw()
+{
+	return b ? (FXuint)(int) b->failures : 0;
+}
+
+FXAsyncIO::FXAsyncIO(FXuint queuedepth, QThreadPool *pool) : p(0)
+{
+	FXERRHM(p=new FXAsyncIOPrivate(queuedepth ? queuedepth : 1, pool ? pool : &FXProcess::threadPool()));
+	FXRBOp unconstr=FXRBConstruct(this);
+#ifdef USE_IOURING
+	if(p->setupRing())
+	{
+		FXERRHM(p->reaper=new FXAsyncIOPrivate::Reaper(p));
+		p->reaper->start();
+	}
+	else
+	{	// Fall back to the thread pool
+		if(MAP_FAILED!=(void *) p->sqes) { ::munmap(p->sqes, p->sqeslen); p->sqes=(struct io_uring_sqe *) MAP_FAILED; }
+		if(MAP_FAILED!=p->cqmap && p->cqmap!=p->sqmap) ::munmap(p->cqmap, p->cqmaplen);
+		p->cqmap=MAP_FAILED;
+		if(MAP_FAILED!=p->sqmap) { ::munmap(p->sqmap, p->sqmaplen); p->sqmap=MAP_FAILED; }
+		if(p->ringfd>=0) { ::close(p->ringfd); p->ringfd=-1; }
+	}
+#endif
+	unconstr.dismiss();
+}
+
+FXAsyncIO::~FXAsyncIO()
+{ FXEXCEPTIONDESTRUCT1 {
+	if(p) waitAll();
+	FXDELETE(p);
+} FXEXCEPTIONDESTRUCT2; }
+
+FXuint FXAsyncIO::queueDepth() const throw()
+{
+	return p->depth;
+}
+
+bool FXAsyncIO::isKernelQueued() const throw()
+{
+#ifdef USE_IOURING
+	return p->reaper!=0;
+#else
+	return false;
+#endif
+}
+
+FXAsyncIO::Future FXAsyncIO::submit(Request *reqs, FXuint count, Generic::BoundFunctorV *completion)
+{
+	Batch *b;
+	FXRBOp uncompletion=FXRBNew(completion);
+	FXERRHM(b=new Batch(reqs, count, completion, p->pool));
+	uncompletion.dismiss();
+	FXRBOp unb=FXRBObj(*b, &Batch::release);
+	FXEXCEPTION_STL1 {
+		b->slots.reserve(count);
+	} FXEXCEPTION_STL2;
+	QIODevice *lastdev=0;
+	int fd=-1;
+	for(FXuint n=0; n<count; n++)
+	{	// Look up the kernel handle once per run of requests on the same device
+		Request &r=reqs[n];
+		r.transferred=0; r.errcode=0;
+		if(r.dev!=lastdev || (n && r.type!=reqs[n-1].type))
+		{
+			lastdev=r.dev;
+			fd=r.dev->int_transferHandle(Request::Write==r.type);
+		}
+		b->slots.push_back(Batch::Slot(b, n, fd));
+	}
+	Future ret(b);
+	unb.dismiss();
+	if(!count)
+	{
+		b->finish();
+		return ret;
+	}
+	for(FXuint n=0; n<count; n++)
+	{
+		Batch::Slot &s=b->slots[n];
+		p->reserveSlot();
+#ifdef USE_IOURING
+		if(p->reaper && s.fd>=0)
+		{
+			QMtxHold h(p);
+			p->prepSlot(s, 0);
+			// Submit in runs to amortise the syscall, but don't sit on requests
+			if(n+1==count || p->unsubmitted>=32 || b->slots[n+1].fd<0 || (FXuint)(int) p->inflight>=p->depth)
+				p->submitSQEs();
+			continue;
+		}
+		if(p->reaper)
+		{
+			QMtxHold h(p);
+			p->submitSQEs();
+		}
+#endif
+		p->pool->dispatch(Generic::BindObjN(*p, &FXAsyncIOPrivate::runSlot, &s));
+	}
+	return ret;
+}
+
+void FXAsyncIO::waitAll()
+{
+	p->waitFor(0);
+}
+
+} // namespace
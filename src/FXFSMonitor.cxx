@@ -55,6 +55,7 @@
 #include "QTrans.h"
 #include "FXErrCodes.h"
 #include <qptrlist.h>
+#include <qptrdenselist.h>
 #include <qdict.h>
 #include <qptrdict.h>
 #include <qintdict.h>
@@ -177,7 +178,7 @@ struct FXFSMon : public QMutex
 	bool nofam, fambroken;
 	FAMConnection fc;
 #endif
-	QPtrList<Watcher> watchers;
+	QPtrDenseList<Watcher> watchers;
 	FXFSMon();
 	~FXFSMon();
 	void add(const FXString &path, FXFSMonitor::ChangeHandler handler);
@@ -209,11 +210,11 @@ FXFSMon::FXFSMon() : watchers(true)
 FXFSMon::~FXFSMon()
 { FXEXCEPTIONDESTRUCT1 {
 	Watcher *w;
-	for(QPtrListIterator<Watcher> it(watchers); (w=it.current()); ++it)
+	for(QPtrDenseListIterator<Watcher> it(watchers); (w=it.current()); ++it)
 	{
 		w->requestTermination();
 	}
-	for(QPtrListIterator<Watcher> it(watchers); (w=it.current()); ++it)
+	for(QPtrDenseListIterator<Watcher> it(watchers); (w=it.current()); ++it)
 	{
 		w->wait();
 	}
@@ -660,7 +661,7 @@ void FXFSMon::add(const FXString &path, FXFSMonitor::ChangeHandler handler)
 {
 	QMtxHold lh(fxfsmon);
 	Watcher *w;
-	for(QPtrListIterator<Watcher> it(watchers); (w=it.current()); ++it)
+	for(QPtrDenseListIterator<Watcher> it(watchers); (w=it.current()); ++it)
 	{
 #ifdef USE_WINAPI
 		if(w->paths.count()<MAXIMUM_WAIT_OBJECTS-2) break;
@@ -731,7 +732,7 @@ bool FXFSMon::remove(const FXString &path, FXFSMonitor::ChangeHandler handler)
 {
 	QMtxHold hl(fxfsmon);
 	Watcher *w;
-	for(QPtrListIterator<Watcher> it(watchers); (w=it.current()); ++it)
+	for(QPtrDenseListIterator<Watcher> it(watchers); (w=it.current()); ++it)
 	{
 		Watcher::Path *p=w->paths.find(path);
 		if(!p) continue;
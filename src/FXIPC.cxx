@@ -25,12 +25,14 @@
 #include "QBuffer.h"
 #include "FXProcess.h"
 #include "QGZipDevice.h"
+#include "QLZ4Device.h"
 #include "QPipe.h"
 #include "FXErrCodes.h"
 #include <qintdict.h>
 #include <qptrvector.h>
 #include <qcstring.h>
 #include <qptrlist.h>
+#include <qptrdenselist.h>
 #include <assert.h>
 #include "FXMemDbg.h"
 #if defined(DEBUG) && !defined(FXMEMDBG_DISABLE)
@@ -135,13 +137,15 @@ struct FXDLLLOCAL FXIPCChannelPrivate
 {
 	FXIPCMsgRegistry *registry;
 	QIODeviceS *dev;
-	bool unreliable, compressed, errorTrans, quit, noquitmsg, peerUntrusted, printstats;
+	bool unreliable, compact, peerCompact, errorTrans, quit, noquitmsg, peerUntrusted, printstats;
+	FXIPCChannel::CompressionKinds compressed;
 	FXIPCChannel::EndianConversionKinds endianConversion;
 	FXuint maxMsgSize, garbageMessageCount, sendMsgSize;
 	QBuffer buffer;
 	QGZipDevice *compressedbuffer;
+	QLZ4Device *lz4buffer;
 	FXStream endianiser;
-	QPtrList<QWaitCondition> wcsFree;
+	QPtrDenseList<QWaitCondition> wcsFree;
 	struct AckEntry
 	{
 		FXIPCMsg *FXRESTRICT msg, *FXRESTRICT ack;
@@ -157,11 +161,11 @@ struct FXDLLLOCAL FXIPCChannelPrivate
 	FXulong monitorThreadId;
 	QPtrVector<FXIPCChannel::MsgFilterSpec> premsgfilters;
 	QThreadPool *threadPool;
-	QPtrList<Generic::BoundFunctorV> msgHandlings;
+	QPtrDenseList<Generic::BoundFunctorV> msgHandlings;
 	FXIPCChannelPrivate(FXIPCMsgRegistry *_registry, QIODeviceS *_dev, bool _peerUntrusted, QThreadPool *_threadPool)
-		: registry(_registry), dev(_dev), unreliable(false), compressed(false), errorTrans(true),
-		quit(false), noquitmsg(false), peerUntrusted(_peerUntrusted), printstats(false), endianConversion(FXIPCChannel::AutoEndian),
-		maxMsgSize(65536), garbageMessageCount(0), sendMsgSize(pageSize), buffer(pageSize), compressedbuffer(0), endianiser(&buffer),
+		: registry(_registry), dev(_dev), unreliable(false), compact(false), peerCompact(false), errorTrans(true),
+		quit(false), noquitmsg(false), peerUntrusted(_peerUntrusted), printstats(false), compressed(FXIPCChannel::NoCompression), endianConversion(FXIPCChannel::AutoEndian),
+		maxMsgSize(65536), garbageMessageCount(0), sendMsgSize(pageSize), buffer(pageSize), compressedbuffer(0), lz4buffer(0), endianiser(&buffer),
 		wcsFree(true), msgs(1, true), msgidcount(0), monitorThreadId(0), premsgfilters(true), threadPool(_threadPool), msgHandlings(true)
 	{
 		buffer.open(IO_ReadWrite);
@@ -185,11 +189,11 @@ FXIPCChannel::~FXIPCChannel()
 	}
 	QMtxHold h(this);
 	Generic::BoundFunctorV *callv;
-	for(QPtrListIterator<Generic::BoundFunctorV> it(p->msgHandlings); (callv=it.current());)
+	for(QPtrDenseListIterator<Generic::BoundFunctorV> it(p->msgHandlings); (callv=it.current());)
 	{
 		if(QThreadPool::Cancelled==p->threadPool->cancel(callv, false))
 		{
-			QPtrListIterator<Generic::BoundFunctorV> it2=it;
+			QPtrDenseListIterator<Generic::BoundFunctorV> it2=it;
 			++it;
 			p->msgHandlings.removeByIter(it2);
 		}
@@ -197,6 +201,7 @@ FXIPCChannel::~FXIPCChannel()
 	}
 	h.unlock();
 	while(!p->msgHandlings.isEmpty()) QThread::yield();
+	FXDELETE(p->lz4buffer);
 	FXDELETE(p->compressedbuffer);
 	assert(p->msgs.isEmpty());
 	FXDELETE(p);
@@ -242,6 +247,11 @@ void FXIPCChannel::setUnreliable(bool v)
 	p->unreliable=v;
 }
 bool FXIPCChannel::compression() const
+{
+	// QMtxHold h(this); can do without
+	return NoCompression!=p->compressed;
+}
+FXIPCChannel::CompressionKinds FXIPCChannel::compressionKind() const
 {
 	// QMtxHold h(this); can do without
 	return p->compressed;
@@ -249,7 +259,27 @@ bool FXIPCChannel::compression() const
 void FXIPCChannel::setCompression(bool v)
 {
 	// QMtxHold h(this); can do without
-	p->compressed=v;
+	p->compressed=v ? GZipCompression : NoCompression;
+}
+void FXIPCChannel::setCompression(CompressionKinds kind)
+{
+	// QMtxHold h(this); can do without
+	p->compressed=kind;
+}
+bool FXIPCChannel::compactEncoding() const
+{
+	// QMtxHold h(this); can do without
+	return p->compact;
+}
+void FXIPCChannel::setCompactEncoding(bool v)
+{
+	// QMtxHold h(this); can do without
+	p->compact=v;
+}
+bool FXIPCChannel::compactEncodingActive() const
+{
+	// QMtxHold h(this); can do without
+	return p->compact && p->peerCompact;
 }
 bool FXIPCChannel::active() const
 {
@@ -260,6 +290,7 @@ void FXIPCChannel::reset()
 {
 	QMtxHold h(this);
 	p->quit=false; p->noquitmsg=false;
+	p->peerCompact=false;
 	p->monitorThreadId=0;
 }
 FXIPCChannel::EndianConversionKinds FXIPCChannel::endianConversion() const
@@ -380,6 +411,8 @@ bool FXIPCChannel::doReception(FXuint waitfor)
 				if(AutoEndian==p->endianConversion)		// Receiver translates
 					endianiser.setByteOrder((data.data()[17] & FXIPCMsg::FlagsIsBigEndian) ? FXStream::BigEndian : FXStream::LittleEndian);
 				tmsg.read(endianiser);
+				if(tmsg.myflags & FXIPCMsg::FlagsCompactCapable) p->peerCompact=true;
+				endianiser.setCompact(tmsg.inCompact());
 				assert(tmsg.length()>=FXIPCMsg::minHeaderLength);
 				assert(tmsg.msgType());
 				if(p->maxMsgSize && tmsg.length()>p->maxMsgSize)
@@ -467,6 +500,20 @@ bool FXIPCChannel::doReception(FXuint waitfor)
 						p->compressedbuffer->open(IO_ReadOnly);
 						FXRBOp unopen=FXRBObj(*p->compressedbuffer, &QGZipDevice::close);
 						FXStream compressed(p->compressedbuffer);
+						compressed.setCompact(tmsg.inCompact());
+						deendianise(msg, compressed);
+					}
+					else if(tmsg.myflags & FXIPCMsg::FlagsLZ4)
+					{
+						if(!p->lz4buffer)
+						{
+							FXERRHM(p->lz4buffer=new QLZ4Device);
+						}
+						p->lz4buffer->setLZ4Data(&p->buffer);
+						p->lz4buffer->open(IO_ReadOnly);
+						FXRBOp unopen=FXRBObj(*p->lz4buffer, &QLZ4Device::close);
+						FXStream compressed(p->lz4buffer);
+						compressed.setCompact(tmsg.inCompact());
 						deendianise(msg, compressed);
 					}
 					else
@@ -729,13 +776,40 @@ bool FXIPCChannel::sendMsgI(FXIPCMsg *FXRESTRICT msgack, FXIPCMsg *FXRESTRICT ms
 		case AutoEndian:
 			p->endianiser.swapBytes(0);			// Always disable conversion
 		}
+		if(p->compact)
+			msg->myflags|=FXIPCMsg::FlagsCompactCapable;
+		else
+			msg->myflags&=~FXIPCMsg::FlagsCompactCapable;
+		if(endianise && p->compact && p->peerCompact)
+			msg->myflags|=FXIPCMsg::FlagsCompact;
+		else
+			msg->myflags&=~FXIPCMsg::FlagsCompact;
+		p->endianiser.setCompact(msg->inCompact());
 		QByteArray &data=buffer.buffer();
 #ifdef DEBUG
 		memset(data.data(), 0, data.size());
 #endif
 		if(endianise)
 		{
-			if(p->compressed)
+			msg->myflags&=~(FXIPCMsg::FlagsGZipped|FXIPCMsg::FlagsLZ4);
+			if(LZ4Compression==p->compressed)
+			{
+				if(!p->lz4buffer)
+				{
+					FXERRHM(p->lz4buffer=new QLZ4Device);
+				}
+				p->lz4buffer->setLZ4Data(&buffer);
+				p->lz4buffer->open(IO_WriteOnly);
+				FXRBOp unopen=FXRBObj(*p->lz4buffer, &QLZ4Device::close);
+				FXStream compressed(p->lz4buffer);
+				compressed.setCompact(msg->inCompact());
+				endianise(msg, compressed);
+				p->lz4buffer->close();
+				unopen.dismiss();
+				msg->myflags|=FXIPCMsg::FlagsLZ4;
+				buffer.at(buffer.size());
+			}
+			else if(GZipCompression==p->compressed)
 			{	// If using this, execution speed is hardly a priority
 				if(!p->compressedbuffer)
 				{
@@ -745,23 +819,25 @@ bool FXIPCChannel::sendMsgI(FXIPCMsg *FXRESTRICT msgack, FXIPCMsg *FXRESTRICT ms
 				p->compressedbuffer->open(IO_WriteOnly);
 				FXRBOp unopen=FXRBObj(*p->compressedbuffer, &QGZipDevice::close);
 				FXStream compressed(p->compressedbuffer);
+				compressed.setCompact(msg->inCompact());
 				endianise(msg, compressed);
 				p->compressedbuffer->close();
 				unopen.dismiss();
-				FXuval compressedlen=(FXuval) buffer.size();
-				buffer.truncate(compressedlen+msg->headerLength());
-				memmove(data.data()+msg->headerLength(), data.data(), compressedlen);
 				msg->myflags|=FXIPCMsg::FlagsGZipped;
-				buffer.at(compressedlen+msg->headerLength());
+				buffer.at(buffer.size());
 			}
 			else
 			{
-				buffer.at(msg->headerLength());
+				buffer.at(0);
 				endianise(msg, p->endianiser);
 			}
-		} else buffer.at(msg->headerLength());
-		// NOTE TO SELF: Keep consistent with restampMsgAndSend()
-		FXuval len=(FXuval) buffer.at();
+		} else buffer.at(0);
+		// The header is serialised separately into its own small buffer and sent with the
+		// body by writeBlockV(), so the body is never patched or shuffled to make room for
+		// it and can stay in one presized contiguous buffer rather than a segmented one
+		// NOTE TO SELF: Keep consistent with restampMsgAndSend(), which being handed an
+		// already serialised message is the only place a header is rewritten in place
+		FXuval bodylen=(FXuval) buffer.at(), hdrlen=msg->headerLength(), len=hdrlen+bodylen;
 		msg->len=(FXuint) len;
 		assert(msg->length()>=FXIPCMsg::minHeaderLength);
 		assert(msg->msgType());
@@ -773,20 +849,26 @@ bool FXIPCChannel::sendMsgI(FXIPCMsg *FXRESTRICT msgack, FXIPCMsg *FXRESTRICT ms
 			p->sendMsgSize=msg->length();
 		if(p->garbageMessageCount && (msg->myid % p->garbageMessageCount)==0)
 		{	// Trash the message
-			FXuint seed=*(FXuint *)(data.data()+msg->headerLength());
-			for(FXuval n=msg->headerLength(); n<msg->len; n+=4)
+			FXuint seed=*(FXuint *) data.data();
+			for(FXuval n=0; n<bodylen; n+=4)
 			{
 				*(FXuint *)(data.data()+n)=fxrandom(seed);
 			}
 		}
-		buffer.at(0);
+		FXuchar header[FXIPCMsg::minHeaderLength+sizeof(FXuint)];
+		QByteArray headerdata; headerdata.setRawData(header, sizeof(header));
+		FXRBOp unsetheaderdata=FXRBObj(headerdata, &QByteArray::resetRawData, header, sizeof(header));
+		QBuffer headerbuffer(headerdata);
+		headerbuffer.open(IO_ReadWrite);
+		p->endianiser.setDevice(&headerbuffer);
 		msg->write(p->endianiser);
 		if(p->unreliable)
 		{
-			msg->crc=fxadler32(1, data.data()+2*sizeof(FXuint), len-2*sizeof(FXuint));
-			buffer.at(0);
+			msg->crc=fxadler32(fxadler32(1, header+2*sizeof(FXuint), hdrlen-2*sizeof(FXuint)), data.data(), bodylen);
+			headerbuffer.at(0);
 			msg->write(p->endianiser);
 		}
+		p->endianiser.setDevice(&buffer);
 #ifdef DEBUG
 		p->endianiser.setDevice(0);
 #endif
@@ -818,9 +900,18 @@ bool FXIPCChannel::sendMsgI(FXIPCMsg *FXRESTRICT msgack, FXIPCMsg *FXRESTRICT ms
 				}
 			}
 #endif
-			while(written+=(writ=p->dev->writeBlock(data.data()+written, len-written)), written<len)
+			QIODevice::IOVec segs[2]={ QIODevice::IOVec((char *) header, hdrlen), QIODevice::IOVec((char *) data.data(), bodylen) };
+			while(written+=(writ=p->dev->writeBlockV(written<hdrlen ? segs : segs+1, written<hdrlen ? 2 : 1)), written<len)
 			{
 				fxmessage("Partial write of %u bytes, %u to go\n", (FXuint) writ, (FXuint)(len-written));
+				if(written<hdrlen)
+				{
+					segs[0].data=(char *) header+written; segs[0].len=hdrlen-written;
+				}
+				else
+				{
+					segs[1].data=(char *) data.data()+(written-hdrlen); segs[1].len=len-written;
+				}
 			}
 		}
 		FXERRH_CATCH(FXConnectionLostException &)
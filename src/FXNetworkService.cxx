@@ -20,6 +20,7 @@
 ********************************************************************************/
 
 #include "FXNetworkService.h"
+#include "QSSLDevice.h"
 #include "FXLRUCache.h"
 #include "FXMaths.h"
 #include "FXRollback.h"
@@ -44,9 +45,12 @@ struct FXNetworkServicePrivate
 	FXTime banperiod;
 	QMemArray<FXNetworkService::IPMask> banmasks;
 	FXLRUCache<QHostAddressDict<FXNetworkServiceClient> > clients;
+	FXSocketReactor *reactor;
+	FXSocketReactor::HandlerSpec reactorhandler;
 	FXNetworkServicePrivate(QBlkSocket *_serversocket, FXNetworkService::NewClientSpec _newclientv, QThreadPool *_dispatch, FXuint lrucachesize, FXuint _maxclients)
 		: serversocket(_serversocket), newclientv(std::move(_newclientv)), dispatchpool(_dispatch), maxclients(_maxclients), maxclientsperip(8),
-		maxattemptspermin(1), banperiod(FXTime::micsPerHour), clients(lrucachesize, 1, true) { }
+		maxattemptspermin(1), banperiod(FXTime::micsPerHour), clients(lrucachesize, 1, true),
+		reactor(0), reactorhandler((FXSocketReactor::HandlerSpec::void_ *) 0) { }
 };
 
 FXNetworkService::FXNetworkService(QBlkSocket *serversocket, FXNetworkService::NewClientSpec newclientv, QThreadPool *dispatch,
@@ -147,6 +151,52 @@ void FXNetworkService::setBannedIPMasks(const QMemArray<FXNetworkService::IPMask
 	p->banmasks=list;
 }
 
+bool FXNetworkService::SSLSessionCaching() const
+{
+	const FXuint server=QSSLDevice::ServerSessionCache|QSSLDevice::SessionTickets;
+	return server==(QSSLDevice::sessionCaching() & server);
+}
+
+void FXNetworkService::setSSLSessionCaching(bool enable, FXuint entries)
+{
+	const FXuint server=QSSLDevice::ServerSessionCache|QSSLDevice::SessionTickets;
+	FXuint modes=QSSLDevice::sessionCaching();
+	QSSLDevice::setSessionCaching(enable ? modes|server : modes & ~server);
+	if(enable && entries) QSSLDevice::setSessionCacheSize(entries);
+}
+
+FXSocketReactor *FXNetworkService::reactor() const throw()
+{
+	return p->reactor;
+}
+
+void FXNetworkService::setReactor(FXSocketReactor *reactor, FXSocketReactor::HandlerSpec handler)
+{
+	QMtxHold h(this);
+	p->reactor=reactor;
+	p->reactorhandler=std::move(handler);
+}
+
+void FXNetworkService::int_reactorEvent(FXSocketReactor *reactor, QBlkSocket *skt, FXuint events)
+{
+	FXERRH_TRY
+	{
+		p->reactorhandler(reactor, skt, events);
+	}
+	FXERRH_CATCH(FXException &)
+	{
+		if(!(events & FXSocketReactor::Closed)) throw;
+	}
+	FXERRH_ENDTRY
+}
+
+void FXNetworkService::int_reactorRetired(FXSocketReactor *reactor, QBlkSocket *skt)
+{	// Called however the socket leaves the reactor, including remove() by the handler
+	QMtxHold h(this);
+	FXNetworkServiceClient *client=p->clients.find(skt->peerAddress());
+	if(client && client->connections) client->connections--;
+}
+
 QHostAddressDict<FXNetworkServiceClient> FXNetworkService::IPClientRecords() const
 {
 	QMtxHold h(this);
@@ -210,14 +260,33 @@ void FXNetworkService::run()
 		// Take DDoS measures
 		if(!action && client->refusedCount/((float)(now.value-client->firstSeen.value)/FXTime::micsPerMinute)>=p->maxattemptspermin)
 			action=BAN;
-		if(!action && client->threadhs.count()>=p->maxclientsperip)
-			action=REFUSE;
-		QThreadPool::handle threadh=newClientUpcall(this, newsocket, *client, action, p->newclientv);
-		if(threadh) client->threadhs.push_back(threadh);
+		if(p->reactor)
+		{	// Serve through the reactor rather than a thread per client
+			if(!action && client->connections>=p->maxclientsperip)
+				action=REFUSE;
+			if(!action && p->maxclients && p->reactor->count()>=p->maxclients)
+				action=REFUSE;
+			if(!action)
+				action=p->newclientv(this, newsocket);
+			if(!action)
+			{
+				newsocket->setLingerPeriod(-1);
+				FXSocketReactor::RetiredSpec retired(this, &FXNetworkService::int_reactorRetired);
+				p->reactor->add(newsocket, std::move(FXSocketReactor::HandlerSpec(this, &FXNetworkService::int_reactorEvent)), FXSocketReactor::Readable, true, &retired);
+				newsocket=0;
+				client->connections++;
+			}
+		}
+		else
+		{
+			if(!action && client->threadhs.count()>=p->maxclientsperip)
+				action=REFUSE;
+			QThreadPool::handle threadh=newClientUpcall(this, newsocket, *client, action, p->newclientv);
+			if(threadh) client->threadhs.push_back(threadh);
+		}
 		client->lastSeen=now;
 #ifdef DEBUG
-		fxmessage("FXNetworkService: Action on %s:%u is %d\n",
-			newsocket->peerAddress().toString().text(), newsocket->peerPort(), action);
+		fxmessage("FXNetworkService: Action on %s is %d\n", sktIP.toString().text(), action);
 #endif
 		if(action)
 		{
@@ -0,0 +1,495 @@
+/********************************************************************************
+*                                                                               *
+*                        Event driven network socket reactor                    *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#include "QThread.h"		// May undefine USE_WINAPI and USE_POSIX
+#ifdef USE_POSIX
+ #include <unistd.h>
+ #include <fcntl.h>
+ #include <errno.h>
+ #ifdef __linux__
+  #define USE_EPOLL
+  #include <sys/epoll.h>
+ #else
+  #include <poll.h>
+ #endif
+#endif
+
+#include "FXSocketReactor.h"
+#include "QBlkSocket.h"
+#include "FXProcess.h"
+#include "FXException.h"
+#include "FXRollback.h"
+#include "QTrans.h"
+#include "qptrdict.h"
+#include <vector>
+#include "FXMemDbg.h"
+#if defined(DEBUG) && !defined(FXMEMDBG_DISABLE)
+static const char *_fxmemdbg_current_file_ = __FILE__;
+#endif
+
+namespace FX {
+
+struct FXDLLLOCAL FXSocketReactorPrivate : public QMutex
+{
+	struct Entry
+	{
+		QBlkSocket *skt;
+		int fd;
+		FXuint events, pending;
+		FXSocketReactor::HandlerSpec handler;
+		FXSocketReactor::RetiredSpec retired;
+		bool autodelete, busy, removed;
+		Entry(QBlkSocket *_skt, int _fd, FXSocketReactor::HandlerSpec &_handler, FXuint _events, bool _autodelete, FXSocketReactor::RetiredSpec *_retired)
+			: skt(_skt), fd(_fd), events(_events), pending(0), handler(std::move(_handler)), autodelete(_autodelete), busy(false), removed(false)
+		{
+			if(_retired) retired=std::move(*_retired);
+		}
+	};
+	struct Poller : public QThread
+	{
+		FXSocketReactorPrivate *p;
+		Poller(FXSocketReactorPrivate *_p) : QThread("Socket reactor", false, 64*1024, QThread::InProcess), p(_p) { }
+		void run() { p->loop(); }
+		void *cleanup() { return 0; }
+	};
+	FXSocketReactor *parent;
+	QThreadPool *pool;
+	bool edge;
+	QPtrDict<Entry> entries;
+	std::vector<Entry *> graveyard;		// Only ever freed by the poller
+	FXuint running;						// Handler jobs dispatched and not yet finished
+	QWaitCondition idle;
+	Poller *poller;
+	volatile bool quit;
+#ifdef USE_POSIX
+	int wakefds[2];
+#ifdef USE_EPOLL
+	int epollh;
+#endif
+#endif
+	FXSocketReactorPrivate(FXSocketReactor *_parent, QThreadPool *_pool, bool _edge) : QMutex(), parent(_parent), pool(_pool), edge(_edge),
+		entries(1021), running(0), idle(true), poller(0), quit(false)
+	{
+#ifdef USE_POSIX
+		wakefds[0]=wakefds[1]=-1;
+#ifdef USE_EPOLL
+		epollh=-1;
+#endif
+#endif
+	}
+	~FXSocketReactorPrivate()
+	{
+		if(poller)
+		{
+			quit=true;
+			wake();
+			poller->wait();
+			FXDELETE(poller);
+		}
+		{	// Let any handlers still running finish
+			QMtxHold h(this);
+			while(running)
+			{
+				idle.reset();
+				h.unlock();
+				idle.wait();
+				h.relock();
+			}
+		}
+		freeGraveyard();
+		for(QPtrDictIterator<Entry> it(entries); it.current(); ++it)
+		{
+			Entry *e=it.current();
+			if(e->retired) e->retired(parent, e->skt);
+			if(e->autodelete) FXDELETE(e->skt);
+			FXDELETE(e);
+		}
+		entries.clear();
+#ifdef USE_POSIX
+#ifdef USE_EPOLL
+		if(epollh>=0) ::close(epollh);
+#endif
+		if(wakefds[0]>=0) ::close(wakefds[0]);
+		if(wakefds[1]>=0) ::close(wakefds[1]);
+#endif
+	}
+	void wake()
+	{	// Makes the poller go round its loop
+#ifdef USE_POSIX
+		char c=0;
+		while(-1==::write(wakefds[1], &c, 1) && EINTR==errno);
+#endif
+	}
+	void freeGraveyard()
+	{
+		for(std::vector<Entry *>::iterator it=graveyard.begin(); it!=graveyard.end(); ++it)
+			delete *it;
+		graveyard.clear();
+	}
+#ifdef USE_EPOLL
+	FXuint epollEvents(FXuint events) const
+	{
+		FXuint ret=EPOLLRDHUP|(edge ? EPOLLET : EPOLLONESHOT);
+		if(events & FXSocketReactor::Readable) ret|=EPOLLIN;
+		if(events & FXSocketReactor::Writable) ret|=EPOLLOUT;
+		return ret;
+	}
+	int arm(Entry *e, int op)
+	{
+		struct epoll_event ev={0};
+		ev.events=epollEvents(e->events);
+		ev.data.ptr=e;
+		return ::epoll_ctl(epollh, op, e->fd, &ev);
+	}
+#endif
+	void retire(Entry *e)
+	{	// Lock must be held and the entry not busy
+		entries.take(e->skt);
+		e->removed=true;
+#ifdef USE_EPOLL
+		::epoll_ctl(epollh, EPOLL_CTL_DEL, e->fd, 0);
+#endif
+		FXEXCEPTION_STL1 {
+			graveyard.push_back(e);
+		} FXEXCEPTION_STL2;
+	}
+	void closeHandler(Entry *e)
+	{	// Lets the handler clean up after it threw
+		FXERRH_TRY
+		{
+			e->handler(parent, e->skt, FXSocketReactor::Closed);
+		}
+		FXERRH_CATCH(FXException &)
+		{
+		}
+		FXERRH_ENDTRY
+	}
+	void runHandler(Entry *e, FXuint ev)
+	{	// Called in the context of a pool thread
+		QBlkSocket *skt=e->skt, *todelete=0;
+		FXSocketReactor::RetiredSpec retired;
+		FXERRH_TRY
+		{
+			for(;;)
+			{
+				bool lost=false;
+				FXERRH_TRY
+				{
+					e->handler(parent, e->skt, ev);
+				}
+				FXERRH_CATCH(FXConnectionLostException &)
+				{
+					lost=true;
+				}
+				FXERRH_ENDTRY
+				if(lost)
+				{	// The handler has already been told if it was called with Closed
+					if(!(ev & FXSocketReactor::Closed)) closeHandler(e);
+					ev|=FXSocketReactor::Closed;
+				}
+				QMtxHold h(this);
+				if(!e->removed && !(ev & FXSocketReactor::Closed) && e->pending)
+				{	// More arrived while we were busy (edge triggered only)
+					ev=e->pending;
+					e->pending=0;
+					continue;
+				}
+				finish(e, ev, todelete, retired);
+				break;
+			}
+		}
+		FXERRH_CATCH(FXException &)
+		{
+			if(!(ev & FXSocketReactor::Closed)) closeHandler(e);
+			{
+				QMtxHold h(this);
+				finish(e, FXSocketReactor::Closed, todelete, retired);
+			}
+			if(retired) retired(parent, skt);
+			FXDELETE(todelete);
+			throw;
+		}
+		FXERRH_ENDTRY
+		if(retired) retired(parent, skt);
+		FXDELETE(todelete);
+	}
+	void finish(Entry *e, FXuint ev, QBlkSocket *&todelete, FXSocketReactor::RetiredSpec &retired)
+	{	// Lock must be held. Any retired upcall is left for the caller to make once it's released
+		e->busy=false;
+		if(e->removed)
+		{	// Removed while busy
+			FXEXCEPTION_STL1 {
+				graveyard.push_back(e);
+			} FXEXCEPTION_STL2;
+		}
+#ifdef USE_EPOLL
+		else if((ev & FXSocketReactor::Closed) || (!edge && arm(e, EPOLL_CTL_MOD)<0))
+#else
+		else if(ev & FXSocketReactor::Closed)
+#endif
+		{	// If it can't be rearmed, the handler must have closed it
+			if(e->autodelete) todelete=e->skt;
+			retired=std::move(e->retired);
+			retire(e);
+		}
+#ifndef USE_EPOLL
+		else wake();
+#endif
+		if(!--running) idle.wakeAll();
+	}
+	static void runJob(FXSocketReactorPrivate *p, Entry *e, FXuint ev)
+	{
+		p->runHandler(e, ev);
+	}
+	void dispatch(Entry *e, FXuint ev)
+	{	// Lock must be held
+		e->busy=true;
+		e->pending=0;
+		++running;
+		pool->dispatch(Generic::BindFuncN(&runJob, this, e, ev));
+	}
+	void event(Entry *e, FXuint ev)
+	{	// Lock must be held
+		if(e->removed) return;
+		if(e->busy)
+			e->pending|=ev;
+		else
+		{
+			FXERRH_TRY
+			{
+				dispatch(e, ev);
+			}
+			FXERRH_CATCH(FXException &ex)
+			{
+				--running;
+				e->busy=false;
+#ifdef USE_EPOLL
+				if(!edge) arm(e, EPOLL_CTL_MOD);
+#endif
+				fxwarning("FXSocketReactor: Failed to dispatch handler due to %s\n", ex.report().text());
+			}
+			FXERRH_ENDTRY
+		}
+	}
+	void loop()
+	{
+#ifdef USE_EPOLL
+		struct epoll_event evs[256];
+		for(;;)
+		{
+			{
+				QMtxHold h(this);
+				freeGraveyard();
+			}
+			int no=::epoll_wait(epollh, evs, sizeof(evs)/sizeof(struct epoll_event), -1);
+			if(no<0)
+			{
+				if(EINTR==errno) continue;
+				FXERRHOS(no);
+			}
+			if(quit) return;
+			QMtxHold h(this);
+			for(int n=0; n<no; n++)
+			{
+				Entry *e=(Entry *) evs[n].data.ptr;
+				if(!e)
+				{	// Wake pipe
+					char buffer[64];
+					while(::read(wakefds[0], buffer, sizeof(buffer))>0);
+					continue;
+				}
+				FXuint ev=0;
+				if(evs[n].events & EPOLLIN) ev|=FXSocketReactor::Readable;
+				if(evs[n].events & EPOLLOUT) ev|=FXSocketReactor::Writable;
+				if(evs[n].events & (EPOLLHUP|EPOLLRDHUP|EPOLLERR)) ev|=FXSocketReactor::Closed|(e->events & FXSocketReactor::Readable);
+				event(e, ev);
+			}
+		}
+#elif defined(USE_POSIX)
+		std::vector<struct pollfd> fds;
+		std::vector<Entry *> fdentries;
+		for(;;)
+		{
+			{	// Rebuild the list of sockets not currently being handled
+				QMtxHold h(this);
+				freeGraveyard();
+				fds.clear();
+				fdentries.clear();
+				struct pollfd pfd={0};
+				pfd.fd=wakefds[0];
+				pfd.events=POLLIN;
+				fds.push_back(pfd);
+				fdentries.push_back(0);
+				for(QPtrDictIterator<Entry> it(entries); it.current(); ++it)
+				{
+					Entry *e=it.current();
+					if(e->busy) continue;
+					pfd.fd=e->fd;
+					pfd.events=0;
+					if(e->events & FXSocketReactor::Readable) pfd.events|=POLLIN;
+					if(e->events & FXSocketReactor::Writable) pfd.events|=POLLOUT;
+					fds.push_back(pfd);
+					fdentries.push_back(e);
+				}
+			}
+			int no=::poll(&fds.front(), (nfds_t) fds.size(), -1);
+			if(no<0)
+			{
+				if(EINTR==errno) continue;
+				FXERRHOS(no);
+			}
+			if(quit) return;
+			if(fds[0].revents)
+			{
+				char buffer[64];
+				while(::read(wakefds[0], buffer, sizeof(buffer))>0);
+			}
+			QMtxHold h(this);
+			for(size_t n=1; n<fds.size(); n++)
+			{
+				if(!fds[n].revents) continue;
+				Entry *e=fdentries[n];
+				FXuint ev=0;
+				if(fds[n].revents & POLLIN) ev|=FXSocketReactor::Readable;
+				if(fds[n].revents & POLLOUT) ev|=FXSocketReactor::Writable;
+				if(fds[n].revents & (POLLHUP|POLLERR|POLLNVAL)) ev|=FXSocketReactor::Closed|(e->events & FXSocketReactor::Readable);
+				event(e, ev);
+			}
+		}
+#endif
+	}
+};
+
+FXSocketReactor::FXSocketReactor(QThreadPool *dispatch, bool edgetriggered) : p(0)
+{
+#ifndef USE_POSIX
+	FXERRGNOTSUPP(QTrans::tr("FXSocketReactor", "Non-blocking sockets are not supported on this platform"));
+#else
+	FXERRHM(p=new FXSocketReactorPrivate(this, dispatch ? dispatch : &FXProcess::threadPool(), edgetriggered));
+	FXRBOp unconstr=FXRBConstruct(this);
+	FXERRHOS(::pipe(p->wakefds));
+	for(int n=0; n<2; n++)
+	{
+		::fcntl(p->wakefds[n], F_SETFD, FD_CLOEXEC);
+		::fcntl(p->wakefds[n], F_SETFL, O_NONBLOCK);
+	}
+#ifdef USE_EPOLL
+	FXERRHOS(p->epollh=::epoll_create1(EPOLL_CLOEXEC));
+	struct epoll_event ev={0};
+	ev.events=EPOLLIN;
+	ev.data.ptr=0;
+	FXERRHOS(::epoll_ctl(p->epollh, EPOLL_CTL_ADD, p->wakefds[0], &ev));
+#endif
+	FXERRHM(p->poller=new FXSocketReactorPrivate::Poller(p));
+	p->poller->start();
+	unconstr.dismiss();
+#endif
+}
+
+FXSocketReactor::~FXSocketReactor()
+{ FXEXCEPTIONDESTRUCT1 {
+	FXDELETE(p);
+} FXEXCEPTIONDESTRUCT2; }
+
+QThreadPool *FXSocketReactor::dispatchPool() const throw()
+{
+	return p->pool;
+}
+
+bool FXSocketReactor::edgeTriggered() const throw()
+{
+	return p->edge;
+}
+
+void FXSocketReactor::add(QBlkSocket *skt, HandlerSpec handler, FXuint events, bool autodelete, RetiredSpec *retired)
+{
+	int fd=(int)(FXuval) static_cast<QIODeviceS *>(skt)->int_getOSHandle();
+	FXERRH(skt->isOpen() && fd>0, QTrans::tr("FXSocketReactor", "Socket is not open"), 0, FXERRH_ISDEBUG);
+	skt->setBlocking(false);
+	QMtxHold h(p);
+	FXERRH(!p->entries.find(skt), QTrans::tr("FXSocketReactor", "Socket is already in this reactor"), 0, FXERRH_ISDEBUG);
+	FXSocketReactorPrivate::Entry *e;
+	FXERRHM(e=new FXSocketReactorPrivate::Entry(skt, fd, handler, events, autodelete, retired));
+	FXRBOp une=FXRBNew(e);
+	p->entries.insert(skt, e);
+	FXRBOp unentry=FXRBObj(p->entries, &QPtrDict<FXSocketReactorPrivate::Entry>::take, skt);
+#ifdef USE_EPOLL
+	FXERRHOS(p->arm(e, EPOLL_CTL_ADD));
+#else
+	p->wake();
+#endif
+	unentry.dismiss();
+	une.dismiss();
+}
+
+void FXSocketReactor::setEvents(QBlkSocket *skt, FXuint events)
+{
+	QMtxHold h(p);
+	FXSocketReactorPrivate::Entry *e=p->entries.find(skt);
+	FXERRH(e, QTrans::tr("FXSocketReactor", "Socket is not in this reactor"), 0, FXERRH_ISDEBUG);
+	if(e->events==events) return;
+	e->events=events;
+	// A busy entry is rearmed when its handler returns
+#ifdef USE_EPOLL
+	if(!e->busy || p->edge) FXERRHOS(p->arm(e, EPOLL_CTL_MOD));
+#else
+	if(!e->busy) p->wake();
+#endif
+}
+
+FXuint FXSocketReactor::events(QBlkSocket *skt) const
+{
+	QMtxHold h(p);
+	FXSocketReactorPrivate::Entry *e=p->entries.find(skt);
+	return e ? e->events : 0;
+}
+
+bool FXSocketReactor::remove(QBlkSocket *skt)
+{
+	QMtxHold h(p);
+	FXSocketReactorPrivate::Entry *e=p->entries.find(skt);
+	if(!e) return false;
+	RetiredSpec retired(std::move(e->retired));
+	if(e->busy)
+	{	// The handler finishing puts it into the graveyard
+		p->entries.take(skt);
+		e->removed=true;
+#ifdef USE_EPOLL
+		::epoll_ctl(p->epollh, EPOLL_CTL_DEL, e->fd, 0);
+#endif
+	}
+	else
+		p->retire(e);
+#ifndef USE_EPOLL
+	p->wake();
+#endif
+	h.unlock();
+	if(retired) retired(this, skt);
+	return true;
+}
+
+FXuint FXSocketReactor::count() const
+{
+	QMtxHold h(p);
+	return p->entries.count();
+}
+
+} // namespace
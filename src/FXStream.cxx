@@ -37,9 +37,10 @@
 #include "QBuffer.h"
 #include <qcstring.h>
 
-#ifdef _MSC_VER
-#include <malloc.h>
-#define alloca _alloca
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
 #endif
 
 
@@ -73,11 +74,15 @@ FXStream::FXStream(QIODevice *_dev, const FXObject *cont){
   code=FXStreamOK;
   seq=0x80000000;
   swap=FALSE;
+  compact=false;
   owns=FALSE;
 
   // TnFOX stuff
   hash=0;
   dev=_dev;
+  iobuf=ioptr=ioend=0;
+  iobufsize=0;
+  iodir=FXStreamDead;
   }
 
 // Create PersistentStore object
@@ -92,15 +97,20 @@ FXStream::FXStream(const FXObject *cont){
   code=FXStreamOK;
   seq=0x80000000;
   swap=FALSE;
+  compact=false;
   owns=FALSE;
 
   // TnFOX stuff
   hash=0;
   dev=0;
+  iobuf=ioptr=ioend=0;
+  iobufsize=0;
+  iodir=FXStreamDead;
   }
 
 // Destroy PersistentStore object
-FXStream::~FXStream(){
+FXStream::~FXStream(){ FXEXCEPTIONDESTRUCT1 {
+  if(iobuf){ int_sync(); delete[] iobuf; }
   if(owns){FXFREE(&begptr);}
   parent=(FXObject*)-1L;
   begptr=(FXuchar*)-1L;
@@ -113,7 +123,8 @@ FXStream::~FXStream(){
   FXDELETE(hash);
 #endif
   dev=(QIODevice *)-1L;
-  }
+  iobuf=ioptr=ioend=(FXuchar*)-1L;
+  } FXEXCEPTIONDESTRUCT2; }
 
 
 FXuval FXStream::writeBuffer(FXuval){
@@ -194,6 +205,7 @@ bool FXStream::open(FXStreamDirection save_or_load,FXuval size,FXuchar* data){
 
 // Close store; return TRUE if no errors have been encountered
 bool FXStream::close(){
+  int_sync();
 #ifndef FX_DISABLEGUI
   if(dir){
     hash->clear();
@@ -214,29 +226,125 @@ bool FXStream::close(){
 
 // Flush buffer
 bool FXStream::flush(){
-  // Does nothing as underlying i/o devices do the buffering
+  int_sync();
   return code==FXStreamOK;
   }
 
 
 FXlong FXStream::position() const
 {
-	return (FXlong) dev->at();
+	FXlong ret=(FXlong) dev->at();
+	if(FXStreamSave==iodir) ret+=ioptr-iobuf;
+	else if(FXStreamLoad==iodir) ret-=ioend-ioptr;
+	return ret;
 }
 
 // Move to position
 bool FXStream::position(FXlong newpos,FXWhence whence)
 {
-	if(FXFromCurrent==whence) newpos+=(FXlong) dev->at();
-	else if(FXFromEnd==whence) newpos=(FXlong) dev->size()-newpos;
+	if(FXFromCurrent==whence) newpos+=position();
+	int_sync();
+	if(FXFromEnd==whence) newpos=(FXlong) dev->size()-newpos;
 	return dev->at((FXfval) newpos);
 }
 
 void FXStream::setDevice(QIODevice *_dev)
 {
+	if(dev!=_dev) int_sync();
 	dev=_dev;
 }
 
+void FXStream::setBufferSize(FXuval size)
+{
+	int_sync();
+	if(size!=iobufsize)
+	{
+		FXuchar *newbuf=0;
+		if(size) FXERRHM(newbuf=new FXuchar[size]);
+		delete[] iobuf;
+		iobuf=newbuf;
+		iobufsize=size;
+		ioptr=ioend=iobuf;
+	}
+}
+
+void FXStream::int_sync()
+{
+	if(FXStreamSave==iodir)
+	{
+		FXuval len=ioptr-iobuf;
+		iodir=FXStreamDead;
+		ioptr=ioend=iobuf;
+		if(len) dev->writeBlock((const char *) iobuf, len);
+	}
+	else if(FXStreamLoad==iodir)
+	{	// Rewind the device by however much read-ahead wasn't consumed
+		FXuval unread=ioend-ioptr;
+		iodir=FXStreamDead;
+		ioptr=ioend=iobuf;
+		if(unread) dev->at(dev->at()-unread);
+	}
+}
+
+void FXStream::int_writeBuffered(const char *data, FXuval len)
+{
+	if(!iobuf)
+	{
+		dev->writeBlock(data, len);
+		return;
+	}
+	if(FXStreamSave!=iodir)
+	{
+		int_sync();
+		iodir=FXStreamSave;
+		ioptr=iobuf;
+		ioend=iobuf+iobufsize;
+	}
+	if((FXuval)(ioend-ioptr)<len)
+	{
+		FXuval pending=ioptr-iobuf;
+		ioptr=iobuf;
+		if(pending) dev->writeBlock((const char *) iobuf, pending);
+		if(len>=iobufsize)
+		{	// Too big to be worth buffering
+			dev->writeBlock(data, len);
+			return;
+		}
+	}
+	memcpy(ioptr, data, len);
+	ioptr+=len;
+}
+
+FXuval FXStream::int_readBuffered(char *data, FXuval len)
+{
+	if(FXStreamLoad!=iodir) int_sync();
+	if(!iobuf || dev->isSynchronous() || dev->isTranslated())
+		return dev->readBlock(data, len);
+	FXuval read=0;
+	while(read<len)
+	{
+		if(ioptr==ioend)
+		{
+			iodir=FXStreamDead;
+			ioptr=ioend=iobuf;
+			if(len-read>=iobufsize)
+			{	// Too big to be worth buffering
+				read+=dev->readBlock(data+read, len-read);
+				break;
+			}
+			FXuval got=dev->readBlock((char *) iobuf, iobufsize);
+			if(!got) break;
+			iodir=FXStreamLoad;
+			ioend=iobuf+got;
+		}
+		FXuval tocopy=FXMIN(len-read, (FXuval)(ioend-ioptr));
+		memcpy(data+read, ioptr, tocopy);
+		ioptr+=tocopy;
+		read+=tocopy;
+	}
+	return read;
+}
+
 // Little helper function to work around operator>> hiding
 static inline void readIntegral(FXStream &s, FXuint &v)
 {
@@ -257,12 +365,32 @@ FXStream &FXStream::writeBytes(const char *s, FXuint l)
 
 FXfval FXStream::rewind(FXint amount)
 {
-	FXfval c=dev->at();
+	FXfval c=(FXfval) position();
 	if(amount>0 && c<(FXfval) amount) c=0; else c-=amount;
+	int_sync();
 	dev->at(c);
 	return c;
 }
 
+FXulong FXStream::int_readVarint(FXulong max)
+{
+	FXulong ret=0;
+	for(int shift=0; shift<64; shift+=7)
+	{
+		FXuchar c=0;
+		*this >> c;
+		if(63==shift && (c & 0x7e)) break;		// Would set bits beyond the 64th
+		ret|=(FXulong)(c & 0x7f)<<shift;
+		if(!(c & 0x80))
+		{
+			if(ret>max) break;
+			return ret;
+		}
+	}
+	FXERRGIO(QTrans::tr("FXStream", "Malformed variable length integer"));
+	return 0;
+}
+
 void FXStream::int_throwPrematureEOF()
 {
 	if(hash)
@@ -277,65 +405,115 @@ void FXStream::int_throwPrematureEOF()
 
 
 
+/**********************  Chunked Byte Swapping of Arrays  ***********************/
+
+/* Arrays are endian swapped in chunks of SWAPCHUNK bytes rather than in one go.
+This keeps the working set within the L1 cache and means a save() of a huge array
+no longer needs an alloca() of the entire array (which could overflow the stack).
+Where the compiler is targeting SSSE3 or AVX2 the swap is done with a byte shuffle,
+else fxendianswap() is used per element. */
+#define SWAPCHUNK          8192         // Bytes swapped per i/o device access
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+template<int width> struct SwapMask;
+template<> struct SwapMask<2>
+{
+	static __m128i get() { return _mm_setr_epi8(1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14); }
+};
+template<> struct SwapMask<4>
+{
+	static __m128i get() { return _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12); }
+};
+template<> struct SwapMask<8>
+{
+	static __m128i get() { return _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8); }
+};
+#endif
+
+// Swaps n items from src into dst, which may be the same
+template<typename type> static inline void swapArray(type *dst, const type *src, FXuval n) throw()
+{
+	FXuval idx=0;
+#if defined(__SSSE3__) || defined(__AVX2__)
+	const __m128i mask=SwapMask<sizeof(type)>::get();
+#if defined(__AVX2__)
+	const __m256i mask2=_mm256_broadcastsi128_si256(mask);
+	for(; idx+32/sizeof(type)<=n; idx+=32/sizeof(type))
+		_mm256_storeu_si256((__m256i *)(dst+idx), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src+idx)), mask2));
+#endif
+	for(; idx+16/sizeof(type)<=n; idx+=16/sizeof(type))
+		_mm_storeu_si128((__m128i *)(dst+idx), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src+idx)), mask));
+#endif
+	for(; idx<n; idx++)
+	{
+		type v=src[idx];
+		fxendianswap(v);
+		dst[idx]=v;
+	}
+}
+
+template<typename type> inline void FXStream::int_saveArray(const type *p, FXuval n)
+{
+	if(!swap || !n)
+	{
+		int_write(p, n*sizeof(type));
+		return;
+	}
+	type buffer[SWAPCHUNK/sizeof(type)];
+	while(n)
+	{
+		FXuval chunk=FXMIN(n, (FXuval)(SWAPCHUNK/sizeof(type)));
+		swapArray(buffer, p, chunk);
+		int_write(buffer, chunk*sizeof(type));
+		p+=chunk; n-=chunk;
+	}
+}
+
+template<typename type> inline bool FXStream::int_loadArray(type *p, FXuval n)
+{
+	if(!swap || !n)
+		return n*sizeof(type)==int_read(p, n*sizeof(type));
+	while(n)
+	{	// Swap each chunk while it's still in cache
+		FXuval chunk=FXMIN(n, (FXuval)(SWAPCHUNK/sizeof(type)));
+		if(chunk*sizeof(type)!=int_read(p, chunk*sizeof(type))) return false;
+		swapArray(p, p, chunk);
+		p+=chunk; n-=chunk;
+	}
+	return true;
+}
+
+
+
 /************************  Save Blocks of Basic Types  *************************/
 
 FXStream& FXStream::save(const FXushort* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(swap && n)
-  {
-	  FXushort *_p=(FXushort *) memcpy(alloca(n*sizeof(FXushort)), p, n*sizeof(FXushort));
-	  for(unsigned long i=0; i<n; i++) fxendianswap(_p[i]);
-	  p=_p;
-  }
-  dev->writeBlock((char *) p,n<<1);
+  int_saveArray(p, n);
   return *this;
   }
 
 FXStream& FXStream::save(const FXuint* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(swap && n)
-  {
-	  FXuint *_p=(FXuint *) memcpy(alloca(n*sizeof(FXuint)), p, n*sizeof(FXuint));
-	  for(unsigned long i=0; i<n; i++) fxendianswap(_p[i]);
-	  p=_p;
-  }
-  dev->writeBlock((char *) p,n<<2);
+  int_saveArray(p, n);
   return *this;
   }
 
 FXStream& FXStream::save(const FXfloat* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(swap && n)
-  {
-	  FXfloat *_p=(FXfloat *) memcpy(alloca(n*sizeof(FXfloat)), p, n*sizeof(FXfloat));
-	  for(unsigned long i=0; i<n; i++) fxendianswap(*(FXuint *)&_p[i]);
-	  p=_p;
-  }
-  dev->writeBlock((char *) p,n<<2);
+  int_saveArray(reinterpret_cast<const FXuint *>(p), n);
   return *this;
   }
 
 FXStream& FXStream::save(const FXdouble* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(swap && n)
-  {
-	  FXdouble *_p=(FXdouble *) memcpy(alloca(n*sizeof(FXdouble)), p, n*sizeof(FXdouble));
-	  for(unsigned long i=0; i<n; i++) fxendianswap(*(FXulong *)&_p[i]);
-	  p=_p;
-  }
-  dev->writeBlock((char *) p,n<<3);
+  int_saveArray(reinterpret_cast<const FXulong *>(p), n);
   return *this;
   }
 
 FXStream& FXStream::save(const FXulong* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(swap && n)
-  {
-	  FXulong *_p=(FXulong *) memcpy(alloca(n*sizeof(FXulong)), p, n*sizeof(FXulong));
-	  for(unsigned long i=0; i<n; i++) fxendianswap(_p[i]);
-	  p=_p;
-  }
-  dev->writeBlock((char *) p,n<<3);
+  int_saveArray(p, n);
   return *this;
   }
 
@@ -345,36 +523,31 @@ FXStream& FXStream::save(const FXulong* p,unsigned long n){
 
 FXStream& FXStream::load(FXushort* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(n<<1!=dev->readBlock((char *) p,n<<1)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
-  if(swap&&n){do{fxendianswap(*p++);}while(--n);}
+  if(!int_loadArray(p, n)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
   return *this;
   }
 
 FXStream& FXStream::load(FXuint* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(n<<2!=dev->readBlock((char *) p,n<<2)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
-  if(swap&&n){do{fxendianswap(*p++);}while(--n);}
+  if(!int_loadArray(p, n)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
   return *this;
   }
 
 FXStream& FXStream::load(FXfloat* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(n<<2!=dev->readBlock((char *) p,n<<2)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
-  if(swap&&n){do{fxendianswap(*(FXuint *)(p++));}while(--n);}
+  if(!int_loadArray(reinterpret_cast<FXuint *>(p), n)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
   return *this;
   }
 
 FXStream& FXStream::load(FXdouble* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(n<<3!=dev->readBlock((char *) p,n<<3)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
-  if(swap&&n){do{fxendianswap(*(FXulong *)(p++));}while(--n);}
+  if(!int_loadArray(reinterpret_cast<FXulong *>(p), n)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
   return *this;
   }
 
 FXStream& FXStream::load(FXulong* p,unsigned long n){
   FXASSERT(n==0 || (n>0 && p!=NULL));
-  if(n<<3!=dev->readBlock((char *) p,n<<3)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
-  if(swap&&n){do{fxendianswap(*p++);}while(--n);}
+  if(!int_loadArray(p, n)) FXERRGIO(QTrans::tr("FXStream", "Premature EOF encountered"));
   return *this;
   }
 
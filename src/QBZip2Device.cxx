@@ -24,6 +24,8 @@
 #include "QBuffer.h"
 #include "QThread.h"
 #include "QTrans.h"
+#include "FXPtrHold.h"
+#include "int_ParallelCompressor.h"
 #include <qcstring.h>
 #include "FXErrCodes.h"
 #ifdef HAVE_BZ2LIB_H
@@ -65,6 +67,26 @@ static const char *decodeBZ2Err(int code)
 	}
 	return "Unknown BZip2 error";
 }
+
+#ifdef DEBUG
+#define BZ2VERBOSITY 1
+#else
+#define BZ2VERBOSITY 0
+#endif
+
+// Compresses into a complete .bz2 stream which can be concatenated with others
+static bool bz2CompressStream(QByteArray &out, const FXuchar *in, FXuval len, int level)
+{
+	static char empty;
+	if(len>0x40000000) return false;
+	if(!in) in=(const FXuchar *) &empty;	// libbz2 refuses null even when empty
+	unsigned int outlen=(unsigned int)(len+len/100+600);
+	out.resize(outlen);
+	if(BZ_OK!=BZ2_bzBuffToBuffCompress((char *) out.data(), &outlen, (char *) in, (unsigned int) len, level, BZ2VERBOSITY, 0))
+		return false;
+	out.resize(outlen);
+	return true;
+}
 #endif
 
 struct FXDLLLOCAL QBZip2DevicePrivate : public QMutex
@@ -72,12 +94,36 @@ struct FXDLLLOCAL QBZip2DevicePrivate : public QMutex
 	QIODevice *src;
 	int compression;
 	bool enableSeeking;
+	FXuval parallel;
 	QBuffer uncomp;
 #ifdef HAVE_BZ2LIB_H
 	char inbuffer[16384];
 	bz_stream inh, outh;
+	bool inEnded;
+	QIODevice_ParallelCompressor *pc;
+#endif
+	QBZip2DevicePrivate(QIODevice *_src, int _compression, bool _enableSeeking) : src(_src), compression(_compression), enableSeeking(_enableSeeking), parallel(0)
+#ifdef HAVE_BZ2LIB_H
+		, inEnded(false), pc(0)
+#endif
+	{ }
+#ifdef HAVE_BZ2LIB_H
+	// Called at the end of a stream. Returns false if there isn't another concatenated after it.
+	bool nextInStream()
+	{
+		FXERRHBZ2(BZ2_bzDecompressEnd(&inh));
+		FXuint left=inh.avail_in;
+		memset(&inh, 0, sizeof(inh));
+		if(!left && src->atEnd())
+		{
+			inEnded=true;
+			return false;
+		}
+		FXERRHBZ2(BZ2_bzDecompressInit(&inh, BZ2VERBOSITY, 0));
+		inh.avail_in=left;
+		return true;
+	}
 #endif
-	QBZip2DevicePrivate(QIODevice *_src, int _compression, bool _enableSeeking) : src(_src), compression(_compression), enableSeeking(_enableSeeking) { }
 };
 
 QBZip2Device::QBZip2Device(QIODevice *src, int compression, bool enableSeeking) : p(0)
@@ -104,6 +150,17 @@ void QBZip2Device::setBZ2Data(QIODevice *src)
 	p->src=src;
 }
 
+FXuval QBZip2Device::parallelCompression() const
+{
+	return p->parallel;
+}
+
+void QBZip2Device::setParallelCompression(FXuval blocksize)
+{
+	QMtxHold h(p);
+	p->parallel=blocksize;
+}
+
 bool QBZip2Device::open(FXuint mode)
 {
 	QMtxHold h(p);
@@ -121,6 +178,7 @@ bool QBZip2Device::open(FXuint mode)
 		if(p->src->isClosed()) p->src->open(mode & ~IO_Translate);
 		memset(&p->inh, 0, sizeof(p->inh));
 		memset(&p->outh, 0, sizeof(p->outh));
+		p->inEnded=true;
 		if(p->compression<1) p->compression=1;
 		if(p->compression>9) p->compression=9;
 		if(p->enableSeeking)
@@ -130,14 +188,9 @@ bool QBZip2Device::open(FXuint mode)
 		{
 			if(!p->src->atEnd())
 			{
-				int ret=BZ2_bzDecompressInit(&p->inh,
-#ifdef DEBUG
-					1,
-#else
-					0,
-#endif
-					0);
+				int ret=BZ2_bzDecompressInit(&p->inh, BZ2VERBOSITY, 0);
 				FXERRHBZ2(ret);
+				p->inEnded=false;
 				if(p->enableSeeking)
 				{
 					static const FXuval BlockSize=65536;
@@ -153,8 +206,8 @@ bool QBZip2Device::open(FXuint mode)
 						FXERRHBZ2(ret=BZ2_bzDecompress(&p->inh));
 						memmove(p->inbuffer, p->inh.next_in, p->inh.avail_in);
 						offset+=BlockSize-p->inh.avail_out;
-					} while(BZ_STREAM_END!=ret);
-					FXERRHBZ2(BZ2_bzDecompressEnd(&p->inh));
+						// Concatenated streams (eg; from parallel compression) follow on
+					} while(BZ_STREAM_END!=ret || p->nextInStream());
 					p->uncomp.buffer().resize(offset);
 					if(mode & IO_Translate)
 					{
@@ -184,14 +237,13 @@ bool QBZip2Device::open(FXuint mode)
 		}
 		if((mode & IO_WriteOnly) && !p->enableSeeking)
 		{
-			int ret=BZ2_bzCompressInit(&p->outh, p->compression,
-#ifdef DEBUG
-				1,
-#else
-				0,
-#endif
-				0);
-			FXERRHBZ2(ret);
+			if(p->parallel)
+				FXERRHM(p->pc=new QIODevice_ParallelCompressor(p->src, bz2CompressStream, p->compression, p->parallel));
+			else
+			{
+				int ret=BZ2_bzCompressInit(&p->outh, p->compression, BZ2VERBOSITY, 0);
+				FXERRHBZ2(ret);
+			}
 		}
 		setFlags((mode & IO_ModeMask)|IO_Open);
 #endif
@@ -214,9 +266,15 @@ void QBZip2Device::close()
 		}
 		else
 		{
-			if(isReadable())
+			if(isReadable() && !p->inEnded)
 				FXERRHBZ2(BZ2_bzDecompressEnd(&p->inh));
-			if(isWriteable())
+			if(isWriteable() && p->pc)
+			{
+				FXPtrHold<QIODevice_ParallelCompressor> pc(p->pc);
+				p->pc=0;
+				pc->finish();
+			}
+			else if(isWriteable())
 			{
 				int ret;
 				char outbuffer[16384];
@@ -240,7 +298,28 @@ void QBZip2Device::flush()
 {
 #ifdef HAVE_BZ2LIB_H
 	QMtxHold h(p);
-	if(isOpen() && isWriteable() && p->enableSeeking)
+	if(isOpen() && isWriteable() && p->pc)
+		p->pc->flush();
+	if(isOpen() && isWriteable() && p->enableSeeking && p->parallel)
+	{
+		FXuchar *data=p->uncomp.buffer().data();
+		FXuval datalen=p->uncomp.buffer().size();
+		p->src->at(0);
+		QIODevice_ParallelCompressor pc(p->src, bz2CompressStream, p->compression, p->parallel);
+		if(isTranslated())
+		{
+			FXuchar buffer[4096];
+			for(FXuval idx=0, in; idx<datalen; idx+=in)
+			{
+				in=datalen-idx;
+				pc.write(buffer, applyCRLF(buffer, data+idx, sizeof(buffer), in, crlfFormat(), unicodeTranslation()));
+			}
+		}
+		else pc.write(data, datalen);
+		pc.finish();
+		p->src->truncate(p->src->at());
+	}
+	else if(isOpen() && isWriteable() && p->enableSeeking)
 	{
 		char *data=(char *) p->uncomp.buffer().data();
 		FXuval datalen=p->uncomp.buffer().size();
@@ -366,17 +445,21 @@ FXuval QBZip2Device::readBlock(char *data, FXuval maxlen)
 	if(p->enableSeeking)
 		return p->uncomp.readBlock(data, maxlen);
 	int ret;
-	p->inh.next_out=data;
-	p->inh.avail_out=(FXuint)maxlen;
-	do
+	FXuval read=0;
+	while(!p->inEnded && read<maxlen)
 	{
+		p->inh.next_out=data+read;
+		p->inh.avail_out=(FXuint)(maxlen-read);
 		p->inh.next_in=p->inbuffer;
 		p->inh.avail_in+=(FXuint)p->src->readBlock(p->inbuffer+p->inh.avail_in, sizeof(p->inbuffer)-p->inh.avail_in);
 		FXERRHBZ2(ret=BZ2_bzDecompress(&p->inh));
 		memmove(p->inbuffer, p->inh.next_in, p->inh.avail_in);
-	} while(BZ_STREAM_END!=ret && p->inh.avail_out);
-	ioIndex+=maxlen-p->inh.avail_out;
-	return maxlen-p->inh.avail_out;
+		read=p->inh.next_out-data;
+		// Concatenated streams (eg; from parallel compression) follow on
+		if(BZ_STREAM_END==ret) p->nextInStream();
+	}
+	ioIndex+=read;
+	return read;
 #else
 	return 0;
 #endif
@@ -388,6 +471,11 @@ FXuval QBZip2Device::writeBlock(const char *data, FXuval maxlen)
 	QMtxHold h(p);
 	if(p->enableSeeking)
 		return p->uncomp.writeBlock(data, maxlen);
+	if(p->pc)
+	{
+		ioIndex+=maxlen;
+		return p->pc->write((const FXuchar *) data, maxlen);
+	}
 	int ret;
 	char outbuffer[16384];
 	p->outh.next_in=(char *) data;
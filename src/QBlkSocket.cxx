@@ -151,11 +151,22 @@ static const char *decodeWinsockErr(int code)
 #endif
 
 #define FXERRHSKT(exp) { int __res=(exp); if(__res<0) { \
-	if(EPIPE==errno) \
+	if(EPIPE==errno || ECONNRESET==errno) \
 		{ FXERRGCONLOST("Connection Lost", 0); } \
 	else { FXERRGIO(strerror(errno)); } } }
 #endif
 #include "tnfxselect.h"
+#ifdef __linux__
+#include <poll.h>
+#include <netinet/udp.h>
+#define HAVE_MMSG
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
 
 #include "FXMemDbg.h"
 #if defined(DEBUG) && !defined(FXMEMDBG_DISABLE)
@@ -201,7 +212,7 @@ FXProcess_StaticInit<QBlkSocket_SocketInit> mystaticinit("QBlkSocket");
 struct FXDLLLOCAL QBlkSocketPrivate : public QMutex
 {
 	QBlkSocket::Type type;
-	bool unique, amServer, connected, monitoring;
+	bool unique, amServer, connected, monitoring, blocking, coalescing;
 	FXint maxPending;
 	struct Req_t
 	{
@@ -226,7 +237,7 @@ struct FXDLLLOCAL QBlkSocketPrivate : public QMutex
 	int handle;
 #endif
 	QBlkSocketPrivate(QBlkSocket::Type _type, FXushort port) : type(_type), unique(false), amServer(false),
-		connected(false), monitoring(false), maxPending(50), handle(0), QMutex()
+		connected(false), monitoring(false), blocking(true), coalescing(false), maxPending(50), handle(0), QMutex()
 	{
 		req.port=port; mine.port=0; peer.port=0;
 #ifdef USE_WINAPI
@@ -235,7 +246,7 @@ struct FXDLLLOCAL QBlkSocketPrivate : public QMutex
 #endif
 	}
 	QBlkSocketPrivate(const QBlkSocketPrivate &o, int h) : type(o.type), unique(o.unique), amServer(o.amServer),
-		connected(o.connected), monitoring(o.monitoring), maxPending(o.maxPending), handle(h), req(o.req), mine(o.mine), QMutex()
+		connected(o.connected), monitoring(o.monitoring), blocking(true), coalescing(false), maxPending(o.maxPending), handle(h), req(o.req), mine(o.mine), QMutex()
 	{
 		peer.port=0;
 #ifdef USE_WINAPI
@@ -255,6 +266,18 @@ void *QBlkSocket::int_getOSHandle() const
 #endif
 }
 
+int QBlkSocket::int_transferHandle(bool write)
+{
+#ifdef USE_POSIX
+	QMtxHold h(p);
+	if(!isOpen() || Stream!=p->type) return -1;
+	if(write ? !isWriteable() : !QIODevice::isReadable()) return -1;
+	return p->handle;
+#else
+	return -1;
+#endif
+}
+
 QBlkSocket::QBlkSocket(QBlkSocket::Type type, FXushort port) : p(0), QIODeviceS()
 {
 	FXRBOp unconstr=FXRBConstruct(this);
@@ -535,6 +558,22 @@ void QBlkSocket::setLingerPeriod(FXint period)
 	}
 }
 
+bool QBlkSocket::blocking() const
+{
+	QMtxHold h(p);
+	return p->blocking;
+}
+
+void QBlkSocket::setBlocking(bool newb)
+{
+	QMtxHold h(p);
+#ifdef USE_WINAPI
+	FXERRH(newb, "Non-blocking sockets are not supported on Windows", 0, FXERRH_ISDEBUG);
+#endif
+	p->blocking=newb;
+	if(isOpen()) applyBlocking();
+}
+
 bool QBlkSocket::usingNagles() const
 {
 	QMtxHold h(p);
@@ -631,6 +670,14 @@ void QBlkSocket::fillInAddrs(bool incPeer)
 	}
 }
 
+#ifdef USE_POSIX
+// A non-blocking socket which would have had to wait instead fails with EAGAIN
+static inline bool wouldHaveBlocked(FXuval ret)
+{
+	return (FXuval)-1==ret && (EAGAIN==errno || EWOULDBLOCK==errno);
+}
+#endif
+
 void QBlkSocket::zeroAddrs()
 {
 	p->mine.addr=p->peer.addr=QHostAddress();
@@ -646,6 +693,15 @@ void QBlkSocket::setupSocket()
 #endif
 }
 
+void QBlkSocket::applyBlocking()
+{
+#ifdef USE_POSIX
+	int fl=::fcntl(p->handle, F_GETFL, 0);
+	FXERRHOS(fl);
+	FXERRHOS(::fcntl(p->handle, F_SETFL, (p->blocking) ? fl & ~O_NONBLOCK : fl|O_NONBLOCK));
+#endif
+}
+
 bool QBlkSocket::create(FXuint mode)
 {
 	QMtxHold h(p);
@@ -679,6 +735,7 @@ bool QBlkSocket::create(FXuint mode)
 		FXERRHSKT(::listen(p->handle, p->maxPending));
 	}
 	fillInAddrs(false);
+	if(!p->blocking) applyBlocking();
 	p->amServer=true;
 	p->connected=false;
 	setFlags((mode & IO_ModeMask)|IO_Open);
@@ -725,6 +782,7 @@ bool QBlkSocket::open(FXuint mode)
 			FXERRHSKT(ret);
 			fillInAddrs(true);
 		}
+		if(!p->blocking) applyBlocking();
 		p->amServer=false;
 		p->connected=true;
 #ifdef USE_WINAPI
@@ -768,6 +826,7 @@ void QBlkSocket::close()
 			p->handle=0;
 			h.relock();
 		}
+		p->coalescing=false;
 #ifdef USE_WINAPI
 		if(p->olr.hEvent)
 		{
@@ -897,10 +956,13 @@ FXuval QBlkSocket::readBlock(char *data, FXuval maxlen)
 #if defined(__APPLE__)
 			// Mac OS X has such inconsistent thread cancellation support :(
 			// 10.5 is much improved, but sockets still won't cancel
-			fd_set fds;
-			FD_ZERO(&fds);
-			FD_SET(p->handle, &fds);
-			tnfxselect(p->handle+1, &fds, 0, 0, NULL);
+			if(p->blocking)
+			{
+				fd_set fds;
+				FD_ZERO(&fds);
+				FD_SET(p->handle, &fds);
+				tnfxselect(p->handle+1, &fds, 0, 0, NULL);
+			}
 #endif
 			/* 31st Jan 2005 ned: Finally fixed segfault on Linux 2.6 kernels when
 			library was being using dynamically. For some odd reason it doesn't like
@@ -908,6 +970,11 @@ FXuval QBlkSocket::readBlock(char *data, FXuval maxlen)
 			read() which FreeBSD needed anyway */
 			readed=::read(p->handle, data, maxlen);
 			//h.relock();
+			if(!p->blocking)
+			{	// Nothing waiting must be distinguishable from the other end closing
+				if(wouldHaveBlocked(readed)) return 0;
+				if(!readed) FXERRGCONLOST("Connection closed", 0);
+			}
 		}
 		else if(Datagram==p->type)
 		{
@@ -916,12 +983,16 @@ FXuval QBlkSocket::readBlock(char *data, FXuval maxlen)
 #ifdef __FreeBSD__
 			// Unfortunately recvfrom is not a thread cancellation point on FreeBSD, so
 			// we use select() to do it for us
-			fd_set fds;
-			FD_ZERO(&fds);
-			FD_SET(p->handle, &fds);
-			::select(p->handle+1, &fds, 0, 0, NULL);
+			if(p->blocking)
+			{
+				fd_set fds;
+				FD_ZERO(&fds);
+				FD_SET(p->handle, &fds);
+				::select(p->handle+1, &fds, 0, 0, NULL);
+			}
 #endif
 			readed=::recvfrom(p->handle, data, maxlen, 0, (sockaddr *) &sa6, &salen);
+			if(!p->blocking && wouldHaveBlocked(readed)) return 0;
 			h.relock();
 			if((FXuval)-1!=readed)
 				readSockAddr(p->peer.addr, p->peer.port, &sa6);
@@ -1008,6 +1079,7 @@ FXuval QBlkSocket::writeBlock(const char *data, FXuval maxlen)
 				sa, salen);
 		}
 		h.relock();
+		if(!p->blocking && wouldHaveBlocked(written)) written=0;
 		FXERRHSKT(written);
 		if(QIODeviceS_SignalHandler::unlockWrite())		// Nasty this
 			FXERRGCONLOST("Broken socket", 0);
@@ -1094,6 +1166,7 @@ FXuval QBlkSocket::writeBlock(const char *data, FXuval maxlen, const QHostAddres
 							 sa, salen);
 		}
 		h.relock();
+		if(!p->blocking && wouldHaveBlocked(written)) written=0;
 		FXERRHSKT(written);
 		if(QIODeviceS_SignalHandler::unlockWrite())		// Nasty this
 			FXERRGCONLOST("Broken socket", 0);
@@ -1104,6 +1177,414 @@ FXuval QBlkSocket::writeBlock(const char *data, FXuval maxlen, const QHostAddres
 	return 0;
 }
 
+FXuval QBlkSocket::readBlockV(const IOVec *segs, FXuint count)
+{
+#ifdef USE_POSIX
+	QMtxHold h(p);
+	if(!QIODevice::isReadable()) FXERRGIO(QTrans::tr("QBlkSocket", "Not open for reading"));
+	if(isOpen())
+	{
+		FXuval readed=(FXuval) -1;
+		if(Datagram==p->type && count>64) FXERRGIO(QTrans::tr("QBlkSocket", "Too many segments for one datagram"));
+		h.unlock();
+		if(Stream==p->type)
+		{
+#if defined(__APPLE__)
+			if(p->blocking)
+			{
+				fd_set fds;
+				FD_ZERO(&fds);
+				FD_SET(p->handle, &fds);
+				tnfxselect(p->handle+1, &fds, 0, 0, NULL);
+			}
+#endif
+			readed=int_vectoredIO(p->handle, segs, count, false);
+			if(!p->blocking)
+			{
+				if(wouldHaveBlocked(readed)) return 0;
+				if(!readed) FXERRGCONLOST("Connection closed", 0);
+			}
+		}
+		else if(Datagram==p->type)
+		{
+			sockaddr_in6 sa6={0};
+			struct iovec iov[64];
+			struct msghdr msg={0};
+			for(FXuint n=0; n<count; n++)
+			{
+				iov[n].iov_base=segs[n].data;
+				iov[n].iov_len=segs[n].len;
+			}
+			msg.msg_name=&sa6;
+			msg.msg_namelen=sizeof(sa6);
+			msg.msg_iov=iov;
+			msg.msg_iovlen=count;
+#ifdef __FreeBSD__
+			if(p->blocking)
+			{
+				fd_set fds;
+				FD_ZERO(&fds);
+				FD_SET(p->handle, &fds);
+				::select(p->handle+1, &fds, 0, 0, NULL);
+			}
+#endif
+			readed=::recvmsg(p->handle, &msg, 0);
+			if(!p->blocking && wouldHaveBlocked(readed)) return 0;
+			h.relock();
+			if((FXuval)-1!=readed)
+				readSockAddr(p->peer.addr, p->peer.port, &sa6);
+		}
+		FXERRHSKT(readed);
+		return readed;
+	}
+	return 0;
+#else
+	return QIODevice::readBlockV(segs, count);
+#endif
+}
+
+FXuval QBlkSocket::writeBlockV(const IOVec *segs, FXuint count)
+{
+#ifdef USE_POSIX
+	QMtxHold h(p);
+	if(!isWriteable()) FXERRGIO(QTrans::tr("QBlkSocket", "Not open for writing"));
+	if(isOpen())
+	{
+		FXuval written=(FXuval) -1;
+		if(Datagram==p->type && count>64) FXERRGIO(QTrans::tr("QBlkSocket", "Too many segments for one datagram"));
+		QIODeviceS_SignalHandler::lockWrite();
+		h.unlock();
+		if(Stream==p->type)
+			written=int_vectoredIO(p->handle, segs, count, true);
+		else if(Datagram==p->type)
+		{
+			sockaddr_in6 sa6={0};
+			int salen;
+			struct iovec iov[64];
+			struct msghdr msg={0};
+			for(FXuint n=0; n<count; n++)
+			{
+				iov[n].iov_base=segs[n].data;
+				iov[n].iov_len=segs[n].len;
+			}
+			msg.msg_name=makeSockAddr(salen, sa6, p->req.addr, p->req.port);
+			msg.msg_namelen=salen;
+			msg.msg_iov=iov;
+			msg.msg_iovlen=count;
+			written=::sendmsg(p->handle, &msg,
+#ifdef __linux__
+				MSG_NOSIGNAL
+#else
+				0
+#endif
+				);
+		}
+		h.relock();
+		if(!p->blocking && wouldHaveBlocked(written)) written=0;
+		FXERRHSKT(written);
+		if(QIODeviceS_SignalHandler::unlockWrite())		// Nasty this
+			FXERRGCONLOST("Broken socket", 0);
+		if(isRaw()) flush();
+		return written;
+	}
+	return 0;
+#else
+	return QIODevice::writeBlockV(segs, count);
+#endif
+}
+
+bool QBlkSocket::receiveCoalescing() const
+{
+	QMtxHold h(p);
+	return p->coalescing;
+}
+
+bool QBlkSocket::setReceiveCoalescing(bool newb)
+{
+	QMtxHold h(p);
+	FXERRH(Datagram==p->type, QTrans::tr("QBlkSocket", "Not a datagram socket"), 0, FXERRH_ISDEBUG);
+	if(isOpen())
+	{
+#ifdef __linux__
+		int val=(int) newb;
+		if(::setsockopt(p->handle, IPPROTO_UDP, UDP_GRO, (char *) &val, sizeof(val))<0)
+		{	// Kernels before 5.0 don't have it
+			if(ENOPROTOOPT!=errno) FXERRHSKT(-1);
+			newb=false;
+		}
+		p->coalescing=newb;
+#endif
+	}
+	return p->coalescing;
+}
+
+#ifdef USE_POSIX
+#ifndef HAVE_MMSG
+// Emulate the batch calls one datagram at a time
+struct mmsghdr
+{
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+};
+#define MSG_WAITFORONE 0
+static int sendmmsg(int fd, struct mmsghdr *msgs, unsigned int vlen, int flags)
+{
+	unsigned int n;
+	for(n=0; n<vlen; n++)
+	{
+		ssize_t ret=::sendmsg(fd, &msgs[n].msg_hdr, flags);
+		if(ret<0) return n ? (int) n : -1;
+		msgs[n].msg_len=(unsigned int) ret;
+	}
+	return (int) n;
+}
+static int recvmmsg(int fd, struct mmsghdr *msgs, unsigned int vlen, int flags, struct timespec *)
+{
+	unsigned int n;
+	for(n=0; n<vlen; n++)
+	{	// Only the first may wait
+		ssize_t ret=::recvmsg(fd, &msgs[n].msg_hdr, n ? flags|MSG_DONTWAIT : flags);
+		if(ret<0) return n ? (int) n : -1;
+		msgs[n].msg_len=(unsigned int) ret;
+	}
+	return (int) n;
+}
+#endif
+static int segmentationOffload=0;	// 1 if the kernel does UDP_SEGMENT, -1 if not, 0 if unknown
+#endif
+
+bool QBlkSocket::hasSegmentationOffload() const
+{
+	QMtxHold h(p);
+#ifdef __linux__
+	if(!segmentationOffload && isOpen() && Datagram==p->type)
+	{
+		int val=0;
+		socklen_t valsize=sizeof(val);
+		segmentationOffload=(::getsockopt(p->handle, IPPROTO_UDP, UDP_SEGMENT, (char *) &val, &valsize)<0) ? -1 : 1;
+	}
+	return segmentationOffload>0;
+#else
+	return false;
+#endif
+}
+
+FXuint QBlkSocket::readDatagrams(Packet *pkts, FXuint count)
+{
+	QMtxHold h(p);
+	if(Datagram!=p->type) FXERRGIO(QTrans::tr("QBlkSocket", "Not a datagram socket"));
+	if(!QIODevice::isReadable()) FXERRGIO(QTrans::tr("QBlkSocket", "Not open for reading"));
+	if(!isOpen() || !count) return 0;
+#ifdef USE_POSIX
+	const FXuint batch=64;
+	struct mmsghdr msgs[batch];
+	struct iovec iovs[batch];
+	sockaddr_in6 addrs[batch];
+	union
+	{
+		struct cmsghdr align;
+		char buffer[CMSG_SPACE(sizeof(int))];
+	} cmsgs[batch];
+	bool coalescing=p->coalescing;
+	FXuint done=0;
+	h.unlock();
+	while(done<count)
+	{
+		FXuint no=FXMIN(count-done, batch);
+		memset(msgs, 0, no*sizeof(struct mmsghdr));
+		for(FXuint n=0; n<no; n++)
+		{
+			QBlkSocket::Packet &d=pkts[done+n];
+			iovs[n].iov_base=d.data;
+			iovs[n].iov_len=d.len;
+			struct msghdr &msg=msgs[n].msg_hdr;
+			msg.msg_name=&addrs[n];
+			msg.msg_namelen=sizeof(sockaddr_in6);
+			msg.msg_iov=&iovs[n];
+			msg.msg_iovlen=1;
+			if(coalescing)
+			{
+				msg.msg_control=cmsgs[n].buffer;
+				msg.msg_controllen=sizeof(cmsgs[n].buffer);
+			}
+		}
+#ifdef __FreeBSD__
+		if(p->blocking && !done)
+		{
+			fd_set fds;
+			FD_ZERO(&fds);
+			FD_SET(p->handle, &fds);
+			::select(p->handle+1, &fds, 0, 0, NULL);
+		}
+#endif
+		// Wait for the first datagram only, then take whatever else is already there
+		int ret=::recvmmsg(p->handle, msgs, no, done ? MSG_DONTWAIT : MSG_WAITFORONE, 0);
+		if(ret<0)
+		{
+			if(EINTR==errno && !done) continue;
+			if(done || (!p->blocking && wouldHaveBlocked((FXuval) -1))) break;
+			h.relock();
+			FXERRHSKT(ret);
+		}
+		for(int n=0; n<ret; n++)
+		{
+			QBlkSocket::Packet &d=pkts[done+n];
+			d.len=msgs[n].msg_len;
+			d.truncated=(msgs[n].msg_hdr.msg_flags & MSG_TRUNC)!=0;
+			d.segmentSize=0;
+			readSockAddr(d.addr, d.port, &addrs[n]);
+#ifdef __linux__
+			for(struct cmsghdr *cmsg=coalescing ? CMSG_FIRSTHDR(&msgs[n].msg_hdr) : 0; cmsg; cmsg=CMSG_NXTHDR(&msgs[n].msg_hdr, cmsg))
+			{
+				if(IPPROTO_UDP==cmsg->cmsg_level && UDP_GRO==cmsg->cmsg_type)
+				{
+					int segsize;
+					memcpy(&segsize, CMSG_DATA(cmsg), sizeof(segsize));
+					if((FXuval) segsize<d.len) d.segmentSize=segsize;
+				}
+			}
+#endif
+		}
+		done+=ret;
+		if((FXuint) ret<no) break;
+	}
+	h.relock();
+	if(done)
+	{
+		p->peer.addr=pkts[done-1].addr;
+		p->peer.port=pkts[done-1].port;
+	}
+	return done;
+#else
+	FXuint done;
+	for(done=0; done<count; done++)
+	{	// No batching available, so do one at a time
+		QBlkSocket::Packet &d=pkts[done];
+		if(done && !size()) break;
+		d.len=readBlock(d.data, d.len);
+		d.truncated=false;
+		d.segmentSize=0;
+		d.addr=p->peer.addr;
+		d.port=p->peer.port;
+	}
+	return done;
+#endif
+}
+
+FXuint QBlkSocket::writeDatagrams(const Packet *pkts, FXuint count)
+{
+	QMtxHold h(p);
+	if(Datagram!=p->type) FXERRGIO(QTrans::tr("QBlkSocket", "Not a datagram socket"));
+	if(!isWriteable()) FXERRGIO(QTrans::tr("QBlkSocket", "Not open for writing"));
+	if(!isOpen()) return 0;
+#ifdef USE_POSIX
+	const FXuint batch=64;
+	struct mmsghdr msgs[batch];
+	struct iovec iovs[batch];
+	sockaddr_in6 addrs[batch];
+	union
+	{
+		struct cmsghdr align;
+		char buffer[CMSG_SPACE(sizeof(FXushort))];
+	} cmsgs[batch];
+	FXuint owner[batch];
+	FXuval ends[batch];
+	bool gso=hasSegmentationOffload();
+	QHostAddress reqaddr(p->req.addr);
+	FXushort reqport=p->req.port;
+	FXuint done=0;
+	FXuval offset=0;		// How much of pkts[done] has been sent
+	QIODeviceS_SignalHandler::lockWrite();
+	h.unlock();
+	while(done<count)
+	{	// Fill a batch, splitting datagrams with a segment size either for the kernel or ourselves
+		FXuint no=0, idx=done;
+		FXuval off=offset;
+		memset(msgs, 0, sizeof(msgs));
+		while(no<batch && idx<count)
+		{
+			const QBlkSocket::Packet &d=pkts[idx];
+			FXuval len=d.len-off;
+			struct msghdr &msg=msgs[no].msg_hdr;
+			if(d.segmentSize && d.segmentSize<len)
+			{
+				if(gso)
+				{	// The kernel takes up to 64 segments of no more than 64Kb in total
+					FXuval segs=FXMIN((FXuval) 64, 65507/d.segmentSize);
+					if(!segs) segs=1;
+					len=FXMIN(len, segs*d.segmentSize);
+					if(len>d.segmentSize)
+					{
+						FXushort segsize=(FXushort) d.segmentSize;
+						msg.msg_control=cmsgs[no].buffer;
+						msg.msg_controllen=CMSG_SPACE(sizeof(segsize));
+						struct cmsghdr *cmsg=CMSG_FIRSTHDR(&msg);
+						cmsg->cmsg_level=IPPROTO_UDP;
+						cmsg->cmsg_type=UDP_SEGMENT;
+						cmsg->cmsg_len=CMSG_LEN(sizeof(segsize));
+						memcpy(CMSG_DATA(cmsg), &segsize, sizeof(segsize));
+					}
+				}
+				else
+					len=d.segmentSize;
+			}
+			int salen;
+			iovs[no].iov_base=(char *) d.data+off;
+			iovs[no].iov_len=len;
+			msg.msg_name=makeSockAddr(salen, addrs[no], d.addr.isNull() ? reqaddr : d.addr, d.addr.isNull() ? reqport : d.port);
+			msg.msg_namelen=salen;
+			msg.msg_iov=&iovs[no];
+			msg.msg_iovlen=1;
+			owner[no]=idx;
+			ends[no]=(off+=len);
+			no++;
+			if(off>=d.len) { idx++; off=0; }
+		}
+		int ret=::sendmmsg(p->handle, msgs, no,
+#ifdef __linux__
+			MSG_NOSIGNAL
+#else
+			0
+#endif
+			);
+		if(ret<0)
+		{
+			if(EINTR==errno) continue;
+			if(!p->blocking && wouldHaveBlocked((FXuval) -1)) break;
+			h.relock();
+			FXERRHSKT(ret);
+		}
+		for(int n=0; n<ret; n++)
+		{
+			done=owner[n];
+			offset=ends[n];
+			if(offset>=pkts[done].len) { done++; offset=0; }
+		}
+	}
+	h.relock();
+	if(QIODeviceS_SignalHandler::unlockWrite())		// Nasty this
+		FXERRGCONLOST("Broken socket", 0);
+	return done;
+#else
+	FXuint done;
+	for(done=0; done<count; done++)
+	{	// No batching available, so do one at a time
+		const QBlkSocket::Packet &d=pkts[done];
+		FXuval segsize=d.segmentSize ? d.segmentSize : d.len, off=0;
+		do
+		{
+			FXuval len=FXMIN(segsize, d.len-off);
+			if(d.addr.isNull())
+				writeBlock(d.data+off, len);
+			else
+				writeBlock(d.data+off, len, d.addr, d.port);
+			off+=len;
+		} while(off<d.len);
+	}
+	return done;
+#endif
+}
+
 int QBlkSocket::ungetch(int c)
 {
 	return -1;
@@ -1202,11 +1683,24 @@ QBlkSocket *QBlkSocket::waitForConnection(FXuint waitfor)
 		_tv.tv_usec=(waitfor % 1000)*1000;
 		tv=&_tv;
 	}
-	fd_set fds;
-	FD_ZERO(&fds);
-	FD_SET(p->handle, &fds);
-	if(!tnfxselect(p->handle+1, &fds, 0, 0, tv)) return 0;
+	if(p->blocking)
+	{
+#ifdef __linux__
+		// poll() has no limit on how big the handle can be, unlike select()
+		struct pollfd pfd;
+		pfd.fd=p->handle;
+		pfd.events=POLLIN;
+		pfd.revents=0;
+		if(!::poll(&pfd, 1, (waitfor==FXINFINITE) ? -1 : (int) waitfor)) return 0;
+#else
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(p->handle, &fds);
+		if(!tnfxselect(p->handle+1, &fds, 0, 0, tv)) return 0;
+#endif
+	}
 	int newskt=::accept(p->handle, (sockaddr *) sa6addr, &salen);
+	if(!p->blocking && wouldHaveBlocked((FXuval)(FXival) newskt)) return 0;
 	h.relock();
 	FXERRHSKT(newskt);
 	FXAutoPtr<QBlkSocket> ret;
@@ -20,6 +20,7 @@
 ********************************************************************************/
 
 #include <qcstring.h>
+#include <qmemarray.h>
 #include "QBuffer.h"
 #include "FXException.h"
 #include "QThread.h"
@@ -33,12 +34,101 @@ static const char *_fxmemdbg_current_file_ = __FILE__;
 
 namespace FX {
 
+// Keeps freed segments for reuse so building and discarding buffers doesn't hit the heap
+class QBufferSegmentPool : public QMutex
+{
+	QMemArray<char *> spare;
+public:
+	enum { MaxSpare=256 };		// 16Mb
+	~QBufferSegmentPool()
+	{
+		for(FXuval n=0; n<spare.size(); n++)
+			free(spare.at(n));
+	}
+	char *get()
+	{
+		{
+			QMtxHold h(this);
+			if(!spare.empty())
+			{
+				char *ret=spare.at(spare.size()-1);
+				spare.truncate(spare.size()-1);
+				return ret;
+			}
+		}
+		char *ret;
+		FXERRHM(ret=(char *) malloc(QBuffer::SegmentSize));
+		return ret;
+	}
+	void put(char *seg)
+	{
+		QMtxHold h(this);
+		if(spare.size()<MaxSpare)
+			spare.push_back(seg);
+		else
+			free(seg);
+	}
+};
+static QBufferSegmentPool &segmentPool()
+{
+	static QBufferSegmentPool pool;
+	return pool;
+}
+
 struct FXDLLLOCAL QBufferPrivate : public QMutex
 {
 	bool mine;
 	QByteArray *buffer;
 	char *fastbuffer;
-	QBufferPrivate() : mine(false), buffer(0), fastbuffer(0), QMutex() { }
+	bool segmented;
+	QMemArray<char *> segs;		// When segmented, each is SegmentSize long
+	FXfval seglen;
+	QByteArray linear;			// Returned by linearize() when contents span segments
+	QBufferPrivate() : mine(false), buffer(0), fastbuffer(0), segmented(false), seglen(0), QMutex() { }
+	~QBufferPrivate()
+	{
+		freeSegments(0);
+	}
+	// Returns segments beyond what's needed to hold len bytes to the pool
+	void freeSegments(FXfval len)
+	{
+		FXuval keep=(FXuval)((len+QBuffer::SegmentSize-1)/QBuffer::SegmentSize);
+		for(FXuval n=keep; n<segs.size(); n++)
+			segmentPool().put(segs.at(n));
+		if(keep<segs.size()) segs.truncate(keep);
+	}
+	// Extends the chain to hold len bytes, zeroing anything between seglen and from
+	void extendSegments(FXfval from, FXfval len)
+	{
+		while((FXfval) segs.size()*QBuffer::SegmentSize<len)
+		{
+			char *seg=segmentPool().get();
+			FXRBOp unseg=FXRBObj(segmentPool(), &QBufferSegmentPool::put, seg);
+			segs.push_back(seg);
+			unseg.dismiss();
+		}
+		for(FXfval idx=seglen; idx<from;)
+		{
+			FXuval offset=(FXuval)(idx % QBuffer::SegmentSize), todo=(FXuval) FXMIN(from-idx, (FXfval)(QBuffer::SegmentSize-offset));
+			memset(segs.at((FXuval)(idx/QBuffer::SegmentSize))+offset, 0, todo);
+			idx+=todo;
+		}
+	}
+	// Copies between the segments and data, reading if write is false
+	void copySegments(FXfval pos, char *data, FXuval len, bool write)
+	{
+		while(len)
+		{
+			FXuval offset=(FXuval)(pos % QBuffer::SegmentSize), todo=FXMIN(len, QBuffer::SegmentSize-offset);
+			char *seg=segs.at((FXuval)(pos/QBuffer::SegmentSize))+offset;
+			if(write) memcpy(seg, data, todo); else memcpy(data, seg, todo);
+			pos+=todo; data+=todo; len-=todo;
+		}
+	}
+	FXfval size() const
+	{
+		return segmented ? seglen : buffer->size();
+	}
 	void resizeFastbuffer(FXuval newsize)
 	{
 		if(fastbuffer)
@@ -88,6 +178,7 @@ QBuffer::~QBuffer()
 	{
 		close();
 		if(p->mine) FXDELETE(p->buffer);
+		p->freeSegments(0);
 		if(p->fastbuffer)
 		{
 			free(p->fastbuffer);
@@ -99,14 +190,16 @@ QBuffer::~QBuffer()
 
 bool QBuffer::isNull() const
 {
-	return !p->buffer;
+	return !p->buffer && !p->segmented;
 }
 
 QByteArray &QBuffer::buffer() const
 {
-	if(!p->buffer)
+	if(!p->buffer || p->segmented)
 	{
 		QMtxHold h(p);
+		if(p->segmented)
+			const_cast<QBuffer *>(this)->setSegmented(false);
 		if(!p->buffer)
 		{
 			FXERRHM(p->buffer=new QByteArray);
@@ -116,9 +209,91 @@ QByteArray &QBuffer::buffer() const
 	return *p->buffer;
 }
 
+bool QBuffer::isSegmented() const
+{
+	return p->segmented;
+}
+
+void QBuffer::setSegmented(bool v)
+{
+	QMtxHold h(p);
+	if(v==p->segmented) return;
+	if(v)
+	{	// Copy the contents out into segments
+		FXfval len=p->buffer ? p->buffer->size() : 0;
+		p->seglen=0;
+		p->extendSegments(0, len);
+		if(len) p->copySegments(0, (char *) p->buffer->data(), (FXuval) len, true);
+		p->seglen=len;
+		p->segmented=true;
+		if(p->mine)
+		{
+			FXDELETE(p->buffer);
+			if(p->fastbuffer)
+			{
+				free(p->fastbuffer);
+				p->fastbuffer=0;
+			}
+			p->mine=false;
+		}
+	}
+	else
+	{	// Copy the contents back into one array
+		if(!p->buffer)
+		{
+			FXERRHM(p->buffer=new QByteArray);
+			p->mine=true;
+		}
+		FXERRH(p->seglen<((FXuint)-1), "Cannot linearise a buffer larger than a FXuint", QBUFFER_FILETOOBIG, FXERRH_ISDEBUG);
+		p->buffer->resize((FXuint) p->seglen);
+		if(p->seglen) p->copySegments(0, (char *) p->buffer->data(), (FXuval) p->seglen, false);
+		p->segmented=false;
+		p->freeSegments(p->seglen=0);
+		p->linear.resize(0);
+	}
+}
+
+const char *QBuffer::linearize()
+{
+	QMtxHold h(p);
+	if(!p->segmented) return (const char *) buffer().data();
+	if(p->seglen<=SegmentSize) return p->segs.empty() ? "" : p->segs.at(0);
+	FXERRH(p->seglen<((FXuint)-1), "Cannot linearise a buffer larger than a FXuint", QBUFFER_FILETOOBIG, FXERRH_ISDEBUG);
+	p->linear.resize((FXuint) p->seglen);
+	p->copySegments(0, (char *) p->linear.data(), (FXuval) p->seglen, false);
+	return (const char *) p->linear.data();
+}
+
+FXuint QBuffer::segments(IOVec *segs, FXuint count, FXfval offset) const
+{
+	QMtxHold h(p);
+	FXfval len=isNull() ? 0 : p->size();
+	if(offset>=len) return 0;
+	if(!p->segmented)
+	{
+		if(segs && count) segs[0]=IOVec((char *) p->buffer->data()+offset, (FXuval)(len-offset));
+		return 1;
+	}
+	FXuint n=0;
+	for(FXfval idx=offset; idx<len; n++)
+	{
+		FXuval segoffset=(FXuval)(idx % SegmentSize), todo=(FXuval) FXMIN(len-idx, (FXfval)(SegmentSize-segoffset));
+		if(segs)
+		{
+			if(n>=count) break;
+			segs[n]=IOVec(p->segs.at((FXuval)(idx/SegmentSize))+segoffset, todo);
+		}
+		idx+=todo;
+	}
+	return n;
+}
+
 void QBuffer::setBuffer(QByteArray &buffer)
 {
 	QMtxHold h(p);
+	p->segmented=false;
+	p->freeSegments(p->seglen=0);
+	p->linear.resize(0);
 	if(p->mine) FXDELETE(p->buffer);
 	if(p->fastbuffer)
 	{
@@ -139,7 +314,7 @@ bool QBuffer::open(FXuint mode)
 	}
 	else
 	{
-		if(!p->buffer)
+		if(!p->buffer && !p->segmented)
 		{
 			if(!(mode & IO_WriteOnly))
 			{
@@ -150,11 +325,16 @@ bool QBuffer::open(FXuint mode)
 		}
 		if(mode & IO_Truncate)
 		{
-			p->buffer->resize(0);
-			p->resizeFastbuffer(0);
+			if(p->segmented)
+				p->freeSegments(p->seglen=0);
+			else
+			{
+				p->buffer->resize(0);
+				p->resizeFastbuffer(0);
+			}
 		}
 		setFlags((mode & IO_ModeMask)|IO_Open);
-		ioIndex=(mode & IO_Append) ? p->buffer->size() : 0;
+		ioIndex=(mode & IO_Append) ? p->size() : 0;
 	}
 	return true;
 }
@@ -176,7 +356,7 @@ void QBuffer::flush()
 FXfval QBuffer::size() const
 {
 	// QMtxHold h(p);	can do without
-	return p->buffer->size();
+	return p->size();
 }
 
 void QBuffer::truncate(FXfval size)
@@ -185,10 +365,18 @@ void QBuffer::truncate(FXfval size)
 	if(!isWriteable()) FXERRGIO(QTrans::tr("QBuffer", "Not open for writing"));
 	if(isOpen())
 	{
-		if((mode() & IO_ShredTruncate) && size<p->buffer->size())
+		if((mode() & IO_ShredTruncate) && size<p->size())
 			shredData(size);
 		if(ioIndex>size) at(size);
-		if(p->fastbuffer)
+		if(p->segmented)
+		{
+			if(size>p->seglen)
+				p->extendSegments(size, size);
+			else
+				p->freeSegments(size);
+			p->seglen=size;
+		}
+		else if(p->fastbuffer)
 			p->resizeFastbuffer((FXuval) size);
 		else
 			p->buffer->truncate((FXuint) size);
@@ -199,11 +387,14 @@ FXuval QBuffer::readBlock(char *data, FXuval maxlen)
 {
 	QMtxHold h(p);
 	if(!isReadable()) FXERRGIO(QTrans::tr("QBuffer", "Not open for reading"));
-	if(isOpen() && ioIndex<p->buffer->size())
+	if(isOpen() && ioIndex<p->size())
 	{
-		FXuval left=(FXuval)(p->buffer->size()-ioIndex);
+		FXuval left=(FXuval)(p->size()-ioIndex);
 		FXuval read=FXMIN(left, maxlen);
-		memcpy(data, &p->buffer->data()[ioIndex], read);
+		if(p->segmented)
+			p->copySegments(ioIndex, data, read, false);
+		else
+			memcpy(data, &p->buffer->data()[ioIndex], read);
 		ioIndex+=read;
 		return read;
 	}
@@ -214,6 +405,18 @@ FXuval QBuffer::writeBlock(const char *data, FXuval maxlen)
 {
 	QMtxHold h(p);
 	if(!isWriteable()) FXERRGIO(QTrans::tr("QBuffer", "Not open for writing"));
+	if(isOpen() && p->segmented)
+	{	// Only ever adds segments, so never copies what's already there
+		FXfval end=ioIndex+maxlen;
+		if(end>p->seglen || ioIndex>p->seglen)
+		{
+			p->extendSegments(ioIndex, end);
+			if(end>p->seglen) p->seglen=end;
+		}
+		p->copySegments(ioIndex, const_cast<char *>(data), maxlen, true);
+		ioIndex=end;
+		return maxlen;
+	}
 	if(isOpen())
 	{
 		FXuval buffersize=p->buffer->size();
@@ -250,8 +453,14 @@ int QBuffer::getch()
 {
 	QMtxHold h(p);
 	if(!isReadable()) FXERRGIO(QTrans::tr("QBuffer", "Not open for reading"));
-	if(isOpen() && ioIndex<p->buffer->size())
+	if(isOpen() && ioIndex<p->size())
 	{
+		if(p->segmented)
+		{
+			FXuchar c=(FXuchar) p->segs.at((FXuval)(ioIndex/SegmentSize))[(FXuval)(ioIndex % SegmentSize)];
+			ioIndex++;
+			return c;
+		}
 		FXuval left=(FXuval)(p->buffer->size()-ioIndex);
 		if(left<1) return -1;
 		return p->buffer->data()[ioIndex++];
@@ -263,6 +472,12 @@ int QBuffer::putch(int c)
 {
 	QMtxHold h(p);
 	if(!isWriteable()) FXERRGIO(QTrans::tr("QBuffer", "Not open for writing"));
+	if(isOpen() && p->segmented)
+	{
+		char ch=(char) c;
+		writeBlock(&ch, 1);
+		return c;
+	}
 	if(isOpen())
 	{
 		FXuval buffersize=p->buffer->size();
@@ -289,6 +504,12 @@ int QBuffer::ungetch(int c)
 		{	// TODO: shuffle entire array downwards
 			return -1;
 		}
+		if(p->segmented)
+		{
+			ioIndex--;
+			if(ioIndex<p->seglen) p->segs.at((FXuval)(ioIndex/SegmentSize))[(FXuval)(ioIndex % SegmentSize)]=(char) c;
+			return c;
+		}
 		p->buffer->data()[ioIndex--]=(char) c;
 		return c;
 	}
@@ -298,17 +519,33 @@ int QBuffer::ungetch(int c)
 FXStream &operator<<(FXStream &s, const QBuffer &i)
 {
 	QMtxHold h(i.p);
+	if(i.p->segmented)
+	{
+		for(FXfval idx=0; idx<i.p->seglen; idx+=QBuffer::SegmentSize)
+			s.writeRawBytes(i.p->segs.at((FXuval)(idx/QBuffer::SegmentSize)), (FXuval) FXMIN(i.p->seglen-idx, (FXfval) QBuffer::SegmentSize));
+		return s;
+	}
 	return s.writeRawBytes(i.buffer().data(), (FXuval) i.size());
 }
 
 FXStream &operator>>(FXStream &s, QBuffer &i)
 {
 	QMtxHold h(i.p);
-	FXuval len=(FXuval) s.device()->size();
+	FXfval len=s.device()->size();
+	if(i.p->segmented)
+	{	// Read straight into the segments
+		i.p->freeSegments(i.p->seglen=0);
+		i.p->extendSegments(0, len);
+		i.p->seglen=len;
+		i.at(0);
+		for(FXfval idx=0; idx<len; idx+=QBuffer::SegmentSize)
+			s.readRawBytes(i.p->segs.at((FXuval)(idx/QBuffer::SegmentSize)), (FXuval) FXMIN(len-idx, (FXfval) QBuffer::SegmentSize));
+		return s;
+	}
 	FXERRH(len<((FXuint)-1), "Cannot read a file larger than a FXuint", QBUFFER_FILETOOBIG, FXERRH_ISDEBUG);
 	i.buffer().resize((FXuint) len);
 	i.at(0);
-	return s.readRawBytes(i.buffer().data(), len);
+	return s.readRawBytes(i.buffer().data(), (FXuval) len);
 }
 
 
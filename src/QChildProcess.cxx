@@ -83,6 +83,43 @@ struct QChildProcessPrivate : public QMutex
 		childh=0;
 		alwayssignalled=0;
 	}
+	// Reads everything currently waiting in a channel's pipe into its log
+	void suckPipe(FXuchar channel)
+	{
+		QPipe &pipe=(QChildProcess::StdOut==channel) ? childinout[0] : childerr[0];
+		QBuffer &log=(QChildProcess::StdOut==channel) ? outlog : errlog;
+		if(connectionBroken & channel) return;
+		FXERRH_TRY
+		{
+			do
+			{
+				char buffer[4096];
+				FXuval read;
+				if(!(read=pipe.readBlock(buffer, sizeof(buffer))))
+				{
+					connectionBroken|=channel;
+					break;
+				}
+				log.writeBlock(buffer, read);
+			} while(!pipe.atEnd());
+		}
+		FXERRH_CATCH(FXConnectionLostException &)
+		{	// Sink this error - QPipe will return zero bytes read from now on
+			connectionBroken|=channel;
+		}
+		FXERRH_ENDTRY
+	}
+	// Returns how many bytes can be read from a pipe without blocking
+	FXfval waiting(QPipe &pipe)
+	{
+#ifdef USE_POSIX
+		int fd=pipe.int_transferHandle(false), count=0;
+		if(fd<0 || ::ioctl(fd, FIONREAD, &count)<0) return 0;
+		return (FXfval) count;
+#else
+		return pipe.size();
+#endif
+	}
 };
 
 void *QChildProcess::int_getOSHandle() const
@@ -108,6 +145,12 @@ void *QChildProcess::int_getOSHandle() const
 	return 0;
 }
 
+int QChildProcess::int_transferHandle(bool write)
+{	// Output is buffered by int_suckPipesDry(), so only input can be handed out
+	if(!write || !isOpen() || !isWriteable() || p->connectionBroken) return -1;
+	return p->childinout[0].int_transferHandle(true);
+}
+
 void QChildProcess::int_killChildI(bool)
 {
 	terminate();
@@ -115,7 +158,6 @@ void QChildProcess::int_killChildI(bool)
 
 bool QChildProcess::int_suckPipesDry(bool block)
 {
-	FXuval read=0;
 	QIODeviceS *devs[2], *ready[3];
 	devs[0]=&p->childinout[0];
 	devs[1]=&p->childerr[0];
@@ -124,52 +166,10 @@ bool QChildProcess::int_suckPipesDry(bool block)
 	{
 		for(QIODeviceS **dev=ready; *dev; dev++)
 		{
-			if(*dev==&p->childinout[0] && !(p->connectionBroken & 1))
-			{
-				//fxmessage("Child stdout is signalled. atEnd=%d\n", p->childinout[0].atEnd());
-				FXERRH_TRY
-				{
-					do
-					{
-						char buffer[4096];
-						if(!(read=p->childinout[0].readBlock(buffer, sizeof(buffer))))
-						{
-							p->connectionBroken|=1;
-							break;
-						}
-						//fxmessage("Read %u from child stdout\n", read);
-						p->outlog.writeBlock(buffer, read);
-					} while(!p->childinout[0].atEnd());
-				}
-				FXERRH_CATCH(FXConnectionLostException &)
-				{	// Sink this error - QPipe will return zero bytes read from now on
-					p->connectionBroken|=1;
-				}
-				FXERRH_ENDTRY
-			}
-			else if(*dev==&p->childerr[0] && !(p->connectionBroken & 2))
-			{
-				//fxmessage("Child stderr is signalled. atEnd=%d\n", p->childerr[0].atEnd());
-				FXERRH_TRY
-				{
-					do
-					{
-						char buffer[4096];
-						if(!(read=p->childerr[0].readBlock(buffer, sizeof(buffer))))
-						{
-							p->connectionBroken|=2;
-							break;
-						}
-						//fxmessage("Read %u from child stderr\n", read);
-						p->errlog.writeBlock(buffer, read);
-					} while(!p->childerr[0].atEnd());
-				}
-				FXERRH_CATCH(FXConnectionLostException &)
-				{	// Sink this error - QPipe will return zero bytes read from now on
-					p->connectionBroken|=2;
-				}
-				FXERRH_ENDTRY
-			}
+			if(*dev==&p->childinout[0])
+				p->suckPipe(QChildProcess::StdOut);
+			else if(*dev==&p->childerr[0])
+				p->suckPipe(QChildProcess::StdErr);
 		}
 		return true;
 	}
@@ -597,6 +597,79 @@ FXuval QChildProcess::writeBlock(const char *data, FXuval maxlen)
 	return 0;
 }
 
+FXfval QChildProcess::transferTo(QIODevice &dst, FXfval len)
+{
+	QMtxHold h(p);
+	if(!QIODevice::isReadable()) FXERRGIO(QTrans::tr("QChildProcess", "Not open for reading"));
+	if(!isOpen()) return 0;
+	if(Combined==p->readChannel)
+	{	// Merging the two needs a pass through user space
+		h.unlock();
+		return QIODevice::transferTo(dst, len);
+	}
+	FXuchar channel=(FXuchar) p->readChannel, otherchannel=3-channel;
+	QBuffer &log=(StdOut==channel) ? p->outlog : p->errlog;
+	QPipe &pipe=(StdOut==channel) ? p->childinout[0] : p->childerr[0];
+	QPipe &other=(StdOut==channel) ? p->childerr[0] : p->childinout[0];
+	FXfval moved=0;
+	while(moved<len)
+	{
+		if(log.size())
+		{	// Write out what has already been sucked from the pipe
+			QByteArray &b=log.buffer();
+			FXuval amount=(FXuval) FXMIN(len-moved, (FXfval) b.size()), written=0;
+			while(written<amount)
+			{
+				FXuval writ=dst.writeBlock((const char *) b.data()+written, amount-written);
+				if(!writ) break;
+				written+=writ;
+			}
+			// Keep whatever wasn't written for a later read
+			memmove(b.data(), b.data()+written, (size_t)(b.size()-written));
+			b.resize((FXuint)(b.size()-written));
+			log.at(0);
+			moved+=written;
+			if(written<amount) FXERRGIO(QTrans::tr("QChildProcess", "Destination device accepted no data"));
+			continue;
+		}
+		if(p->connectionBroken & channel) break;
+		/* Wait on both pipes, as a child blocked writing to the other one will
+		never write any more to ours. Whatever the other channel has is sucked
+		into its log for a later readBlock(), and only as much as is waiting is
+		spliced from ours so that the splice never blocks either. */
+		QIODeviceS *devs[2], *ready[3]={ 0, 0, 0 };
+		devs[0]=&pipe;
+		devs[1]=&other;
+		if(!QIODeviceS::waitForData(ready, (p->connectionBroken & otherchannel) ? 1 : 2, devs)) continue;
+		bool ours=false;
+		for(QIODeviceS **dev=ready; *dev; dev++)
+		{
+			if(*dev==&other)
+				p->suckPipe(otherchannel);
+			else
+				ours=true;
+		}
+		if(!ours) continue;
+		FXfval waiting=p->waiting(pipe);
+		if(!waiting)
+		{	// The command has closed its output
+			p->connectionBroken|=channel;
+			break;
+		}
+		FXfval chunk=FXMIN(waiting, len-moved);
+		h.unlock();
+		FXfval justmoved=pipe.transferTo(dst, chunk);
+		h.relock();
+		moved+=justmoved;
+		if(justmoved<chunk)
+		{
+			p->connectionBroken|=channel;
+			break;
+		}
+	}
+	return moved;
+}
+
 int QChildProcess::ungetch(int)
 {
 	return -1;
@@ -34,6 +34,7 @@
 #include "FXWinLinks.h"
 #include "FXErrCodes.h"
 #include "qmemarray.h"
+#include "fxascii.h"
 #ifndef USE_POSIX
 #define USE_WINAPI
 #include "WindowsGubbins.h"
@@ -76,82 +77,112 @@ struct FXDLLLOCAL FXDirPrivate
 	}
 	void doLeafInfos();
 	void read();
-	struct ExpensiveSortRef
+	struct SortKey
 	{
-		int idx;	// Mostly for debugging purposes
-		FXDirPrivate *parent;
-		QStringList::iterator sit;
-		QFileInfoList::iterator fit;
-		ExpensiveSortRef(int _idx, FXDirPrivate *p, const QStringList::iterator &_sit, const QFileInfoList::iterator &_fit) : idx(_idx), parent(p), sit(_sit), fit(_fit) { }
-		bool operator<(const ExpensiveSortRef &o) const
-		{
-			if((parent->sortBy & QDir::SortByMask)==QDir::Time) return (*fit).lastModified()<(*o.fit).lastModified();
-			if((parent->sortBy & QDir::SortByMask)==QDir::Size) return (*fit).size()<(*o.fit).size();
-			return false;
-		}
-		bool operator==(const ExpensiveSortRef &o) const
-		{
-			if((parent->sortBy & QDir::SortByMask)==QDir::Time) return (*fit).lastModified()==(*o.fit).lastModified();
-			if((parent->sortBy & QDir::SortByMask)==QDir::Size) return (*fit).size()==(*o.fit).size();
-			return false;
-		}
+		const FXString *name;		// Points at folded if ignoring case
+		FXString folded;
+		FXTime modified;
+		FXfval size;
+		bool isDir;
+		SortKey() : name(0), size(0), isDir(false) { }
 	};
-	template<class type> struct ExpensiveMover : private Pol::itMove<type>
+	struct SortCtx
 	{
-		void move(QValueList<type> &list, typename QValueList<type>::iterator To, typename QValueList<type>::iterator &From) const
-		{
-			ExpensiveSortRef &to=*To, &from=*From;
-			FXDirPrivate *parent=from.parent;
-			// Slightly dodgy this ...
-			if(to.parent!=parent)
+		int sortBy;
+		SortKey *keys;
+	};
+	static bool sortLess(void *ctx, FXuint a, FXuint b);
+	void sort();
+};
+
+static FXint compareNames(const FXString &_a, const FXString &_b, bool numeric)
+{
+	const FXuchar *a=(const FXuchar *) _a.text(), *b=(const FXuchar *) _b.text();
+	if(!numeric) return compare(_a, _b);
+	for(;;)
+	{
+		if(*a>='0' && *a<='9' && *b>='0' && *b<='9')
+		{	// Longer runs of digits sans leading zeros are bigger, otherwise compare digit by digit
+			while('0'==*a) a++;
+			while('0'==*b) b++;
+			const FXuchar *ea=a, *eb=b;
+			while(*ea>='0' && *ea<='9') ea++;
+			while(*eb>='0' && *eb<='9') eb++;
+			if(ea-a!=eb-b) return (FXint)((ea-a)-(eb-b));
+			for(; a<ea; a++, b++)
 			{
-				to=ExpensiveSortRef(-1, parent, parent->leafs.end(), parent->leafinfos->end());
+				if(*a!=*b) return *a-*b;
 			}
-			//fxmessage("B: %s\n", parent->leafs.join(",").text());
-			Pol::itMove<type>::move(parent->leafs, to.sit, from.sit);
-			//fxmessage("A: %s\n", parent->leafs.join(",").text());
-			Pol::itMove<type>::move(*parent->leafinfos, to.fit, from.fit);
-			Pol::itMove<type>::move(list, To, From);
+			continue;
 		}
-	};
-	template<class type> struct ExpensiveSwap : private Pol::itSwap<type>
+		if(*a!=*b || !*a) return *a-*b;
+		a++; b++;
+	}
+}
+
+bool FXDirPrivate::sortLess(void *_ctx, FXuint a, FXuint b)
+{
+	SortCtx *ctx=(SortCtx *) _ctx;
+	const SortKey &ka=ctx->keys[a], &kb=ctx->keys[b];
+	if((ctx->sortBy & QDir::DirsFirst) && ka.isDir!=kb.isDir) return ka.isDir;
+	switch(ctx->sortBy & QDir::SortByMask)
 	{
-		template<class I> void ptrSwap(I &A, I &B) const
-		{
-			I t=A; A=B; B=t;
-		}
-		void swap(QValueList<type> &list, typename QValueList<type>::iterator &A, typename QValueList<type>::iterator &B) const
-		{
-			ExpensiveSortRef &a=*A, &b=*B;
-			FXDirPrivate *parent=a.parent;
-			//fxmessage("B: %s\n", parent->leafs.join(",").text());
-			Pol::itSwap<type>::swap(parent->leafs, a.sit, b.sit); ptrSwap(a.sit, b.sit);
-			//fxmessage("A: %s\n", parent->leafs.join(",").text());
-			Pol::itSwap<type>::swap(*parent->leafinfos, a.fit, b.fit); ptrSwap(a.fit, b.fit);
-			Pol::itSwap<type>::swap(list, A, B);
-		}
-	};
-	template<class type> struct NameCompare
+	case QDir::Name:
+		return compareNames(*ka.name, *kb.name, 0!=(ctx->sortBy & QDir::Numeric))<0;
+	case QDir::Time:
+		return ka.modified<kb.modified;
+	case QDir::Size:
+		return ka.size<kb.size;
+	}
+	return false;
+}
+
+void FXDirPrivate::sort()
+{	// Calculate the sort keys once, sort a permutation of them and then relink the lists in that order
+	FXuint count=(FXuint) leafs.size(), n;
+	int sortby=sortBy & QDir::SortByMask;
+	if(count<2) return;
+	if(QDir::Time==sortby || QDir::Size==sortby || (sortBy & QDir::DirsFirst))
+		doLeafInfos();
+	QMemArray<SortKey> keys(count);
+	QMemArray<FXuint> order(count);
+	QMemArray<QStringList::iterator> sits(count);
+	QMemArray<QFileInfoList::iterator> fits(leafinfos ? count : 0);
+	QStringList::iterator sit=leafs.begin();
+	QFileInfoList::iterator fit;
+	if(leafinfos) fit=leafinfos->begin();
+	for(n=0; n<count; n++, ++sit)
 	{
-		FXDirPrivate *parent;
-		template<class L, class I> bool compare(L &list, I &a, I &b) const
+		SortKey &key=keys[n];
+		order[n]=n;
+		sits[n]=sit;
+		key.name=&(*sit);
+		if(QDir::Name==sortby && (sortBy & QDir::IgnoreCase))
 		{
-			if(parent->sortBy & QDir::IgnoreCase)
-				return comparecase(*a, *b)<0;
-			else
-				return *a<*b;
+			key.folded=*sit;
+			FXint len=key.folded.length(), i;
+			for(i=0; i<len && !(key.folded[i] & 0x80); i++)
+				key.folded[i]=Ascii::toLower(key.folded[i]);
+			if(i<len) key.folded.lower();
+			key.name=&key.folded;
 		}
-	};
-	template<class type> struct ExpensiveDirsFirst
-	{
-		template<class L, class I> bool compare(L &list, I &A, I &B) const
+		if(leafinfos)
 		{
-			ExpensiveSortRef &a=*A, &b=*B;
-			const QFileInfo &fa=*a.fit, &fb=*b.fit;
-			return (fa.isDir() && !fb.isDir());
+			fits[n]=fit;
+			const QFileInfo &fi=*fit++;
+			if(QDir::Time==sortby) key.modified=fi.lastModified();
+			if(QDir::Size==sortby) key.size=fi.size();
+			if(sortBy & QDir::DirsFirst) key.isDir=fi.isDir();
 		}
-	};
-};
+	}
+	SortCtx ctx={ sortBy, keys.data() };
+	int_parallelSort(order.data(), count, sortLess, &ctx);
+	for(n=0; n<count; n++)
+	{
+		leafs.splice(leafs.end(), leafs, sits[order[n]]);
+		if(leafinfos) leafinfos->splice(leafinfos->end(), *leafinfos, fits[order[n]]);
+	}
+}
 
 void FXDirPrivate::doLeafInfos()
 {
@@ -219,47 +250,7 @@ remove:
 		}
 		if((sortBy & QDir::SortByMask)!=QDir::Unsorted || (sortBy & QDir::DirsFirst))
 		{
-			switch(sortBy & QDir::SortByMask)
-			{
-			case QDir::Name:
-				{	// Name sort
-					QValueListQSort<FXString, Pol::itMove, Pol::itSwap, NameCompare> sorter(leafs);
-					sorter.parent=this;
-					sorter.run();
-					break;
-				}
-			case QDir::Time:
-			case QDir::Size:
-				{	// Expensive sort
-					doLeafInfos();
-					QValueList<ExpensiveSortRef> list;
-					QStringList::iterator sit=leafs.begin();
-					QFileInfoList::iterator fit=leafinfos->begin();
-					for(int idx=0; sit!=leafs.end(); ++sit, ++fit)
-					{
-						list.push_back(ExpensiveSortRef(idx++, this, sit, fit));
-					}
-					QValueListQSort<ExpensiveSortRef, ExpensiveMover, ExpensiveSwap> sorter(list);
-					sorter.run();
-					break;
-				}
-			case QDir::Unsorted:
-				break;
-			}
-			//fxmessage("Hello!\n");
-			if(sortBy & QDir::DirsFirst)
-			{
-				doLeafInfos();
-				QValueList<ExpensiveSortRef> list;
-				QStringList::iterator sit=leafs.begin();
-				QFileInfoList::iterator fit=leafinfos->begin();
-				for(int idx=0; sit!=leafs.end(); ++sit, ++fit)
-				{
-					list.push_back(ExpensiveSortRef(idx++, this, sit, fit));
-				}
-				QValueListQSort<ExpensiveSortRef, ExpensiveMover, ExpensiveSwap, ExpensiveDirsFirst> sorter(list);
-				sorter.run(QVLQSortStable);
-			}
+			sort();
 			if(sortBy & QDir::Reversed)
 			{
 				leafs.reverse();
@@ -34,6 +34,7 @@
 #include <shellapi.h>
 #else
 #include <sys/time.h>
+#include <sys/mman.h>
 #endif
 #include "FXException.h"
 #include "QThread.h"
@@ -93,12 +94,148 @@ public:
 	QByteArray ungetchbuffer;
 	bool doacl;
 	FXACL *acl;
-	QFilePrivate(bool _amStdio, bool _doacl) : amStdio(_amStdio), handle(0), size(0), lastop(NoOp), doacl(_doacl), acl(0)
+	// The buffer holds the file's contents at bufstart when reading, in which case the
+	// OS file pointer is at bufstart+buflen. When writing it holds data yet to be written
+	// at bufstart, which is where the OS file pointer is.
+	FXuchar *buf;
+	FXuval bufsize, buflen, bufpos, readahead;
+	FXfval bufstart, nextseq;
+	LastOp bufmode;
+	// A copy of bufmode which positional i/o reads without the lock
+	FXAtomicInt unlockedbufmode;
+	// When reading a big file via a mapping, the OS file pointer is not kept at ioIndex
+	FXfval mapthreshold, mapsize;
+	const char *volatile mapaddr;
+	// Counts positional reads copying out of the mapping without the lock. The mapping is
+	// only replaced with MapChanging added, once those already copying have left
+	FXAtomicInt mapreaders;
+	static const int MapChanging=0x40000000;
+	QFilePrivate(bool _amStdio, bool _doacl) : amStdio(_amStdio), handle(0), size(0), lastop(NoOp), doacl(_doacl), acl(0),
+		buf(0), bufsize(64*1024), buflen(0), bufpos(0), readahead(0), bufstart(0), nextseq(0), bufmode(NoOp),
+		mapthreshold(0), mapsize(0), mapaddr(0)
 	{
 	}
 	~QFilePrivate()
 	{
+		unmapFile();
 		FXDELETE(acl);
+		free(buf);
+	}
+	bool isRegularFile() const
+	{
+#ifdef WIN32
+		return FILE_TYPE_DISK==GetFileType((HANDLE) _get_osfhandle(handle));
+#else
+		struct ::stat s={0};
+		return !::fstat(handle, &s) && S_ISREG(s.st_mode);
+#endif
+	}
+	void setBufMode(LastOp mode)
+	{
+		bufmode=mode;
+		unlockedbufmode=(int) mode;
+	}
+	// Keeps lock-free readers out of the mapping and waits for those already in it to leave
+	void beginMapChange()
+	{
+		mapreaders+=MapChanging;
+		while(MapChanging!=(int) mapreaders)
+			QThread::yield();
+	}
+	void endMapChange()
+	{
+		mapreaders-=MapChanging;
+	}
+	void dropMapping()
+	{
+		if(mapaddr)
+		{
+#ifdef WIN32
+			UnmapViewOfFile(mapaddr);
+#else
+			::munmap((void *) mapaddr, (size_t) mapsize);
+#endif
+		}
+		mapaddr=0;
+		mapsize=0;
+	}
+	void unmapFile()
+	{
+		if(!mapaddr) return;
+		beginMapChange();
+		dropMapping();
+		endMapChange();
+	}
+	bool mapFile()
+	{	// Replaces any existing mapping with one of the whole file from the open handle, returning false if it can't be mapped
+		beginMapChange();
+		dropMapping();
+		const char *addr=0;
+		if(size && size==(FXuval) size)		// Can't map nothing or more than the address space
+		{
+#ifdef WIN32
+			HANDLE mappingh=CreateFileMapping((HANDLE) _get_osfhandle(handle), NULL, PAGE_READONLY, 0, 0, NULL);
+			if(mappingh)
+			{
+				addr=(const char *) MapViewOfFile(mappingh, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mappingh);		// The view keeps the mapping alive
+			}
+#else
+			void *_addr=::mmap(0, (size_t) size, PROT_READ, MAP_SHARED, handle, 0);
+			if(MAP_FAILED!=_addr) addr=(const char *) _addr;
+#endif
+		}
+		if(addr)
+		{
+			mapsize=size;
+			mapaddr=addr;
+		}
+		endMapChange();
+		return addr!=0;
+	}
+	// Copies out of the mapping without the lock, returning false if there isn't one to use
+	bool readMapped(char *data, FXuval maxlen, FXfval pos, FXuval &copylen)
+	{
+		bool ret=false;
+		if(!((++mapreaders) & MapChanging) && mapaddr)
+		{
+			copylen=(pos<mapsize) ? (FXuval) FXMIN((FXfval) maxlen, mapsize-pos) : 0;
+			memcpy(data, mapaddr+(FXuval) pos, copylen);
+			ret=true;
+		}
+		--mapreaders;
+		return ret;
+	}
+	FXuval rawRead(char *data, FXuval len)
+	{
+#ifdef WIN32
+		DWORD ioreaded;
+		FXERRHWIN(ReadFile((HANDLE) _get_osfhandle(handle), data, (DWORD) len, &ioreaded, NULL));
+#else
+		ssize_t ioreaded;
+		FXERRHIO(ioreaded=::read(amStdio ? fileno(stdin) : handle, data, len));
+#endif
+		return (FXuval) ioreaded;
+	}
+	FXuval rawWrite(const char *data, FXuval len)
+	{
+#ifdef WIN32
+		DWORD written;
+		FXERRHWIN(WriteFile((HANDLE) _get_osfhandle(handle), data, (DWORD) len, &written, NULL));
+#else
+		ssize_t written;
+		FXERRHIO(written=::write(handle, data, len));
+#endif
+		return (FXuval) written;
+	}
+	void rawSeek(FXfval pos)
+	{
+#ifdef WIN32
+		LARGE_INTEGER _newpos; _newpos.QuadPart=pos;
+		FXERRHWIN(SetFilePointerEx((HANDLE) _get_osfhandle(handle), _newpos, NULL, FILE_BEGIN));
+#else
+		FXERRHIO(::lseek(handle, pos, SEEK_SET));
+#endif
 	}
 };
 static FXPtrHold<QFile> stdiofile;
@@ -108,6 +245,77 @@ int QFile::int_fileDescriptor() const
 	return p->handle;
 }
 
+inline bool QFile::int_buffered() const
+{
+	return p->bufsize && !p->amStdio && !isRaw() && !isTranslated();
+}
+
+bool QFile::int_readyPositional(bool write, FXfval pos, FXuval len)
+{	// Returns true if pread()/pwrite() may be used outside the lock
+	if(!isOpen() || p->amStdio || isTranslated()) return false;
+	if(write ? !isWriteable() : !QIODevice::isReadable()) return false;
+	// Reads can ignore read-ahead, so only an occupied buffer needs the lock
+	int bufmode=p->unlockedbufmode;
+	if(QFilePrivate::NoOp==bufmode || (!write && QFilePrivate::Read==bufmode)) return true;
+	QMtxHold h(p);
+	// Reads must see pending write-behind data and writes mustn't leave stale read-ahead behind
+	if(QFilePrivate::Write==p->bufmode
+		|| (write && QFilePrivate::Read==p->bufmode && pos<p->bufstart+p->buflen && pos+len>p->bufstart))
+		int_syncBuffer();
+	return true;
+}
+
+void QFile::int_syncBuffer()
+{	// Leaves the OS file pointer where it ought to be and the buffer empty
+	if(QFilePrivate::Write==p->bufmode)
+	{
+		QThread_DTHold dth;
+		FXuval written=0, len=p->buflen;
+		// Empty the buffer first so a failed write isn't retried by close()
+		p->setBufMode(QFilePrivate::NoOp);
+		p->buflen=p->bufpos=0;
+		while(written<len)
+			written+=p->rawWrite((const char *) p->buf+written, len-written);
+		p->lastop=QFilePrivate::Write;
+	}
+	else if(QFilePrivate::Read==p->bufmode && p->bufpos!=p->buflen)
+	{	// Put the OS file pointer back to where we have read up to
+		p->rawSeek(p->bufstart+p->bufpos);
+	}
+	p->setBufMode(QFilePrivate::NoOp);
+	p->buflen=p->bufpos=0;
+}
+
+int QFile::int_transferHandle(bool write)
+{
+#ifdef USE_POSIX
+	QMtxHold h(p);
+	if(!isOpen() || p->amStdio || isTranslated() || !p->ungetchbuffer.isEmpty()) return -1;
+	if(write ? !isWriteable() : !QIODevice::isReadable()) return -1;
+	if(QFilePrivate::NoOp!=p->bufmode) int_syncBuffer();
+	if(p->mapaddr) p->rawSeek(ioIndex);
+	return p->handle;
+#else
+	return -1;
+#endif
+}
+
+void QFile::int_transferDone(bool write, FXfval moved)
+{
+	QMtxHold h(p);
+	ioIndex+=moved;
+	if(write)
+	{
+		if(ioIndex>p->size) p->size=ioIndex;
+		p->lastop=QFilePrivate::Write;
+	}
+	else
+	{
+		p->nextseq=ioIndex;
+		p->lastop=QFilePrivate::Read;
+	}
+}
+
 QFile::QFile() : p(0), QIODevice()
 {
 	FXERRHM(p=new QFilePrivate(false, true));
@@ -179,19 +387,64 @@ FXfval QFile::reloadSize()
 	QMtxHold h(p);
 	if(isOpen())
 	{
+		if(QFilePrivate::Write==p->bufmode) int_syncBuffer();
 #ifdef WIN32
 		DWORD high;
-		return (p->size=(GetFileSize((HANDLE) _get_osfhandle(p->handle), &high)|(((FXfval) high)<<32)));
+		p->size=(GetFileSize((HANDLE) _get_osfhandle(p->handle), &high)|(((FXfval) high)<<32));
 #else
 		// I can't see any alternative to a full stat
 		struct ::stat s={0};
 		::fstat(p->handle, &s);
-		return (p->size=(FXfval) s.st_size);
+		p->size=(FXfval) s.st_size;
 #endif
+		if(p->mapaddr && p->size!=p->mapsize)
+		{	// Remap to the new length. If that fails reads go back to the OS file pointer, so put it where they expect
+			if(!p->mapFile()) p->rawSeek(ioIndex);
+		}
+		return p->size;
 	}
 	return 0;
 }
 
+FXuval QFile::bufferSize() const
+{
+	return p->bufsize;
+}
+
+void QFile::setBufferSize(FXuval size)
+{
+	QMtxHold h(p);
+	if(isOpen()) int_syncBuffer();
+	if(size!=p->bufsize)
+	{
+		free(p->buf);
+		p->buf=0;
+		p->bufsize=size;
+	}
+}
+
+FXfval QFile::mapThreshold() const
+{
+	return p->mapthreshold;
+}
+
+void QFile::setMapThreshold(FXfval size)
+{
+	QMtxHold h(p);
+	p->mapthreshold=size;
+}
+
+bool QFile::isMapped() const
+{
+	return p->mapaddr!=0;
+}
+
+const char *QFile::view(FXfval offset, FXuval len) const
+{
+	if(!p->mapaddr || offset>p->mapsize || len>p->mapsize-offset) return 0;
+	return p->mapaddr+(FXuval) offset;
+}
+
 QIODevice &QFile::stdio(bool applyCRLFTranslation)
 {
 	if(!stdiofile)
@@ -275,7 +528,12 @@ bool QFile::open(FXuint mode)
 		if(p->acl) *p->acl=FXACL(p->handle, FXACL::File);
 		setFlags((mode & IO_ModeMask)|IO_Open);
 		p->lastop=QFilePrivate::NoOp;
+		p->setBufMode(QFilePrivate::NoOp);
+		p->buflen=p->bufpos=0;
+		p->readahead=0;
 		reloadSize();
+		if(p->mapthreshold && p->size>=p->mapthreshold && IO_ReadOnly==(mode & (IO_ReadWrite|IO_Translate)) && p->isRegularFile())
+			p->mapFile();
 		ioIndex=0;
 		if(!(mode & IO_NoAutoUTF) && isReadable() && isTranslated())
 		{	// Have a quick peek to see what kind of text it is
@@ -295,6 +553,8 @@ void QFile::close()
 	if(isOpen() && !p->amStdio)
 	{
 		QThread_DTHold dth;
+		int_syncBuffer();
+		p->unmapFile();
 		FXERRHIO(::close(p->handle));
 		p->handle=0;
 		p->size=0;
@@ -313,6 +573,7 @@ void QFile::flush()
 	if(isOpen() && isWriteable())
 	{
 		QThread_DTHold dth;
+		if(QFilePrivate::Write==p->bufmode) int_syncBuffer();
 #ifdef WIN32
 		FXERRHWIN(FlushFileBuffers((HANDLE) _get_osfhandle(p->handle)));
 		//FXERRHIO(::_commit(p->handle));
@@ -340,6 +601,7 @@ void QFile::truncate(FXfval size)
 	if(isOpen() && !p->amStdio)
 	{
 		QThread_DTHold dth;
+		int_syncBuffer();
 		if((mode() & IO_ShredTruncate) && size<p->size)
 			shredData(size);
 		if(ioIndex>size) at(size);
@@ -359,14 +621,29 @@ bool QFile::at(FXfval newpos)
 	QMtxHold h(p);
 	if(isOpen() && ioIndex!=newpos && !p->amStdio)
 	{
-		QThread_DTHold dth;
 		assert(newpos<0xf000000000000000ULL);
-#ifdef WIN32
-		LARGE_INTEGER _newpos; _newpos.QuadPart=newpos;
-		FXERRHWIN(SetFilePointerEx((HANDLE) _get_osfhandle(p->handle), _newpos, NULL, FILE_BEGIN));
-#else
-		FXERRHIO(::lseek(p->handle, newpos, SEEK_SET));
-#endif
+		if(p->mapaddr)
+		{	// Reads come from the mapping, so the OS file pointer is left alone
+			ioIndex=newpos;
+			p->ungetchbuffer.resize(0);
+			return true;
+		}
+		if(QFilePrivate::Read==p->bufmode && newpos>=p->bufstart && newpos<=p->bufstart+p->buflen)
+		{	// Within the read-ahead window
+			p->bufpos=(FXuval)(newpos-p->bufstart);
+			ioIndex=newpos;
+			p->ungetchbuffer.resize(0);
+			return true;
+		}
+		QThread_DTHold dth;
+		if(QFilePrivate::Write==p->bufmode)
+			int_syncBuffer();
+		else
+		{	// No point in seeking twice
+			p->setBufMode(QFilePrivate::NoOp);
+			p->buflen=p->bufpos=0;
+		}
+		p->rawSeek(newpos);
 		ioIndex=newpos;
 		if(ioIndex>p->size) p->size=ioIndex;
 		p->ungetchbuffer.resize(0);
@@ -421,6 +698,9 @@ FXuval QFile::readBlock(char *data, FXuval maxlen)
 	{
 		QThread_DTHold dth;
 		FXuval readed=0;
+		bool buffered=int_buffered();
+		if(QFilePrivate::Write==p->bufmode || (!buffered && QFilePrivate::Read==p->bufmode))
+			int_syncBuffer();
 #ifdef USE_POSIX
 		if(QFilePrivate::Write==p->lastop && !p->amStdio)
 		{
@@ -437,12 +717,56 @@ FXuval QFile::readBlock(char *data, FXuval maxlen)
 			if(copylen<ungetchlen) memmove(ungetchdata, ungetchdata+copylen, ungetchlen-copylen);
 			p->ungetchbuffer.resize((FXuint)(ungetchlen-copylen));
 		}
-		int ioreaded;
-#ifdef WIN32
-		FXERRHWIN(ReadFile((HANDLE) _get_osfhandle(p->handle), data+readed, (DWORD)(maxlen-readed), (LPDWORD) &ioreaded, NULL));
-#else
-		FXERRHIO(ioreaded=::read((p->amStdio) ? fileno(stdin) : p->handle, data+readed, maxlen-readed));
-#endif
+		if(p->mapaddr)
+		{	// Straight out of the mapping
+			FXuval copylen=(ioIndex<p->mapsize) ? (FXuval) FXMIN((FXfval)(maxlen-readed), p->mapsize-ioIndex) : 0;
+			memcpy(data+readed, p->mapaddr+(FXuval) ioIndex, copylen);
+			ioIndex+=copylen; readed+=copylen;
+			p->lastop=QFilePrivate::Read;
+			return readed;
+		}
+		if(buffered)
+		{
+			while(readed<maxlen)
+			{
+				if(QFilePrivate::Read==p->bufmode && p->bufpos<p->buflen)
+				{
+					FXuval copylen=FXMIN(p->buflen-p->bufpos, maxlen-readed);
+					memcpy(data+readed, p->buf+p->bufpos, copylen);
+					p->bufpos+=copylen; ioIndex+=copylen; readed+=copylen;
+					continue;
+				}
+				// Buffer is exhausted. Grow the read-ahead while access remains sequential
+				FXfval filepos=(QFilePrivate::Read==p->bufmode) ? p->bufstart+p->buflen : ioIndex;
+				FXuval left=maxlen-readed, ioreaded;
+				if(filepos==p->nextseq && p->readahead)
+					p->readahead=FXMIN(p->readahead*2, p->bufsize);
+				else
+					p->readahead=FXMIN((FXuval) 4096, p->bufsize);
+				p->setBufMode(QFilePrivate::NoOp);
+				p->buflen=p->bufpos=0;
+				if(left>=p->readahead)
+				{	// Big reads go straight to the destination
+					ioreaded=p->rawRead(data+readed, left);
+					ioIndex+=ioreaded; readed+=ioreaded;
+					p->nextseq=filepos+ioreaded;
+					break;
+				}
+				if(!p->buf)
+				{
+					FXERRHM(p->buf=(FXuchar *) malloc(p->bufsize));
+				}
+				ioreaded=p->rawRead((char *) p->buf, p->readahead);
+				p->nextseq=filepos+ioreaded;
+				if(!ioreaded) break;
+				p->setBufMode(QFilePrivate::Read);
+				p->bufstart=filepos;
+				p->buflen=ioreaded;
+			}
+			p->lastop=QFilePrivate::Read;
+			return readed;
+		}
+		FXuval ioreaded=p->rawRead(data+readed, maxlen-readed);
 		ioIndex+=ioreaded; readed+=ioreaded;
 		p->lastop=QFilePrivate::Read;
 		if(isTranslated())
@@ -468,6 +792,35 @@ FXuval QFile::writeBlock(const char *data, FXuval maxlen)
 	{
 		QThread_DTHold dth;
 		FXuval written=0;
+		if(QFilePrivate::Read==p->bufmode) int_syncBuffer();
+		if(int_buffered())
+		{
+			if(!p->ungetchbuffer.isEmpty())
+			{	// The OS file pointer is past the ungot data
+				p->rawSeek(ioIndex);
+				p->ungetchbuffer.resize(0);
+			}
+			if(QFilePrivate::Write==p->bufmode && p->buflen+maxlen>p->bufsize)
+				int_syncBuffer();
+			if(maxlen<p->bufsize)
+			{	// Coalesce with other small writes
+				if(!p->buf)
+				{
+					FXERRHM(p->buf=(FXuchar *) malloc(p->bufsize));
+				}
+				if(QFilePrivate::NoOp==p->bufmode)
+				{
+					p->setBufMode(QFilePrivate::Write);
+					p->bufstart=ioIndex;
+				}
+				memcpy(p->buf+p->buflen, data, maxlen);
+				p->buflen+=maxlen;
+				ioIndex+=maxlen;
+				if(ioIndex>p->size) p->size=ioIndex;
+				return maxlen;
+			}
+		}
+		else if(QFilePrivate::Write==p->bufmode) int_syncBuffer();
 #ifdef USE_POSIX
 		if(QFilePrivate::Read==p->lastop && !p->amStdio)
 		{
@@ -496,13 +849,7 @@ FXuval QFile::writeBlock(const char *data, FXuval maxlen)
 		}
 		else
 		{
-#ifdef WIN32
-			DWORD __written;
-			FXERRHWIN(WriteFile((HANDLE) _get_osfhandle(p->handle), data, (DWORD) maxlen, (LPDWORD) &__written, NULL));
-			written=__written;
-#else
-			FXERRHIO(written=::write(p->handle, data, maxlen));
-#endif
+			written=p->rawWrite(data, maxlen);
 			ioIndex+=written;
 		}
 		if(ioIndex>p->size) p->size=ioIndex;
@@ -515,15 +862,149 @@ FXuval QFile::writeBlock(const char *data, FXuval maxlen)
 
 FXuval QFile::readBlockFrom(char *data, FXuval maxlen, FXfval pos)
 {
+	if(p->mapaddr)
+	{	// Many threads can copy at once, with reloadSize() or close() waiting for them before replacing the mapping
+		FXuval copylen;
+		if(p->readMapped(data, maxlen, pos, copylen)) return copylen;
+	}
+#ifdef USE_POSIX
+	/* Untranslated positional reads go straight to the kernel without the file pointer
+	so many threads can read at once, the lock being taken only when write-behind
+	data must be written out first */
+	if(int_readyPositional(false, pos, maxlen))
+	{
+		QThread_DTHold dth;
+		FXuval read=0;
+		while(read<maxlen)
+		{
+			ssize_t ret=::pread(p->handle, data+read, maxlen-read, (off_t)(pos+read));
+			if(ret<0)
+			{
+				if(EINTR==errno) continue;
+				FXERRHIO(ret);
+			}
+			if(!ret) break;
+			read+=(FXuval) ret;
+		}
+		return read;
+	}
+#endif
 	QMtxHold h(p);
+	FXfval oldpos=ioIndex;
 	at(pos);
-	return readBlock(data, maxlen);
+	FXuval ret=readBlock(data, maxlen);
+	at(oldpos);
+	return ret;
 }
 FXuval QFile::writeBlockTo(FXfval pos, const char *data, FXuval maxlen)
 {
+#ifdef USE_POSIX
+	// As above, except read-ahead covering the written range is thrown away too
+	if(int_readyPositional(true, pos, maxlen))
+	{
+		QThread_DTHold dth;
+		FXuval written=0;
+		while(written<maxlen)
+		{
+			ssize_t ret=::pwrite(p->handle, data+written, maxlen-written, (off_t)(pos+written));
+			if(ret<0)
+			{
+				if(EINTR==errno) continue;
+				FXERRHIO(ret);
+			}
+			if(!ret) break;
+			written+=(FXuval) ret;
+		}
+		if(pos+written>p->size)
+		{	// Extending the file is rare enough to take the lock
+			QMtxHold h(p);
+			if(pos+written>p->size) p->size=pos+written;
+		}
+		if(isRaw()) flush();
+		return written;
+	}
+#endif
 	QMtxHold h(p);
+	FXfval oldpos=ioIndex;
 	at(pos);
-	return writeBlock(data, maxlen);
+	FXuval ret=writeBlock(data, maxlen);
+	at(oldpos);
+	return ret;
+}
+
+FXuval QFile::readBlockV(const IOVec *segs, FXuint count)
+{
+	QMtxHold h(p);
+#ifdef USE_POSIX
+	FXuval total=0;
+	for(FXuint n=0; n<count; n++) total+=segs[n].len;
+	// Small transfers are better served by the buffer
+	if(isOpen() && QIODevice::isReadable() && !p->amStdio && !isTranslated() && p->ungetchbuffer.isEmpty()
+		&& !p->mapaddr && !(int_buffered() && total<p->bufsize))
+	{
+		QThread_DTHold dth;
+		if(QFilePrivate::NoOp!=p->bufmode) int_syncBuffer();
+		FXuval readed;
+		FXERRHIO(readed=int_vectoredIO(p->handle, segs, count, false));
+		ioIndex+=readed;
+		p->nextseq=ioIndex;
+		p->lastop=QFilePrivate::Read;
+		return readed;
+	}
+#endif
+	return QIODevice::readBlockV(segs, count);
+}
+
+FXuval QFile::writeBlockV(const IOVec *segs, FXuint count)
+{
+	QMtxHold h(p);
+#ifdef USE_POSIX
+	FXuval total=0;
+	for(FXuint n=0; n<count; n++) total+=segs[n].len;
+	if(isOpen() && isWriteable() && !isTranslated() && !(int_buffered() && total<p->bufsize))
+	{
+		QThread_DTHold dth;
+		if(QFilePrivate::NoOp!=p->bufmode) int_syncBuffer();
+		if(!p->ungetchbuffer.isEmpty())
+		{	// The OS file pointer is past the ungot data
+			p->rawSeek(ioIndex);
+			p->ungetchbuffer.resize(0);
+		}
+		FXuval written;
+		FXERRHIO(written=int_vectoredIO(p->handle, segs, count, true));
+		ioIndex+=written;
+		if(ioIndex>p->size) p->size=ioIndex;
+		p->lastop=QFilePrivate::Write;
+		if(isRaw()) flush();
+		return written;
+	}
+#endif
+	return QIODevice::writeBlockV(segs, count);
+}
+
+int QFile::getch()
+{
+	QMtxHold h(p);
+	if(QFilePrivate::Read==p->bufmode && p->bufpos<p->buflen && p->ungetchbuffer.isEmpty() && int_buffered())
+	{
+		++ioIndex;
+		return p->buf[p->bufpos++];
+	}
+	if(p->mapaddr && ioIndex<p->mapsize && p->ungetchbuffer.isEmpty())
+		return (FXuchar) p->mapaddr[(FXuval) ioIndex++];
+	return QIODevice::getch();
+}
+
+int QFile::putch(int c)
+{
+	QMtxHold h(p);
+	if(QFilePrivate::Write==p->bufmode && p->buflen<p->bufsize && int_buffered())
+	{
+		p->buf[p->buflen++]=(FXuchar) c;
+		if(++ioIndex>p->size) p->size=ioIndex;
+		return c;
+	}
+	return QIODevice::putch(c);
 }
 
 int QFile::ungetch(int c)
@@ -531,6 +1012,17 @@ int QFile::ungetch(int c)
 	QMtxHold h(p);
 	if(isOpen())
 	{
+		if(QFilePrivate::Read==p->bufmode && p->bufpos && p->ungetchbuffer.isEmpty() && p->buf[p->bufpos-1]==(FXuchar) c)
+		{	// Simply step back within the read-ahead
+			--p->bufpos;
+			--ioIndex;
+			return c;
+		}
+		if(p->mapaddr && ioIndex && ioIndex<=p->mapsize && p->ungetchbuffer.isEmpty() && (FXuchar) p->mapaddr[(FXuval) ioIndex-1]==(FXuchar) c)
+		{	// Likewise within the mapping
+			--ioIndex;
+			return c;
+		}
 		FXuval size=p->ungetchbuffer.size();
 		p->ungetchbuffer.resize(size+1);
 		p->ungetchbuffer[(FXuint)size]=(char) c;
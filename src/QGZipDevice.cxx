@@ -25,7 +25,12 @@
 #include "QBuffer.h"
 #include "QThread.h"
 #include "QTrans.h"
+#include "FXRollback.h"
+#include "FXPtrHold.h"
+#include "int_ParallelCompressor.h"
 #include <qcstring.h>
+#include <qptrvector.h>
+#include <qmemarray.h>
 #include <stdio.h>
 #include "FXErrCodes.h"
 #include "FXMemDbg.h"
@@ -425,25 +430,306 @@ static int gz_close (gzFile file)
     }
     return destroy((gz_stream*)file);
 }
+
+/* Compresses len bytes at in into a complete .gz member, which
+ * can be concatenated with others to make a valid .gz file.
+ */
+static bool gz_compressmember (FX::QByteArray &out, const FX::FXuchar *in, FX::FXuval len, int level)
+{
+    z_stream stream;
+    int err;
+    uLong bound, crc;
+    Byte *o;
+
+    if (len > 0x40000000) return false;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    bound = deflateBound(&stream, (uLong)len);
+    out.resize(10 + bound + 8);
+    o = out.data();
+    o[0] = gz_magic[0]; o[1] = gz_magic[1]; o[2] = Z_DEFLATED; o[3] = 0 /*flags*/;
+    o[4] = o[5] = o[6] = o[7] = 0 /*time*/; o[8] = 0 /*xflags*/; o[9] = OS_CODE;
+    stream.next_in = (Bytef *)in;
+    stream.avail_in = (uInt)len;
+    stream.next_out = o + 10;
+    stream.avail_out = (uInt)bound;
+    err = deflate(&stream, Z_FINISH);
+    o += 10 + stream.total_out;
+    deflateEnd(&stream);
+    if (err != Z_STREAM_END) return false;
+    crc = crc32(crc32(0L, Z_NULL, 0), in, (uInt)len);
+    for (int n = 0; n < 4; n++, crc >>= 8) *o++ = (Byte)(crc & 0xff);
+    for (int n = 0; n < 4; n++, len >>= 8) *o++ = (Byte)(len & 0xff);
+    out.resize(o - out.data());
+    return true;
+}
 } // extern "C"
 #endif
 
 namespace FX {
 
 
+#ifdef HAVE_ZLIB_H
+#define GZ_WINSIZE 32768			// The deflate window
+#define GZ_OBUFSIZE (4*GZ_WINSIZE)	// Output buffer when streaming
+#endif
+
 struct FXDLLLOCAL QGZipDevicePrivate : public QMutex
 {
 	QIODevice *src;
 	QBuffer uncomp;
+	bool streaming;
+	FXuval spacing, parallel;
 #ifdef HAVE_ZLIB_H
 	gzFile inh, outh;
+	QIODevice_ParallelCompressor *pc;
+	// A place in the compressed data where inflation can restart (see zlib's examples/zran.c)
+	struct AccessPoint
+	{
+		FXfval out, in;				// Uncompressed and compressed offsets
+		int bits;					// Bits of the byte before in yet to be consumed
+		FXuint winlen;
+		FXuchar window[GZ_WINSIZE];	// The uncompressed data preceding out
+	};
+	QPtrVector<AccessPoint> index;
+	// When streaming in, obuf holds the uncompressed data before oend
+	FXuchar *obuf;
+	FXuval olen, opos;
+	FXfval oend, sizeguess;
+	bool haveguess, ateof, crcvalid;
+	// When streaming out, how much has been written
+	FXfval outsize;
+#endif
+	QGZipDevicePrivate(QIODevice *_src, bool _streaming, FXuval _spacing) : src(_src), streaming(_streaming), spacing(_spacing), parallel(0), QMutex()
+#ifdef HAVE_ZLIB_H
+		, inh(0), outh(0), pc(0), index(true), obuf(0), olen(0), opos(0), oend(0), sizeguess(0), haveguess(false), ateof(false), crcvalid(true), outsize(0)
+#endif
+	{ }
+#ifdef HAVE_ZLIB_H
+	ZLib::gz_stream *ins() const { return (ZLib::gz_stream *) inh; }
+	void corrupt()
+	{
+		FXERRGIO(QTrans::tr("QGZipDevice", "Corrupt .gz data"));
+	}
+	FXfval inPos() const
+	{
+		return src->at()-ins()->stream.avail_in;
+	}
+	void addPoint(int bits)
+	{
+		if(!index.isEmpty() && oend<index.getLast()->out+spacing) return;
+		AccessPoint *ap;
+		FXERRHM(ap=new AccessPoint);
+		FXRBOp unap=FXRBNew(ap);
+		ap->out=oend;
+		ap->in=index.isEmpty() ? (FXfval) ins()->startpos : inPos();
+		ap->bits=bits;
+		ap->winlen=(FXuint) FXMIN(olen, (FXuval) GZ_WINSIZE);
+		memcpy(ap->window, obuf+olen-ap->winlen, ap->winlen);
+		index.append(ap);
+		unap.dismiss();
+	}
+	void openIn()
+	{
+		FXERRHM(inh=ZLib::gz_open(src, false));
+		FXERRHM(obuf=(FXuchar *) malloc(GZ_OBUFSIZE));
+		ZLib::gz_stream *s=ins();
+		if(Z_OK!=s->z_err && Z_STREAM_END!=s->z_err) corrupt();
+		olen=opos=0; oend=0; sizeguess=0; haveguess=false; ateof=(Z_STREAM_END==s->z_err); crcvalid=true;
+		if(!src->isSynchronous() && !s->transparent && !ateof)
+		{	// Start the index and guess the size from the trailer, which is modulo 4Gb
+			addPoint(0);
+			FXfval here=src->at(), srcsize=src->size();
+			FXuchar trailer[4];
+			if(srcsize>=(FXfval) s->startpos+8 && 4==src->readBlockFrom(trailer, 4, srcsize-4))
+			{
+				sizeguess=trailer[0]|(trailer[1]<<8)|(trailer[2]<<16)|(((FXfval) trailer[3])<<24);
+				haveguess=true;
+			}
+			src->at(here);
+		}
+	}
+	void closeIn()
+	{
+		if(inh) ZLib::gz_close(inh);
+		inh=0;
+		free(obuf);
+		obuf=0;
+		index.clear();
+	}
+	// Inflates more data into obuf, returning false at the end
+	bool fill()
+	{
+		ZLib::gz_stream *s=ins();
+		if(ateof) return false;
+		if(GZ_OBUFSIZE==olen)
+		{	// Keep a window's worth for access points and short back seeks
+			memmove(obuf, obuf+olen-GZ_WINSIZE, GZ_WINSIZE);
+			opos-=olen-GZ_WINSIZE;
+			olen=GZ_WINSIZE;
+		}
+		if(s->transparent)
+		{
+			FXuval read;
+			if(s->stream.avail_in)
+			{
+				read=FXMIN((FXuval) s->stream.avail_in, GZ_OBUFSIZE-olen);
+				memcpy(obuf+olen, s->stream.next_in, read);
+				s->stream.next_in+=read;
+				s->stream.avail_in-=(uInt) read;
+			}
+			else read=src->readBlock((char *) obuf+olen, GZ_OBUFSIZE-olen);
+			if(!read) ateof=true;
+			olen+=read; oend+=read;
+			return read!=0;
+		}
+		for(;;)
+		{
+			if(!s->stream.avail_in)
+			{
+				s->stream.next_in=s->inbuf;
+				if(!(s->stream.avail_in=(uInt) src->readBlock((char *) s->inbuf, Z_BUFSIZE)))
+					FXERRGIO(QTrans::tr("QGZipDevice", "Unexpected end of .gz data"));
+			}
+			Bytef *start=obuf+olen;
+			s->stream.next_out=start;
+			s->stream.avail_out=(uInt)(GZ_OBUFSIZE-olen);
+			int ret=inflate(&s->stream, Z_BLOCK);
+			if(Z_OK!=ret && Z_STREAM_END!=ret && Z_BUF_ERROR!=ret) corrupt();
+			FXuval made=(FXuval)(s->stream.next_out-start);
+			if(crcvalid) s->crc=crc32(s->crc, start, (uInt) made);
+			olen+=made; oend+=made;
+			if(Z_STREAM_END==ret)
+			{	// Check the trailer and look for a concatenated member
+				uLong crc=ZLib::getLong(s);
+				(void) ZLib::getLong(s);
+				if(Z_DATA_ERROR==s->z_err || (crcvalid && crc!=s->crc)) corrupt();
+				ZLib::check_header(s);
+				if(Z_OK!=s->z_err || s->transparent)
+				{	// Trailing garbage is ignored like gunzip does
+					s->transparent=0;
+					ateof=true;
+					return made!=0;
+				}
+				inflateReset(&s->stream);
+				s->crc=crc32(0L, Z_NULL, 0);
+				crcvalid=true;
+			}
+			else if(!src->isSynchronous() && (s->stream.data_type & 128) && !(s->stream.data_type & 64))
+				addPoint(s->stream.data_type & 7);
+			if(made) return true;
+		}
+	}
+	void restore(AccessPoint *ap)
+	{
+		ZLib::gz_stream *s=ins();
+		inflateReset(&s->stream);
+		src->at(ap->in-(ap->bits ? 1 : 0));
+		s->stream.avail_in=0;
+		s->z_eof=0;
+		s->z_err=Z_OK;
+		if(ap->bits)
+		{
+			int c=ZLib::get_byte(s);
+			if(EOF==c) corrupt();
+			inflatePrime(&s->stream, ap->bits, c>>(8-ap->bits));
+		}
+		if(ap->winlen) inflateSetDictionary(&s->stream, ap->window, ap->winlen);
+		memcpy(obuf, ap->window, ap->winlen);
+		olen=opos=ap->winlen;
+		oend=ap->out;
+		ateof=false;
+		// The CRC can only be checked when a member is inflated from its start
+		if((crcvalid=!ap->out)) s->crc=crc32(0L, Z_NULL, 0);
+	}
+	FXfval pos() const
+	{
+		return oend-(olen-opos);
+	}
+	void seek(FXfval newpos)
+	{
+		ZLib::gz_stream *s=ins();
+		FXfval obufstart=oend-olen;
+		if(newpos>=obufstart && newpos<=oend)
+		{
+			opos=(FXuval)(newpos-obufstart);
+			return;
+		}
+		if(s->transparent)
+		{
+			src->at(s->startpos+newpos);
+			s->stream.avail_in=0;
+			olen=opos=0;
+			oend=newpos;
+			ateof=false;
+			return;
+		}
+		// Restart from the nearest access point if going backwards or if it saves work
+		AccessPoint *ap=0;
+		if(!index.isEmpty())
+		{
+			FXuint lo=0, hi=index.count();
+			while(hi-lo>1)
+			{
+				FXuint mid=(lo+hi)/2;
+				if(index[mid]->out<=newpos) lo=mid; else hi=mid;
+			}
+			ap=index[lo];
+		}
+		if(newpos<obufstart || (ap && ap->out>oend))
+		{
+			if(!ap) FXERRG(QTrans::tr("QGZipDevice", "Can't seek backwards in a .gz stream read from a sequential device"), QGZIPDEVICE_NOTSEEKABLE, 0);
+			restore(ap);
+		}
+		while(oend<newpos)
+		{
+			opos=olen;
+			if(!fill()) break;
+		}
+		opos=(oend>newpos) ? olen-(FXuval)(oend-newpos) : olen;
+	}
+	FXuval read(char *data, FXuval maxlen)
+	{
+		FXuval read=0;
+		while(read<maxlen)
+		{
+			if(opos==olen && !fill()) break;
+			FXuval len=FXMIN(olen-opos, maxlen-read);
+			memcpy(data+read, obuf+opos, len);
+			opos+=len; read+=len;
+		}
+		return read;
+	}
+	FXuval write(const char *data, FXuval maxlen)
+	{
+		if(pc)
+		{
+			pc->write((const FXuchar *) data, maxlen);
+			outsize+=maxlen;
+			return maxlen;
+		}
+		ZLib::gz_stream *s=(ZLib::gz_stream *) outh;
+		FXuval written=0;
+		while(written<maxlen)
+		{
+			uInt len=(uInt) FXMIN(maxlen-written, (FXuval) 0x40000000);
+			written+=ZLib::gz_write(outh, data+written, len);
+			if(Z_OK!=s->z_err) FXERRGIO(QTrans::tr("QGZipDevice", "Failed to write .gz data"));
+		}
+		outsize+=written;
+		return written;
+	}
+	void notStreamable() const
+	{
+		FXERRG(QTrans::tr("QGZipDevice", "Can't seek a .gz stream being written"), QGZIPDEVICE_NOTSEEKABLE, 0);
+	}
 #endif
-	QGZipDevicePrivate(QIODevice *_src) : src(_src), QMutex() { }
 };
 
-QGZipDevice::QGZipDevice(QIODevice *src) : p(0), QIODevice()
+QGZipDevice::QGZipDevice(QIODevice *src, bool streaming, FXuval indexspacing) : p(0), QIODevice()
 {
-	FXERRHM(p=new QGZipDevicePrivate(src));
+	FXERRHM(p=new QGZipDevicePrivate(src, streaming, indexspacing));
 }
 
 QGZipDevice::~QGZipDevice()
@@ -465,6 +751,22 @@ void QGZipDevice::setGZData(QIODevice *src)
 	p->src=src;
 }
 
+bool QGZipDevice::isStreaming() const
+{
+	return p->streaming;
+}
+
+FXuval QGZipDevice::parallelCompression() const
+{
+	return p->parallel;
+}
+
+void QGZipDevice::setParallelCompression(FXuval blocksize)
+{
+	QMtxHold h(p);
+	p->parallel=blocksize;
+}
+
 bool QGZipDevice::open(FXuint mode)
 {
 	QMtxHold h(p);
@@ -479,22 +781,42 @@ bool QGZipDevice::open(FXuint mode)
 #else
 		//if(mode & IO_Truncate) FXERRG("Cannot truncate with this device", QGZIPDEVICE_CANTTRUNCATE, FXERRH_ISDEBUG);
 		FXERRH(p->src, "Need to set a source device before opening", QGZIPDEVICE_MISSINGSOURCE, FXERRH_ISDEBUG);
+		if(p->streaming)
+		{
+			FXERRH(IO_ReadWrite!=(mode & IO_ReadWrite) && !(mode & IO_Translate), "Streaming mode can only read or write untranslated data", QGZIPDEVICE_BADSTREAMINGMODE, FXERRH_ISDEBUG);
+			// Opening write only would usually truncate what we're appending to
+			if(p->src->isClosed()) p->src->open((mode & IO_Append) ? (mode|IO_ReadOnly) : mode);
+			if(mode & IO_ReadOnly)
+			{
+				p->openIn();
+			}
+			else
+			{
+				if(!p->src->isSynchronous()) p->src->at((mode & IO_Append) ? p->src->size() : 0);
+				if(p->parallel)
+					FXERRHM(p->pc=new QIODevice_ParallelCompressor(p->src, ZLib::gz_compressmember, Z_DEFAULT_COMPRESSION, p->parallel));
+				else
+					FXERRHM(p->outh=ZLib::gz_open(p->src, true));
+				p->outsize=0;
+			}
+			setFlags((mode & IO_ModeMask)|IO_Open);
+			ioIndex=0;
+			return true;
+		}
 		if(p->src->isClosed()) p->src->open(mode & ~IO_Translate);
+		// Growing a segmented buffer never copies, but translation needs it contiguous
+		p->uncomp.setSegmented(!(mode & IO_Translate));
 		p->uncomp.open(IO_ReadWrite);
 		if(mode & IO_ReadOnly)
 		{
 			if(!p->src->atEnd())
 			{
 				p->inh=ZLib::gz_open(p->src, false);
-				int len=Z_BUFSIZE, read, offset=0;
-				do
-				{
-					p->uncomp.buffer().resize(len);
-					FXuchar *data=p->uncomp.buffer().data()+offset;
-					read=ZLib::gz_read(p->inh, data, Z_BUFSIZE);
-					len+=read; offset+=read;
-				} while(read);
-				p->uncomp.buffer().resize(len-Z_BUFSIZE);
+				FXuchar buffer[Z_BUFSIZE];
+				int read;
+				while((read=ZLib::gz_read(p->inh, buffer, Z_BUFSIZE)))
+					p->uncomp.writeBlock((char *) buffer, read);
+				p->uncomp.at(0);
 				ZLib::gz_close(p->inh);
 				p->inh=0;
 				if(mode & IO_Translate)
@@ -536,6 +858,35 @@ void QGZipDevice::close()
 	QMtxHold h(p);
 	if(isOpen())
 	{
+		if(p->streaming)
+		{
+			int err=Z_OK;
+			if(isReadable())
+				p->closeIn();
+			else if(p->pc)
+			{
+				FXPtrHold<QIODevice_ParallelCompressor> pc(p->pc);
+				p->pc=0;
+				pc->finish();
+				if(!(mode() & IO_Append) && !p->src->isSynchronous()) p->src->truncate(p->src->at());
+			}
+			else if(p->outh)
+			{
+				// As gz_close(), but keeping the error
+				ZLib::gz_stream *s=(ZLib::gz_stream *) p->outh;
+				if(Z_OK==(err=ZLib::do_flush(p->outh, Z_FINISH)))
+				{
+					ZLib::putLong(p->src, s->crc);
+					ZLib::putLong(p->src, s->stream.total_in);
+				}
+				ZLib::destroy(s);
+				p->outh=0;
+				if(!(mode() & IO_Append) && !p->src->isSynchronous()) p->src->truncate(p->src->at());
+			}
+			setFlags(0);
+			if(Z_OK!=err) FXERRGIO(QTrans::tr("QGZipDevice", "Failed to write .gz data"));
+			return;
+		}
 		flush();
 		p->uncomp.truncate(0);
 		p->uncomp.close();
@@ -550,10 +901,23 @@ void QGZipDevice::flush()
 	QMtxHold h(p);
 	if(isOpen() && isWriteable())
 	{
-		FXuchar *data=p->uncomp.buffer().data();
-		FXuval datalen=p->uncomp.buffer().size();
+		if(p->streaming)
+		{	// Push out everything so far without ending the stream
+			if(p->pc)
+				p->pc->flush();
+			else if(Z_OK!=ZLib::do_flush(p->outh, Z_SYNC_FLUSH))
+				FXERRGIO(QTrans::tr("QGZipDevice", "Failed to write .gz data"));
+			return;
+		}
+		FXuchar *data=0;
+		FXuval datalen=(FXuval) p->uncomp.size();
+		if(isTranslated()) data=p->uncomp.buffer().data();
 		p->src->at(0);
-		p->outh=ZLib::gz_open(p->src, true);
+		FXPtrHold<QIODevice_ParallelCompressor> pc;
+		if(p->parallel)
+			FXERRHM(pc=new QIODevice_ParallelCompressor(p->src, ZLib::gz_compressmember, Z_DEFAULT_COMPRESSION, p->parallel));
+		else
+			p->outh=ZLib::gz_open(p->src, true);
 		if(isTranslated())
 		{
 			FXuchar buffer[4096];
@@ -562,13 +926,32 @@ void QGZipDevice::flush()
 			{
 				in=datalen-idx;
 				out=applyCRLF(buffer, data+idx, sizeof(buffer), in, crlfFormat(), unicodeTranslation());
-				ZLib::gz_write(p->outh, buffer, (FXuint) out);
+				if(pc)
+					pc->write(buffer, out);
+				else
+					ZLib::gz_write(p->outh, buffer, (FXuint) out);
 				idx+=in;
 			}
 		}
-		else ZLib::gz_write(p->outh, data, (FXuint) datalen);
-		ZLib::gz_close(p->outh);
-		p->outh=0;
+		else
+		{	// Compress straight out of the segments
+			QMemArray<IOVec> segs(p->uncomp.segments(0, 0));
+			if(!segs.empty()) p->uncomp.segments(segs.data(), (FXuint) segs.size());
+			for(FXuval n=0; n<segs.size(); n++)
+			{
+				if(pc)
+					pc->write((FXuchar *) segs.at(n).data, segs.at(n).len);
+				else
+					ZLib::gz_write(p->outh, segs.at(n).data, (FXuint) segs.at(n).len);
+			}
+		}
+		if(pc)
+			pc->finish();
+		else
+		{
+			ZLib::gz_close(p->outh);
+			p->outh=0;
+		}
 		p->src->truncate(p->src->at());
 		//p->src->flush();
 	}
@@ -579,6 +962,23 @@ FXfval QGZipDevice::size() const
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		if(!isOpen()) return 0;
+		if(isWriteable()) return p->outsize;
+		if(p->ateof) return p->oend;
+		if(p->ins()->transparent && !p->src->isSynchronous())
+		{	// Not compressed, so it's whatever follows the start
+			FXfval srcsize=p->src->size();
+			return (srcsize>(FXfval) p->ins()->startpos) ? srcsize-p->ins()->startpos : 0;
+		}
+		// Without a trailer (eg; a sequential source) only what has been inflated so far is known
+		if(!p->haveguess) return p->oend;
+		// The trailer only holds the size modulo 4Gb, so choose the first candidate after what we know
+		FXfval guess=p->sizeguess;
+		while(guess<p->oend) guess+=((FXfval) 1)<<32;
+		return guess;
+	}
 	return p->uncomp.size();
 #else
 	return 0;
@@ -589,6 +989,12 @@ void QGZipDevice::truncate(FXfval size)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		if(size!=QGZipDevice::size())
+			FXERRG(QTrans::tr("QGZipDevice", "Can't truncate a .gz stream"), QGZIPDEVICE_CANTTRUNCATE, 0);
+		return;
+	}
 	if((mode() & IO_ShredTruncate) && size<p->uncomp.size())
 		shredData(size);
 	p->uncomp.truncate(size);
@@ -599,6 +1005,8 @@ FXfval QGZipDevice::at() const
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+		return !isOpen() ? 0 : isWriteable() ? p->outsize : p->pos();
 	return p->uncomp.at();
 #else
 	return 0;
@@ -609,6 +1017,16 @@ bool QGZipDevice::at(FXfval newpos)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		if(!isOpen()) return false;
+		if(isWriteable())
+		{
+			if(newpos!=p->outsize) p->notStreamable();
+		}
+		else p->seek(newpos);
+		return true;
+	}
 	return p->uncomp.at(newpos);
 #else
 	return false;
@@ -619,6 +1037,11 @@ bool QGZipDevice::atEnd() const
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		if(!isOpen() || isWriteable()) return true;
+		return p->opos==p->olen && !p->fill();
+	}
 	return p->uncomp.atEnd();
 #else
 	return true;
@@ -629,6 +1052,8 @@ FXuval QGZipDevice::readBlock(char *data, FXuval maxlen)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+		return (isOpen() && isReadable()) ? p->read(data, maxlen) : 0;
 	return p->uncomp.readBlock(data, maxlen);
 #else
 	return 0;
@@ -639,6 +1064,8 @@ FXuval QGZipDevice::writeBlock(const char *data, FXuval maxlen)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+		return (isOpen() && isWriteable()) ? p->write(data, maxlen) : 0;
 	return p->uncomp.writeBlock(data, maxlen);
 #else
 	return 0;
@@ -649,6 +1076,12 @@ FXuval QGZipDevice::readBlockFrom(char *data, FXuval maxlen, FXfval pos)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		if(!isOpen() || !isReadable()) return 0;
+		p->seek(pos);
+		return p->read(data, maxlen);
+	}
 	p->uncomp.at(pos);
 	return p->uncomp.readBlock(data, maxlen);
 #else
@@ -659,6 +1092,12 @@ FXuval QGZipDevice::writeBlockTo(FXfval pos, const char *data, FXuval maxlen)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		if(!isOpen() || !isWriteable()) return 0;
+		if(pos!=p->outsize) p->notStreamable();
+		return p->write(data, maxlen);
+	}
 	p->uncomp.at(pos);
 	return p->uncomp.writeBlock(data, maxlen);
 #else
@@ -670,6 +1109,11 @@ int QGZipDevice::getch()
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		char c;
+		return (1==readBlock(&c, 1)) ? (FXuchar) c : -1;
+	}
 	return p->uncomp.getch();
 #else
 	return -1;
@@ -680,6 +1124,11 @@ int QGZipDevice::putch(int c)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{
+		char _c=(char) c;
+		return (1==writeBlock(&_c, 1)) ? c : -1;
+	}
 	return p->uncomp.putch(c);
 #else
 	return -1;
@@ -690,6 +1139,12 @@ int QGZipDevice::ungetch(int c)
 {
 #ifdef HAVE_ZLIB_H
 	QMtxHold h(p);
+	if(p->streaming)
+	{	// The byte just read is always still in the buffer
+		if(!isOpen() || !isReadable() || !p->opos) return -1;
+		p->obuf[--p->opos]=(FXuchar) c;
+		return c;
+	}
 	return p->uncomp.ungetch(c);
 #else
 	return -1;
@@ -28,11 +28,27 @@
 #include "FXSecure.h"
 #include "QBuffer.h"
 #include <qcstring.h>
+#include <qptrdict.h>
+#include <qintdict.h>
+#include <qptrvector.h>
+#include <qmemarray.h>
 #include <string.h>
 #include "FXErrCodes.h"
+#include "FXRollback.h"
 #ifdef USE_POSIX
 #include <sys/select.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "tnfxselect.h"
+#include "sigpipehandler.h"
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
 #else
 #include "WindowsGubbins.h"
 #endif
@@ -87,11 +103,209 @@ FXuval QIODevice::readLine(char *data, FXuval maxlen)
 	return count;
 }
 
+FXuval QIODevice::readBlockV(const IOVec *segs, FXuint count)
+{
+	FXuval readed=0;
+	for(FXuint n=0; n<count; n++)
+	{
+		FXuval r=readBlock(segs[n].data, segs[n].len);
+		readed+=r;
+		if(r<segs[n].len) break;
+	}
+	return readed;
+}
+
+FXuval QIODevice::writeBlockV(const IOVec *segs, FXuint count)
+{
+	FXuval written=0;
+	for(FXuint n=0; n<count; n++)
+	{
+		FXuval w=writeBlock(segs[n].data, segs[n].len);
+		written+=w;
+		if(w<segs[n].len) break;
+	}
+	return written;
+}
+
+#ifdef USE_POSIX
+FXuval QIODevice::int_vectoredIO(int fd, const IOVec *segs, FXuint count, bool write)
+{
+	FXuval total=0;
+	while(count)
+	{
+		struct iovec iov[64];
+		FXuint n, batch=FXMIN(count, (FXuint)(sizeof(iov)/sizeof(iov[0])));
+		FXuval want=0;
+		for(n=0; n<batch; n++)
+		{
+			iov[n].iov_base=segs[n].data;
+			want+=(iov[n].iov_len=segs[n].len);
+		}
+		ssize_t ret=write ? ::writev(fd, iov, (int) batch) : ::readv(fd, iov, (int) batch);
+		if(ret<0) return total ? total : (FXuval) -1;
+		total+=(FXuval) ret;
+		if((FXuval) ret<want) break;
+		segs+=batch; count-=batch;
+	}
+	return total;
+}
+#endif
+
+int QIODevice::int_transferHandle(bool)
+{
+	return -1;
+}
+
+void QIODevice::int_transferDone(bool, FXfval)
+{
+}
+
+#ifdef __linux__
+// Returns true if errno indicates the kernel can't do this kind of transfer
+static inline bool transferUnsupported()
+{
+	return EINVAL==errno || ENOSYS==errno || EXDEV==errno || EOPNOTSUPP==errno || EBADF==errno;
+}
+#endif
+
+FXfval QIODevice::transferTo(QIODevice &dst, FXfval len)
+{
+	FXfval moved=0;
+#ifdef __linux__
+	int src=int_transferHandle(false), dest=(src>=0) ? dst.int_transferHandle(true) : -1;
+	if(src>=0 && dest>=0)
+	{
+		struct stat ss, ds;
+		FXERRHIO(::fstat(src, &ss));
+		FXERRHIO(::fstat(dest, &ds));
+		enum { CopyRange, SendFile, Splice, Pump } method=Splice;
+		if(S_ISREG(ss.st_mode))
+			method=S_ISREG(ds.st_mode) ? CopyRange : SendFile;
+		int pipefds[2]={ -1, -1 };
+		bool waited=false;
+		QByteArray stranded;		// Data taken from the source which couldn't be spliced onwards
+		FXERRH_TRY
+		{
+			while(moved<len && Pump!=method)
+			{
+				FXuval chunk=(FXuval) FXMIN(len-moved, (FXfval) 1<<30);
+				ssize_t ret=-1;
+				QIODeviceS_SignalHandler::lockWrite();
+				if(CopyRange==method)
+				{
+#ifdef __NR_copy_file_range
+					ret=::syscall(__NR_copy_file_range, src, (loff_t *) 0, dest, (loff_t *) 0, chunk, 0);
+#else
+					errno=ENOSYS;
+#endif
+					if(ret<0 && transferUnsupported()) { method=SendFile; continue; }
+				}
+				else if(SendFile==method)
+				{
+					ret=::sendfile(dest, src, 0, chunk);
+					if(ret<0 && transferUnsupported()) { method=Splice; continue; }
+				}
+				else if(S_ISFIFO(ss.st_mode) || S_ISFIFO(ds.st_mode))
+				{
+					ret=::splice(src, 0, dest, 0, chunk, SPLICE_F_MOVE);
+					if(ret<0 && transferUnsupported()) { method=Pump; continue; }
+				}
+				else
+				{	// Neither end is a pipe, so splice through one of our own
+					if(-1==pipefds[0])
+					{	// The kernel refuses to splice into a file opened for appending, so
+						// find out before anything leaves the source
+						if(::fcntl(dest, F_GETFL) & O_APPEND) { method=Pump; continue; }
+						FXERRHIO(::pipe(pipefds));
+					}
+					ret=::splice(src, 0, pipefds[1], 0, FXMIN(chunk, (FXuval) 65536), SPLICE_F_MOVE);
+					if(ret<0 && transferUnsupported()) { method=Pump; continue; }
+					for(ssize_t togo=ret, out; togo>0;)
+					{
+						out=::splice(pipefds[0], 0, dest, 0, togo, SPLICE_F_MOVE);
+						if(out<0 && EAGAIN==errno)
+						{	// A non-blocking destination is full
+							fd_set fds;
+							FD_ZERO(&fds);
+							FD_SET(dest, &fds);
+							FXERRHIO(tnfxselect(dest+1, 0, &fds, 0, NULL));
+							continue;
+						}
+						if(out<0 && transferUnsupported())
+						{	// What has already left the source must go out the slow way
+							stranded.resize((FXuint) togo);
+							for(ssize_t readed=0, r; readed<togo; readed+=r)
+							{
+								FXERRHIO(r=::read(pipefds[0], stranded.data()+readed, togo-readed));
+							}
+							method=Pump;
+							break;
+						}
+						FXERRHIO(out);
+						togo-=out;
+					}
+				}
+				if(QIODeviceS_SignalHandler::unlockWrite())
+					FXERRGCONLOST("Broken pipe", 0);
+				if((ret<0 && EAGAIN==errno) || (!ret && !waited && S_ISFIFO(ss.st_mode)))
+				{	// A non-blocking handle (eg; the read end of a QPipe) isn't ready yet,
+					// or a FIFO whose other end hasn't yet connected looks closed
+					waited=!ret;
+					fd_set fds;
+					FD_ZERO(&fds);
+					FD_SET(src, &fds);
+					FXERRHIO(tnfxselect(src+1, &fds, 0, 0, NULL));
+					FD_ZERO(&fds);
+					FD_SET(dest, &fds);
+					FXERRHIO(tnfxselect(dest+1, 0, &fds, 0, NULL));
+					continue;
+				}
+				FXERRHIO(ret);
+				if(!ret) break;
+				moved+=ret;
+			}
+		}
+		FXERRH_CATCH(FXException &)
+		{
+			if(-1!=pipefds[0]) { ::close(pipefds[0]); ::close(pipefds[1]); }
+			int_transferDone(false, moved);
+			dst.int_transferDone(true, moved);
+			throw;
+		}
+		FXERRH_ENDTRY;
+		if(-1!=pipefds[0]) { ::close(pipefds[0]); ::close(pipefds[1]); }
+		int_transferDone(false, moved);
+		dst.int_transferDone(true, moved-stranded.size());
+		if(Pump!=method) return moved;
+		for(FXuval written=0; written<stranded.size();)
+		{
+			FXuval writ=dst.writeBlock(stranded.data()+written, stranded.size()-written);
+			if(!writ) FXERRGIO(QTrans::tr("QIODevice", "Destination device accepted no data"));
+			written+=writ;
+		}
+	}
+#endif
+	QByteArray buffer((FXuint) FXMIN(len-moved, (FXfval) 256*1024));
+	while(moved<len)
+	{
+		FXuval readed=readBlock(buffer.data(), (FXuval) FXMIN(len-moved, (FXfval) buffer.size())), written=0;
+		if(!readed) break;
+		while(written<readed)
+		{
+			FXuval writ=dst.writeBlock(buffer.data()+written, readed-written);
+			if(!writ) FXERRGIO(QTrans::tr("QIODevice", "Destination device accepted no data"));
+			written+=writ;
+		}
+		moved+=readed;
+	}
+	return moved;
+}
+
 int QIODevice::getch()
 {
 	char ret=0;
 	if(readBlock(&ret, 1))
-		return (int) ret;
+		return (int)(FXuchar) ret;
 	else
 		return -1;
 }
@@ -427,6 +641,7 @@ FXStream &operator>>(FXStream &s, QIODevice &i)
 	char buffer[256*1024];
 	FXuval read;
 	QIODevice *sdev=s.device();
+	s.flush();		// Return any read-ahead to the device
 	i.at(0);
 	while((read=sdev->readBlock(buffer, sizeof(buffer))))
 	{
@@ -496,12 +711,33 @@ bool QIODeviceS::waitForData(QIODeviceS **signalled, FXuint no, QIODeviceS **lis
 	}
 	fd_set fds;
 	FD_ZERO(&fds);
+#ifndef USE_EPOLL
 	FXERRH(no<=FD_SETSIZE, "FD_SETSIZE exceeded", 0, FXERRH_ISDEBUG);
+#endif
 	int maxfd=0;
 	for(FXuint n=0; n<no; n++)
 	{
 		int fd=(int)(FXuval) list[n]->int_getOSHandle();
 		FXERRH(fd, QTrans::tr("QIODeviceS", "Either i/o device is not open or not supported"), 0, FXERRH_ISDEBUG);
+#ifdef USE_EPOLL
+		if(fd>=FD_SETSIZE)
+		{	// select() can't do this, so use a throwaway epoll set
+			QIODeviceSWaitSet set;
+			for(n=0; n<no; n++)
+				set.add(list[n]);
+			if(signalled)
+			{
+				FXuint ready=set.wait(signalled, no, waitfor);
+				for(n=ready; n<no; n++)
+					signalled[n]=0;
+				return ready>0;
+			}
+			QIODeviceS *dummy;
+			return set.wait(&dummy, 1, waitfor)>0;
+		}
+#else
+		FXERRH(fd<FD_SETSIZE, "FD_SETSIZE exceeded", 0, FXERRH_ISDEBUG);
+#endif
 		FD_SET(fd, &fds);
 		if(fd>maxfd) maxfd=fd;
 	}
@@ -527,10 +763,212 @@ FXuint QIODeviceS::waitForDataMax() throw()
 {
 #ifndef USE_POSIX
 	return MAXIMUM_WAIT_OBJECTS-1;
+#elif defined(USE_EPOLL)
+	return (FXuint)-1;
 #else
 	return FD_SETSIZE;
 #endif
 }
 
+//***************************************************************************************
+
+struct FXDLLLOCAL QIODeviceSWaitSetPrivate : public QMutex
+{
+	QPtrDict<QIODeviceS> devices;
+#ifdef USE_EPOLL
+	// epoll takes each OS handle only once, yet several devices can share one
+	// (eg; a FX::QSSLDevice and the socket beneath it)
+	struct Handle
+	{
+		int fd;
+		QPtrVector<QIODeviceS> devices;
+		Handle(int _fd) : fd(_fd) { }
+	};
+	QIntDict<Handle> handles;
+	QPtrDict<Handle> handleOf;
+	int epollh;
+	QIODeviceSWaitSetPrivate() : devices(1021), handles(1021, true), handleOf(1021), epollh(-1), QMutex() { }
+	~QIODeviceSWaitSetPrivate()
+	{
+		if(epollh>=0) ::close(epollh);
+		epollh=-1;
+	}
+#else
+	QIODeviceSWaitSetPrivate() : devices(1021), QMutex() { }
+#endif
+};
+
+QIODeviceSWaitSet::QIODeviceSWaitSet() : p(0)
+{
+	FXERRHM(p=new QIODeviceSWaitSetPrivate);
+	FXRBOp unnew=FXRBNew(p);
+#ifdef USE_EPOLL
+#ifdef EPOLL_CLOEXEC
+	FXERRHIO(p->epollh=::epoll_create1(EPOLL_CLOEXEC));
+#else
+	FXERRHIO(p->epollh=::epoll_create(1024));
+	::fcntl(p->epollh, F_SETFD, FD_CLOEXEC);
+#endif
+#endif
+	unnew.dismiss();
+}
+
+QIODeviceSWaitSet::~QIODeviceSWaitSet()
+{ FXEXCEPTIONDESTRUCT1 {
+	FXDELETE(p);
+} FXEXCEPTIONDESTRUCT2; }
+
+void QIODeviceSWaitSet::add(QIODeviceS *dev)
+{
+	QMtxHold h(p);
+	if(p->devices.find(dev)) return;
+	void *handle=dev->int_getOSHandle();
+	FXERRH(handle, QTrans::tr("QIODeviceS", "Either i/o device is not open or not supported"), 0, FXERRH_ISDEBUG);
+#ifdef USE_EPOLL
+	int fd=(int)(FXuval) handle;
+	QIODeviceSWaitSetPrivate::Handle *hd=p->handles.find(fd);
+	if(hd)
+	{
+		hd->devices.append(dev);
+		FXRBOp unappend=FXRBObj(hd->devices, &QPtrVector<QIODeviceS>::removeRef, dev);
+		p->handleOf.insert(dev, hd);
+		FXRBOp unhandleof=FXRBObj(p->handleOf, &QPtrDict<QIODeviceSWaitSetPrivate::Handle>::remove, dev);
+		p->devices.insert(dev, dev);
+		unhandleof.dismiss();
+		unappend.dismiss();
+		return;
+	}
+	FXERRHM(hd=new QIODeviceSWaitSetPrivate::Handle(fd));
+	FXRBOp unnew=FXRBNew(hd);
+	hd->devices.append(dev);
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events=EPOLLIN;
+	ev.data.fd=fd;
+	FXERRHIO(::epoll_ctl(p->epollh, EPOLL_CTL_ADD, fd, &ev));
+	FXRBOp unadd=FXRBFunc(::epoll_ctl, p->epollh, EPOLL_CTL_DEL, fd, &ev);
+	p->handles.insert(fd, hd);
+	unnew.dismiss();
+	FXRBOp unhandles=FXRBObj(p->handles, &QIntDict<QIODeviceSWaitSetPrivate::Handle>::remove, fd);
+	p->handleOf.insert(dev, hd);
+	FXRBOp unhandleof=FXRBObj(p->handleOf, &QPtrDict<QIODeviceSWaitSetPrivate::Handle>::remove, dev);
+	p->devices.insert(dev, dev);
+	unhandleof.dismiss();
+	unhandles.dismiss();
+	unadd.dismiss();
+#else
+	p->devices.insert(dev, dev);
+#endif
+}
+
+bool QIODeviceSWaitSet::remove(QIODeviceS *dev)
+{
+	QMtxHold h(p);
+	if(!p->devices.find(dev)) return false;
+#ifdef USE_EPOLL
+	QIODeviceSWaitSetPrivate::Handle *hd=p->handleOf.find(dev);
+	if(hd->devices.count()<=1)
+	{	// The handle may already have gone if the device was closed, in which case
+		// the kernel has already dropped it
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		if(::epoll_ctl(p->epollh, EPOLL_CTL_DEL, hd->fd, &ev)<0 && ENOENT!=errno && EBADF!=errno)
+			FXERRHIO(-1);
+		p->handles.remove(hd->fd);
+	}
+	else
+		hd->devices.removeRef(dev);
+	p->handleOf.remove(dev);
+#endif
+	p->devices.remove(dev);
+	return true;
+}
+
+bool QIODeviceSWaitSet::contains(QIODeviceS *dev) const
+{
+	QMtxHold h(p);
+	return p->devices.find(dev)!=0;
+}
+
+FXuint QIODeviceSWaitSet::count() const
+{
+	QMtxHold h(p);
+	return p->devices.count();
+}
+
+void QIODeviceSWaitSet::clear()
+{
+	QMtxHold h(p);
+#ifdef USE_EPOLL
+	// Quicker to start again than to remove each
+	int newh;
+#ifdef EPOLL_CLOEXEC
+	FXERRHIO(newh=::epoll_create1(EPOLL_CLOEXEC));
+#else
+	FXERRHIO(newh=::epoll_create(1024));
+	::fcntl(newh, F_SETFD, FD_CLOEXEC);
+#endif
+	::close(p->epollh);
+	p->epollh=newh;
+	p->handleOf.clear();
+	p->handles.clear();
+#endif
+	p->devices.clear();
+}
+
+FXuint QIODeviceSWaitSet::wait(QIODeviceS **signalled, FXuint max, FXuint waitfor)
+{
+	if(!max) return 0;
+#ifdef USE_EPOLL
+	struct epoll_event evs[256];
+	FXuint out=0;
+	for(;;)
+	{
+		int ret;
+		do
+		{	// epoll_wait() is a cancellation point
+			ret=::epoll_wait(p->epollh, evs, (int) FXMIN(max, (FXuint)(sizeof(evs)/sizeof(evs[0]))),
+				(FXINFINITE==waitfor) ? -1 : (int) waitfor);
+		} while(ret<0 && EINTR==errno);
+		FXERRHIO(ret);
+		if(!ret) break;
+		// Events are translated to devices under the lock, so a device is never returned
+		// once remove() has returned
+		QMtxHold h(p);
+		for(int n=0; n<ret && out<max; n++)
+		{
+			QIODeviceSWaitSetPrivate::Handle *hd=p->handles.find(evs[n].data.fd);
+			if(!hd) continue;
+			for(FXuint i=0; i<hd->devices.count() && out<max; i++)
+				signalled[out++]=hd->devices.at(i);
+		}
+		// Go round again if everything signalled was removed in the meantime
+		if(out) break;
+	}
+	if(out<max) signalled[out]=0;
+	return out;
+#else
+	QMemArray<QIODeviceS *> list;
+	{
+		QMtxHold h(p);
+		QIODeviceS *dev;
+		for(QPtrDictIterator<QIODeviceS> it(p->devices); (dev=it.current()); ++it)
+			list.push_back(dev);
+	}
+	if(list.empty()) return 0;
+	QMemArray<QIODeviceS *> ready(list.size());
+	if(!QIODeviceS::waitForData(ready.data(), (FXuint) list.size(), list.data(), waitfor)) return 0;
+	QMtxHold h(p);
+	FXuint n=0;
+	for(FXuint i=0; n<max && i<ready.size() && ready.at(i); i++)
+	{	// Skip any removed during the wait
+		if(p->devices.find(ready.at(i)))
+			signalled[n++]=ready.at(i);
+	}
+	if(n<max) signalled[n]=0;
+	return n;
+#endif
+}
+
 } // namespace
 
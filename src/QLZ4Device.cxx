@@ -0,0 +1,481 @@
+/********************************************************************************
+*                                                                               *
+*                          Filter device applying .lz4                          *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#include "QLZ4Device.h"
+#include "FXException.h"
+#include "QThread.h"
+#include "QTrans.h"
+#include <qcstring.h>
+#include <qmemarray.h>
+#include "lz4/lz4.h"
+#include "FXErrCodes.h"
+#include "FXMemDbg.h"
+#if defined(DEBUG) && defined(FXMEMDBG_H)
+static const char *_fxmemdbg_current_file_ = __FILE__;
+#endif
+
+namespace FX {
+
+#define LZ4_MAGIC 0x184D2204
+#define LZ4_SKIPPABLEMAGIC 0x184D2A50	// Bottom four bits can be anything
+
+static inline FXuint getLong(const FXuchar *p)
+{
+	return p[0]|(p[1]<<8)|(p[2]<<16)|(((FXuint) p[3])<<24);
+}
+static inline void putLong(FXuchar *p, FXuint v)
+{
+	p[0]=(FXuchar) v; p[1]=(FXuchar)(v>>8); p[2]=(FXuchar)(v>>16); p[3]=(FXuchar)(v>>24);
+}
+
+struct FXDLLLOCAL QLZ4DevicePrivate : public QMutex
+{
+	QIODevice *src;
+	FXuint bdcode;					// The frame format's block size code (4-7)
+	FXuval blocksize;
+	// Where each block is in the source
+	struct Block
+	{
+		FXfval in, out;				// Offset of its data in the source and its uncompressed offset
+		FXuint inlen, outlen;
+		bool raw, checksum;
+	};
+	QMemArray<Block> index;
+	QByteArray buf, cbuf;			// Uncompressed and compressed data
+	// When reading
+	FXfval start, srcpos, scanpos, scanned;
+	FXint oblock, cblock;			// Which blocks buf and cbuf hold
+	bool inframe, ateof, blockchecksums, contentchecksum;
+	FXuint blockmax;
+	// When writing
+	FXuval ilen;
+
+	QLZ4DevicePrivate(QIODevice *_src, FXuval _blocksize) : src(_src), bdcode(4), QMutex()
+	{
+		while(bdcode<7 && _blocksize>(((FXuval) 1)<<(2*bdcode+8))) bdcode++;
+		blocksize=((FXuval) 1)<<(2*bdcode+8);
+		reset();
+	}
+	void reset()
+	{
+		index.truncate(0);
+		buf.resize(0);
+		cbuf.resize(0);
+		start=srcpos=scanpos=scanned=0;
+		oblock=cblock=-1;
+		inframe=ateof=blockchecksums=contentchecksum=false;
+		blockmax=0;
+		ilen=0;
+	}
+	void corrupt() const
+	{
+		FXERRGIO(QTrans::tr("QLZ4Device", "Corrupt .lz4 data"));
+	}
+	void notStreamable() const
+	{
+		FXERRG(QTrans::tr("QLZ4Device", "Can't seek a .lz4 stream being written"), QLZ4DEVICE_NOTSEEKABLE, 0);
+	}
+	// Reads up to len bytes from offset in the source
+	FXuval readIn(FXfval offset, void *data, FXuval len)
+	{
+		if(src->isSynchronous())
+		{
+			if(offset<srcpos) FXERRG(QTrans::tr("QLZ4Device", "Can't seek backwards in a .lz4 stream read from a sequential device"), QLZ4DEVICE_NOTSEEKABLE, 0);
+			char skip[4096];
+			for(FXuval read; srcpos<offset; srcpos+=read)
+			{
+				if(!(read=src->readBlock(skip, (FXuval) FXMIN((FXfval) sizeof(skip), offset-srcpos)))) return 0;
+			}
+		}
+		else if(srcpos!=offset)
+			src->at(offset);
+		FXuval done=0;
+		for(FXuval read; done<len && (read=src->readBlock((char *) data+done, len-done)); done+=read);
+		srcpos=offset+done;
+		return done;
+	}
+	// Indexes the next block in the source, returning false at the end
+	bool scan()
+	{
+		FXuchar hdr[16];
+		while(!ateof)
+		{
+			if(!inframe)
+			{
+				FXuval read=readIn(scanpos, hdr, 4);
+				FXuint magic=(4==read) ? getLong(hdr) : 0;
+				if(LZ4_SKIPPABLEMAGIC==(magic & 0xFFFFFFF0))
+				{
+					if(4!=readIn(scanpos+4, hdr, 4)) corrupt();
+					scanpos+=8+getLong(hdr);
+					continue;
+				}
+				if(LZ4_MAGIC!=magic)
+				{	// Anything following the frames is ignored, but there must be one
+					if(read && scanpos==start) corrupt();
+					ateof=true;
+					break;
+				}
+				if(3!=readIn(scanpos+4, hdr, 3)) corrupt();
+				FXuchar flg=hdr[0], bd=hdr[1];
+				if(1!=(flg>>6) || (flg & 2) || (bd & 0x8F) || ((bd>>4) & 7)<4) corrupt();
+				if(!(flg & 0x20) || (flg & 1))
+					FXERRG(QTrans::tr("QLZ4Device", "Linked blocks and dictionaries in .lz4 data are not supported"), QLZ4DEVICE_UNSUPPORTED, 0);
+				FXuint desclen=2;
+				if(flg & 8)
+				{	// Skip the content size, as we find it out anyway
+					if(8!=readIn(scanpos+7, hdr+3, 8)) corrupt();
+					desclen+=8;
+				}
+				if(hdr[desclen]!=((TnFXLZ4_xxh32(hdr, desclen, 0)>>8) & 0xFF)) corrupt();
+				blockchecksums=(flg & 0x10)!=0;
+				contentchecksum=(flg & 4)!=0;
+				blockmax=1<<(2*((bd>>4) & 7)+8);
+				scanpos+=4+desclen+1;
+				inframe=true;
+			}
+			if(4!=readIn(scanpos, hdr, 4)) corrupt();
+			FXuint size=getLong(hdr);
+			if(!size)
+			{	// End of frame, whose content checksum is ignored as we don't read in order
+				scanpos+=4+(contentchecksum ? 4 : 0);
+				inframe=false;
+				continue;
+			}
+			Block b;
+			b.in=scanpos+4;
+			b.out=scanned;
+			b.inlen=size & 0x7FFFFFFF;
+			b.raw=(size & 0x80000000)!=0;
+			b.checksum=blockchecksums;
+			if(b.inlen>blockmax) corrupt();
+			// The compressed data must be read to find its uncompressed length, so keep it
+			FXuint toread=b.inlen+(b.checksum ? 4 : 0);
+			if(cbuf.size()<toread) cbuf.resize(toread);
+			if(toread!=readIn(b.in, cbuf.data(), toread)) corrupt();
+			cblock=-1;
+			scanpos=b.in+toread;
+			if(b.raw)
+				b.outlen=b.inlen;
+			else
+			{
+				int outlen=TnFXLZ4_decompressedSize((char *) cbuf.data(), (int) b.inlen, (int) blockmax);
+				if(outlen<0) corrupt();
+				b.outlen=(FXuint) outlen;
+			}
+			if(!b.outlen) continue;
+			cblock=(FXint) index.size();
+			index.push_back(b);
+			scanned+=b.outlen;
+			return true;
+		}
+		return false;
+	}
+	// Returns the block holding pos or -1 if it's after the end
+	FXint find(FXfval pos)
+	{
+		while(pos>=scanned)
+			if(!scan()) return -1;
+		// Usually it's the current or the next block
+		for(FXint i=oblock; i>=0 && i<=oblock+1 && i<(FXint) index.size(); i++)
+		{
+			const Block &b=index[i];
+			if(pos>=b.out && pos<b.out+b.outlen) return i;
+		}
+		FXint lo=0, hi=(FXint) index.size()-1;
+		while(lo<hi)
+		{
+			FXint mid=(lo+hi+1)/2;
+			if(index[mid].out<=pos) lo=mid; else hi=mid-1;
+		}
+		return lo;
+	}
+	// Decompresses block i into buf
+	void load(FXint i)
+	{
+		if(oblock==i) return;
+		const Block &b=index[i];
+		FXuint inlen=b.inlen+(b.checksum ? 4 : 0);
+		oblock=-1;
+		if(cblock!=i)
+		{
+			if(cbuf.size()<inlen) cbuf.resize(inlen);
+			if(inlen!=readIn(b.in, cbuf.data(), inlen)) corrupt();
+			cblock=i;
+		}
+		if(b.checksum && getLong(cbuf.data()+b.inlen)!=TnFXLZ4_xxh32(cbuf.data(), b.inlen, 0)) corrupt();
+		if(buf.size()<b.outlen) buf.resize(b.outlen);
+		if(b.raw)
+			memcpy(buf.data(), cbuf.data(), b.outlen);
+		else if((int) b.outlen!=TnFXLZ4_decompress((char *) cbuf.data(), (char *) buf.data(), (int) b.inlen, (int) b.outlen))
+			corrupt();
+		oblock=i;
+	}
+	FXuval read(FXfval pos, char *data, FXuval maxlen)
+	{
+		FXuval done=0;
+		for(FXint i; done<maxlen && (i=find(pos))>=0;)
+		{
+			load(i);
+			const Block &b=index[i];
+			FXuval offset=(FXuval)(pos-b.out), tocopy=FXMIN(maxlen-done, b.outlen-offset);
+			memcpy(data+done, buf.data()+offset, tocopy);
+			done+=tocopy;
+			pos+=tocopy;
+		}
+		return done;
+	}
+	void writeHeader()
+	{	// Independent blocks without checksums
+		FXuchar hdr[7];
+		putLong(hdr, LZ4_MAGIC);
+		hdr[4]=0x60;
+		hdr[5]=(FXuchar)(bdcode<<4);
+		hdr[6]=(FXuchar)((TnFXLZ4_xxh32(hdr+4, 2, 0)>>8) & 0xFF);
+		src->writeBlock((char *) hdr, sizeof(hdr));
+	}
+	// Writes a block, storing it uncompressed if it won't compress
+	void writeOut(const FXuchar *data, FXuval len)
+	{
+		FXuchar size[4];
+		QIODevice::IOVec segs[2];
+		segs[0]=QIODevice::IOVec((char *) size, 4);
+		int clen=TnFXLZ4_compress((const char *) data, (char *) cbuf.data(), (int) len, (int) len-1);
+		if(clen>0)
+		{
+			putLong(size, (FXuint) clen);
+			segs[1]=QIODevice::IOVec((char *) cbuf.data(), clen);
+		}
+		else
+		{
+			putLong(size, ((FXuint) len)|0x80000000);
+			segs[1]=QIODevice::IOVec((const char *) data, len);
+		}
+		src->writeBlockV(segs, 2);
+	}
+	FXuval write(const char *data, FXuval len)
+	{
+		for(FXuval idx=0; idx<len;)
+		{
+			if(!ilen && len-idx>=blocksize)
+			{	// Compress straight from the caller's buffer
+				writeOut((const FXuchar *) data+idx, blocksize);
+				idx+=blocksize;
+				continue;
+			}
+			FXuval tocopy=FXMIN(len-idx, blocksize-ilen);
+			memcpy(buf.data()+ilen, data+idx, tocopy);
+			ilen+=tocopy;
+			idx+=tocopy;
+			if(blocksize==ilen)
+			{
+				writeOut(buf.data(), ilen);
+				ilen=0;
+			}
+		}
+		return len;
+	}
+};
+
+QLZ4Device::QLZ4Device(QIODevice *src, FXuval blocksize) : p(0), QIODevice()
+{
+	FXERRHM(p=new QLZ4DevicePrivate(src, blocksize));
+}
+
+QLZ4Device::~QLZ4Device()
+{ FXEXCEPTIONDESTRUCT1 {
+	if(p)
+	{
+		close();
+		FXDELETE(p);
+	}
+} FXEXCEPTIONDESTRUCT2; }
+
+QIODevice *QLZ4Device::LZ4Data() const
+{
+	return p->src;
+}
+
+void QLZ4Device::setLZ4Data(QIODevice *src)
+{
+	p->src=src;
+}
+
+FXuval QLZ4Device::blockSize() const
+{
+	return p->blocksize;
+}
+
+bool QLZ4Device::open(FXuint mode)
+{
+	QMtxHold h(p);
+	if(isOpen())
+	{	// I keep fouling myself up here, so assertion check
+		if(QIODevice::mode()!=mode) FXERRGIO(QTrans::tr("QLZ4Device", "Device reopen has different mode"));
+	}
+	else
+	{
+		FXERRH(p->src, "Need to set a source device before opening", QLZ4DEVICE_MISSINGSOURCE, FXERRH_ISDEBUG);
+		FXERRH(IO_ReadWrite!=(mode & IO_ReadWrite) && !(mode & IO_Translate), "QLZ4Device can only read or write untranslated data", QLZ4DEVICE_BADMODE, FXERRH_ISDEBUG);
+		// Opening write only would usually truncate what we're appending to
+		if(p->src->isClosed()) p->src->open((mode & IO_Append) ? (mode|IO_ReadOnly) : mode);
+		p->reset();
+		if(mode & IO_ReadOnly)
+		{
+			p->start=p->srcpos=p->scanpos=p->src->isSynchronous() ? 0 : p->src->at();
+		}
+		else
+		{
+			if(!p->src->isSynchronous()) p->src->at((mode & IO_Append) ? p->src->size() : 0);
+			p->buf.resize(p->blocksize);
+			p->cbuf.resize(p->blocksize);
+			p->writeHeader();
+		}
+		setFlags((mode & IO_ModeMask)|IO_Open);
+		ioIndex=0;
+	}
+	return true;
+}
+
+void QLZ4Device::close()
+{
+	QMtxHold h(p);
+	if(isOpen())
+	{
+		if(isWriteable())
+		{
+			if(p->ilen) p->writeOut(p->buf.data(), p->ilen);
+			p->ilen=0;
+			static const char endmark[4]={ 0, 0, 0, 0 };
+			p->src->writeBlock(endmark, sizeof(endmark));
+			if(!(mode() & IO_Append) && !p->src->isSynchronous()) p->src->truncate(p->src->at());
+		}
+		p->reset();
+		setFlags(0);
+		ioIndex=0;
+	}
+}
+
+void QLZ4Device::flush()
+{
+	QMtxHold h(p);
+	if(isOpen() && isWriteable() && p->ilen)
+	{	// Push out everything so far as a short block
+		p->writeOut(p->buf.data(), p->ilen);
+		p->ilen=0;
+	}
+}
+
+FXfval QLZ4Device::size() const
+{
+	QMtxHold h(p);
+	if(!isOpen()) return 0;
+	if(isWriteable()) return ioIndex;
+	while(p->scan());
+	return p->scanned;
+}
+
+void QLZ4Device::truncate(FXfval size)
+{
+	QMtxHold h(p);
+	if(size!=QLZ4Device::size())
+		FXERRG(QTrans::tr("QLZ4Device", "Can't truncate a .lz4 stream"), QLZ4DEVICE_CANTTRUNCATE, 0);
+}
+
+FXfval QLZ4Device::at() const
+{
+	QMtxHold h(p);
+	return ioIndex;
+}
+
+bool QLZ4Device::at(FXfval newpos)
+{
+	QMtxHold h(p);
+	if(!isOpen()) return false;
+	if(isWriteable() && newpos!=ioIndex) p->notStreamable();
+	ioIndex=newpos;
+	return true;
+}
+
+bool QLZ4Device::atEnd() const
+{
+	QMtxHold h(p);
+	if(!isOpen() || isWriteable()) return true;
+	return p->find(ioIndex)<0;
+}
+
+FXuval QLZ4Device::readBlock(char *data, FXuval maxlen)
+{
+	QMtxHold h(p);
+	if(!isOpen() || !isReadable()) return 0;
+	FXuval read=p->read(ioIndex, data, maxlen);
+	ioIndex+=read;
+	return read;
+}
+
+FXuval QLZ4Device::writeBlock(const char *data, FXuval maxlen)
+{
+	QMtxHold h(p);
+	if(!isOpen() || !isWriteable()) return 0;
+	p->write(data, maxlen);
+	ioIndex+=maxlen;
+	return maxlen;
+}
+
+FXuval QLZ4Device::readBlockFrom(char *data, FXuval maxlen, FXfval pos)
+{
+	QMtxHold h(p);
+	if(!isOpen() || !isReadable()) return 0;
+	return p->read(pos, data, maxlen);
+}
+
+FXuval QLZ4Device::writeBlockTo(FXfval pos, const char *data, FXuval maxlen)
+{
+	QMtxHold h(p);
+	if(!isOpen() || !isWriteable()) return 0;
+	if(pos!=ioIndex) p->notStreamable();
+	return writeBlock(data, maxlen);
+}
+
+int QLZ4Device::getch()
+{
+	char c;
+	return (1==readBlock(&c, 1)) ? (FXuchar) c : -1;
+}
+
+int QLZ4Device::putch(int c)
+{
+	char _c=(char) c;
+	return (1==writeBlock(&_c, 1)) ? c : -1;
+}
+
+int QLZ4Device::ungetch(int c)
+{
+	QMtxHold h(p);
+	if(!isOpen() || !isReadable() || !ioIndex) return -1;
+	FXint i=p->find(ioIndex-1);
+	p->load(i);
+	p->buf[(FXuint)(ioIndex-1-p->index[i].out)]=(FXuchar) c;
+	ioIndex--;
+	return c;
+}
+
+} // namespace
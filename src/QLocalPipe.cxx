@@ -21,7 +21,21 @@
 
 #include <qptrlist.h>
 #include "QLocalPipe.h"
-#include "QThread.h"
+#include "QThread.h"		// May undefine USE_WINAPI and USE_POSIX
+#include "FXProcess.h"
+#if defined(USE_POSIX) && defined(__linux__)
+ #include <unistd.h>
+ #include <time.h>
+ #include <pthread.h>
+ #include <sys/syscall.h>
+ #include <linux/futex.h>
+ #if defined(SYS_futex) && defined(FUTEX_WAIT_PRIVATE)
+  #define USE_FUTEX
+ #endif
+#endif
+#if defined(_MSC_VER)
+ #include <intrin.h>
+#endif
 #include "FXException.h"
 #include "QTrans.h"
 #include "FXRollback.h"
@@ -68,6 +82,112 @@ struct Buffer
 		data.clear();
 	}
 };
+
+// RINGORDER() stops loads and stores being moved across it, RINGFENCE() also
+// stops a store being moved after a following load
+#if defined(__GNUC__)
+ #if defined(__i386__) || defined(__x86_64__)
+  // x86 only ever moves a store after a following load, so the compiler is all that needs stopping
+  #define RINGORDER() __asm__ __volatile__("" ::: "memory")
+  #define RINGPAUSE() __asm__ __volatile__("pause")
+ #else
+  #define RINGORDER() __sync_synchronize()
+  #define RINGPAUSE()
+ #endif
+ #define RINGFENCE() __sync_synchronize()
+#elif defined(_MSC_VER)
+ #define RINGORDER() _ReadWriteBarrier()
+ #define RINGFENCE() _mm_mfence()
+ #define RINGPAUSE() _mm_pause()
+#endif
+// Bigger than any cache line
+#define CACHELINE 128
+// How many times to look again before going to sleep when the other end could be running
+#define RINGSPINS 256
+
+/* Somewhere for one side of a ring to sleep. It only ever sleeps having said
+so in sleeping and rechecked the ring, and the other side only makes the
+syscall to wake it if it sees that, so when data is flowing neither side ever
+enters the kernel. */
+struct FXDLLLOCAL RingWaiter
+{
+	volatile int sleeping;
+#ifdef USE_FUTEX
+	volatile int seq;				// Bumped by each wake and waited upon
+	int expected;
+	RingWaiter() : sleeping(0), seq(0), expected(0) { }
+#else
+	QWaitCondition wakeup;
+	RingWaiter() : sleeping(0) { }
+#endif
+	void prepare()
+	{
+#ifdef USE_FUTEX
+		expected=seq;
+#else
+		wakeup.reset();
+#endif
+		sleeping=1;
+		RINGFENCE();
+	}
+	// Must be preceded by prepare() then a recheck of whatever is being waited for
+	void sleep()
+	{
+#ifdef USE_FUTEX
+		// Wait in slices so cancellation and the other end closing can't be missed
+		struct timespec slice={0, 100000000};
+		::syscall(SYS_futex, &seq, FUTEX_WAIT_PRIVATE, expected, &slice, 0, 0);
+		sleeping=0;
+		pthread_testcancel();
+#else
+		wakeup.wait(100);
+		sleeping=0;
+#endif
+	}
+	void cancel() { sleeping=0; }
+	// Must be preceded by RINGFENCE()
+	void wake(bool always=false)
+	{
+		if(always || sleeping)
+		{
+#ifdef USE_FUTEX
+			__sync_fetch_and_add(&seq, 1);
+			::syscall(SYS_futex, &seq, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+#else
+			wakeup.wakeAll();
+#endif
+		}
+	}
+};
+
+/* A fixed capacity ring for exactly one reader and one writer which needs no
+lock. head is only ever advanced by the writer and tail by the reader, both
+counting bytes ever transferred so the ring is empty when they're equal. Each
+lives on its own cache line along with what only its side touches so the two
+threads don't fight over lines. */
+struct FXDLLLOCAL Ring
+{
+	char pad0[CACHELINE];
+	volatile FXuval head;
+	RingWaiter writer;				// Sleeps when full or flushing
+	char pad1[CACHELINE];
+	volatile FXuval tail;
+	RingWaiter reader;				// Sleeps when empty
+	char pad2[CACHELINE];
+	FXuchar *data;
+	FXuval capacity, mask;
+	Ring(FXuval size) : head(0), tail(0), data(0), capacity(size), mask(size-1)
+	{
+		FXERRHM(data=malloc<FXuchar>(capacity));
+	}
+	~Ring()
+	{
+		free(data);
+		data=0;
+	}
+	FXuval waiting() const { return head-tail; }
+};
+
 #define MAGIC (*(FXuint *)"LCPI")
 struct FXDLLLOCAL QLocalPipePrivate : public QMutex
 {
@@ -75,10 +195,84 @@ struct FXDLLLOCAL QLocalPipePrivate : public QMutex
 	FXAtomicInt clients;
 	Buffer A, B;
 	FXuval granularity;
-	QLocalPipePrivate() : magic(MAGIC), granularity(CHUNKSIZE), QMutex() { }
-	~QLocalPipePrivate() { magic=0; }
+	Ring *ringA, *ringB;
+	volatile bool closed;			// Set once an end has closed in ring mode
+	int spins;
+	QLocalPipePrivate() : magic(MAGIC), granularity(CHUNKSIZE), ringA(0), ringB(0), closed(false), spins(0), QMutex() { }
+	~QLocalPipePrivate() { magic=0; deleteRings(); }
 	Buffer &readBuffer(QLocalPipe *t) { return (t->creator) ? B : A; }
 	Buffer &writeBuffer(QLocalPipe *t) { return (t->creator) ? A : B; }
+	Ring *readRing(QLocalPipe *t) { return (t->creator) ? ringB : ringA; }
+	Ring *writeRing(QLocalPipe *t) { return (t->creator) ? ringA : ringB; }
+	void deleteRings()
+	{
+		FXDELETE(ringA);
+		FXDELETE(ringB);
+	}
+	// Blocks until there is data in the ring, returning how much
+	FXuval waitForData(Ring &r)
+	{
+		FXuval waiting;
+		while(!(waiting=r.waiting()))
+		{
+			if(clients<=1) FXERRGCONLOST("Connection Lost", 0);
+			for(int n=0; n<spins && !r.waiting(); n++) RINGPAUSE();
+			if(r.waiting()) continue;
+			r.reader.prepare();
+			if(r.waiting()) r.reader.cancel(); else r.reader.sleep();
+		}
+		RINGORDER();
+		return waiting;
+	}
+	// Blocks until no more than limit bytes are in the ring, returning how many are
+	FXuval waitForSpace(Ring &r, FXuval limit)
+	{
+		FXuval waiting;
+		while((waiting=r.waiting())>limit)
+		{	// Unlike the reader the writer may run ahead of the other end opening
+			if(closed) FXERRGCONLOST("Connection Lost", 0);
+			for(int n=0; n<spins && r.waiting()>limit; n++) RINGPAUSE();
+			if(r.waiting()<=limit) continue;
+			r.writer.prepare();
+			if(r.waiting()<=limit) r.writer.cancel(); else r.writer.sleep();
+		}
+		RINGORDER();
+		return waiting;
+	}
+	FXuval ringRead(Ring &r, char *data, FXuval maxlen)
+	{
+		FXuval readed=FXMIN(maxlen, waitForData(r));
+		FXuval pos=r.tail & r.mask, first=FXMIN(readed, r.capacity-pos);
+		memcpy(data, r.data+pos, first);
+		memcpy(data+first, r.data, readed-first);
+		RINGORDER();
+		r.tail+=readed;
+		RINGFENCE();
+		r.writer.wake();
+		return readed;
+	}
+	void ringWrite(Ring &r, const char *data, FXuval maxlen)
+	{
+		for(FXuval n=0; n<maxlen;)
+		{
+			FXuval space=r.capacity-waitForSpace(r, r.capacity-1);
+			FXuval len=FXMIN(maxlen-n, space);
+			FXuval pos=r.head & r.mask, first=FXMIN(len, r.capacity-pos);
+			memcpy(r.data+pos, data+n, first);
+			memcpy(r.data, data+n+first, len-first);
+			RINGORDER();
+			r.head+=len; n+=len;
+			RINGFENCE();
+			r.reader.wake();
+		}
+	}
+	// Wakes anything sleeping on the rings so it can notice an end has closed
+	void wakeRings()
+	{
+		RINGFENCE();
+		if(ringA) { ringA->reader.wake(true); ringA->writer.wake(true); }
+		if(ringB) { ringB->reader.wake(true); ringB->writer.wake(true); }
+	}
 };
 
 void *QLocalPipe::int_getOSHandle() const
@@ -127,6 +321,35 @@ void QLocalPipe::setGranularity(FXuval newval)
 	}
 }
 
+FXuval QLocalPipe::ringSize() const
+{
+	if(p && MAGIC==p->magic)
+	{
+		QMtxHold h(p);
+		return p->ringA ? p->ringA->capacity : 0;
+	}
+	return 0;
+}
+
+void QLocalPipe::setRingSize(FXuval size)
+{
+	if(p && MAGIC==p->magic && isClosed())
+	{
+		QMtxHold h(p);
+		if(p->clients) return;
+		p->deleteRings();
+		if(size)
+		{
+			FXuval capacity=4096;
+			while(capacity<size) capacity<<=1;
+			FXERRHM(p->ringA=new Ring(capacity));
+			FXERRHM(p->ringB=new Ring(capacity));
+			// Spinning only wastes the other end's time if it can't be running
+			p->spins=(FXProcess::noOfProcessors()>1) ? RINGSPINS : 0;
+		}
+	}
+}
+
 bool QLocalPipe::open(FXuint mode)
 {
 	QMtxHold h(p);
@@ -136,6 +359,12 @@ bool QLocalPipe::open(FXuint mode)
 	}
 	else
 	{
+		if(!p->clients && p->ringA)
+		{	// Anything left from before both ends last closed is lost
+			p->ringA->head=p->ringA->tail=0;
+			p->ringB->head=p->ringB->tail=0;
+			p->closed=false;
+		}
 		setFlags((mode & IO_ModeMask)|IO_Open);
 		++p->clients;
 	}
@@ -147,10 +376,19 @@ void QLocalPipe::close()
 	if(p && MAGIC==p->magic && isOpen())
 	{
 		QMtxHold h(p);
-		Buffer &b=p->writeBuffer(this);
-		b.data.clear();
-		b.rptr=b.wptr=0;
-		--p->clients;
+		if(p->ringA)
+		{
+			--p->clients;
+			p->closed=true;
+			p->wakeRings();
+		}
+		else
+		{
+			Buffer &b=p->writeBuffer(this);
+			b.data.clear();
+			b.rptr=b.wptr=0;
+			--p->clients;
+		}
 	}
 	setFlags(0);
 }
@@ -160,7 +398,10 @@ void QLocalPipe::flush()
 	if(isOpen() && isWriteable())
 	{
 		if(!p || MAGIC!=p->magic) FXERRGCONLOST("Connection Lost", 0);
-		p->writeBuffer(this).empty.wait();
+		if(Ring *r=p->writeRing(this))
+			p->waitForSpace(*r, 0);
+		else
+			p->writeBuffer(this).empty.wait();
 	}
 }
 
@@ -169,6 +410,8 @@ FXfval QLocalPipe::size() const
 	if(isOpen())
 	{
 		if(!p || MAGIC!=p->magic) return 0;
+		if(Ring *r=p->readRing(const_cast<QLocalPipe *>(this)))
+			return r->waiting();
 		QMtxHold h(p);
 		Buffer &b=p->readBuffer(const_cast<QLocalPipe *>(this));
 		FXfval waiting=(b.datachunks-1)*p->granularity;
@@ -185,6 +428,12 @@ bool QLocalPipe::atEnd() const { return size()==0; }
 
 FXuval QLocalPipe::readBlock(char *data, FXuval maxlen)
 {
+	if(p && MAGIC==p->magic && p->ringA)
+	{	// The ring needs no lock as only this thread reads it
+		if(!isReadable()) FXERRGIO(QTrans::tr("QLocalPipe", "Not open for reading"));
+		if(!isOpen() || !maxlen) return 0;
+		return p->ringRead(*p->readRing(this), data, maxlen);
+	}
 	QMtxHold h(p);
 	if(!isReadable()) FXERRGIO(QTrans::tr("QLocalPipe", "Not open for reading"));
 	if(isOpen() && maxlen)
@@ -232,6 +481,14 @@ FXuval QLocalPipe::readBlock(char *data, FXuval maxlen)
 
 FXuval QLocalPipe::writeBlock(const char *data, FXuval maxlen)
 {
+	if(p && MAGIC==p->magic && p->ringA)
+	{	// The ring needs no lock as only this thread writes it
+		if(!isWriteable()) FXERRGIO(QTrans::tr("QLocalPipe", "Not open for writing"));
+		if(!isOpen() || !maxlen) return 0;
+		p->ringWrite(*p->writeRing(this), data, maxlen);
+		if(isRaw()) flush();
+		return maxlen;
+	}
 	QMtxHold h(p);
 	if(!isWriteable()) FXERRGIO(QTrans::tr("QLocalPipe", "Not open for writing"));
 	if(isOpen() && maxlen)
@@ -240,7 +497,7 @@ FXuval QLocalPipe::writeBlock(const char *data, FXuval maxlen)
 		Buffer &b=p->writeBuffer(this);
 		for(FXuval n=0; n<maxlen;)
 		{
-			FXuval len=FXMIN(maxlen, (p->granularity-b.wptr));
+			FXuval len=FXMIN(maxlen-n, (p->granularity-b.wptr));
 			memcpy(b.data.last()+b.wptr, data+n, len);
 			b.wptr+=len; n+=len;
 			if(p->granularity==b.wptr)
@@ -0,0 +1,608 @@
+/********************************************************************************
+*                                                                               *
+*                          Local domain socket i/o device                       *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#include "xincs.h"
+#include "QLocalSocket.h"
+#include "FXString.h"
+#include "QThread.h"
+#include "FXException.h"
+#include "QTrans.h"
+#include "FXProcess.h"
+#include "FXRollback.h"
+#include "FXACL.h"
+#include <stdlib.h>
+#include <assert.h>
+#include "sigpipehandler.h"
+
+#ifndef USE_POSIX
+#define USE_WINAPI
+#endif
+#ifdef USE_POSIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/poll.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define FXERRHSKT(exp) { int __res=(int)(exp); if(__res<0) { \
+	if(EPIPE==errno || ECONNRESET==errno) \
+		{ FXERRGCONLOST("Connection Lost", 0); } \
+	else { FXERRGIO(strerror(errno)); } } }
+#endif
+
+#include "FXMemDbg.h"
+#if defined(DEBUG) && !defined(FXMEMDBG_DISABLE)
+static const char *_fxmemdbg_current_file_ = __FILE__;
+#endif
+
+namespace FX {
+
+// The most handles sent in one write. Linux allows up to 253
+#define MAXHANDLES 64
+
+struct FXDLLLOCAL QLocalSocketPrivate : public QMutex
+{
+	FXString name;
+	QLocalSocket::Type type;
+	FXACL acl;
+	int handle;
+	bool listening;
+	QLocalSocketPrivate(QLocalSocket::Type _type) : type(_type), acl(FXACL::Pipe), handle(-1), listening(false), QMutex() { }
+	void makePerms()
+	{
+		acl.append(FXACL::Entry(FXACLEntity::owner(), 0, FXACL::Permissions().setAll()));
+	}
+};
+
+static inline FXString makeFullPath(const FXString &src)
+{
+	return "/tmp/TnFOX_"+src+".sock";
+}
+
+#ifdef USE_POSIX
+static void makeSockAddr(sockaddr_un &sa, const FXString &path)
+{
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family=AF_UNIX;
+	if((FXuval) path.length()>=sizeof(sa.sun_path)) FXERRGIO(QTrans::tr("QLocalSocket", "Socket name is too long"));
+	memcpy(sa.sun_path, path.text(), path.length());
+}
+
+static int newSocket(QLocalSocket::Type type)
+{
+	int h;
+	FXERRHSKT(h=::socket(AF_UNIX, (QLocalSocket::SeqPacket==type) ? SOCK_SEQPACKET : SOCK_STREAM, 0));
+	if(-1==::fcntl(h, F_SETFD, ::fcntl(h, F_GETFD, 0)|FD_CLOEXEC))
+	{
+		::close(h);
+		FXERRHOS(-1);
+	}
+	return h;
+}
+
+// Returns true if something is listening on sa, so its name isn't left over from a crash
+static bool isListening(const sockaddr_un &sa, QLocalSocket::Type type)
+{
+	int h=newSocket(type);
+	int ret=::connect(h, (const sockaddr *) &sa, sizeof(sa));
+	int errcode=errno;
+	::close(h);
+	return !(-1==ret && ECONNREFUSED==errcode);
+}
+
+// Receives into iov plus up to nohandles descriptors, returning how many bytes
+static FXuval recvWith(QLocalSocketPrivate *p, QMtxHold &h, struct iovec *iov, int iovcnt, int *handles, FXuint &nohandles)
+{
+	union
+	{
+		struct cmsghdr align;
+		char buffer[CMSG_SPACE(MAXHANDLES*sizeof(int))];
+	} control;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov=iov;
+	msg.msg_iovlen=iovcnt;
+	FXuint maxhandles=FXMIN(nohandles, (FXuint) MAXHANDLES);
+	if(maxhandles)
+	{
+		msg.msg_control=control.buffer;
+		msg.msg_controllen=CMSG_SPACE(maxhandles*sizeof(int));
+	}
+	int flags=0;
+#ifdef MSG_CMSG_CLOEXEC
+	flags|=MSG_CMSG_CLOEXEC;
+#endif
+	int fd=p->handle;
+	h.unlock();
+	ssize_t readed=::recvmsg(fd, &msg, flags);
+	h.relock();
+	FXERRHSKT(readed);
+	nohandles=0;
+	if(maxhandles)
+	{
+		for(struct cmsghdr *cmsg=CMSG_FIRSTHDR(&msg); cmsg; cmsg=CMSG_NXTHDR(&msg, cmsg))
+		{
+			if(SOL_SOCKET!=cmsg->cmsg_level || SCM_RIGHTS!=cmsg->cmsg_type) continue;
+			const char *data=(const char *) CMSG_DATA(cmsg);
+			FXuint count=(FXuint)((cmsg->cmsg_len-CMSG_LEN(0))/sizeof(int));
+			for(FXuint n=0; n<count; n++)
+			{
+				int newh;
+				memcpy(&newh, data+n*sizeof(int), sizeof(int));
+				if(nohandles<maxhandles)
+				{
+#ifndef MSG_CMSG_CLOEXEC
+					::fcntl(newh, F_SETFD, ::fcntl(newh, F_GETFD, 0)|FD_CLOEXEC);
+#endif
+					handles[nohandles++]=newh;
+				}
+				else ::close(newh);
+			}
+		}
+	}
+	if(!readed) FXERRGCONLOST("Connection closed", 0);
+	return (FXuval) readed;
+}
+
+// Sends iov with copies of nohandles descriptors, returning how many bytes
+static FXuval sendWith(QLocalSocketPrivate *p, QMtxHold &h, struct iovec *iov, int iovcnt, const int *handles, FXuint nohandles)
+{
+	union
+	{
+		struct cmsghdr align;
+		char buffer[CMSG_SPACE(MAXHANDLES*sizeof(int))];
+	} control;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov=iov;
+	msg.msg_iovlen=iovcnt;
+	if(nohandles)
+	{
+		FXERRH(nohandles<=MAXHANDLES, QTrans::tr("QLocalSocket", "Too many handles to send at once"), 0, FXERRH_ISDEBUG);
+		memset(&control, 0, sizeof(control));
+		msg.msg_control=control.buffer;
+		msg.msg_controllen=CMSG_SPACE(nohandles*sizeof(int));
+		struct cmsghdr *cmsg=CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level=SOL_SOCKET;
+		cmsg->cmsg_type=SCM_RIGHTS;
+		cmsg->cmsg_len=CMSG_LEN(nohandles*sizeof(int));
+		memcpy(CMSG_DATA(cmsg), handles, nohandles*sizeof(int));
+	}
+	int fd=p->handle;
+	QIODeviceS_SignalHandler::lockWrite();
+	h.unlock();
+	ssize_t written=::sendmsg(fd, &msg, MSG_NOSIGNAL);
+	h.relock();
+	FXERRHSKT(written);
+	if(QIODeviceS_SignalHandler::unlockWrite())		// Nasty this
+		FXERRGCONLOST("Broken socket", 0);
+	return (FXuval) written;
+}
+#endif
+
+void *QLocalSocket::int_getOSHandle() const
+{
+	return (void *)(FXival) p->handle;
+}
+
+int QLocalSocket::int_transferHandle(bool write)
+{
+	if(!isOpen() || p->listening) return -1;
+	if(write) return isWriteable() ? p->handle : -1;
+	return QIODevice::isReadable() ? p->handle : -1;
+}
+
+QLocalSocket::QLocalSocket() : p(0), creator(false), anonymous(true), QIODeviceS()
+{
+	FXERRHM(p=new QLocalSocketPrivate(Stream));
+	p->makePerms();
+}
+
+QLocalSocket::QLocalSocket(const FXString &name, Type type) : p(0), creator(false), anonymous(false), QIODeviceS()
+{
+	FXRBOp unconstr=FXRBConstruct(this);
+	FXERRHM(p=new QLocalSocketPrivate(type));
+	p->makePerms();
+	if(name.empty())
+		setUnique(true);
+	else
+		setName(name);
+	unconstr.dismiss();
+}
+
+QLocalSocket::QLocalSocket(const QLocalSocket &o, int h) : p(0), creator(false), anonymous(false), QIODeviceS(o)
+{
+	FXERRHM(p=new QLocalSocketPrivate(o.p->type));
+	p->name=o.p->name;
+	p->acl=o.p->acl;
+	p->handle=h;
+}
+
+QLocalSocket::~QLocalSocket()
+{ FXEXCEPTIONDESTRUCT1 {
+	close();
+	FXDELETE(p);
+} FXEXCEPTIONDESTRUCT2; }
+
+const FXString &QLocalSocket::name() const
+{
+	return p->name;
+}
+
+void QLocalSocket::setName(const FXString &name)
+{
+	close();
+	p->name=name;
+	setUnique(false);
+}
+
+QLocalSocket::Type QLocalSocket::type() const
+{
+	return p->type;
+}
+
+void QLocalSocket::setType(Type type)
+{
+	close();
+	p->type=type;
+}
+
+bool QLocalSocket::create(FXuint mode)
+{
+	QMtxHold h(p);
+	if(isOpen())
+	{	// I keep fouling myself up here, so assertion check
+		if(QIODevice::mode()!=mode) FXERRGIO(QTrans::tr("QLocalSocket", "Device reopen has different mode"));
+		return true;
+	}
+#ifdef USE_WINAPI
+	FXERRGNOTSUPP(QTrans::tr("QLocalSocket", "Local domain sockets are not supported on this platform"));
+#endif
+#ifdef USE_POSIX
+	bool reclaimed=false;
+	for(;;)
+	{
+		if(anonymous)
+			p->name=FXString("%1_%2").arg(FXProcess::id()).arg(rand(),0,16);
+		FXString fullname=makeFullPath(p->name);
+		sockaddr_un sa;
+		makeSockAddr(sa, fullname);
+		int s=newSocket(p->type);
+		FXRBOp uns=FXRBFunc(::close, s);
+		if(-1==::bind(s, (const sockaddr *) &sa, sizeof(sa)))
+		{
+			if(EADDRINUSE!=errno) FXERRHOSFN(-1, fullname);
+			if(anonymous) continue;
+			if(!reclaimed && !isListening(sa, p->type))
+			{	// Left behind by a process which died without closing it
+				::unlink(fullname.text());
+				reclaimed=true;
+				continue;
+			}
+			FXERRGIO(QTrans::tr("QLocalSocket", "Socket name is already in use"));
+		}
+		const char *fullpath=fullname.text();
+		FXRBOp unlinkname=FXRBFunc(::unlink, fullpath);
+		p->acl.writeTo(fullname);
+		FXERRHSKT(::listen(s, SOMAXCONN));
+		unlinkname.dismiss();
+		uns.dismiss();
+		p->handle=s;
+		break;
+	}
+	p->listening=true;
+	setFlags((mode & IO_ModeMask)|IO_Open);
+	creator=true;
+#endif
+	return true;
+}
+
+bool QLocalSocket::open(FXuint mode)
+{
+	QMtxHold h(p);
+	if(isOpen())
+	{	// I keep fouling myself up here, so assertion check
+		if(QIODevice::mode()!=mode) FXERRGIO(QTrans::tr("QLocalSocket", "Device reopen has different mode"));
+		return true;
+	}
+#ifdef USE_WINAPI
+	FXERRGNOTSUPP(QTrans::tr("QLocalSocket", "Local domain sockets are not supported on this platform"));
+#endif
+#ifdef USE_POSIX
+	FXString fullname=makeFullPath(p->name);
+	sockaddr_un sa;
+	makeSockAddr(sa, fullname);
+	int s=newSocket(p->type);
+	FXRBOp uns=FXRBFunc(::close, s);
+	h.unlock();
+	int ret=::connect(s, (const sockaddr *) &sa, sizeof(sa));
+	h.relock();
+	if(-1==ret)
+	{
+		if(ENOENT==errno || ECONNREFUSED==errno) FXERRGNF(QTrans::tr("QLocalSocket", "Socket not found"), 0);
+		FXERRHOSFN(-1, fullname);
+	}
+	uns.dismiss();
+	p->handle=s;
+	p->listening=false;
+	p->acl=FXACL(fullname, FXACL::Pipe);
+	setFlags((mode & IO_ModeMask)|IO_Open);
+	creator=false;
+#endif
+	return true;
+}
+
+void QLocalSocket::close()
+{
+	if(p)
+	{
+		QMtxHold h(p);
+		QThread_DTHold dth;
+#ifdef USE_POSIX
+		if(-1!=p->handle)
+		{
+			FXERRHIO(::close(p->handle));
+			p->handle=-1;
+			if(creator && !(flags() & IO_DontUnlink))
+				::unlink(makeFullPath(p->name).text());
+		}
+#endif
+		p->listening=false;
+		p->acl=FXACL(FXACL::Pipe);
+		p->makePerms();
+		setFlags(0);
+	}
+}
+
+void QLocalSocket::flush()
+{
+}
+
+FXfval QLocalSocket::size() const
+{
+	QMtxHold h(p);
+	int waiting=0;
+	if(isOpen() && !p->listening)
+	{
+		QThread_DTHold dth;
+#ifdef USE_POSIX
+		FXERRHSKT(::ioctl(p->handle, FIONREAD, &waiting));
+#endif
+	}
+	return (FXfval) waiting;
+}
+
+const FXACL &QLocalSocket::permissions() const
+{
+	return p->acl;
+}
+void QLocalSocket::setPermissions(const FXACL &perms)
+{
+	if(isOpen() && creator) perms.writeTo(makeFullPath(p->name));
+	p->acl=perms;
+}
+FXACL QLocalSocket::permissions(const FXString &name)
+{
+	return FXACL(makeFullPath(name), FXACL::Pipe);
+}
+void QLocalSocket::setPermissions(const FXString &name, const FXACL &perms)
+{
+	perms.writeTo(makeFullPath(name));
+}
+
+FXuval QLocalSocket::readBlock(char *data, FXuval maxlen)
+{
+	FXuint nohandles=0;
+	return readBlock(data, maxlen, 0, nohandles);
+}
+
+FXuval QLocalSocket::readBlock(char *data, FXuval maxlen, int *handles, FXuint &nohandles)
+{
+	QMtxHold h(p);
+	if(!QIODevice::isReadable()) FXERRGIO(QTrans::tr("QLocalSocket", "Not open for reading"));
+	if(isOpen() && maxlen)
+	{
+#ifdef USE_POSIX
+		struct iovec iov;
+		iov.iov_base=data;
+		iov.iov_len=maxlen;
+		return recvWith(p, h, &iov, 1, handles, nohandles);
+#endif
+	}
+	nohandles=0;
+	return 0;
+}
+
+FXuval QLocalSocket::writeBlock(const char *data, FXuval maxlen)
+{
+	return writeBlock(data, maxlen, 0, 0);
+}
+
+FXuval QLocalSocket::writeBlock(const char *data, FXuval maxlen, const int *handles, FXuint nohandles)
+{
+	QMtxHold h(p);
+	if(!isWriteable()) FXERRGIO(QTrans::tr("QLocalSocket", "Not open for writing"));
+	FXERRH(maxlen || !nohandles, QTrans::tr("QLocalSocket", "Handles must be sent with some data"), 0, FXERRH_ISDEBUG);
+	if(isOpen() && maxlen)
+	{
+#ifdef USE_POSIX
+		struct iovec iov;
+		iov.iov_base=(char *) data;
+		iov.iov_len=maxlen;
+		return sendWith(p, h, &iov, 1, handles, nohandles);
+#endif
+	}
+	return 0;
+}
+
+FXuval QLocalSocket::readBlockV(const IOVec *segs, FXuint count)
+{
+#ifdef USE_POSIX
+	struct iovec iov[64];
+	if(count<=sizeof(iov)/sizeof(iov[0]))
+	{
+		QMtxHold h(p);
+		if(!QIODevice::isReadable()) FXERRGIO(QTrans::tr("QLocalSocket", "Not open for reading"));
+		if(!isOpen() || !count) return 0;
+		for(FXuint n=0; n<count; n++)
+		{
+			iov[n].iov_base=segs[n].data;
+			iov[n].iov_len=segs[n].len;
+		}
+		FXuint nohandles=0;
+		return recvWith(p, h, iov, (int) count, 0, nohandles);
+	}
+#endif
+	return QIODevice::readBlockV(segs, count);
+}
+
+FXuval QLocalSocket::writeBlockV(const IOVec *segs, FXuint count)
+{
+#ifdef USE_POSIX
+	struct iovec iov[64];
+	if(count<=sizeof(iov)/sizeof(iov[0]))
+	{
+		QMtxHold h(p);
+		if(!isWriteable()) FXERRGIO(QTrans::tr("QLocalSocket", "Not open for writing"));
+		if(!isOpen() || !count) return 0;
+		for(FXuint n=0; n<count; n++)
+		{
+			iov[n].iov_base=segs[n].data;
+			iov[n].iov_len=segs[n].len;
+		}
+		return sendWith(p, h, iov, (int) count, 0, 0);
+	}
+#endif
+	return QIODevice::writeBlockV(segs, count);
+}
+
+int QLocalSocket::ungetch(int c)
+{
+	return -1;
+}
+
+QLocalSocket *QLocalSocket::waitForConnection(FXuint waitfor)
+{
+	QMtxHold h(p);
+	FXERRH(isOpen() && p->listening, QTrans::tr("QLocalSocket", "Socket isn't listening"), 0, FXERRH_ISDEBUG);
+#ifdef USE_POSIX
+	int lh=p->handle;
+	h.unlock();
+	struct pollfd pfd;
+	pfd.fd=lh;
+	pfd.events=POLLIN;
+	pfd.revents=0;
+	int ret=::poll(&pfd, 1, (FXINFINITE==waitfor) ? -1 : (int) waitfor);
+	if(ret<=0)
+	{
+		if(ret<0 && EINTR!=errno) FXERRHOS(ret);
+		return 0;
+	}
+	int s=::accept(lh, 0, 0);
+	h.relock();
+	FXERRHSKT(s);
+	FXRBOp uns=FXRBFunc(::close, s);
+	FXERRHOS(::fcntl(s, F_SETFD, ::fcntl(s, F_GETFD, 0)|FD_CLOEXEC));
+	QLocalSocket *newskt;
+	FXERRHM(newskt=new QLocalSocket(*this, s));
+	uns.dismiss();
+	return newskt;
+#else
+	return 0;
+#endif
+}
+
+void QLocalSocket::createPair(QLocalSocket *&a, QLocalSocket *&b, Type type)
+{
+#ifdef USE_WINAPI
+	FXERRGNOTSUPP(QTrans::tr("QLocalSocket", "Local domain sockets are not supported on this platform"));
+#endif
+#ifdef USE_POSIX
+	int hs[2];
+	FXERRHSKT(::socketpair(AF_UNIX, (SeqPacket==type) ? SOCK_SEQPACKET : SOCK_STREAM, 0, hs));
+	FXRBOp unh0=FXRBFunc(::close, hs[0]), unh1=FXRBFunc(::close, hs[1]);
+	FXERRHOS(::fcntl(hs[0], F_SETFD, ::fcntl(hs[0], F_GETFD, 0)|FD_CLOEXEC));
+	FXERRHOS(::fcntl(hs[1], F_SETFD, ::fcntl(hs[1], F_GETFD, 0)|FD_CLOEXEC));
+	QLocalSocket *ends[2]={0, 0};
+	FXRBOp unends0=FXRBNew(ends[0]), unends1=FXRBNew(ends[1]);
+	FXERRHM(ends[0]=new QLocalSocket(FXString(), type));
+	FXERRHM(ends[1]=new QLocalSocket(FXString(), type));
+	unh0.dismiss(); unh1.dismiss();
+	for(int n=0; n<2; n++)
+	{
+		ends[n]->anonymous=false;
+		ends[n]->p->handle=hs[n];
+		ends[n]->setFlags(IO_ReadWrite|IO_Open);
+	}
+	unends0.dismiss(); unends1.dismiss();
+	a=ends[0]; b=ends[1];
+#endif
+}
+
+FXuint QLocalSocket::maxHandles() throw()
+{
+	return MAXHANDLES;
+}
+
+int QLocalSocket::createSharedMemory(FXuval size)
+{
+#ifdef USE_WINAPI
+	FXERRGNOTSUPP(QTrans::tr("QLocalSocket", "Local domain sockets are not supported on this platform"));
+#endif
+#ifdef USE_POSIX
+	int h=-1;
+#if defined(__linux__) && defined(SYS_memfd_create)
+	h=(int) ::syscall(SYS_memfd_create, "TnFOX", 1 /* MFD_CLOEXEC */);
+#endif
+	if(-1==h)
+	{	// No memfd, so make a uniquely named object and unlink it straight away
+		for(;;)
+		{
+			FXString name(FXString("/TnFOX_%1_%2").arg(FXProcess::id()).arg(rand(),0,16));
+			if(-1!=(h=::shm_open(name.text(), O_RDWR|O_CREAT|O_EXCL, S_IREAD|S_IWRITE)))
+			{
+				::shm_unlink(name.text());
+				break;
+			}
+			if(EEXIST!=errno) FXERRHOS(-1);
+		}
+		if(-1==::fcntl(h, F_SETFD, ::fcntl(h, F_GETFD, 0)|FD_CLOEXEC))
+		{
+			::close(h);
+			FXERRHOS(-1);
+		}
+	}
+	FXRBOp unh=FXRBFunc(::close, h);
+	FXERRHIO(::ftruncate(h, (off_t) size));
+	unh.dismiss();
+	return h;
+#else
+	return -1;
+#endif
+}
+
+}
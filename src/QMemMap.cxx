@@ -90,6 +90,18 @@ public:
 static QMemMapInit qmemmapinit;
 #endif
 
+static FXuint mapGranularity()
+{	// What mapping offsets must be a multiple of
+#ifdef USE_WINAPI
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwAllocationGranularity;
+#endif
+#ifdef USE_POSIX
+	return FXProcess::pageSize();
+#endif
+}
+
 struct FXDLLLOCAL Mapping
 {
 	FXfval offset, len;
@@ -114,6 +126,10 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 	FXuint pageSize;		// Page size of machine
 	Mapping *cmapping;		// Mapping ioIndex is in, or zero if it isn't
 	QSortedListIterator<Mapping> cmappingit;
+	QMemMap::AccessHint hint;	// Applied to new mappings
+	bool prefault, hugepages;
+	FXuval windowsize;		// Zero if not sliding windows
+	Mapping *window;		// The current sliding window
 #ifdef USE_WINAPI
 	HANDLE mappingh;
 	DWORD pageaccess;
@@ -124,6 +140,7 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 	QMemMapPrivate(QMemMap::Type _type, QFile *f=0) : type(_type), myfile(0==f), creator(false),
 		mappingsFailed(false), unique(false), file(f), filefd(0), size(0), acl(FXACL::MemMap), mappings(true),
 		pageSize(FXProcess::pageSize()), cmapping(0), cmappingit(mappings),
+		hint(QMemMap::NormalAccess), prefault(false), hugepages(false), windowsize(0), window(0),
 #ifdef USE_WINAPI
 		mappingh(0),
 #endif
@@ -141,7 +158,7 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 	{
 		QSortedListIterator<Mapping> it=mappings.findClosestIter(&Mapping(offset));
 		Mapping *m=it.current();
-		if(!m) return 0;
+		if(!m && !(m=it.toLast())) return 0;
 		// findClosestIter() returns item /after/ if offset is bigger
 		if(m->offset>offset && !it.atFirst())
 		{
@@ -156,6 +173,61 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 		if(!m) return 0;
 		return (void *)(FXuval)((FXfval)(FXuval)m->addr+offset-m->offset);
 	}
+	bool advise(Mapping *m, QMemMap::AccessHint h, FXfval offset, FXfval len)
+	{	// offset is relative to the mapping and must be page aligned
+		char *addr=(char *) m->addr+(FXuval) offset;
+#ifdef USE_WINAPI
+		if(QMemMap::WillNeedAccess==h)
+		{	// PrefetchVirtualMemory() is only on Windows 8 or later
+			struct RangeEntry { PVOID VirtualAddress; SIZE_T NumberOfBytes; } range={ addr, (SIZE_T) len };
+			static BOOL (WINAPI *PrefetchVirtualMemoryAddr)(HANDLE, ULONG_PTR, RangeEntry *, ULONG)=(BOOL (WINAPI *)(HANDLE, ULONG_PTR, RangeEntry *, ULONG)) -1;
+			if((BOOL (WINAPI *)(HANDLE, ULONG_PTR, RangeEntry *, ULONG)) -1==PrefetchVirtualMemoryAddr)
+				PrefetchVirtualMemoryAddr=(BOOL (WINAPI *)(HANDLE, ULONG_PTR, RangeEntry *, ULONG)) GetProcAddress(GetModuleHandle(L"kernel32"), "PrefetchVirtualMemory");
+			return PrefetchVirtualMemoryAddr && PrefetchVirtualMemoryAddr(GetCurrentProcess(), 1, &range, 0);
+		}
+		return false;
+#endif
+#ifdef USE_POSIX
+		int advice=POSIX_MADV_NORMAL;
+		switch(h)
+		{
+		case QMemMap::SequentialAccess:
+			advice=POSIX_MADV_SEQUENTIAL; break;
+		case QMemMap::RandomAccess:
+			advice=POSIX_MADV_RANDOM; break;
+		case QMemMap::WillNeedAccess:
+			advice=POSIX_MADV_WILLNEED; break;
+		case QMemMap::DontNeedAccess:
+			{	// Linux's POSIX_MADV_DONTNEED does nothing, whereas MADV_DONTNEED throws
+				// away private pages so only use it on shared mappings
+				if(m->copyOnWrite) return false;
+#ifdef MADV_DONTNEED
+				return !::madvise(addr, (size_t) len, MADV_DONTNEED);
+#else
+				advice=POSIX_MADV_DONTNEED; break;
+#endif
+			}
+		default:
+			break;
+		}
+		return !::posix_madvise(addr, (size_t) len, advice);
+#endif
+	}
+	void prepare(Mapping *m)
+	{	// Applies access pattern, huge pages & prefaulting to a newly mapped section
+		if(QMemMap::NormalAccess!=hint) advise(m, hint, 0, m->len);
+#if defined(USE_POSIX) && defined(MADV_HUGEPAGE)
+		if(hugepages) ::madvise(m->addr, (size_t) m->len, MADV_HUGEPAGE);
+#endif
+#if !defined(USE_POSIX) || !defined(MAP_POPULATE)
+		if(prefault)
+		{	// Touch each page to fault it in
+			volatile const char *addr=(volatile const char *) m->addr;
+			for(FXfval n=0; n<m->len; n+=pageSize)
+				(void) addr[(FXuval) n];
+		}
+#endif
+	}
 	void map()
 	{	// Maps in all unmapped regions
 		Mapping *m=0;
@@ -185,6 +257,9 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 #endif
 #ifdef USE_POSIX
 				int flags=(m->copyOnWrite) ? MAP_PRIVATE : MAP_SHARED;
+#ifdef MAP_POPULATE
+				if(prefault) flags|=MAP_POPULATE;
+#endif
 				if(MAP_FAILED==(m->addr=::mmap(m->oldaddr, (size_t) m->len, pageaccess,
 					flags, filefd, m->offset))) m->addr=0;
 #ifdef DEBUG
@@ -195,6 +270,7 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 				}
 #endif
 #endif
+				if(m->addr) prepare(m);
 			}
 			if(!m->addr) mappingsFailed=true;
 		}
@@ -202,11 +278,12 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 	void unmap(FXfval offset, FXfval amount, bool delEntries=true)
 	{
 		QSortedListIterator<Mapping> it=mappings.findClosestIter(&Mapping(offset));
-		if(!it.atFirst()) --it;
+		if(!it.current()) it.toLast();
+		else if(!it.atFirst()) --it;
 		if(!amount) amount=1;
 		for(Mapping *m=0; (m=it.current()) && m->offset<offset+amount;)
 		{
-			if((offset-m->offset)<amount || (offset+amount)>m->offset)
+			if(m->offset+m->len>offset)
 			{
 				if(m->addr)
 				{
@@ -220,6 +297,7 @@ struct FXDLLLOCAL QMemMapPrivate : public QMutex
 					m->addr=0;
 				}
 				if(m==cmapping) cmapping=0;
+				if(m==window) window=0;
 				if(delEntries)
 				{
 					QSortedListIterator<Mapping> cit(it);
@@ -339,8 +417,16 @@ bool QMemMap::remove()
 FXfval QMemMap::reloadSize()
 {
 	QMtxHold h(p);
-	if(isOpen() && File==p->type)
-		return p->file->reloadSize();
+	if(isOpen())
+	{
+		if(File==p->type)
+			return p->file->reloadSize();
+#ifdef USE_POSIX
+		struct stat s={0};
+		if(!::fstat(p->filefd, &s)) return (FXfval) s.st_size;
+#endif
+		return p->size;
+	}
 	return 0;
 }
 
@@ -384,9 +470,9 @@ void *QMemMap::mapIn(FXfval offset, FXfval amount, bool copyOnWrite)
 {
 	QMtxHold h(p);
 	Mapping *m;
-	if((FXfval) -1==amount) amount=p->size;
+	offset&=~((FXfval) p->pageSize-1);	// Round down to page size
+	if((FXfval) -1==amount) amount=(offset<p->size) ? p->size-offset : 0;
 	if(!amount) return 0;	// Can't have null maps
-	offset&=p->pageSize-1;	// Round down to page size
 	p->unmap(offset, amount);
 	bool noMappings=p->mappings.isEmpty();
 	FXERRHM(m=new Mapping(offset, amount, copyOnWrite));
@@ -479,6 +565,126 @@ void *QMemMap::mapOffset(FXfval offset) const
 		return 0;
 }
 
+bool QMemMap::advise(QMemMap::AccessHint hint, FXfval offset, FXfval amount)
+{
+	QMtxHold h(p);
+	bool ret=true;
+	FXfval end=offset+amount;
+	if(end<offset) end=(FXfval) -1;
+	if(NormalAccess==hint || SequentialAccess==hint || RandomAccess==hint)
+		p->hint=hint;
+	QSortedListIterator<Mapping> it(p->mappings);
+	for(Mapping *m; (m=it.current()); ++it)
+	{
+		if(!m->addr || m->offset+m->len<=offset || m->offset>=end) continue;
+		FXfval start=FXMAX(offset, m->offset)-m->offset, len=FXMIN(end, m->offset+m->len)-m->offset;
+		start&=~((FXfval) p->pageSize-1);
+		if(!p->advise(m, hint, start, len-start)) ret=false;
+	}
+#if defined(USE_POSIX) && defined(POSIX_FADV_NORMAL)
+	if(File==p->type && isOpen())
+	{	// Also tell the page cache, which affects read ahead of unmapped parts
+		static const int advices[]={ POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED };
+		if(::posix_fadvise(p->filefd, (off_t) offset, ((FXfval) -1==amount) ? 0 : (off_t) amount, advices[hint])) ret=false;
+	}
+#endif
+	return ret;
+}
+
+QMemMap::AccessHint QMemMap::accessHint() const
+{
+	QMtxHold h(p);
+	return p->hint;
+}
+
+bool QMemMap::prefault() const
+{
+	QMtxHold h(p);
+	return p->prefault;
+}
+
+void QMemMap::setPrefault(bool v)
+{
+	QMtxHold h(p);
+	p->prefault=v;
+}
+
+bool QMemMap::hugePages() const
+{
+	QMtxHold h(p);
+	return p->hugepages;
+}
+
+void QMemMap::setHugePages(bool v)
+{
+	QMtxHold h(p);
+	p->hugepages=v;
+}
+
+FXuval QMemMap::windowSize() const
+{
+	QMtxHold h(p);
+	return p->windowsize;
+}
+
+void QMemMap::setWindowSize(FXuval size)
+{
+	QMtxHold h(p);
+	FXuval granularity=mapGranularity();
+	if(p->window)
+	{
+		p->unmap(p->window->offset, p->window->len);
+		if(p->mappingsFailed) p->map();
+		p->cmapping=0;
+		setIoIndex(ioIndex);
+	}
+	p->windowsize=(size+granularity-1) & ~(granularity-1);
+}
+
+bool QMemMap::slideWindow()
+{	// Maps in a window containing ioIndex in place of the last one, avoiding user mappings
+	FXfval granularity=mapGranularity();
+	FXfval start=ioIndex-ioIndex%p->windowsize, end=FXMIN(start+p->windowsize, p->size);
+	if(ioIndex>=end) return false;
+	if(p->window)
+	{	// Removing it invalidates cmappingit
+		p->unmap(p->window->offset, p->window->len);
+		p->cmapping=0;
+		setIoIndex(ioIndex);
+	}
+	QSortedListIterator<Mapping> it(p->mappings);
+	for(Mapping *m; (m=it.current()); ++it)
+	{
+		FXfval mend=m->offset+m->len;
+		if(mend<=ioIndex)
+		{
+			if(mend>start) start=(mend+granularity-1) & ~(granularity-1);
+		}
+		else if(m->offset<end) end=m->offset;
+	}
+	if(start>ioIndex || ioIndex>=end) return false;
+	Mapping *m;
+	FXERRHM(m=new Mapping(start, end-start));
+	FXRBOp unm=FXRBNew(m);
+	p->mappings.insert(m);
+	unm.dismiss();
+#ifdef USE_WINAPI
+	if(!p->mappingh) winopen(mode());
+#endif
+	p->map();
+	if(!m->addr)
+	{	// Out of address space, so use file i/o
+		p->unmap(start, end-start);
+		p->cmapping=0;
+		setIoIndex(ioIndex);
+		return false;
+	}
+	p->window=m;
+	p->cmapping=0;
+	setIoIndex(ioIndex);
+	return true;
+}
+
 void QMemMap::winopen(int mode)
 {
 #ifdef USE_WINAPI
@@ -568,6 +774,8 @@ inline void QMemMap::setIoIndex(FXfval newpos)
 		++p->cmappingit;
 		p->cmapping=p->cmappingit.current();
 		if(p->cmapping && newpos<p->cmapping->offset) p->cmapping=0;
+		else if(p->cmapping && newpos>=p->cmapping->offset+p->cmapping->len)
+			p->cmapping=p->findMapping(newpos, &p->cmappingit);
 	}
 	else if(newpos<p->cmapping->offset)
 		p->cmapping=p->findMapping(newpos, &p->cmappingit);
@@ -586,6 +794,8 @@ bool QMemMap::open(FXuint mode)
 		if(File==p->type)
 		{
 			if(p->file->isOpen()) p->file->flush();
+			// We access the file both through the mapping and directly
+			p->file->setBufferSize(0);
 			int filemode=mode & ~IO_Translate;
 			if((filemode & IO_ReadWrite)==IO_WriteOnly) filemode|=IO_ReadOnly|IO_Truncate;	// mmaps imply reading when writing
 			p->file->open(filemode);
@@ -680,11 +890,12 @@ void QMemMap::close()
 #ifdef USE_POSIX
 		if(Memory==p->type)
 		{
+			QThread_DTHold dth;
+			FXERRHIO(::close(p->filefd));
+			p->filefd=0;
 			if(p->creator && !(flags() & IO_DontUnlink))
 			{
-				QThread_DTHold dth;
 				FXString name(POSIX_SHARED_MEM_PREFIX+p->name);
-				FXERRHIO(::close(p->filefd));
 				FXERRHIO(::shm_unlink(name.text()));
 			}
 		}
@@ -881,6 +1092,7 @@ FXuval QMemMap::readBlock(char *data, FXuval maxlen)
 				if(readed==maxlen) break;
 			}
 			if(readed==maxlen) break;
+			if(p->windowsize && slideWindow()) continue;
 			FXERRH(p->file, QTrans::tr("QMemMap", "Unable to read unmapped shared memory"), QMEMMAP_NOTMAPPED, 0);
 			// Ok do file read
 			Mapping *nextm=p->cmappingit.current(); // Next mapping still held by iterator
@@ -946,6 +1158,7 @@ FXuval QMemMap::writeBlock(const char *data, FXuval maxlen)
 				if(written==maxlen) break;
 			}
 			if(written==maxlen) break;
+			if(p->windowsize && slideWindow()) continue;
 			FXERRH(p->file, QTrans::tr("QMemMap", "Unable to write unmapped shared memory"), QMEMMAP_NOTMAPPED, 0);
 			// Ok do file write
 			Mapping *nextm=p->cmappingit.current(); // Next mapping still held by iterator
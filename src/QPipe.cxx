@@ -47,6 +47,13 @@
 #ifdef USE_POSIX
 #include <sys/poll.h>
 #include "tnfxselect.h"
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <qcstring.h>
+#endif
 #if defined(__FreeBSD__) || defined(__APPLE__)
 #include <sys/pipe.h>		// For PIPE_SIZE et al
 #endif
@@ -59,6 +66,11 @@ static const char *_fxmemdbg_current_file_ = __FILE__;
 
 namespace FX {
 
+#ifdef __linux__
+// Writes at least this big are vmsplice()'d in gift mode. Smaller ones are quicker copied.
+#define GIFTTHRESHOLD 65536
+#endif
+
 struct FXDLLLOCAL QPipePrivate : public QMutex
 {
 	FXString pipename;
@@ -73,6 +85,7 @@ struct FXDLLLOCAL QPipePrivate : public QMutex
 #endif
 #ifdef USE_POSIX
 	int readh, writeh;
+	bool gift;
 	QPipePrivate(bool deepPipe, bool _inheritable=false) : acl(FXACL::Pipe),
 #if defined(__FreeBSD__) || defined(__APPLE__)
 		// PIPE_BUF lies on FreeBSD :(
@@ -81,7 +94,7 @@ struct FXDLLLOCAL QPipePrivate : public QMutex
 		// It seems Linux can make use of feeding it big packets
 		bufferLength(deepPipe ? 65536 : PIPE_BUF),
 #endif
-		readh(0), writeh(0), QMutex() { }
+		readh(0), writeh(0), gift(false), QMutex() { }
 #endif
 	void makePerms()
 	{
@@ -99,6 +112,19 @@ void *QPipe::int_getOSHandle() const
 #endif
 }
 
+int QPipe::int_transferHandle(bool write)
+{
+#ifdef USE_POSIX
+	if(!isOpen()) return -1;
+	if(!write) return QIODevice::isReadable() ? p->readh : -1;
+	if(!isWriteable()) return -1;
+	if(!p->writeh) writeBlock((const char *) 0, 0);		// Opens the write end
+	return p->writeh;
+#else
+	return -1;
+#endif
+}
+
 void QPipe::int_hack_makeWriteNonblocking() const
 {
 #ifdef USE_POSIX
@@ -180,6 +206,23 @@ void QPipe::setName(const FXString &name)
 	setUnique(false);
 }
 
+bool QPipe::giftMode() const
+{
+#ifdef USE_POSIX
+	return p->gift;
+#else
+	return false;
+#endif
+}
+
+void QPipe::setGiftMode(bool v)
+{
+#ifdef USE_POSIX
+	QMtxHold h(p);
+	p->gift=v;
+#endif
+}
+
 
 static inline FXString makeFullPath(const FXString &src)
 {
@@ -434,6 +477,31 @@ void QPipe::flush()
 		// This is supposed to work, but Linux keeps giving an error :(
 		//FXERRHIO(::fsync(p->writeh));
 		::fsync(p->writeh);
+#ifdef __linux__
+		if(p->gift && p->writeh)
+		{	// Gifted pages must not be reused until the other end has read them
+			int waiting;
+			struct pollfd pfd={0};
+			pfd.fd=p->writeh;
+			h.unlock();
+			while(!::ioctl(p->writeh, FIONREAD, &waiting) && waiting>0)
+			{	/* Nothing signals a pipe becoming empty, but POLLOUT sleeps until the
+				reader makes room in a full one. After that wait out what remains a
+				millisecond at a time, still waking at once if the reader goes away */
+				pfd.events=POLLOUT;
+				int ret=::poll(&pfd, 1, -1);
+				if(ret>=0 && !(pfd.revents & POLLERR))
+				{
+					pfd.events=0;
+					ret=::poll(&pfd, 1, 1);
+				}
+				if(ret<0 && EINTR==errno) continue;
+				FXERRHIO(ret);
+				if(pfd.revents & POLLERR) break;	// Nothing is left to read it
+			}
+			h.relock();
+		}
+#endif
 #endif
 	}
 }
@@ -685,7 +753,35 @@ FXuval QPipe::writeBlock(const char *data, FXuval maxlen)
 		{
 			QIODeviceS_SignalHandler::lockWrite();
 			h.unlock();
-			written=::write(p->writeh, data, maxlen);
+#ifdef __linux__
+			if(p->gift && maxlen>=GIFTTHRESHOLD)
+			{	// The pipe refers to the caller's pages rather than a copy of them. Unlike
+				// write(), vmsplice() returns after each pipe-full so keep going till done.
+				FXuval pagemask=FXProcess::pageSize()-1;
+				unsigned int flags=(((FXuval) data|maxlen) & pagemask) ? 0 : SPLICE_F_GIFT;
+				written=0;
+				while(written<maxlen)
+				{
+					struct iovec iov={ (void *)(data+written), maxlen-written };
+					ssize_t ret=::vmsplice(p->writeh, &iov, 1, flags);
+					if(ret<0)
+					{
+						if(EINTR==errno) continue;
+						if(!written && (EINVAL==errno || ENOSYS==errno))
+						{
+							p->gift=false;
+							written=::write(p->writeh, data, maxlen);
+						}
+						else if(!written)
+							written=(FXuval) -1;
+						break;
+					}
+					written+=ret;
+				}
+			}
+			else
+#endif
+				written=::write(p->writeh, data, maxlen);
 			h.relock();
 			FXERRHIO(written);
 			if(QIODeviceS_SignalHandler::unlockWrite())		// Nasty this
@@ -698,6 +794,147 @@ FXuval QPipe::writeBlock(const char *data, FXuval maxlen)
 	return 0;
 }
 
+FXuval QPipe::readBlockV(const IOVec *segs, FXuint count)
+{
+#ifdef USE_POSIX
+	QMtxHold h(p);
+	if(!QIODevice::isReadable()) FXERRGIO(QTrans::tr("QPipe", "Not open for reading"));
+	if(isOpen())
+	{
+		FXuval readed;
+		fd_set rfds, efds;
+		FD_ZERO(&rfds);
+		FD_ZERO(&efds);
+		FD_SET(p->readh, &rfds);
+		FD_SET(p->readh, &efds);
+		h.unlock();
+		FXERRHIO(tnfxselect(p->readh+1, &rfds, 0, &efds, NULL));
+		if(FD_ISSET(p->readh, &efds))	// error occurred (eg; widowed pipe)
+			return 0;
+		assert(FD_ISSET(p->readh, &rfds));
+		readed=int_vectoredIO(p->readh, segs, count, false);
+		h.relock();
+		FXERRHIO(readed);
+		return readed;
+	}
+	return 0;
+#else
+	return QIODevice::readBlockV(segs, count);
+#endif
+}
+
+FXuval QPipe::writeBlockV(const IOVec *segs, FXuint count)
+{
+#ifdef USE_POSIX
+	QMtxHold h(p);
+	if(!isWriteable()) FXERRGIO(QTrans::tr("QPipe", "Not open for writing"));
+	if(isOpen())
+	{
+		FXuval written=0;
+		if(!p->writeh)
+		{
+			FXString writename(makeFullPath(p->pipename)+((creator) ? 'w' : 'r'));
+			h.unlock();
+			p->writeh=::open(writename.text(), O_WRONLY, 0);
+			h.relock();
+			FXERRHOSFN(p->writeh, writename);
+			FXERRHOS(::fcntl(p->writeh, F_SETFD, ::fcntl(p->writeh, F_GETFD, 0)|FD_CLOEXEC));
+		}
+		if(count)
+		{
+			QIODeviceS_SignalHandler::lockWrite();
+			h.unlock();
+			written=int_vectoredIO(p->writeh, segs, count, true);
+			h.relock();
+			FXERRHIO(written);
+			if(QIODeviceS_SignalHandler::unlockWrite())		// Nasty this
+				FXERRGCONLOST("Broken pipe", 0);
+		}
+		if(isRaw()) flush();
+		return written;
+	}
+	return 0;
+#else
+	return QIODevice::writeBlockV(segs, count);
+#endif
+}
+
+FXfval QPipe::teeTo(QIODevice &dst, FXfval len)
+{
+#if defined(USE_POSIX) && defined(__linux__)
+	QMtxHold h(p);
+	if(!QIODevice::isReadable()) FXERRGIO(QTrans::tr("QPipe", "Not open for reading"));
+	if(!isOpen() || !len) return 0;
+	int dest=dst.int_transferHandle(true), to=dest;
+	struct stat ds;
+	if(dest>=0) FXERRHIO(::fstat(dest, &ds));
+	FXuval chunk=(FXuval) FXMIN(len, (FXfval) 1<<30);
+	int pipefds[2]={ -1, -1 };
+	ssize_t copied=0;
+	FXfval moved=0;		// Through dest
+	h.unlock();
+	FXERRH_TRY
+	{
+		if(dest<0 || !S_ISFIFO(ds.st_mode))
+		{	// tee() only goes between pipes, so go through one of our own
+			FXERRHIO(::pipe(pipefds));
+			to=pipefds[1];
+			chunk=FXMIN(chunk, (FXuval) 65536);
+		}
+		for(;;)
+		{	// Wait for there to be something to read as readBlock() does, as until the
+			// other end connects the pipe looks closed
+			fd_set fds;
+			FD_ZERO(&fds);
+			FD_SET(p->readh, &fds);
+			FXERRHIO(tnfxselect(p->readh+1, &fds, 0, 0, NULL));
+			QIODeviceS_SignalHandler::lockWrite();
+			copied=::tee(p->readh, to, chunk, 0);
+			if(QIODeviceS_SignalHandler::unlockWrite())
+				FXERRGCONLOST("Broken pipe", 0);
+			if(copied>=0 || EAGAIN!=errno) break;
+			// Then for room to put it
+			FD_ZERO(&fds);
+			FD_SET(to, &fds);
+			FXERRHIO(tnfxselect(to+1, 0, &fds, 0, NULL));
+		}
+		FXERRHIO(copied);
+		if(to==dest)
+			moved=copied;
+		else if(dest>=0)
+		{
+			for(ssize_t out; (ssize_t) moved<copied; moved+=out)
+			{
+				FXERRHIO(out=::splice(pipefds[0], 0, dest, 0, copied-moved, SPLICE_F_MOVE));
+			}
+		}
+		else if(to!=dest)
+		{	// Not backed by a handle, so it must be copied through user space after all
+			QByteArray buffer((FXuint) copied);
+			for(ssize_t got=0, readed; got<copied; got+=readed)
+			{
+				FXERRHIO(readed=::read(pipefds[0], buffer.data()+got, copied-got));
+			}
+			for(FXuval written=0; written<(FXuval) copied;)
+				written+=dst.writeBlock(buffer.data()+written, copied-written);
+		}
+	}
+	FXERRH_CATCH(FXException &)
+	{
+		if(-1!=pipefds[0]) { ::close(pipefds[0]); ::close(pipefds[1]); }
+		if(dest>=0) dst.int_transferDone(true, moved);
+		throw;
+	}
+	FXERRH_ENDTRY;
+	if(-1!=pipefds[0]) { ::close(pipefds[0]); ::close(pipefds[1]); }
+	if(dest>=0) dst.int_transferDone(true, moved);
+	return copied;
+#else
+	FXERRGNOTSUPP(QTrans::tr("QPipe", "Duplicating pipe data is not supported on this platform"));
+	return 0;
+#endif
+}
+
 int QPipe::ungetch(int c)
 {
 	return -1;
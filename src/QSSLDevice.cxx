@@ -30,9 +30,13 @@
 #include "FXRollback.h"
 #include "FXPath.h"
 #include "FXNetwork.h"
+#include "QBlkSocket.h"
 #include "QBuffer.h"
+#include "FXLRUCache.h"
 #include "FXErrCodes.h"
 #include <qcstring.h>
+#include <qptrvector.h>
+#include <qdict.h>
 #ifdef _MSC_VER
 #include <malloc.h>			// For alloca()
 #endif
@@ -47,6 +51,14 @@
 #include "openssl/crypto.h"
 #include "openssl/md5.h"
 #include <stdio.h>
+#include <time.h>
+#endif
+#if defined(__AVX2__)
+#include "immintrin.h"
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include "emmintrin.h"
+#define QSSLDEVICE_SSE2
 #endif
 #include <assert.h>
 //#include "FXMemDbg.h"
@@ -204,6 +216,23 @@ static DH *getDHParams(SSL *ssl, int isexport, int keylen)
 
 #endif
 
+#ifdef HAVE_OPENSSL
+// Sessions are only resumed between servers with the same id context
+static FXString sessionIdContext(bool disabled=false)
+{
+	FXString myname(disabled ? "TnFOX_%1_%2_%3_disabled" : "TnFOX_%1_%2_%3");
+	myname.arg(FXNetwork::hostname()).arg(FXPath::name(FXProcess::execpath())).arg(FXProcess::id(), 0, 16);
+	return myname;
+}
+
+struct QSSLDevice_CachedSession
+{
+	SSL_SESSION *session;
+	QSSLDevice_CachedSession(SSL_SESSION *s) : session(s) { }
+	~QSSLDevice_CachedSession() { SSL_SESSION_free(session); }
+};
+#endif
+
 class QSSLDevice_Init;
 static QSSLDevice_Init *myinit;
 class QSSLDevice_Init : public QMutex
@@ -212,6 +241,9 @@ public:
 #ifdef HAVE_OPENSSL
 	SSL_CTX *ctx;
 	QMemArray<QMutex *> locks;
+	FXuint sessioncaching, sessiontimeout;
+	FXLRUCache<QDict<QSSLDevice_CachedSession> > clientsessions;
+	QSSLDevice::SessionCacheStats sessionstats;
 	static void lockingfunction(int mode, int n, const char *file, int line)
 	{
 		if(!myinit) return;
@@ -224,8 +256,10 @@ public:
 #ifndef HAVE_OPENSSL
 	{
 #else
-		: ctx(0), locks(CRYPTO_num_locks())
+		: ctx(0), locks(CRYPTO_num_locks()), sessioncaching(QSSLDevice::ServerSessionCache|QSSLDevice::SessionTickets),
+		sessiontimeout(300), clientsessions(1024, 127, true)
 	{
+		clientsessions.setDynamic(false);
 		SSL_load_error_strings();
 		FXERRHSSL(SSL_library_init());
 		for(FXuint n=0; n<locks.size(); n++)
@@ -271,16 +305,67 @@ public:
 			FXERRHSSL(SSL_CTX_set_cipher_list(ctx, "ALL:@STRENGTH"));
 			SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, 0);
 			SSL_CTX_set_mode(ctx, SSL_MODE_AUTO_RETRY|SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
-			FXString myname("TnFOX_%1_%2");
-			myname.arg(FXNetwork::hostname()).arg(FXProcess::id(), 0, 16);
+			FXString myname(sessionIdContext());
 			FXERRHSSL(SSL_CTX_set_session_id_context(ctx, (unsigned char *) myname.text(), myname.length()));
+			applySessionCaching();
 		}
 #endif
 	}
+#ifdef HAVE_OPENSSL
+	void applySessionCaching()
+	{	// Lock must be held
+		if(!ctx) return;
+		SSL_CTX_set_session_cache_mode(ctx, (sessioncaching & QSSLDevice::ServerSessionCache) ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+		SSL_CTX_sess_set_cache_size(ctx, clientsessions.maxCost());
+		SSL_CTX_set_timeout(ctx, sessiontimeout);
+	}
+	void useClientSession(SSL *handle, const FXString &peer)
+	{
+		QMtxHold h(this);
+		if(!(sessioncaching & QSSLDevice::ClientSessionCache) || peer.empty()) return;
+		QSSLDevice_CachedSession *cs=clientsessions.find(peer);
+		if(!cs) return;
+		if(SSL_SESSION_get_time(cs->session)+SSL_SESSION_get_timeout(cs->session)<(long) ::time(0))
+		{	// Expired, so don't bother offering it
+			clientsessions.remove(peer);
+			return;
+		}
+		FXERRHSSL(SSL_set_session(handle, cs->session));
+	}
+	void handshakeDone(SSL *handle, bool amServer, const FXString &peer)
+	{
+		QMtxHold h(this);
+		bool reused=!!SSL_session_reused(handle);
+		if(amServer)
+		{
+			if(reused) sessionstats.serverHits++; else sessionstats.serverMisses++;
+			return;
+		}
+		if(!(sessioncaching & QSSLDevice::ClientSessionCache) || peer.empty()) return;
+		if(reused)
+		{
+			sessionstats.clientHits++;
+			return;
+		}
+		sessionstats.clientMisses++;
+		SSL_SESSION *session=SSL_get1_session(handle);
+		if(!session) return;
+		QSSLDevice_CachedSession *cs;
+		if(!(cs=new QSSLDevice_CachedSession(session)))
+		{
+			SSL_SESSION_free(session);
+			FXERRHM(0);
+		}
+		FXRBOp uncs=FXRBNew(cs);
+		clientsessions.remove(peer);
+		if(clientsessions.insert(peer, cs)) uncs.dismiss();
+	}
+#endif
 	~QSSLDevice_Init()
 	{
 #ifdef HAVE_OPENSSL
 		QMtxHold h(this);
+		clientsessions.clear();
 		if(ctx)
 		{
 			SSL_CTX_free(ctx);
@@ -1295,17 +1380,23 @@ struct FXDLLLOCAL QSSLDevicePrivate : public QMutex
 	SSL *handle;
 	BIO *bio;
 	X509 *peercert;
+	FXString sessionpeer;
+	bool sessionreused;
 	EVP_CIPHER_CTX estream;
+	const EVP_CIPHER *cipher;
+	FXuchar *streamkey;		// Copy of the key estream was initialised with, for worker threads
+	int streamkeybits;		// Non-zero if the key length had to be set
 	FXfval headerdiff;		// The diff between source dev and us due to the TNFXSECD header
 	FXuchar *nonce;			// Holds the nonce
 	FXuval noncelen;
-	FXuchar *ebuffer;		// Holds a block of encryption stream
+	FXuchar *cbuffer;		// Holds the counter blocks being encrypted into ebuffer
+	FXuchar *ebuffer;		// Holds KeyStreamBatch bytes of encryption stream
 	FXfval ebufferIoIndex;
 #endif
 	QSSLDevicePrivate(QIODevice *ed) : dev(ed), amServer(false), connected(false),
 		ciphers("HIGH:@STRENGTH"), key(0),
 #ifdef HAVE_OPENSSL
-		handle(0), bio(0), peercert(0), headerdiff(0), nonce(0), noncelen(0), ebuffer(0), ebufferIoIndex((FXfval)-1),
+		cipher(0), streamkey(0), streamkeybits(0), handle(0), bio(0), peercert(0), sessionreused(false), headerdiff(0), nonce(0), noncelen(0), cbuffer(0), ebuffer(0), ebufferIoIndex((FXfval)-1),
 #endif
 		QMutex() { }
 	~QSSLDevicePrivate()
@@ -1316,6 +1407,16 @@ struct FXDLLLOCAL QSSLDevicePrivate : public QMutex
 			Secure::free(nonce);
 			nonce=0; noncelen=0;
 		}
+		if(streamkey)
+		{
+			Secure::free(streamkey);
+			streamkey=0;
+		}
+		if(cbuffer)
+		{
+			Secure::free(cbuffer);
+			cbuffer=0;
+		}
 		if(ebuffer)
 		{
 			Secure::free(ebuffer);
@@ -1345,10 +1446,25 @@ struct FXDLLLOCAL QSSLDevicePrivate : public QMutex
 			FXERRHSSL(SSL_set_ssl_method(handle, SSLv3_method()));
 		}
 		FXERRHSSL(SSL_set_cipher_list(handle, ciphers.text()));
+#ifdef SSL_OP_NO_TICKET
+		if(!(myinit->sessioncaching & QSSLDevice::SessionTickets))
+			SSL_set_options(handle, SSL_OP_NO_TICKET);
+#endif
 		if(!(bio=BIO_new(&BIO_s_QIODevice))) FXERRHSSL(-1);
 		BIO_set_fp(bio, dev, 0);
 		SSL_set_bio(handle, bio, bio);
 	}
+	FXString sessionPeer() const
+	{	// Client sessions are cached per peer and cipher list
+		FXString peer(sessionpeer);
+		if(peer.empty())
+		{
+			QBlkSocket *s=dynamic_cast<QBlkSocket *>(dev);
+			if(!s || !s->isOpen()) return peer;
+			peer=s->peerAddress().toString()+":"+FXString::number((FXint) s->peerPort());
+		}
+		return peer+"/"+ciphers;
+	}
 	void negotiate()
 	{	// Negotiation is not threadsafe, even at the device level :(
 		bool oldConnected=connected;
@@ -1360,8 +1476,7 @@ struct FXDLLLOCAL QSSLDevicePrivate : public QMutex
 		{
 			if(amServer)
 			{	// Need to temporarily disable the session cache
-				FXString myname("TnFOX_%1_%2_%3_disabled");
-				myname.arg(FXNetwork::hostname()).arg(FXPath::name(FXProcess::execpath())).arg(FXProcess::id(), 0, 16);
+				FXString myname(sessionIdContext(true));
 				FXERRHSSL(SSL_CTX_set_session_id_context(myinit->ctx, (unsigned char *) myname.text(), myname.length()));
 			}
 			int ret;
@@ -1376,8 +1491,7 @@ struct FXDLLLOCAL QSSLDevicePrivate : public QMutex
 			h.relock();
 			if(amServer)
 			{
-				FXString myname("TnFOX_%1_%2_%3");
-				myname.arg(FXNetwork::hostname()).arg(FXPath::name(FXProcess::execpath())).arg(FXProcess::id(), 0, 16);
+				FXString myname(sessionIdContext());
 				FXERRHSSL(SSL_CTX_set_session_id_context(myinit->ctx, (unsigned char *) myname.text(), myname.length()));
 			}
 			FXERRHSSL(ret);
@@ -1397,6 +1511,8 @@ struct FXDLLLOCAL QSSLDevicePrivate : public QMutex
 			}
 			else
 			{
+				FXString peer(sessionPeer());
+				myinit->useClientSession(handle, peer);
 				h.unlock();
 				int ret=SSL_connect(handle);
 				h.relock();
@@ -1405,7 +1521,10 @@ struct FXDLLLOCAL QSSLDevicePrivate : public QMutex
 					FXERRG(getSSLError(), QSSLDEVICE_NEGOTIATIONFAILED, 0);
 				}
 				FXERRHSSL(ret);
+				myinit->handshakeDone(handle, false, peer);
 			}
+			if(amServer) myinit->handshakeDone(handle, true, FXString());
+			sessionreused=!!SSL_session_reused(handle);
 		}
 		connected=true;
 		if(SSL_get_verify_result(handle)==X509_V_OK)
@@ -1421,71 +1540,195 @@ void *QSSLDevice::int_getOSHandle() const
 	return p->dev->isSynchronous() ? static_cast<QIODeviceS *>(p->dev)->int_getOSHandle() : 0;
 }
 #ifdef HAVE_OPENSSL
+static const FXuval KeyStreamBatch=4096;			// Bytes of key stream generated per EVP call
+static const FXuval ParallelXorMin=512*1024;		// Transfers this big are split across the thread pool
+
+// Encrypts the nonce XORed with the file offset of each block to generate len bytes
+// of key stream for the block aligned offset cblock
+static void genKeyStream(EVP_CIPHER_CTX *ctx, const FXuchar *nonce, FXuval noncelen, FXfval cblock, FXuchar *counters, FXuchar *out, FXuval len)
+{
+	// Keysize is guaranteed to be multiple of 8
+	FXSTATIC_ASSERT(sizeof(FXfval)==8, FXfval_Is_Not_Eight);
+	assert(noncelen>=8 && !(len % noncelen));
+	for(FXuval b=0; b<len; b+=noncelen)
+	{
+		for(FXuval n=0; n<noncelen/sizeof(FXfval); n++)
+			((FXfval *)(counters+b))[n]=((const FXfval *) nonce)[n] ^ (cblock+b+n*sizeof(FXfval));
+	}
+	int outlen=0;
+	FXERRHSSL(EVP_EncryptUpdate(ctx, out, &outlen, counters, (int) len));
+	assert(outlen==(int) len);
+}
+
+static inline void xorKeyStream(char *dest, const char *src, const FXuchar *ks, FXuval len)
+{	// None of which need be aligned, and dest may be src
+	FXuval n=0;
+#if defined(__AVX2__)
+	for(; n+32<=len; n+=32)
+		_mm256_storeu_si256((__m256i *)(dest+n), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(src+n)), _mm256_loadu_si256((const __m256i *)(ks+n))));
+#endif
+#ifdef QSSLDEVICE_SSE2
+	for(; n+16<=len; n+=16)
+		_mm_storeu_si128((__m128i *)(dest+n), _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src+n)), _mm_loadu_si128((const __m128i *)(ks+n))));
+#endif
+	for(; n+8<=len; n+=8)
+	{
+		FXulong a, b;
+		memcpy(&a, src+n, 8); memcpy(&b, ks+n, 8);
+		a^=b;
+		memcpy(dest+n, &a, 8);
+	}
+	for(; n<len; n++)
+		dest[n]=src[n]^(char) ks[n];
+}
+
+struct FXDLLLOCAL QSSLDeviceXorJob
+{	// Encrypts or decrypts a portion of a big transfer with its own cipher context. Reference
+	// counted as the pool may get round to it after the caller has claimed and run it itself
+	FXAtomicInt refs, claimed;
+	const EVP_CIPHER *cipher;
+	const FXuchar *key, *nonce;
+	int keybits;				// Non-zero if key length must be set
+	FXuval noncelen;
+	FXfval offset;
+	char *dest;
+	const char *src;
+	FXuval len;
+	QWaitCondition done;
+	bool failed;
+	QSSLDeviceXorJob() : refs(1), failed(false) { }
+	void release()
+	{
+		if(!--refs) delete this;
+	}
+	// Returns true if the caller is the one to run it
+	bool claim()
+	{
+		return !claimed.swap(1);
+	}
+	void process()
+	{
+		EVP_CIPHER_CTX ctx;
+		FXuchar counters[KeyStreamBatch], ks[KeyStreamBatch];
+		EVP_CIPHER_CTX_init(&ctx);
+		FXRBOp unctx=FXRBFunc(&EVP_CIPHER_CTX_cleanup, &ctx);
+		FXERRHSSL(EVP_EncryptInit_ex(&ctx, cipher, NULL, key, NULL));
+		if(keybits)
+			FXERRHSSL(EVP_CIPHER_CTX_set_key_length(&ctx, keybits));
+		for(FXuval idx=0; idx<len;)
+		{
+			FXfval pos=offset+idx, cblock=pos-(pos % noncelen);
+			FXuval skip=(FXuval)(pos-cblock), todo=FXMIN(len-idx, KeyStreamBatch-skip);
+			genKeyStream(&ctx, nonce, noncelen, cblock, counters, ks, (skip+todo+noncelen-1)/noncelen*noncelen);
+			xorKeyStream(dest+idx, src+idx, ks+skip, todo);
+			idx+=todo;
+		}
+		memset(counters, 0, sizeof(counters));		// Ensure buffers are wiped on exit
+		memset(ks, 0, sizeof(ks));
+	}
+	void execute()
+	{
+		FXERRH_TRY
+		{
+			process();
+		}
+		FXERRH_CATCH(FXException &)
+		{
+			failed=true;
+		}
+		FXERRH_ENDTRY
+		done.wakeAll();
+	}
+	static void run(QSSLDeviceXorJob *job)
+	{
+		if(job->claim()) job->execute();
+		job->release();
+	}
+};
+struct FXDLLLOCAL QSSLDeviceXorJobs : public QPtrVector<QSSLDeviceXorJob>
+{	// Waiting on jobs the pool hasn't started would deadlock if we're a pool thread, so run those ourselves
+	~QSSLDeviceXorJobs() { finish(false); }
+	bool finish(bool runinline=true)
+	{	// Returns true if any job failed
+		bool failed=false;
+		for(FXuint n=0; n<count(); n++)
+		{
+			QSSLDeviceXorJob *job=at(n);
+			if(!job->claim())
+				job->done.wait();
+			else if(runinline)
+				job->execute();
+			else
+				job->failed=true;
+			if(job->failed) failed=true;
+			job->release();
+		}
+		clear();
+		return failed;
+	}
+};
+
 inline void QSSLDevice::int_genEBuffer() const
 {
-	FXfval cblock=ioIndex-(ioIndex % p->noncelen);
+	FXfval cblock=ioIndex-(ioIndex % KeyStreamBatch);
 	if(p->ebufferIoIndex!=cblock)
-	{	// XOR the nonce and ioIndex and encrypt to generate ebuffer
-		FXuchar *buffer=(FXuchar *) alloca(p->noncelen+4);	// use alloca() for speed
-		if((((FXuval) buffer) & 4)) buffer+=4;	// align
-		assert(p->noncelen>=8);
-		// Keysize is guaranteed to be multiple of 8
-		FXSTATIC_ASSERT(sizeof(FXfval)==8, FXfval_Is_Not_Eight);
-		for(FXuval n=0; n<p->noncelen/sizeof(FXfval); n++)
-			((FXfval *) buffer)[n]=((FXfval *) p->nonce)[n] ^ (cblock+n*sizeof(FXfval));
-		int outlen=0, ret;
-		ret=EVP_EncryptUpdate(&p->estream, p->ebuffer, &outlen, buffer, (FXuint) p->noncelen);
-		memset(buffer, 0, p->noncelen);		// Ensure buffer is wiped on exit
-		FXERRHSSL(ret);
-		assert(outlen==(int)p->noncelen);
+	{	// KeyStreamBatch is a multiple of all block sizes
+		genKeyStream(&p->estream, p->nonce, p->noncelen, cblock, p->cbuffer, p->ebuffer, KeyStreamBatch);
 		p->ebufferIoIndex=cblock;
 	}
 }
 
 void QSSLDevice::int_xorInEBuffer(char *dest, const char *src, FXuval amount)
-{	// Keysize must be a multiple of 8, so we can process in 64 bit words for speed
-	FXSTATIC_ASSERT(sizeof(FXulong)==8, FXulong_Is_Not_Eight);
-	bool first=true;
-	// Try to optimise by address alignment
-	while(amount)
-	{
-		FXival ebufferoffset=(FXival)(ioIndex % p->noncelen);
-		FXuchar *ebuffer=FXOFFSETPTR(p->ebuffer, ebufferoffset);
-		if(first || !ebufferoffset)
-		{	// Only call this when needed
-			int_genEBuffer();
-			first=false;
-		}
-		FXuval d=(FXuval) dest, s=(FXuval) src, e=(FXuval) ebuffer, todo=FXMIN(amount, p->noncelen-ebufferoffset), size=0;
-#if 0
-		if(todo>=16 && !(d & 15) && !(s & 15) && !(e & 15))
-		{	// TODO: Use SSE2 16 byte XOR
-			int a=1;
-		}
-#endif
-		if(todo>=8 && !(d & 7) && !(s & 7) && !(e & 7))
-		{	// Do it as one 64 bit op
-			*((FXulong *) dest)=*((FXulong *) src) ^ *((FXulong *) ebuffer);
-			size=8;
-			goto end;
-		}
-		if(todo>=4 && !(d & 3) && !(s & 3) && !(e & 3))
-		{	// Do it as one 32 bit op
-			*((FXuint *) dest)=*((FXuint *) src) ^ *((FXuint *) ebuffer);
-			size=4;
-			goto end;
+{
+	QSSLDeviceXorJobs jobs;
+	FXuval serial=amount;
+	FXuint threads=FXProcess::threadPool().maximum();
+	if(amount>=ParallelXorMin && threads>1)
+	{	// Counter mode blocks are independent, so farm out all but the first chunk to the thread pool
+		FXuval chunks=FXMIN((FXuval) threads, amount/(ParallelXorMin/2));
+		serial=(amount/chunks+KeyStreamBatch-1) & ~(KeyStreamBatch-1);
+		for(FXuval offset=serial; offset<amount; offset+=serial)
+		{
+			QSSLDeviceXorJob *job;
+			FXERRHM(job=new QSSLDeviceXorJob);
+			FXRBOp unjob=FXRBNew(job);
+			job->cipher=p->cipher;
+			job->key=p->streamkey;
+			job->keybits=p->streamkeybits;
+			job->nonce=p->nonce;
+			job->noncelen=p->noncelen;
+			job->offset=ioIndex+offset;
+			job->dest=dest+offset;
+			job->src=src+offset;
+			job->len=FXMIN(serial, amount-offset);
+			jobs.append(job);
+			unjob.dismiss();
+			++job->refs;
+			FXRBOp unref=FXRBObj(*job, &QSSLDeviceXorJob::release);
+			FXProcess::threadPool().dispatch(Generic::BindFuncN(&QSSLDeviceXorJob::run, job));
+			unref.dismiss();
 		}
-		if(todo>=2 && !(d & 1) && !(s & 1) && !(e & 1))
-		{	// Do it as one 16 bit op
-			*((FXushort *) dest)=*((FXushort *) src) ^ *((FXushort *) ebuffer);
-			size=2;
-			goto end;
+	}
+	bool failed=false;
+	FXERRH_TRY
+	{
+		for(FXuval done=0; done<serial;)
+		{
+			int_genEBuffer();
+			FXuval offset=(FXuval)(ioIndex-p->ebufferIoIndex), todo=FXMIN(serial-done, KeyStreamBatch-offset);
+			xorKeyStream(dest+done, src+done, p->ebuffer+offset, todo);
+			done+=todo; ioIndex+=todo;
 		}
-		*((FXuchar *) dest)=*((FXuchar *) src) ^ *((FXuchar *) ebuffer);
-		size=1;
-end:
-		dest+=size; src+=size; ioIndex+=size; amount-=size;
 	}
+	FXERRH_CATCH(FXException &)
+	{
+		if(jobs.isEmpty()) throw;
+		failed=true;
+	}
+	FXERRH_ENDTRY
+	if(jobs.finish()) failed=true;
+	if(failed) FXERRGIO(QTrans::tr("QSSLDevice", "Failed to generate encryption stream"));
+	ioIndex+=amount-serial;
 }
 #endif
 
@@ -1670,6 +1913,34 @@ void QSSLDevice::renegotiate()
 #endif
 }
 
+FXString QSSLDevice::sessionPeer() const
+{
+	QMtxHold h(p);
+#ifdef HAVE_OPENSSL
+	return p->sessionpeer;
+#else
+	return FXString();
+#endif
+}
+
+void QSSLDevice::setSessionPeer(const FXString &peer)
+{
+	QMtxHold h(p);
+#ifdef HAVE_OPENSSL
+	p->sessionpeer=peer;
+#endif
+}
+
+bool QSSLDevice::sessionReused() const
+{
+	QMtxHold h(p);
+#ifdef HAVE_OPENSSL
+	return p->sessionreused;
+#else
+	return false;
+#endif
+}
+
 FXuint QSSLDevice::fileHeaderLen() const throw()
 {
 #ifdef HAVE_OPENSSL
@@ -1887,7 +2158,7 @@ bool QSSLDevice::open(FXuint mode)
 			// Okay set up for reading & writing
 			assert(!p->nonce);
 			assert(!p->ebuffer);
-			const EVP_CIPHER *cipher=0;
+			const EVP_CIPHER *&cipher=p->cipher;
 			switch(key.type())
 			{
 			case FXSSLKey::NoEncryption:
@@ -1921,13 +2192,16 @@ bool QSSLDevice::open(FXuint mode)
 			EVP_CIPHER_CTX_init(&p->estream);
 			FXERRHSSL(EVP_EncryptInit_ex(&p->estream, cipher, NULL, (FXuchar *) key.p->key, NULL));
 			if(FXSSLKey::Blowfish==key.type())
-				FXERRHSSL(EVP_CIPHER_CTX_set_key_length(&p->estream, key.bitsLen()));
+				FXERRHSSL(EVP_CIPHER_CTX_set_key_length(&p->estream, p->streamkeybits=key.bitsLen()));
+			FXERRHM(p->streamkey=Secure::malloc<FXuchar>(FXMAX(key.bytesLen(), 1)));
+			memcpy(p->streamkey, key.p->key, key.bytesLen());
 			p->noncelen=EVP_CIPHER_CTX_block_size(&p->estream);
 			if(p->noncelen<8) p->noncelen=8;	// For null cipher
 			p->headerdiff+=p->noncelen;
 			// Allocate nonce and buffers
 			FXERRHM(p->nonce=Secure::malloc<FXuchar>(p->noncelen));
-			FXERRHM(p->ebuffer=Secure::malloc<FXuchar>(p->noncelen));
+			FXERRHM(p->cbuffer=Secure::malloc<FXuchar>(KeyStreamBatch));
+			FXERRHM(p->ebuffer=Secure::malloc<FXuchar>(KeyStreamBatch));
 			p->ebufferIoIndex=(FXfval)-1;
 
 			if((mode & IO_ReadOnly) && !p->dev->atEnd())
@@ -1971,6 +2245,10 @@ void QSSLDevice::close()
 			FXERRHSSL(EVP_CIPHER_CTX_cleanup(&p->estream));
 			Secure::free(p->nonce);
 			p->nonce=0; p->noncelen=0;
+			Secure::free(p->streamkey);
+			p->streamkey=0; p->streamkeybits=0;
+			Secure::free(p->cbuffer);
+			p->cbuffer=0;
 			Secure::free(p->ebuffer);
 			p->ebuffer=0;
 		}
@@ -1991,6 +2269,7 @@ void QSSLDevice::close()
 			ERR_clear_error();
 			p->handle=0;
 			p->bio=0;
+			p->sessionreused=false;
 		}
 		if(p->dev)
 		{
@@ -2242,6 +2521,94 @@ const FXString &QSSLDevice::fastestAnonCipher()
 	return temp;
 }
 
+FXuint QSSLDevice::sessionCaching()
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	return myinit->sessioncaching;
+#else
+	return 0;
+#endif
+}
+
+void QSSLDevice::setSessionCaching(FXuint modes)
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	myinit->sessioncaching=modes;
+	if(!(modes & ClientSessionCache)) myinit->clientsessions.clear();
+	myinit->applySessionCaching();
+#endif
+}
+
+FXuint QSSLDevice::sessionCacheSize()
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	return myinit->clientsessions.maxCost();
+#else
+	return 0;
+#endif
+}
+
+void QSSLDevice::setSessionCacheSize(FXuint entries)
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	myinit->clientsessions.setMaxCost(entries);
+	myinit->applySessionCaching();
+#endif
+}
+
+FXuint QSSLDevice::sessionCacheTimeout()
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	return myinit->sessiontimeout;
+#else
+	return 0;
+#endif
+}
+
+void QSSLDevice::setSessionCacheTimeout(FXuint secs)
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	myinit->sessiontimeout=secs;
+	myinit->applySessionCaching();
+#endif
+}
+
+QSSLDevice::SessionCacheStats QSSLDevice::sessionCacheStats()
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	SessionCacheStats ret(myinit->sessionstats);
+	ret.clientEntries=myinit->clientsessions.count();
+	ret.serverEntries=myinit->ctx ? (FXuint) SSL_CTX_sess_number(myinit->ctx) : 0;
+	return ret;
+#else
+	return SessionCacheStats();
+#endif
+}
+
+void QSSLDevice::resetSessionCacheStats()
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	myinit->sessionstats=SessionCacheStats();
+#endif
+}
+
+void QSSLDevice::flushSessionCache()
+{
+#ifdef HAVE_OPENSSL
+	QMtxHold h(myinit);
+	myinit->clientsessions.clear();
+	if(myinit->ctx) SSL_CTX_flush_sessions(myinit->ctx, 0);		// Zero removes all
+#endif
+}
+
 //**********************************************************************************
 
 namespace Secure
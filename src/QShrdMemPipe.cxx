@@ -0,0 +1,538 @@
+/********************************************************************************
+*                                                                               *
+*                         Shared memory pipe i/o device                         *
+*                                                                               *
+*********************************************************************************
+*        Copyright (C) 2003-2008 by Niall Douglas.   All Rights Reserved.       *
+*       NOTE THAT I DO NOT PERMIT ANY OF MY CODE TO BE PROMOTED TO THE GPL      *
+*********************************************************************************
+* This code is free software; you can redistribute it and/or modify it under    *
+* the terms of the GNU Library General Public License v2.1 as published by the  *
+* Free Software Foundation EXCEPT that clause 3 does not apply ie; you may not  *
+* "upgrade" this code to the GPL without my prior written permission.           *
+* Please consult the file "License_Addendum2.txt" accompanying this file.       *
+*                                                                               *
+* This code is distributed in the hope that it will be useful,                  *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of                *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.                          *
+*********************************************************************************
+* $Id:                                                                          *
+********************************************************************************/
+
+#include "QShrdMemPipe.h"
+#include "QMemMap.h"
+#include "QThread.h"		// May undefine USE_WINAPI and USE_POSIX
+#include "FXProcess.h"
+#include "FXString.h"
+#include "FXACL.h"
+#include <stdio.h>
+#ifdef USE_POSIX
+ #include <signal.h>
+ #include <errno.h>
+ #ifdef __linux__
+  #include <unistd.h>
+  #include <time.h>
+  #include <pthread.h>
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+  #if defined(SYS_futex) && defined(FUTEX_WAIT)
+   #define USE_FUTEX
+  #endif
+ #endif
+#endif
+#if defined(_MSC_VER)
+ #include <intrin.h>
+#endif
+#include "FXException.h"
+#include "QTrans.h"
+#include "FXRollback.h"
+#include "FXMemDbg.h"
+#if defined(DEBUG) && !defined(FXMEMDBG_DISABLE)
+static const char *_fxmemdbg_current_file_ = __FILE__;
+#endif
+
+namespace FX {
+
+// RINGORDER() stops loads and stores being moved across it, RINGFENCE() also
+// stops a store being moved after a following load. As for QLocalPipe.
+#if defined(__GNUC__)
+ #if defined(__i386__) || defined(__x86_64__)
+  #define RINGORDER() __asm__ __volatile__("" ::: "memory")
+  #define RINGPAUSE() __asm__ __volatile__("pause")
+ #else
+  #define RINGORDER() __sync_synchronize()
+  #define RINGPAUSE()
+ #endif
+ #define RINGFENCE() __sync_synchronize()
+ #define RINGCAS(ptr, oldval, newval) __sync_bool_compare_and_swap(ptr, oldval, newval)
+#elif defined(_MSC_VER)
+ #define RINGORDER() _ReadWriteBarrier()
+ #define RINGFENCE() _mm_mfence()
+ #define RINGPAUSE() _mm_pause()
+ #define RINGCAS(ptr, oldval, newval) ((long)(oldval)==_InterlockedCompareExchange((volatile long *)(ptr), (long)(newval), (long)(oldval)))
+#endif
+// Bigger than any cache line
+#define CACHELINE 128
+// How many times to look again before going to sleep when the other end could be running
+#define RINGSPINS 256
+
+/* Everything below lives in the shared memory so it must be plain data. The
+layout is that of QLocalPipe's rings except that the data follows the header
+rather than being pointed to, and a sleeping side waits on a process shared
+futex rather than a private one. */
+struct SharedWaiter
+{
+	volatile int sleeping;
+	volatile int seq;				// Bumped by each wake and waited upon
+	int expected;
+	void prepare()
+	{
+		expected=seq;
+		sleeping=1;
+		RINGFENCE();
+	}
+	// Must be preceded by prepare() then a recheck of whatever is being waited for
+	void sleep()
+	{
+#ifdef USE_FUTEX
+		// Wait in slices so cancellation and the other end dying can't be missed
+		struct timespec slice={0, 100000000};
+		::syscall(SYS_futex, &seq, FUTEX_WAIT, expected, &slice, 0, 0);
+		sleeping=0;
+		pthread_testcancel();
+#else
+		QThread::msleep(1);
+		sleeping=0;
+#endif
+	}
+	void cancel() { sleeping=0; }
+	// Must be preceded by RINGFENCE()
+	void wake(bool always=false)
+	{
+		if(always || sleeping)
+		{
+#ifdef USE_FUTEX
+			__sync_fetch_and_add(&seq, 1);
+			::syscall(SYS_futex, &seq, FUTEX_WAKE, 1, 0, 0, 0);
+#endif
+		}
+	}
+};
+struct SharedRing
+{
+	volatile FXuval head;			// Only ever advanced by the writer
+	SharedWaiter writer;			// Sleeps when full or flushing
+	char pad0[CACHELINE-sizeof(FXuval)-sizeof(SharedWaiter)];
+	volatile FXuval tail;			// Only ever advanced by the reader
+	SharedWaiter reader;			// Sleeps when empty
+	char pad1[CACHELINE-sizeof(FXuval)-sizeof(SharedWaiter)];
+	FXuval waiting() const { return head-tail; }
+};
+struct SharedHeader
+{
+	FXuint magic, version;
+	FXuval capacity;				// Of each ring
+	volatile FXuint ends;			// Which ends are open or have been
+	FXint pids[2];					// Of the creator and the client
+	char pad[CACHELINE-3*sizeof(FXuint)-sizeof(FXuval)-2*sizeof(FXint)];
+	SharedRing rings[2];			// The creator writes the first and reads the second
+};
+#define MAGIC (*(FXuint *)"SMPI")
+// Changes whenever the layout does, including with the size of a pointer
+#define VERSION ((1<<8)|sizeof(FXuval))
+enum
+{
+	CreatorOpen=1,
+	ClientOpen=2,
+	ClientClosed=4
+};
+
+struct FXDLLLOCAL QShrdMemPipePrivate : public QMutex
+{
+	FXString name;
+	FXuval ringsize;
+	FXACL acl;
+	QMemMap *map;
+	SharedHeader *header;
+	SharedRing *readring, *writering;
+	FXuchar *readdata, *writedata;
+	FXuval capacity, mask;
+	bool peerdied;
+	volatile bool closing;
+	FXAtomicInt users;				// Threads using the rings, which close() waits for
+	int spins;
+	QShrdMemPipePrivate(FXuval _ringsize) : ringsize(_ringsize), acl(FXACL::MemMap), map(0), header(0),
+		readring(0), writering(0), readdata(0), writedata(0), capacity(0), mask(0), peerdied(false), closing(false),
+		spins((FXProcess::noOfProcessors()>1) ? RINGSPINS : 0), QMutex() { }
+	// Keeps the mapping alive while the rings are used without the lock, throwing if it is closing
+	struct User
+	{
+		QShrdMemPipePrivate *p;
+		User(QShrdMemPipePrivate *_p) : p(_p)
+		{
+			++p->users;
+			if(p->closing || !p->header)
+			{
+				--p->users;
+				FXERRGCONLOST("Connection Lost", 0);
+			}
+		}
+		~User() { --p->users; }
+	};
+	~QShrdMemPipePrivate() { FXDELETE(map); }
+	void setup(bool creator)
+	{
+		FXuchar *data=(FXuchar *) header+sizeof(SharedHeader);
+		capacity=header->capacity;
+		mask=capacity-1;
+		readring=&header->rings[creator ? 1 : 0];
+		writering=&header->rings[creator ? 0 : 1];
+		readdata=data+(creator ? capacity : 0);
+		writedata=data+(creator ? 0 : capacity);
+		peerdied=false;
+	}
+	// Atomically clears then sets bits in ends, returning what it was before
+	FXuint updateEnds(FXuint clear, FXuint set)
+	{
+		FXuint old;
+		do
+		{
+			old=header->ends;
+		} while(!RINGCAS(&header->ends, old, (old & ~clear)|set));
+		return old;
+	}
+	// True if the other end has closed, or this end is being closed by another thread
+	bool peerClosed(bool creator) const
+	{
+		FXuint ends=header->ends;
+		return peerdied || closing || (creator ? !!(ends & ClientClosed) : !(ends & CreatorOpen));
+	}
+	// Called after sleeping to notice the other end's process having died without closing
+	void checkPeer(bool creator)
+	{
+		FXuint ends=header->ends;
+		if(creator && !(ends & ClientOpen)) return;
+		FXint pid=header->pids[creator ? 1 : 0];
+		if(pid && processGone(pid)) peerdied=true;
+	}
+	static bool processGone(FXint pid)
+	{
+#ifdef USE_POSIX
+		if(-1==::kill(pid, 0) && ESRCH==errno) return true;
+#ifdef __linux__
+		{	// A child which has died remains a zombie until its parent waits for it
+			char buffer[512], *state;
+			sprintf(buffer, "/proc/%d/stat", pid);
+			FILE *ih=fopen(buffer, "r");
+			if(ih)
+			{	// The state follows the bracketed command name, which may contain anything
+				if(!fgets(buffer, sizeof(buffer), ih)) buffer[0]=0;
+				fclose(ih);
+				if((state=strrchr(buffer, ')')) && ('Z'==state[2] || 'X'==state[2])) return true;
+			}
+		}
+#endif
+#endif
+		return false;
+	}
+	// Blocks until there is data in the ring, returning how much
+	FXuval waitForData(bool creator)
+	{
+		SharedRing &r=*readring;
+		FXuval waiting;
+		while(!(waiting=r.waiting()))
+		{
+			if(peerClosed(creator)) FXERRGCONLOST("Connection Lost", 0);
+			for(int n=0; n<spins && !r.waiting(); n++) RINGPAUSE();
+			if(r.waiting()) continue;
+			r.reader.prepare();
+			if(r.waiting() || peerClosed(creator)) r.reader.cancel();
+			else
+			{
+				r.reader.sleep();
+				checkPeer(creator);
+			}
+		}
+		RINGORDER();
+		return waiting;
+	}
+	// Blocks until no more than limit bytes are in the ring, returning how many are
+	FXuval waitForSpace(bool creator, FXuval limit)
+	{
+		SharedRing &r=*writering;
+		FXuval waiting;
+		while((waiting=r.waiting())>limit)
+		{
+			if(peerClosed(creator)) FXERRGCONLOST("Connection Lost", 0);
+			for(int n=0; n<spins && r.waiting()>limit; n++) RINGPAUSE();
+			if(r.waiting()<=limit) continue;
+			r.writer.prepare();
+			if(r.waiting()<=limit || peerClosed(creator)) r.writer.cancel();
+			else
+			{
+				r.writer.sleep();
+				checkPeer(creator);
+			}
+		}
+		RINGORDER();
+		return waiting;
+	}
+	FXuval ringRead(bool creator, char *data, FXuval maxlen)
+	{
+		SharedRing &r=*readring;
+		FXuval readed=FXMIN(maxlen, waitForData(creator));
+		FXuval pos=r.tail & mask, first=FXMIN(readed, capacity-pos);
+		memcpy(data, readdata+pos, first);
+		memcpy(data+first, readdata, readed-first);
+		RINGORDER();
+		r.tail+=readed;
+		RINGFENCE();
+		r.writer.wake();
+		return readed;
+	}
+	void ringWrite(bool creator, const char *data, FXuval maxlen)
+	{
+		SharedRing &r=*writering;
+		// Nothing will ever read it
+		if(peerClosed(creator)) FXERRGCONLOST("Connection Lost", 0);
+		for(FXuval n=0; n<maxlen;)
+		{
+			FXuval space=capacity-waitForSpace(creator, capacity-1);
+			FXuval len=FXMIN(maxlen-n, space);
+			FXuval pos=r.head & mask, first=FXMIN(len, capacity-pos);
+			memcpy(writedata+pos, data+n, first);
+			memcpy(writedata, data+n+first, len-first);
+			RINGORDER();
+			r.head+=len; n+=len;
+			RINGFENCE();
+			r.reader.wake();
+		}
+	}
+	// Wakes anything sleeping on the rings so it can notice an end has closed
+	void wakeRings()
+	{
+		RINGFENCE();
+		for(int n=0; n<2; n++)
+		{
+			header->rings[n].reader.wake(true);
+			header->rings[n].writer.wake(true);
+		}
+	}
+};
+
+void *QShrdMemPipe::int_getOSHandle() const
+{
+	return 0;
+}
+
+QShrdMemPipe::QShrdMemPipe() : p(0), creator(false), anonymous(true), QIODeviceS()
+{
+	FXERRHM(p=new QShrdMemPipePrivate(256*1024));
+}
+
+QShrdMemPipe::QShrdMemPipe(const FXString &name, FXuval ringsize) : p(0), creator(false), anonymous(false), QIODeviceS()
+{
+	FXRBOp unconstr=FXRBConstruct(this);
+	FXERRHM(p=new QShrdMemPipePrivate(ringsize));
+	if(name.empty())
+		setUnique(true);
+	else
+		setName(name);
+	unconstr.dismiss();
+}
+
+QShrdMemPipe::~QShrdMemPipe()
+{ FXEXCEPTIONDESTRUCT1 {
+	close();
+	FXDELETE(p);
+} FXEXCEPTIONDESTRUCT2; }
+
+const FXString &QShrdMemPipe::name() const
+{
+	return p->name;
+}
+
+void QShrdMemPipe::setName(const FXString &name)
+{
+	close();
+	p->name=name;
+	setUnique(false);
+}
+
+FXuval QShrdMemPipe::ringSize() const
+{
+	QMtxHold h(p);
+	return p->header ? p->capacity : p->ringsize;
+}
+
+void QShrdMemPipe::setRingSize(FXuval size)
+{
+	QMtxHold h(p);
+	p->ringsize=size;
+}
+
+bool QShrdMemPipe::create(FXuint mode)
+{
+	QMtxHold h(p);
+	if(isOpen())
+	{	// I keep fouling myself up here, so assertion check
+		if(QIODevice::mode()!=mode) FXERRGIO(QTrans::tr("QShrdMemPipe", "Device reopen has different mode"));
+		return true;
+	}
+	FXuval capacity=4096;
+	while(capacity<p->ringsize) capacity<<=1;
+	FXuval total=sizeof(SharedHeader)+2*capacity;
+	FXERRHM(p->map=new QMemMap(anonymous ? FXString() : p->name, total));
+	FXRBOp unmap=FXRBNew(p->map);
+	p->map->setPermissions(p->acl);
+	p->map->open(IO_ReadWrite|(mode & IO_DontUnlink));
+	SharedHeader *header;
+	if(p->map->reloadSize()>=sizeof(SharedHeader))
+	{	// If the name was in use it's opened rather than created, so only reclaim it if its creator has gone
+		FXERRHM(header=(SharedHeader *) p->map->mapIn(0, sizeof(SharedHeader)));
+		bool inuse=MAGIC==header->magic && (header->ends & CreatorOpen) && !QShrdMemPipePrivate::processGone(header->pids[0]);
+		p->map->mapOut(header);
+		if(inuse) FXERRGIO(QTrans::tr("QShrdMemPipe", "Shared memory pipe name is already in use"));
+	}
+	// Make sure what's being reclaimed is the right size
+	p->map->truncate(total);
+	FXERRHM(header=(SharedHeader *) p->map->mapIn());
+	memset(header, 0, sizeof(SharedHeader));
+	header->magic=MAGIC;
+	header->version=VERSION;
+	header->capacity=capacity;
+	header->pids[0]=(FXint) FXProcess::id();
+	RINGFENCE();
+	header->ends=CreatorOpen;
+	unmap.dismiss();
+	if(anonymous) p->name=p->map->name();
+	p->header=header;
+	p->setup(true);
+	setFlags((mode & IO_ModeMask)|IO_Open);
+	creator=true;
+	return true;
+}
+
+bool QShrdMemPipe::open(FXuint mode)
+{
+	QMtxHold h(p);
+	if(isOpen())
+	{	// I keep fouling myself up here, so assertion check
+		if(QIODevice::mode()!=mode) FXERRGIO(QTrans::tr("QShrdMemPipe", "Device reopen has different mode"));
+		return true;
+	}
+	FXuval total;
+	{	// Find out how big it is from its header
+		QMemMap headermap(p->name, sizeof(SharedHeader));
+		headermap.open(IO_ReadOnly);
+		SharedHeader *header;
+		FXERRHM(header=(SharedHeader *) headermap.mapIn());
+		if(MAGIC!=header->magic || VERSION!=header->version)
+			FXERRGIO(QTrans::tr("QShrdMemPipe", "Not a shared memory pipe"));
+		total=sizeof(SharedHeader)+2*header->capacity;
+	}
+	FXERRHM(p->map=new QMemMap(p->name, total));
+	FXRBOp unmap=FXRBNew(p->map);
+	p->map->open(IO_ReadWrite);
+	SharedHeader *header;
+	FXERRHM(header=(SharedHeader *) p->map->mapIn());
+	if(!RINGCAS(&header->ends, (FXuint) CreatorOpen, (FXuint)(CreatorOpen|ClientOpen)))
+		FXERRGIO(QTrans::tr("QShrdMemPipe", "Shared memory pipe is already connected or closed"));
+	header->pids[1]=(FXint) FXProcess::id();
+	unmap.dismiss();
+	p->header=header;
+	p->setup(false);
+	setFlags((mode & IO_ModeMask)|IO_Open);
+	creator=false;
+	return true;
+}
+
+void QShrdMemPipe::close()
+{
+	if(p && isOpen())
+	{
+		QMtxHold h(p);
+		if(p->header)
+		{	// Whatever is in the rings stays readable by the other end
+			p->closing=true;
+			RINGFENCE();
+			if(creator)
+				p->updateEnds(CreatorOpen, 0);
+			else
+				p->updateEnds(ClientOpen, ClientClosed);
+			while(p->users)
+			{	// Other threads in this process blocked on the rings must leave before they're unmapped
+				p->wakeRings();
+				QThread::yield();
+			}
+			p->wakeRings();
+			p->header=0;
+			p->readring=p->writering=0;
+			p->readdata=p->writedata=0;
+		}
+		FXDELETE(p->map);
+		p->closing=false;
+	}
+	setFlags(0);
+}
+
+void QShrdMemPipe::flush()
+{
+	if(isOpen() && isWriteable())
+	{
+		QShrdMemPipePrivate::User user(p);
+		p->waitForSpace(creator, 0);
+	}
+}
+
+FXfval QShrdMemPipe::size() const
+{
+	if(isOpen() && p->readring)
+	{
+		++p->users;
+		FXfval waiting=(p->closing || !p->readring) ? 0 : p->readring->waiting();
+		--p->users;
+		return waiting;
+	}
+	return 0;
+}
+
+const FXACL &QShrdMemPipe::permissions() const
+{
+	QMtxHold h(p);
+	return p->map ? p->map->permissions() : p->acl;
+}
+
+void QShrdMemPipe::setPermissions(const FXACL &perms)
+{
+	QMtxHold h(p);
+	if(p->map) p->map->setPermissions(perms);
+	p->acl=perms;
+}
+
+FXuval QShrdMemPipe::readBlock(char *data, FXuval maxlen)
+{	// The ring needs no lock as only this thread reads it, and close() waits for us to leave
+	if(!isReadable()) FXERRGIO(QTrans::tr("QShrdMemPipe", "Not open for reading"));
+	if(!isOpen() || !maxlen) return 0;
+	QShrdMemPipePrivate::User user(p);
+	return p->ringRead(creator, data, maxlen);
+}
+
+FXuval QShrdMemPipe::writeBlock(const char *data, FXuval maxlen)
+{	// The ring needs no lock as only this thread writes it, and close() waits for us to leave
+	if(!isWriteable()) FXERRGIO(QTrans::tr("QShrdMemPipe", "Not open for writing"));
+	if(!isOpen() || !maxlen) return 0;
+	{
+		QShrdMemPipePrivate::User user(p);
+		p->ringWrite(creator, data, maxlen);
+	}
+	if(isRaw()) flush();
+	return maxlen;
+}
+
+int QShrdMemPipe::ungetch(int c)
+{
+	return -1;
+}
+
+}
@@ -39,8 +39,10 @@ FXuint systemProcessors;
 
 #include <qvaluelist.h>
 #include <qptrlist.h>
+#include <qptrdenselist.h>
 #include <qptrdict.h>
 #include <qsortedlist.h>
+#include <algorithm>
 #include "QTrans.h"
 #include "FXApp.h"
 #include "FXProcess.h"
@@ -1791,8 +1793,8 @@ public:
 			delete this;
 		}
 	};
-	QPtrList<Thread> threads;
-	QPtrList<CodeItem> timed, waiting;
+	QPtrDenseList<Thread> threads;
+	QPtrDenseList<CodeItem> timed, waiting;
 	QPtrDict<QWaitCondition> waitingwcs;
 	QPtrDict<FXuint> timedtimes;
 
@@ -1801,7 +1803,7 @@ public:
 	{
 		QMtxHold h(this);
 		Thread *t;
-		for(QPtrListIterator<Thread> it(threads); (t=it.current()); ++it)
+		for(QPtrDenseListIterator<Thread> it(threads); (t=it.current()); ++it)
 			t->requestTermination();
 		h.unlock();
 		// Not especially pleasant this, but it's also not awful
@@ -2029,7 +2031,7 @@ void QThreadPool::startThreads(FXuint newno)
 		}
 	}
 	p->total=newno;
-	for(QPtrListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
+	for(QPtrDenseListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
 	{
 		if(!t->running()) t->start();
 	}
@@ -2083,7 +2085,7 @@ QThreadPool::handle QThreadPool::dispatch(FXAutoPtr<Generic::BoundFunctorV> code
 		if(p->free)
 		{
 			QThreadPoolPrivate::Thread *t;
-			for(QPtrListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
+			for(QPtrDenseListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
 			{
 				if(t->free && !t->codeitem)
 				{
@@ -2119,7 +2121,7 @@ QThreadPool::CancelledState QThreadPool::cancel(QThreadPool::handle _code, bool
 	QMtxHold h(p);
 	//fxmessage("Thread pool cancel %p\n", code);
 	QThreadPoolPrivate::CodeItem *ci;
-	for(QPtrListIterator<QThreadPoolPrivate::CodeItem> it=p->waiting; (ci=it.current()); ++it)
+	for(QPtrDenseListIterator<QThreadPoolPrivate::CodeItem> it=p->waiting; (ci=it.current()); ++it)
 	{
 		if(PtrPtr(ci->code)==code)
 		{
@@ -2132,7 +2134,7 @@ QThreadPool::CancelledState QThreadPool::cancel(QThreadPool::handle _code, bool
 		h.unlock();
 		QMtxHold h2(mastertimekeeperlock);
 		h.relock();
-		for(QPtrListIterator<QThreadPoolPrivate::CodeItem> it=p->waiting; (ci=it.current()); ++it)
+		for(QPtrDenseListIterator<QThreadPoolPrivate::CodeItem> it=p->waiting; (ci=it.current()); ++it)
 		{
 			if(PtrPtr(ci->code)==code)
 			{
@@ -2159,20 +2161,22 @@ QThreadPool::CancelledState QThreadPool::cancel(QThreadPool::handle _code, bool
 			h2.unlock();	// Unlock time keeper
 			{	// Ok, is it currently being executed? If so, wait till it's done
 				QThreadPoolPrivate::Thread *t;
-				for(QPtrListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
+				for(QPtrDenseListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
 				{
-					if(t->codeitem && PtrPtr(t->codeitem->code)==code)
-					{	// Wait for it to complete
-						if(QThread::id()==t->myId())
-						{
-							FXERRH(!wait, "You cannot cancel a thread pool dispatch from within that dispatch with wait as a deadlock would occur!", 0, FXERRH_ISDEBUG);
-						}
-						//fxmessage("Thread pool cancel %p waiting for completion\n", code);
-						h.unlock();
-						if(wait) { QMtxHold h3(t); }
-						// Should be deleted if we waited
-						return WasRunning;
+					if(t->codeitem && PtrPtr(t->codeitem->code)==code) break;
+				}
+				// The iterator must leave the list's chain before the lock is released
+				if(t)
+				{	// Wait for it to complete
+					if(QThread::id()==t->myId())
+					{
+						FXERRH(!wait, "You cannot cancel a thread pool dispatch from within that dispatch with wait as a deadlock would occur!", 0, FXERRH_ISDEBUG);
 					}
+					//fxmessage("Thread pool cancel %p waiting for completion\n", code);
+					h.unlock();
+					if(wait) { QMtxHold h3(t); }
+					// Should be deleted if we waited
+					return WasRunning;
 				}
 			}
 			//fxmessage("Thread pool cancel %p not found!\n", code);
@@ -2213,7 +2217,7 @@ bool QThreadPool::wait(QThreadPool::handle _code, FXuint period)
 	QMtxHold h(p);
 	QThreadPoolPrivate::CodeItem *ci;
 	// Search the waiting list
-	for(QPtrListIterator<QThreadPoolPrivate::CodeItem> it=p->waiting; (ci=it.current()); ++it)
+	for(QPtrDenseListIterator<QThreadPoolPrivate::CodeItem> it=p->waiting; (ci=it.current()); ++it)
 	{
 		if(PtrPtr(ci->code)==code)
 			break;
@@ -2221,7 +2225,7 @@ bool QThreadPool::wait(QThreadPool::handle _code, FXuint period)
 	if(!ci)
 	{	// Search the running jobs
 		QThreadPoolPrivate::Thread *t;
-		for(QPtrListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
+		for(QPtrDenseListIterator<QThreadPoolPrivate::Thread> it(p->threads); (t=it.current()); ++it)
 		{
 			if(t->codeitem && PtrPtr(t->codeitem->code)==code) break;
 		}
@@ -2261,5 +2265,103 @@ bool QThreadPool::wait(QThreadPool::handle _code, FXuint period)
 	return true;
 }
 
-} // namespace
+/**************************************************************************************************************/
+
+struct FXDLLLOCAL ParallelSortRound
+{	// Reference counted as pool threads may get round to it after the caller has finished
+	struct Less
+	{
+		bool (*less)(void *, FXuint, FXuint);
+		void *ctx;
+		Less(bool (*_less)(void *, FXuint, FXuint), void *_ctx) : less(_less), ctx(_ctx) { }
+		bool operator()(FXuint a, FXuint b) const { return less(ctx, a, b); }
+	};
+	struct Job
+	{
+		FXuint *src, *dest, lb, mid, ub;
+		Job(FXuint *_src, FXuint *_dest, FXuint _lb, FXuint _mid, FXuint _ub) : src(_src), dest(_dest), lb(_lb), mid(_mid), ub(_ub) { }
+	};
+	FXAtomicInt refs, next, done;
+	Less less;
+	std::vector<Job> jobs;
+	ParallelSortRound(const Less &_less) : refs(1), less(_less) { }
+	void release()
+	{
+		if(!--refs) delete this;
+	}
+	bool runOne()
+	{
+		FXuint idx=(FXuint)(next++);
+		if(idx>=jobs.size()) return false;
+		const Job &j=jobs[idx];
+		if(!j.src)
+			std::stable_sort(j.dest+j.lb, j.dest+j.ub, less);
+		else if(j.mid==j.ub)
+			memcpy(j.dest+j.lb, j.src+j.lb, (j.ub-j.lb)*sizeof(FXuint));
+		else
+			std::merge(j.src+j.lb, j.src+j.mid, j.src+j.mid, j.src+j.ub, j.dest+j.lb, less);
+		++done;
+		return true;
+	}
+	void worker()
+	{
+		while(runOne());
+		release();
+	}
+	void run()
+	{	// Dispatch helpers to the pool and pitch in ourselves
+		QThreadPool &pool=FXProcess::threadPool();
+		FXuint helpers=FXMIN((FXuint) jobs.size()-1, pool.total());
+		for(FXuint n=0; n<helpers; n++)
+		{
+			++refs;
+			pool.dispatch(Generic::BindObjN(*this, &ParallelSortRound::worker));
+		}
+		while(runOne());
+		while((FXuint)(int) done<jobs.size())
+			QThread::yield();
+	}
+};
 
+void int_parallelSort(FXuint *idxs, FXuint count, bool (*less)(void *ctx, FXuint a, FXuint b), void *ctx)
+{
+	static const FXuint minRun=8192;
+	ParallelSortRound::Less lessf(less, ctx);
+	FXuint runs=FXProcess::noOfProcessors();
+	while(runs>1 && count/runs<minRun) runs>>=1;
+	if(runs<=1)
+	{
+		std::stable_sort(idxs, idxs+count, lessf);
+		return;
+	}
+	std::vector<FXuint> bounds, temp;
+	FXEXCEPTION_STL1 {
+		temp.resize(count);
+		for(FXuint n=0; n<=runs; n++)
+			bounds.push_back((FXuint)(((FXulong) count*n)/runs));
+	} FXEXCEPTION_STL2;
+	FXuint *src=idxs, *dest=&temp.front();
+	ParallelSortRound *round;
+	FXERRHM(round=new ParallelSortRound(lessf));
+	FXRBOp unround=FXRBObj(*round, &ParallelSortRound::release);
+	for(FXuint n=0; n<runs; n++)
+		round->jobs.push_back(ParallelSortRound::Job(0, src, bounds[n], bounds[n+1], bounds[n+1]));
+	round->run();
+	unround.dismiss();
+	round->release();
+	for(FXuint width=1; width<runs; width<<=1)
+	{	// Merge pairs of adjacent runs, ping-ponging between the two buffers
+		FXERRHM(round=new ParallelSortRound(lessf));
+		FXRBOp unround=FXRBObj(*round, &ParallelSortRound::release);
+		for(FXuint n=0; n<runs; n+=2*width)
+			round->jobs.push_back(ParallelSortRound::Job(src, dest, bounds[n], bounds[FXMIN(n+width, runs)], bounds[FXMIN(n+2*width, runs)]));
+		round->run();
+		unround.dismiss();
+		round->release();
+		FXuint *t=src; src=dest; dest=t;
+	}
+	if(src!=idxs)
+		memcpy(idxs, src, count*sizeof(FXuint));
+}
+
+} // namespace
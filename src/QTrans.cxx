@@ -22,6 +22,7 @@
 #include <qdict.h>
 #include <qcstring.h>
 #include <qptrlist.h>
+#include <qptrdenselist.h>
 #include <qptrvector.h>
 #include <qvaluelist.h>
 #include <stdarg.h>
@@ -95,15 +96,15 @@ public:
 		const void *staticaddr, *modulestart, *moduleend;
 		FXString modulepath;
 		QDict<LangTrans> langs; // by <langid>[_<region>[@<modifier>]]
-		QPtrList<FXString> srcfiles, classnames, hints, transstrs;
+		QPtrDenseList<FXString> srcfiles, classnames, hints, transstrs;
 		ModuleTrans(const void *sa, const void *modstart, const void *modend, const FXString &modpath)
 			: staticaddr(sa), modulestart(modstart), moduleend(modend), modulepath(modpath),
 			langs(7, true, true), srcfiles(true), classnames(true), hints(true), transstrs(true) { }
-		FXString *getLiteral(QPtrList<FXString> &list, const FXString &str) const
+		FXString *getLiteral(QPtrDenseList<FXString> &list, const FXString &str) const
 		{
 			if(str.empty()) return 0;
 			FXString *ret;
-			for(QPtrListIterator<FXString> it(list); (ret=it.current()); ++it)
+			for(QPtrDenseListIterator<FXString> it(list); (ret=it.current()); ++it)
 			{
 				if(*ret==str) return ret;
 			}
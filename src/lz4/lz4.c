@@ -0,0 +1,271 @@
+/* lz4.c
+A small, self contained implementation of the LZ4 block format. See lz4.h.
+*/
+
+#include "lz4.h"
+#include <string.h>
+
+typedef unsigned char u8;
+typedef unsigned int u32;
+
+#define MINMATCH 4
+#define LASTLITERALS 5			/* The last five bytes are always literals */
+#define MFLIMIT 12				/* No match may start within the last twelve bytes */
+#define MAXDISTANCE 65535
+#define HASHLOG 13
+#define SKIPSTRENGTH 6			/* How quickly to speed up over incompressible data */
+#define ML_MASK 15
+#define RUN_MASK 15
+
+static u32 read32(const u8 *p)
+{
+	return (u32) p[0] | ((u32) p[1]<<8) | ((u32) p[2]<<16) | ((u32) p[3]<<24);
+}
+
+/* Copies in eight byte chunks, so may write up to seven bytes beyond dst+len */
+static void wildCopy(u8 *dst, const u8 *src, size_t len)
+{
+	u8 *end=dst+len;
+	do
+	{
+		memcpy(dst, src, 8);
+		dst+=8; src+=8;
+	} while(dst<end);
+}
+
+/* Returns how many bytes at a and b match, comparing no further than limit */
+static size_t matchLength(const u8 *a, const u8 *b, const u8 *limit)
+{
+	const u8 *start=a;
+	size_t wa, wb;
+	while(a+sizeof(size_t)<=limit)
+	{
+		memcpy(&wa, a, sizeof(size_t));
+		memcpy(&wb, b, sizeof(size_t));
+		if(wa!=wb) break;
+		a+=sizeof(size_t); b+=sizeof(size_t);
+	}
+	while(a<limit && *a==*b)
+	{
+		a++; b++;
+	}
+	return a-start;
+}
+
+static u32 hash32(u32 seq)
+{
+	return (seq*2654435761U)>>(32-HASHLOG);
+}
+
+static u8 *putLength(u8 *op, size_t len)
+{
+	for(; len>=255; len-=255) *op++=255;
+	*op++=(u8) len;
+	return op;
+}
+
+/* Writes literals then, if matchlen is nonzero, a match. Returns zero if it won't fit */
+static u8 *putSequence(u8 *op, const u8 *oend, const u8 *literals, size_t litlen, u32 offset, size_t matchlen)
+{
+	u8 *token;
+	size_t ml=matchlen ? matchlen-MINMATCH : 0;
+	/* The token, literals and their length, offset and match length */
+	if((size_t)(oend-op)<1+litlen+litlen/255+1+2+ml/255+1) return 0;
+	token=op++;
+	if(litlen>=RUN_MASK)
+	{
+		*token=RUN_MASK<<4;
+		op=putLength(op, litlen-RUN_MASK);
+	}
+	else *token=(u8)(litlen<<4);
+	memcpy(op, literals, litlen);
+	op+=litlen;
+	if(!matchlen) return op;
+	*op++=(u8) offset;
+	*op++=(u8)(offset>>8);
+	if(ml>=ML_MASK)
+	{
+		*token|=ML_MASK;
+		op=putLength(op, ml-ML_MASK);
+	}
+	else *token|=(u8) ml;
+	return op;
+}
+
+int TnFXLZ4_compress(const char *src, char *dst, int srclen, int dstcap)
+{
+	const u8 *base=(const u8 *) src, *ip=base, *anchor=base, *iend=base+srclen;
+	u8 *op=(u8 *) dst, *oend=op+dstcap;
+	u32 table[1<<HASHLOG];
+	if(srclen<0 || srclen>TNFXLZ4_MAXINPUTSIZE || dstcap<1) return 0;
+	if(srclen>MFLIMIT)
+	{
+		const u8 *mflimit=iend-MFLIMIT, *matchlimit=iend-LASTLITERALS;
+		u32 searches=1<<SKIPSTRENGTH;
+		memset(table, 0, sizeof(table));
+		ip++;
+		while(ip<mflimit)
+		{
+			u32 seq=read32(ip), h=hash32(seq);
+			const u8 *ref=base+table[h];
+			table[h]=(u32)(ip-base);
+			if(ref<ip && ip-ref<=MAXDISTANCE && read32(ref)==seq)
+			{
+				const u8 *mp=ip+MINMATCH;
+				mp+=matchLength(mp, ref+MINMATCH, matchlimit);
+				while(ip>anchor && ref>base && ip[-1]==ref[-1])
+				{
+					ip--; ref--;
+				}
+				if(!(op=putSequence(op, oend, anchor, ip-anchor, (u32)(ip-ref), mp-ip))) return 0;
+				ip=anchor=mp;
+				searches=1<<SKIPSTRENGTH;
+				/* Remember a position inside the match so runs chain together */
+				if(ip<mflimit) table[hash32(read32(ip-2))]=(u32)(ip-2-base);
+			}
+			else ip+=searches++>>SKIPSTRENGTH;
+		}
+	}
+	if(!(op=putSequence(op, oend, anchor, iend-anchor, 0, 0))) return 0;
+	return (int)(op-(u8 *) dst);
+}
+
+/* Reads an extended length, returning zero if the input runs out */
+static const u8 *getLength(const u8 *ip, const u8 *iend, size_t *len)
+{
+	u8 s;
+	do
+	{
+		if(ip>=iend) return 0;
+		*len+=(s=*ip++);
+	} while(255==s);
+	return ip;
+}
+
+int TnFXLZ4_decompress(const char *src, char *dst, int srclen, int dstcap)
+{
+	const u8 *ip=(const u8 *) src, *iend=ip+srclen;
+	u8 *obase=(u8 *) dst, *op=obase, *oend=op+dstcap;
+	if(srclen<=0 || dstcap<0) return -1;
+	for(;;)
+	{
+		u8 token;
+		size_t litlen, matchlen;
+		u32 offset;
+		const u8 *match;
+		if(ip>=iend) return -1;
+		token=*ip++;
+		litlen=token>>4;
+		if(RUN_MASK==litlen && !(ip=getLength(ip, iend, &litlen))) return -1;
+		if(litlen>(size_t)(iend-ip) || litlen>(size_t)(oend-op)) return -1;
+		if(litlen+8<=(size_t)(iend-ip) && litlen+8<=(size_t)(oend-op))
+			wildCopy(op, ip, litlen);
+		else
+			memcpy(op, ip, litlen);
+		op+=litlen; ip+=litlen;
+		if(ip==iend) break;			/* The last sequence has no match */
+		if(iend-ip<2) return -1;
+		offset=ip[0] | ((u32) ip[1]<<8);
+		ip+=2;
+		if(!offset || offset>(size_t)(op-obase)) return -1;
+		matchlen=token & ML_MASK;
+		if(ML_MASK==matchlen && !(ip=getLength(ip, iend, &matchlen))) return -1;
+		matchlen+=MINMATCH;
+		if(matchlen>(size_t)(oend-op)) return -1;
+		match=op-offset;
+		if(offset>=8 && matchlen+8<=(size_t)(oend-op))
+			wildCopy(op, match, matchlen);
+		else if(1==offset)
+			memset(op, *match, matchlen);
+		else if(offset>=matchlen)
+			memcpy(op, match, matchlen);
+		else
+		{	/* Overlapping copies repeat the pattern */
+			size_t n;
+			for(n=0; n<matchlen; n++) op[n]=match[n];
+		}
+		op+=matchlen;
+	}
+	return (int)(op-obase);
+}
+
+int TnFXLZ4_decompressedSize(const char *src, int srclen, int maxlen)
+{
+	const u8 *ip=(const u8 *) src, *iend=ip+srclen;
+	size_t total=0;
+	if(srclen<=0 || maxlen<0) return -1;
+	for(;;)
+	{
+		u8 token;
+		size_t litlen, matchlen;
+		u32 offset;
+		if(ip>=iend) return -1;
+		token=*ip++;
+		litlen=token>>4;
+		if(RUN_MASK==litlen && !(ip=getLength(ip, iend, &litlen))) return -1;
+		if(litlen>(size_t)(iend-ip)) return -1;
+		ip+=litlen;
+		total+=litlen;
+		if(ip==iend) break;
+		if(iend-ip<2) return -1;
+		offset=ip[0] | ((u32) ip[1]<<8);
+		ip+=2;
+		if(!offset || offset>total) return -1;
+		matchlen=token & ML_MASK;
+		if(ML_MASK==matchlen && !(ip=getLength(ip, iend, &matchlen))) return -1;
+		total+=matchlen+MINMATCH;
+		if(total>(size_t) maxlen) return -1;
+	}
+	return total>(size_t) maxlen ? -1 : (int) total;
+}
+
+#define PRIME32_1 2654435761U
+#define PRIME32_2 2246822519U
+#define PRIME32_3 3266489917U
+#define PRIME32_4 668265263U
+#define PRIME32_5 374761393U
+#define ROTL32(x, r) (((x)<<(r)) | ((x)>>(32-(r))))
+
+static u32 xxh32round(u32 acc, u32 input)
+{
+	acc+=input*PRIME32_2;
+	acc=ROTL32(acc, 13);
+	return acc*PRIME32_1;
+}
+
+unsigned int TnFXLZ4_xxh32(const void *data, size_t len, unsigned int seed)
+{
+	const u8 *p=(const u8 *) data, *bend=p+len;
+	u32 h32;
+	if(len>=16)
+	{
+		const u8 *limit=bend-16;
+		u32 v1=seed+PRIME32_1+PRIME32_2, v2=seed+PRIME32_2, v3=seed, v4=seed-PRIME32_1;
+		do
+		{
+			v1=xxh32round(v1, read32(p)); p+=4;
+			v2=xxh32round(v2, read32(p)); p+=4;
+			v3=xxh32round(v3, read32(p)); p+=4;
+			v4=xxh32round(v4, read32(p)); p+=4;
+		} while(p<=limit);
+		h32=ROTL32(v1, 1)+ROTL32(v2, 7)+ROTL32(v3, 12)+ROTL32(v4, 18);
+	}
+	else h32=seed+PRIME32_5;
+	h32+=(u32) len;
+	for(; p+4<=bend; p+=4)
+	{
+		h32+=read32(p)*PRIME32_3;
+		h32=ROTL32(h32, 17)*PRIME32_4;
+	}
+	for(; p<bend; p++)
+	{
+		h32+=(*p)*PRIME32_5;
+		h32=ROTL32(h32, 11)*PRIME32_1;
+	}
+	h32^=h32>>15;
+	h32*=PRIME32_2;
+	h32^=h32>>13;
+	h32*=PRIME32_3;
+	h32^=h32>>16;
+	return h32;
+}
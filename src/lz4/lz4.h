@@ -0,0 +1,44 @@
+/* lz4.h
+A small, self contained implementation of the LZ4 block format and the xxHash32
+checksum used by the LZ4 frame format, as specified at http://www.lz4.org/.
+Output is readable by the reference lz4 library and tools and vice versa.
+
+Everything here is reentrant and allocates nothing.
+*/
+
+#ifndef TNFXLZ4_H
+#define TNFXLZ4_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The largest input a single call will process (an LZ4 frame's blocks are at most 4Mb) */
+#define TNFXLZ4_MAXINPUTSIZE 0x7E000000
+
+/* Returns the most that TnFXLZ4_compress() can output for srclen bytes of input */
+#define TNFXLZ4_COMPRESSBOUND(srclen) ((srclen)+((srclen)/255)+16)
+
+/* Compresses srclen bytes at src into at most dstcap bytes at dst as one LZ4 block,
+returning the compressed size or zero if it didn't fit */
+extern int TnFXLZ4_compress(const char *src, char *dst, int srclen, int dstcap);
+
+/* Decompresses the LZ4 block of srclen bytes at src into at most dstcap bytes at dst,
+returning the decompressed size or -1 if the block is malformed or doesn't fit.
+Never reads or writes outside the buffers given, whatever the input */
+extern int TnFXLZ4_decompress(const char *src, char *dst, int srclen, int dstcap);
+
+/* Returns the size the LZ4 block of srclen bytes at src decompresses to without
+decompressing it, or -1 if it is malformed or decompresses to more than maxlen */
+extern int TnFXLZ4_decompressedSize(const char *src, int srclen, int maxlen);
+
+/* Returns the 32 bit xxHash of len bytes at data */
+extern unsigned int TnFXLZ4_xxh32(const void *data, size_t len, unsigned int seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif